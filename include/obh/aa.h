@@ -0,0 +1,68 @@
+/*****************************************************
+Create Date:        2024-12-08
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef AA_H
+#define AA_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+
+enum AAMode {
+    AA_OFF,
+    AA_MSAA_2X,
+    AA_MSAA_4X,
+    AA_FXAA,
+    AA_MODE_COUNT,
+};
+
+/*
+ * Anti-aliasing for an offscreen scene target (the dynres target).
+ * MSAA modes draw into a multisampled framebuffer of the same size and
+ * resolve into the scene target, FXAA draws straight into it and
+ * filters while it is copied to the window.
+ */
+struct AntiAliasing {
+    enum AAMode mode;
+    /* what passes should draw into this frame, msaa fbo or the scene target */
+    RenderTexture2D draw_target;
+
+    unsigned int msaa_fbo, msaa_color, msaa_depth;
+    int msaa_width, msaa_height, msaa_samples;
+    /* clamped to GL_MAX_SAMPLES, 0 if multisampled fbos are unsupported */
+    int max_samples;
+
+    Shader fxaa;
+    int fxaa_resolution_loc;
+};
+
+typedef struct AntiAliasing AntiAliasing;
+
+void aaInit(AntiAliasing *aa, enum AAMode mode);
+void aaUnload(AntiAliasing *aa);
+/**
+ * switch mode, takes effect at the next aaPrepare
+ */
+void aaSetMode(AntiAliasing *aa, enum AAMode mode);
+const char *aaModeName(enum AAMode mode);
+/**
+ * (re)create the msaa framebuffer for the scene target and pick
+ * draw_target, once per frame before drawing
+ */
+void aaPrepare(AntiAliasing *aa, RenderTexture2D scene);
+void aaBegin(AntiAliasing *aa);
+/**
+ * end drawing and resolve msaa into scene
+ */
+void aaEnd(AntiAliasing *aa, RenderTexture2D scene);
+/**
+ * bracket the draw of the scene to the window, applies FXAA
+ */
+void aaBeginPresent(AntiAliasing *aa, RenderTexture2D scene);
+void aaEndPresent(AntiAliasing *aa);
+
+#endif
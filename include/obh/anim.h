@@ -0,0 +1,120 @@
+/*****************************************************
+Create Date:        2024-12-22
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef ANIM_H
+#define ANIM_H
+
+#include "./incl.h"
+#include "./util.h"
+#include "./simd.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+/* threads posing and skinning, the caller included */
+#define ANIM_MAX_THREADS 16
+/* raylib samples gltf clips into a pose every 17 ms */
+#define ANIM_FRAME_TIME 0.017f
+
+/* a skinned model and its clips, both stay with the caller */
+struct AnimRig {
+    Model model;
+    ModelAnimation *clips;
+    int clip_count, joint_count;
+    /* model space to each joint's space in the bind pose */
+    Matrix *inverse_bind;
+    /* float offset of each mesh in an instance's vertices, -1 if the mesh
+     * has no skin, and floats per instance */
+    int *mesh_offset;
+    int floats;
+    int vertex_count;
+};
+
+struct AnimInstance {
+    int rig;
+    Vector3 position;
+    /* clip playing and the one faded out of, -1 for none */
+    int clip, from_clip;
+    float time, from_time, speed;
+    /* 0 is all from_clip, 1 all clip, rising by fade_rate a second */
+    float blend, fade_rate;
+    /* seconds between poses from the distance to the camera, and seconds
+     * gone by since the last one */
+    float interval, pending;
+    /* posed on the last animUpdate */
+    bool posed;
+    /* joint_count joint matrices as 4 columns */
+    v4f *palette;
+    /* every skinned mesh's positions then normals */
+    float *vertices;
+};
+
+/*
+ * Keyframe animation for crowds of skinned models. Every update samples
+ * and blends the clips of each instance due, builds its joint palette and
+ * skins its vertices on the cpu, spread over a thread pool. A vertex's
+ * joint matrices are blended by weight and applied a column at a time in 4
+ * wide vectors. Instances far from the camera are posed less often, down
+ * to every lod_interval seconds at lod_far.
+ *
+ * Instances share their rig's vertex buffers, animDraw uploads an
+ * instance's vertices before drawing it.
+ */
+struct AnimSystem {
+    struct AnimRig *rigs;
+    struct AnimInstance *instances;
+    float lod_near, lod_far, lod_interval;
+    bool gpu;
+
+    /* instances the pool poses and skins this update */
+    int *due;
+    JobPool pool;
+
+    /* stats for the last animUpdate */
+    int posed, skipped;
+    u64 vertices;
+    double ms;
+};
+
+typedef struct AnimSystem AnimSystem;
+
+/**
+ * @param threads threads including the caller, <= 0 for one per core
+ * @param gpu draw, false for headless use
+ */
+void animInit(AnimSystem *as, int threads, bool gpu);
+/**
+ * free every instance and rig, models and clips stay with the caller
+ */
+void animUnload(AnimSystem *as);
+/**
+ * @param clips from LoadModelAnimations
+ * @return rig id, -1 if the clips do not fit the model's skeleton
+ */
+int animAddRig(AnimSystem *as, Model model, ModelAnimation *clips, int clip_count);
+/**
+ * @param clip played from its start, -1 for the bind pose
+ * @return instance id
+ */
+int animAddInstance(AnimSystem *as, int rig, int clip, Vector3 position);
+/**
+ * fade instance over to clip from where it is now
+ * @param fade seconds, 0 to cut
+ */
+void animPlay(AnimSystem *as, int instance, int clip, float fade);
+/**
+ * advance, pose and skin every instance due
+ * @param camera instances are posed less often the further they are from it
+ */
+void animUpdate(AnimSystem *as, float dt, Vector3 camera);
+/**
+ * draw instance at its position
+ * @param yaw degrees around y
+ */
+void animDraw(AnimSystem *as, int instance, float yaw, float scale, Color tint);
+
+#endif
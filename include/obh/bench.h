@@ -0,0 +1,88 @@
+/*****************************************************
+Create Date:        2024-12-04
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+
+/*
+ * Benchmarks, run as `game --bench <name> [args]`. CPU only benches are
+ * headless, the ones measuring GL work open their own window. Results go
+ * to stdout.
+ *
+ * `game --headless [camera path|-] [results.json] [golden]` renders the
+ * game itself in a hidden window along a camera path and writes the
+ * results below as json.
+ */
+
+/* one recorded camera, "px py pz tx ty tz fovy" per line on disk */
+struct BenchCamera {
+    Vector3 position, target;
+    float fovy;
+};
+
+/**
+ * @return stb_ds array of cameras read from path, NULL if it can not be read
+ */
+struct BenchCamera *benchLoadCameraPath(const char *path);
+/**
+ * @return stb_ds array with a low orbit around the origin
+ */
+struct BenchCamera *benchDefaultCameraPath(int frames);
+/**
+ * append one camera to a path file opened by the caller
+ */
+void benchRecordCamera(FILE *f, Camera3D camera);
+Camera3D benchCamera(struct BenchCamera c);
+
+/* one frame of a `game --headless` run */
+struct BenchFrame {
+    double cpu_ms, gpu_ms;
+    u64 draw_calls, triangles;
+    /* 0 unless checksums were asked for */
+    u32 checksum;
+};
+
+/* frames left out of the summary while shaders compile and the world generates */
+#define BENCH_WARMUP_FRAMES 10
+
+/**
+ * count every draw issued from now on, rlgl's included, by wrapping the
+ * glad entry points, call once after InitWindow. rlgl only goes through
+ * the wrappers when libraylib exports its glad_gl* symbols, exits with an
+ * error when a test draw is not counted
+ */
+void benchCountDraws(void);
+/**
+ * draws and triangles since the last call
+ */
+void benchTakeDrawCounts(u64 *draw_calls, u64 *triangles);
+/**
+ * FNV-1a of the backbuffer, a blocking readback so only when checksums
+ * are asked for. Only comparable on the same driver and resolution.
+ */
+u32 benchChecksumBackbuffer(void);
+/**
+ * summary and per frame results as json
+ */
+bool benchWriteResults(const char *path, const struct BenchFrame *frames, int count);
+/**
+ * compare checksums with a golden file of "frame checksum" lines, the file
+ * is written when it does not exist yet
+ * @return frames that differ, -1 if the file can not be read or written
+ */
+int benchGolden(const char *path, const struct BenchFrame *frames, int count);
+/**
+ * @param argc/argv arguments after `--bench`
+ * @return process exit code
+ */
+int benchMain(int argc, char **argv);
+
+#endif
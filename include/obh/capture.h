@@ -0,0 +1,128 @@
+/*****************************************************
+Create Date:        2024-12-16
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "./incl.h"
+#include "./util.h"
+#include "../raylib/raylib.h"
+
+/* readbacks in flight, a frame is mapped two frames after it was read */
+#define CAPTURE_BUFFERS 3
+/* frames copied out and waiting to be encoded, new captures are dropped past it */
+#define CAPTURE_MAX_BACKLOG 32
+#define CAPTURE_MAX_THREADS 8
+#define CAPTURE_JPG_QUALITY 90
+
+enum CaptureFormat {
+    CAPTURE_PNG,
+    CAPTURE_JPG,
+};
+
+enum CaptureBufferState {
+    CAPTURE_BUFFER_FREE,
+    /* glReadPixels issued, waiting on the fence */
+    CAPTURE_BUFFER_READING,
+    /* mapped, a worker copies it out */
+    CAPTURE_BUFFER_MAPPED,
+    /* copied, unmapped on the next captureFrame */
+    CAPTURE_BUFFER_COPIED,
+};
+
+struct CaptureBuffer {
+    enum CaptureBufferState state;
+    unsigned pbo;
+    /* GLsync */
+    void *fence;
+    int width, height;
+    /* size the pbo was allocated for */
+    size_t size;
+    enum CaptureFormat format;
+    char path[256];
+};
+
+/*
+ * One frame on its way to disk. Workers copy it out of the mapped buffer,
+ * flipped and without alpha, then encode the copy.
+ */
+struct CaptureJob {
+    /* -1 once copied */
+    int buffer;
+    const u8 *mapped;
+    u8 *pixels;
+    int width, height;
+    enum CaptureFormat format;
+    char path[256];
+};
+
+/*
+ * Screenshots and numbered recordings of the backbuffer. The render thread
+ * only issues readbacks into pixel buffers and maps them once their fence
+ * has passed, copying and encoding happen on worker threads.
+ */
+struct Capture {
+    char dir[256];
+    struct CaptureBuffer buffers[CAPTURE_BUFFERS];
+    int next;
+
+    bool screenshot_pending;
+    enum CaptureFormat screenshot_format;
+    int screenshots;
+    /* frames left to record, numbered from 0 under record_name */
+    int record_left, record_index;
+    enum CaptureFormat record_format;
+    char record_name[64];
+
+    /* of CaptureJob, copies are pushed ahead of encodes. Its lock also
+     * guards the buffer states and everything below */
+    WorkQueue queue;
+    /* frames read back and not yet written */
+    int outstanding;
+    /* set by a worker when a write fails, logged by captureFrame */
+    char failed_path[256];
+
+    /* stats, totals since init except where noted */
+    int written, dropped, failed;
+    double encode_ms;
+    /* render thread time in the last captureFrame and the worst since init */
+    double frame_ms, frame_ms_peak;
+};
+
+typedef struct Capture Capture;
+
+/**
+ * @param dir created if missing
+ * @param threads encoder count, <= 0 for one per core but the main thread
+ */
+void captureInit(Capture *c, const char *dir, int threads);
+/**
+ * finish every capture in flight, then stop the workers
+ */
+void captureUnload(Capture *c);
+/**
+ * save the next frame captureFrame sees
+ */
+void captureScreenshot(Capture *c, enum CaptureFormat format);
+/**
+ * save the next frames numbered record_<time>_00000 up, for assembling
+ * into a video, frames 0 stops a recording
+ */
+void captureRecord(Capture *c, int frames, enum CaptureFormat format);
+/**
+ * hand finished readbacks to the workers and read back this frame if a
+ * capture wants it, call after the last draw and before EndDrawing
+ */
+void captureFrame(Capture *c);
+/**
+ * block until every frame read back so far is written
+ */
+void captureWait(Capture *c);
+const char *captureFormatExtension(enum CaptureFormat format);
+
+#endif
@@ -5,4 +5,9 @@
 #include "../glad/glad.h"
 #include "../raylib/raylib.h"
 
+/**
+ * the cube of genVAO as a cpu mesh, not indexed and not uploaded
+ */
+Mesh genCubeMesh();
+
 #endif
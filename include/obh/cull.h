@@ -0,0 +1,47 @@
+/*****************************************************
+Create Date:        2024-12-17
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef CULL_H
+#define CULL_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+
+/**
+ * conservative frustum test, false only if all 8 corners of box are outside
+ * one clip plane
+ * @param view_proj world to clip space
+ */
+static inline bool cullBoxVisible(const Matrix *view_proj, BoundingBox box)
+{
+    const Matrix *m = view_proj;
+    int outside[6] = { 0 };
+    for (int i = 0; i < 8; ++i) {
+        Vector3 c = {
+            (i & 1) ? box.max.x : box.min.x,
+            (i & 2) ? box.max.y : box.min.y,
+            (i & 4) ? box.max.z : box.min.z,
+        };
+        float x = m->m0 * c.x + m->m4 * c.y + m->m8 * c.z + m->m12;
+        float y = m->m1 * c.x + m->m5 * c.y + m->m9 * c.z + m->m13;
+        float z = m->m2 * c.x + m->m6 * c.y + m->m10 * c.z + m->m14;
+        float w = m->m3 * c.x + m->m7 * c.y + m->m11 * c.z + m->m15;
+        outside[0] += x < -w;
+        outside[1] += x > w;
+        outside[2] += y < -w;
+        outside[3] += y > w;
+        outside[4] += z < -w;
+        outside[5] += z > w;
+    }
+    for (int p = 0; p < 6; ++p)
+        if (outside[p] == 8)
+            return false;
+    return true;
+}
+
+#endif
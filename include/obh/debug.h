@@ -1,9 +1,162 @@
+/*****************************************************
+Create Date:        2024-12-14
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef DEBUG_H
+#define DEBUG_H
+
+#include <pthread.h>
+
 #include "incl.h"
+#include "./text.h"
 #include "../raylib/raylib.h"
 #include "../raylib/rlgl.h"
 
-static void DrawTextCodepoint3D(Font font, int codepoint, Vector3 position, float fontSize, bool backface, bool SHOW_LETTER_BOUNDRY, Color tint);
-static void DrawText3D(Font font, const char *text, Vector3 position, float fontSize, float fontSpacing, float lineSpacing, bool backface, Color tint);
-void DrawAxes(Vector3 pos, float len, Font font);
-void DrawGridPos(int slices, float spacing, Vector3 pos);
+/*
+ * Batched debug drawing. DEBUG_* calls append lines and labels to per
+ * thread buffers from anywhere, debugDrawFlush draws everything in one
+ * go once per frame.
+ *
+ * A call costs one load and a branch when its category is switched off,
+ * its arguments are not evaluated. Building with -DDEBUG_DRAW_OFF turns
+ * every call into nothing at all.
+ */
+
+enum DebugDrawCategory {
+    DEBUG_DRAW_AXES   = 1 << 0,
+    DEBUG_DRAW_BOUNDS = 1 << 1,
+    DEBUG_DRAW_GRID   = 1 << 2,
+    DEBUG_DRAW_LIGHTS = 1 << 3,
+    DEBUG_DRAW_CHUNKS = 1 << 4,
+};
+
+#define DEBUG_DRAW_CATEGORY_COUNT 5
+#define DEBUG_DRAW_ALL ((1u << DEBUG_DRAW_CATEGORY_COUNT) - 1)
+/* line segments per circle of a sphere */
+#define DEBUG_DRAW_SPHERE_SEGMENTS 16
+
+struct DebugVertex {
+    Vector3 position;
+    Color color;
+};
+
+struct DebugText {
+    Vector3 position;
+    float size;
+    Color color;
+    /* offset into chars */
+    int text;
+};
+
+/* what one thread pushed since the last flush, one list per category */
+struct DebugDrawBuffer {
+    pthread_mutex_t lock;
+    struct DebugVertex *lines[DEBUG_DRAW_CATEGORY_COUNT];
+    struct DebugText *texts[DEBUG_DRAW_CATEGORY_COUNT];
+    char *chars[DEBUG_DRAW_CATEGORY_COUNT];
+};
+
+struct DebugDraw {
+    /* categories switched on and the master switch, active is what calls test */
+    u32 categories;
+    bool enabled;
+    u32 active;
+
+    pthread_mutex_t lock;
+    struct DebugDrawBuffer **buffers;
+    /* buffers gathered by the last flush */
+    struct DebugVertex *vertices;
+    struct DebugText *texts;
+    char *chars;
+
+    bool gpu;
+    TextFont font;
+    Shader shader;
+    int mvp_loc;
+    unsigned vao, vbo;
+    size_t vbo_size;
+
+    /* stats for the last flush */
+    int lines, labels;
+};
+
+typedef struct DebugDraw DebugDraw;
+
+extern struct DebugDraw debug_draw;
+
+/**
+ * @param font labels are drawn with this, it must outlive debug drawing
+ * @param gpu false only gathers on flush, for headless benches
+ */
+void debugDrawInit(TextFont font, u32 categories, bool gpu);
+void debugDrawUnload(void);
+void debugDrawSetEnabled(bool enabled);
+void debugDrawToggle(u32 category);
+/**
+ * @return name of a single category bit
+ */
+const char *debugDrawCategoryName(u32 category);
+/**
+ * draw and clear everything pushed since the last flush, call inside
+ * BeginMode3D
+ */
+void debugDrawFlush(void);
+
+static inline bool debugDrawEnabled(u32 category)
+{
+    return (__atomic_load_n(&debug_draw.active, __ATOMIC_RELAXED) & category) != 0;
+}
+
+/* use the DEBUG_* macros rather than these, category is a single bit */
+void debugDrawLine(u32 category, Vector3 a, Vector3 b, Color color);
+void debugDrawBox(u32 category, BoundingBox box, Color color);
+void debugDrawSphere(u32 category, Vector3 centre, float radius, Color color);
+/**
+ * label facing the camera with its top left corner at position, size in
+ * world units
+ */
+void debugDrawText(u32 category, Vector3 position, float size, Color color, const char *fmt, ...);
+/**
+ * arrows along +x +y +z labelled with their origin
+ */
+void debugDrawAxes(Vector3 position, float len);
+/**
+ * slices x slices grid on the xz plane, snapped to whole units
+ */
+void debugDrawGrid(int slices, float spacing, Vector3 position);
+
+#ifdef DEBUG_DRAW_OFF
+/* the call sits inside sizeof, never evaluated but its arguments still count as used */
+#define DEBUG_DRAW_DISCARD(call) ((void)sizeof((call), 0))
+#define DEBUG_LINE(category, a, b, color) \
+    DEBUG_DRAW_DISCARD(debugDrawLine((category), (a), (b), (color)))
+#define DEBUG_BOX(category, box, color) \
+    DEBUG_DRAW_DISCARD(debugDrawBox((category), (box), (color)))
+#define DEBUG_SPHERE(category, centre, radius, color) \
+    DEBUG_DRAW_DISCARD(debugDrawSphere((category), (centre), (radius), (color)))
+#define DEBUG_TEXT(category, position, size, color, ...) \
+    DEBUG_DRAW_DISCARD(debugDrawText((category), (position), (size), (color), __VA_ARGS__))
+#define DEBUG_AXES(position, len) \
+    DEBUG_DRAW_DISCARD(debugDrawAxes((position), (len)))
+#define DEBUG_GRID(slices, spacing, position) \
+    DEBUG_DRAW_DISCARD(debugDrawGrid((slices), (spacing), (position)))
+#else
+#define DEBUG_LINE(category, a, b, color) \
+    (debugDrawEnabled(category) ? debugDrawLine((category), (a), (b), (color)) : (void)0)
+#define DEBUG_BOX(category, box, color) \
+    (debugDrawEnabled(category) ? debugDrawBox((category), (box), (color)) : (void)0)
+#define DEBUG_SPHERE(category, centre, radius, color) \
+    (debugDrawEnabled(category) ? debugDrawSphere((category), (centre), (radius), (color)) : (void)0)
+#define DEBUG_TEXT(category, position, size, color, ...) \
+    (debugDrawEnabled(category) ? debugDrawText((category), (position), (size), (color), __VA_ARGS__) : (void)0)
+#define DEBUG_AXES(position, len) \
+    (debugDrawEnabled(DEBUG_DRAW_AXES) ? debugDrawAxes((position), (len)) : (void)0)
+#define DEBUG_GRID(slices, spacing, position) \
+    (debugDrawEnabled(DEBUG_DRAW_GRID) ? debugDrawGrid((slices), (spacing), (position)) : (void)0)
+#endif
 
+#endif
@@ -0,0 +1,56 @@
+/*****************************************************
+Create Date:        2024-12-07
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef DYNRES_H
+#define DYNRES_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+
+/* render target sizes move in these steps, so it is not reallocated every adjustment */
+#define DYNRES_SCALE_STEP 0.05f
+
+/*
+ * Dynamic resolution: the 3D scene renders into target at scale times the
+ * window size and is stretched to the window afterwards. Every interval
+ * frames the scale is nudged so the measured frame cost meets target_ms.
+ */
+struct DynamicResolution {
+    RenderTexture2D target;
+    int width, height;
+    float scale, min_scale, max_scale;
+    float target_ms;
+    /* frames averaged per adjustment */
+    int interval;
+    bool enabled;
+
+    int frames;
+    double accum_ms;
+    /* average frame cost over the last interval */
+    float avg_ms;
+};
+
+typedef struct DynamicResolution DynamicResolution;
+
+/**
+ * @param target_ms frame cost to hold, e.g. 16.6 for 60 fps
+ * @param min_scale/max_scale bounds on the resolution scale per axis
+ */
+void dynresInit(DynamicResolution *dr, float target_ms, float min_scale, float max_scale);
+void dynresUnload(DynamicResolution *dr);
+/**
+ * feed the cost of the last frame (cpu/gpu work, not vsync wait) and
+ * resize the target if needed, call outside texture mode
+ */
+void dynresUpdate(DynamicResolution *dr, float frame_ms);
+/**
+ * stretch the target over the whole window
+ */
+void dynresDraw(DynamicResolution *dr);
+
+#endif
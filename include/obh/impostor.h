@@ -0,0 +1,85 @@
+/*****************************************************
+Create Date:        2024-12-18
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include "./incl.h"
+#include "./sprite.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+#define IMPOSTOR_MAX_VIEWS 64
+
+/* views of one model around its y axis, all from the same pitch */
+struct ImpostorModel {
+    Model model;
+    int first_region, views;
+    /* bounding sphere in model space */
+    Vector3 center;
+    float radius;
+};
+
+/*
+ * Models drawn as camera facing quads past a distance. Every model is
+ * rendered from evenly spaced angles around it into a sprite atlas when it
+ * is added, a quad shows the view nearest the camera.
+ *
+ * Over the fade units before the distance the mesh is still drawn and the
+ * quad fades in on top of it. Quads are moved towards the camera by the
+ * radius and shrunk to match, so they cover the mesh they replace instead
+ * of cutting through it.
+ */
+struct ImpostorSet {
+    SpriteAtlas atlas;
+    SpriteBatch batch;
+    struct ImpostorModel *models;
+    float distance, fade;
+    bool gpu;
+
+    /* counted by impostorDraw, moved to the stats on flush */
+    int queued_meshes, queued_blended;
+
+    /* stats for the last impostorFlush */
+    int meshes, impostors, blended;
+};
+
+typedef struct ImpostorSet ImpostorSet;
+
+/**
+ * @param distance from the camera to a model's centre where only its quad is drawn
+ * @param fade width of the band before distance the two are blended over
+ * @param gpu false leaves the views blank, for headless benches
+ */
+void impostorInit(ImpostorSet *set, float distance, float fade, bool gpu);
+void impostorUnload(ImpostorSet *set);
+/**
+ * render the views of model, call before impostorBuild with the window open
+ * @param model must outlive the set, it is drawn as is up close
+ * @param views angles around the model, up to IMPOSTOR_MAX_VIEWS
+ * @param pitch degrees the views look down from, the camera pitch the game uses
+ * @param size pixels per side of one view
+ * @return model id for impostorDraw
+ */
+int impostorAdd(ImpostorSet *set, Model model, int views, float pitch, int size);
+/**
+ * pack the views, nothing can be added after
+ */
+void impostorBuild(ImpostorSet *set);
+/**
+ * draw the mesh now or queue the quad for impostorFlush, or both while
+ * fading, inside BeginMode3D
+ * @param yaw degrees around y, as DrawModelEx takes it
+ */
+void impostorDraw(ImpostorSet *set, int id, Vector3 position, float yaw, float scale, Color tint, Camera3D camera);
+/**
+ * draw every queued quad, after the opaque meshes
+ */
+void impostorFlush(ImpostorSet *set);
+
+#endif
@@ -0,0 +1,103 @@
+/*****************************************************
+Create Date:        2024-12-11
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+/* screen tiles by depth slices, x must be a multiple of 4 */
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+#define CLUSTERS_COUNT (CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z)
+#define CLUSTERS_MAX_LIGHTS 1024
+
+/* texture slots after the shadow maps */
+#define CLUSTERS_LIGHT_SLOT 12
+#define CLUSTERS_GRID_SLOT 13
+#define CLUSTERS_INDEX_SLOT 14
+
+struct PointLight {
+    Vector3 position;
+    /* no light past this distance */
+    float radius;
+    Vector3 color;
+    float intensity;
+};
+
+/*
+ * Clustered forward lighting. The view frustum is cut into screen tiles
+ * and exponential depth slices, every light is assigned on the CPU to
+ * the clusters its sphere touches, and the lit shader only loops over
+ * the lights listed for the cluster a fragment falls in.
+ * Light data, the per cluster (offset, count) grid and the index lists
+ * go to the GPU as buffer textures.
+ */
+struct LightClusters {
+    /* depth range the slices cover, slice 0 reaches down to the camera */
+    float near, far;
+    /* slice = log(depth) * slice_scale + slice_bias */
+    float slice_scale, slice_bias;
+    float slice_depth[CLUSTERS_Z + 1];
+    /* projection the bounds were built for */
+    float fovy, aspect;
+    /* view space x/y bounds per cluster, x fastest */
+    float *min_x, *max_x, *min_y, *max_y;
+
+    /* stb_ds array, filled by the caller each frame */
+    struct PointLight *lights;
+    /* (offset, count) into indices per cluster */
+    u32 *grid;
+    /* stb_ds arrays, light indices grouped by cluster and the unsorted (cluster, light) hits */
+    u32 *indices;
+    u32 *hit_cluster, *hit_light;
+
+    bool gpu;
+    unsigned int light_buffer, grid_buffer, index_buffer;
+    unsigned int light_texture, grid_texture, index_texture;
+
+    /* stats for the last lightClustersAssign */
+    double assign_ms;
+    int clusters_lit, max_per_cluster;
+};
+
+typedef struct LightClusters LightClusters;
+
+/**
+ * @param gpu create the buffer textures, false for headless use
+ */
+void lightClustersInit(LightClusters *lc, float near, float far, bool gpu);
+void lightClustersUnload(LightClusters *lc);
+void lightClustersClear(LightClusters *lc);
+/**
+ * @return false if CLUSTERS_MAX_LIGHTS are already added
+ */
+bool lightClustersAdd(LightClusters *lc, struct PointLight light);
+/**
+ * @return cluster containing a view space depth, x/y in [-1, 1] ndc
+ */
+int lightClustersIndex(const LightClusters *lc, float ndc_x, float ndc_y, float depth);
+/**
+ * assign every light to the clusters of the camera's frustum
+ */
+void lightClustersAssign(LightClusters *lc, Camera3D camera, float aspect);
+/**
+ * upload lights and cluster lists, write the slice constants into the
+ * frame uniforms and bind the buffer textures
+ */
+void lightClustersBind(LightClusters *lc);
+/**
+ * point a lighting shader's cluster samplers at their texture slots, once
+ * after loading it
+ */
+void lightClustersSetupShader(Shader shader);
+
+#endif
@@ -0,0 +1,126 @@
+/*****************************************************
+Create Date:        2024-12-21
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include "./incl.h"
+#include "./util.h"
+#include "./mesh_opt.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+/* the model as added and up to 3 simplified levels */
+#define MESH_LOD_MAX_LEVELS 4
+/* triangles of a level against the one before */
+#define MESH_LOD_RATIO 0.25f
+/* error a level may reach against its mesh's bounding box diagonal, past
+ * it the level stops short of its triangles */
+#define MESH_LOD_MAX_ERROR 0.05f
+#define MESH_LOD_MAX_THREADS 8
+
+struct LodModel {
+    /* levels[0] is the model as added, the others share its materials and
+     * skeleton but own their meshes */
+    Model levels[MESH_LOD_MAX_LEVELS];
+    int level_count;
+    /* meshes of each level still with a worker, a level is drawn once
+     * none are */
+    int pending[MESH_LOD_MAX_LEVELS];
+    /* model units the level's surface is off by, the rms distance of its
+     * worst collapse in any mesh, and its size */
+    float error[MESH_LOD_MAX_LEVELS];
+    int triangles[MESH_LOD_MAX_LEVELS];
+    Vector3 center;
+};
+
+/* simplify one mesh of a model to one level, on a worker */
+struct MeshLodJob {
+    int id, level, mesh;
+    float ratio;
+    /* the added model's mesh, read only while the job is out */
+    const Mesh *source;
+    Mesh result;
+    float error;
+    double ms;
+};
+
+/*
+ * Levels of detail for models, simplified with quadric error metrics on
+ * worker threads when a model is added. Edges are collapsed onto one of
+ * their vertices, so what survives keeps its uvs and skin weights exactly;
+ * uv seams and open borders are never collapsed. A model is drawn at the
+ * coarsest level whose error covers fewer than pixel_error pixels on
+ * screen.
+ */
+struct MeshLodSet {
+    struct LodModel *models;
+    float pixel_error;
+    bool gpu;
+
+    /* of MeshLodJob */
+    WorkQueue queue;
+    /* worker time and triangles of the meshes simplified and taken in */
+    double simplify_ms;
+    u64 simplified;
+
+    u64 queued[MESH_LOD_MAX_LEVELS], queued_triangles;
+    /* stats for the last meshLodUpdate, models drawn at each level */
+    u64 drawn[MESH_LOD_MAX_LEVELS], triangles;
+};
+
+typedef struct MeshLodSet MeshLodSet;
+
+/**
+ * @param pixel_error screen pixels a level may be off by, 1 is about
+ * invisible
+ * @param threads worker count, <= 0 for one per core but the main thread
+ * @param gpu upload the levels, false for headless use
+ */
+void meshLodInit(MeshLodSet *set, float pixel_error, int threads, bool gpu);
+/**
+ * free every level built, the models added stay with the caller
+ */
+void meshLodUnload(MeshLodSet *set);
+/**
+ * queue levels for every mesh of model, each MESH_LOD_RATIO of the one
+ * before. The model's cpu arrays must stay as they are until meshLodWait.
+ * @param levels the model itself included, clamped to MESH_LOD_MAX_LEVELS
+ * @return id for meshLodDraw
+ */
+int meshLodAdd(MeshLodSet *set, Model model, int levels);
+/**
+ * take in finished levels and roll the draw stats, once per frame on the
+ * thread that owns the gl context
+ */
+void meshLodUpdate(MeshLodSet *set);
+/**
+ * block until every queued level is built, then take them in
+ */
+void meshLodWait(MeshLodSet *set);
+/**
+ * @return the level of model id to draw distance away with a camera of
+ * fovy degrees
+ */
+int meshLodSelect(const MeshLodSet *set, int id, float distance, float scale, float fovy, int screen_height);
+/**
+ * draw model id at the level its size on screen calls for
+ * @param yaw degrees around y
+ */
+void meshLodDraw(MeshLodSet *set, int id, Vector3 position, float yaw, float scale, Color tint, Camera3D camera);
+/**
+ * an indexed copy of mesh with about ratio of its triangles, unused
+ * vertices dropped and reordered as meshOptimize does. Nothing is
+ * uploaded. Stops early when every edge left is on a seam or border, would
+ * fold a triangle over or would pass MESH_LOD_MAX_ERROR.
+ * @param error set to model units the surface moved by, rms over the
+ * planes of the worst collapse, may be NULL
+ */
+Mesh meshLodSimplify(const Mesh *mesh, float ratio, float *error);
+
+#endif
@@ -0,0 +1,79 @@
+/*****************************************************
+Create Date:        2024-12-20
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef MESH_OPT_H
+#define MESH_OPT_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+/* raylib config.h default, not exported by raylib.h */
+#ifndef MAX_MESH_VERTEX_BUFFERS
+#define MAX_MESH_VERTEX_BUFFERS 9
+#endif
+
+/* lru entries the triangle order is scored against */
+#define MESH_OPT_CACHE_SIZE 32
+/* fifo entries ACMR is measured with, a small post transform cache */
+#define MESH_OPT_ACMR_CACHE 16
+
+/* one meshOptimize, bytes are vertex attributes plus indices */
+struct MeshOptStats {
+    int vertices_before, vertices_after, triangles;
+    /* cache misses per triangle, 3 is no reuse at all, 0.5 the limit for a
+     * large regular grid */
+    float acmr_before, acmr_after;
+    /* as raylib uploads them, and as meshOptUpload packs them */
+    size_t bytes_before, bytes_after, bytes_packed;
+    double ms;
+};
+
+/*
+ * Meshes reworked for the gpu at load or cook time. Identical vertices are
+ * merged into an indexed mesh, triangles are reordered for the post
+ * transform cache with Forsyth's method and vertices are reordered by first
+ * use so fetches walk the buffer forwards.
+ *
+ * A packed upload interleaves the attributes with 16 bit normals, tangents
+ * and texture coordinates. They are normalized attributes, so the shaders
+ * read them as before.
+ */
+
+/**
+ * dedup and reorder the cpu arrays, a mesh already on the gpu keeps its old
+ * buffers until meshOptUpload. Meshes that would need more than 65535
+ * vertices once indexed are left as they are.
+ * @param stats may be NULL, after is the same as before if it is left
+ * @return false if the mesh was left as it is
+ */
+bool meshOptimize(Mesh *mesh, struct MeshOptStats *stats);
+/**
+ * (re)upload a mesh, replacing any buffers it has
+ * @param pack 16 bit attributes, skinned meshes are always uploaded unpacked
+ * @return bytes uploaded
+ */
+size_t meshOptUpload(Mesh *mesh, bool pack);
+/**
+ * optimize and upload every mesh of a model, logging what each saved
+ */
+void meshOptimizeModel(Model *model, const char *name, bool pack);
+/**
+ * @return a cpu copy of every array of mesh, nothing uploaded
+ */
+Mesh meshOptCopy(const Mesh *mesh);
+/**
+ * @return cache misses per triangle of indices through a fifo of cache_size
+ */
+float meshOptACMR(const unsigned short *indices, int index_count, int vertex_count, int cache_size);
+/**
+ * @return bytes of one packed vertex of mesh, 0 if it can not be packed
+ */
+int meshOptPackedStride(const Mesh *mesh);
+
+#endif
@@ -0,0 +1,100 @@
+/*****************************************************
+Create Date:        2024-12-04
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <pthread.h>
+
+#include "./incl.h"
+#include "./world.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+/* depth buffer size, width must be a multiple of 4 */
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+/* 256x128 down to 4x2 */
+#define OCCLUSION_LEVELS 7
+/* occluder cells per chunk side */
+#define OCCLUSION_GRID 8
+/* occluders not picked for this many frames are dropped */
+#define OCCLUSION_EVICT_FRAMES 120
+
+/*
+ * Conservative stand-in for a chunk: every cell is at or below the
+ * lowest cube top it covers, so it never hides something the real
+ * cubes would not.
+ */
+struct Occluder {
+    u64 revision;
+    u64 last_frame;
+    Vector3 origin;
+    float heights[(OCCLUSION_GRID + 1) * (OCCLUSION_GRID + 1)];
+};
+
+struct OccluderMap {
+    iVec2 key;
+    struct Occluder value;
+};
+
+/*
+ * Software occlusion culler. Occluders picked around the camera are
+ * rasterized into a small depth buffer (4 pixels at a time) and reduced
+ * into min/max depth pyramids that boxes are tested against.
+ * Depth is NDC z remapped to [0, 1], smaller is closer.
+ */
+struct OcclusionCuller {
+    int level_w[OCCLUSION_LEVELS], level_h[OCCLUSION_LEVELS];
+    /* level 0 of max_levels is the depth buffer itself */
+    float *max_levels[OCCLUSION_LEVELS];
+    float *min_levels[OCCLUSION_LEVELS];
+    Matrix vp;
+    float near;
+
+    struct OccluderMap *occluders;
+    /* occluders used for the frame being rasterized, nearest first */
+    const struct Occluder **frame_occluders;
+    int max_occluders;
+    u64 frame;
+
+    bool threaded;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool job_pending, job_running, quit;
+
+    /* stats, raster is for the last frame, counters reset in occlusionBegin */
+    double raster_ms;
+    u64 triangles;
+    int tested, occluded, off_screen;
+};
+
+typedef struct OcclusionCuller OcclusionCuller;
+
+/**
+ * @param threaded rasterize on a worker thread between occlusionBegin
+ * and occlusionWait, otherwise occlusionBegin does the work inline
+ */
+void occlusionInit(OcclusionCuller *oc, bool threaded);
+void occlusionUnload(OcclusionCuller *oc);
+/**
+ * pick occluders near the camera and start rasterizing them
+ */
+void occlusionBegin(OcclusionCuller *oc, Camera3D camera, float aspect);
+/**
+ * block until the depth pyramid for the last occlusionBegin is built
+ */
+void occlusionWait(OcclusionCuller *oc);
+/**
+ * @return false if the box is fully hidden behind occluders or off
+ * screen, only valid after occlusionWait
+ */
+bool occlusionTestBox(OcclusionCuller *oc, BoundingBox box);
+
+#endif
@@ -0,0 +1,114 @@
+/*****************************************************
+Create Date:        2024-12-15
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include "./incl.h"
+#include "./world.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+#define PARTICLES_MAX_EMITTERS 64
+/* heightfield columns per side an emitter collides against, centred on it */
+#define PARTICLES_FIELD 64
+
+enum ParticleShape {
+    /* anywhere in a box of extent around the origin */
+    PARTICLE_SHAPE_BOX,
+    /* from the origin, velocity inside a cone of spread radians around +y */
+    PARTICLE_SHAPE_CONE,
+};
+
+struct ParticleEmitterDesc {
+    enum ParticleShape shape;
+    Vector3 extent;
+    /* particles per second, 0 for bursts only */
+    float rate;
+    float life, speed, spread;
+    /* constant acceleration and the fraction of velocity lost per second */
+    Vector3 gravity;
+    float drag;
+    /* velocity kept along y and across the ground after hitting it */
+    float bounce, friction;
+    /* die on the first ground hit, for rain */
+    bool kill_on_hit;
+    float size;
+    Color color;
+    /* fixed pool, rounded up to a multiple of 16 */
+    int capacity;
+};
+
+/*
+ * Fixed capacity pool, structure of arrays. Every slot is simulated,
+ * dead ones (life <= 0) are drawn at size 0. x, y, z and life are
+ * adjacent in data so they go to the gpu as a single upload.
+ */
+struct ParticleEmitter {
+    struct ParticleEmitterDesc desc;
+    Vector3 origin;
+    int capacity;
+    float *data;
+    float *x, *y, *z, *life, *vx, *vy, *vz;
+    /* next slot to spawn into, slots are reused round robin */
+    int cursor;
+    float spawn_debt;
+    u32 rng;
+
+    /* ground heights under the pool, snapshotted around field_origin */
+    float field[PARTICLES_FIELD * PARTICLES_FIELD];
+    Vector2 field_origin;
+    u64 field_revision;
+
+    bool visible;
+    unsigned vao, vbo;
+};
+
+struct ParticleSystem {
+    struct ParticleEmitter *emitters[PARTICLES_MAX_EMITTERS];
+    int emitter_count;
+    bool gpu;
+    Shader shader;
+    int view_loc, projection_loc, color_loc, size_loc, fade_loc;
+
+    /* stats for the last particlesUpdate */
+    int emitters_culled;
+    u64 simulated;
+    double update_ms;
+};
+
+typedef struct ParticleSystem ParticleSystem;
+
+/**
+ * @param gpu false only simulates, for headless benches
+ */
+void particlesInit(ParticleSystem *ps, bool gpu);
+void particlesUnload(ParticleSystem *ps);
+/**
+ * @return emitter index, -1 when PARTICLES_MAX_EMITTERS are in use
+ */
+int particlesAddEmitter(ParticleSystem *ps, struct ParticleEmitterDesc desc, Vector3 origin);
+/**
+ * move an emitter, its ground snapshot follows when it drifts too far
+ */
+void particlesMoveEmitter(ParticleSystem *ps, int emitter, Vector3 origin);
+/**
+ * spawn count particles at once, oldest slots are taken over
+ */
+void particlesBurst(ParticleSystem *ps, int emitter, int count);
+/**
+ * cull emitters against the camera, spawn and simulate the visible ones,
+ * culled emitters are paused
+ */
+void particlesUpdate(ParticleSystem *ps, Camera3D camera, float aspect, float dt);
+/**
+ * one instanced draw per visible emitter, call inside BeginMode3D
+ */
+void particlesDraw(ParticleSystem *ps);
+
+#endif
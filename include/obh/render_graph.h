@@ -0,0 +1,101 @@
+/*****************************************************
+Create Date:        2024-12-06
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+
+#define RG_MAX_PASSES 32
+#define RG_MAX_RESOURCES 32
+/* gpu timings are read back this many frames late, so nothing stalls */
+#define RG_QUERY_FRAMES 3
+
+#define RG_BIT(resource) (1u << (resource))
+
+typedef void (*RenderPassFn)(void *user);
+typedef bool (*RenderPassChangedFn)(void *user);
+
+/*
+ * A pass and the resources it touches. Reading a resource orders the
+ * pass after its writers, clearing one means earlier contents are dead.
+ */
+struct RenderPassDesc {
+    const char *name;
+    u32 reads, writes;
+    /* subset of writes, cleared to clear_color by the graph before execute */
+    u32 clears;
+    Color clear_color;
+    /* false: treated as if it was never added */
+    bool enabled;
+    RenderPassFn execute;
+    /* NULL: always re-run, otherwise false keeps last frame's output */
+    RenderPassChangedFn changed;
+    void *user;
+};
+
+struct RenderPassStats {
+    const char *name;
+    bool ran, culled, skipped;
+    double cpu_ms, gpu_ms;
+};
+
+/*
+ * Passes are declared every frame between rgBeginFrame and rgExecute, in
+ * any order. rgExecute sorts them by their reads/writes, drops passes
+ * whose output nobody observes and skips unchanged ones. Stats are kept
+ * per declaration slot, so declare the same passes in the same order
+ * each frame (disable instead of leaving one out).
+ */
+struct RenderGraph {
+    const char *resource_names[RG_MAX_RESOURCES];
+    /* NULL for the backbuffer */
+    RenderTexture2D *resource_targets[RG_MAX_RESOURCES];
+    int resource_count;
+    /* resources that must be valid after the frame, usually the backbuffer */
+    u32 outputs;
+
+    struct RenderPassDesc passes[RG_MAX_PASSES];
+    int pass_count;
+    int order[RG_MAX_PASSES];
+    bool live[RG_MAX_PASSES];
+    struct RenderPassStats stats[RG_MAX_PASSES];
+
+    bool gpu_timers;
+    unsigned int queries[RG_QUERY_FRAMES][RG_MAX_PASSES];
+    bool query_issued[RG_QUERY_FRAMES][RG_MAX_PASSES];
+    u64 frame;
+
+    /* totals for the last rgExecute, gpu_ms is the latest timings read back */
+    int passes_run, passes_culled, passes_skipped, clears;
+    double cpu_ms, gpu_ms;
+};
+
+typedef struct RenderGraph RenderGraph;
+
+/**
+ * needs a GL context, gpu timers are used when GL 3.3 or
+ * ARB_timer_query is there
+ */
+void rgInit(RenderGraph *graph);
+void rgUnload(RenderGraph *graph);
+/**
+ * @param target cleared through BeginTextureMode, NULL is the backbuffer
+ * @return resource id for RG_BIT
+ */
+int rgResource(RenderGraph *graph, const char *name, RenderTexture2D *target);
+void rgSetOutput(RenderGraph *graph, int resource);
+void rgBeginFrame(RenderGraph *graph);
+void rgAddPass(RenderGraph *graph, struct RenderPassDesc pass);
+/**
+ * order, cull and run the passes added since rgBeginFrame
+ */
+void rgExecute(RenderGraph *graph);
+
+#endif
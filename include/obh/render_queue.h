@@ -0,0 +1,88 @@
+/*****************************************************
+Create Date:        2024-12-05
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+/* raylib config.h default, not exported by raylib.h */
+#ifndef MAX_MATERIAL_MAPS
+#define MAX_MATERIAL_MAPS 12
+#endif
+
+/* executed in this order, alpha is sorted back to front */
+enum RenderPass {
+    RENDER_PASS_OPAQUE,
+    RENDER_PASS_ALPHA,
+    RENDER_PASS_COUNT,
+};
+
+/*
+ * sort key, most significant first:
+ * pass (4) | shader id (12) | diffuse texture id (16) | view distance (32)
+ * distance is the raw bits of a non negative float, which sort like the
+ * float itself. ids are truncated, collisions only cost extra binds
+ */
+#define RENDER_KEY_PASS_SHIFT 60
+#define RENDER_KEY_SHADER_SHIFT 48
+#define RENDER_KEY_TEXTURE_SHIFT 32
+
+struct RenderItem {
+    const Mesh *mesh;
+    const Material *material;
+    Matrix transform;
+    Color tint;
+};
+
+struct RenderSortEntry {
+    u64 key;
+    u32 item;
+};
+
+/*
+ * Draws pushed during a frame are sorted by key and executed with
+ * shader, texture and per shader uniform binds only issued on change.
+ * Meshes and materials are referenced, they must outlive the flush.
+ */
+struct RenderQueue {
+    struct RenderItem *items;
+    struct RenderSortEntry *entries, *scratch;
+    Vector3 view_pos;
+    /* false: draw in push order through DrawMesh, for comparison */
+    bool sort;
+
+    /* stats for the last flush */
+    int draw_calls, shader_binds, texture_binds;
+    double sort_ms, submit_ms;
+};
+
+typedef struct RenderQueue RenderQueue;
+
+void renderQueueInit(RenderQueue *rq);
+void renderQueueUnload(RenderQueue *rq);
+/**
+ * drop pending items, depth in sort keys is measured from view_pos
+ */
+void renderQueueBegin(RenderQueue *rq, Vector3 view_pos);
+void renderQueuePushMesh(RenderQueue *rq, enum RenderPass pass, const Mesh *mesh,
+        const Material *material, Matrix transform, Color tint);
+/**
+ * DrawModel equivalent, one item per mesh
+ */
+void renderQueuePushModel(RenderQueue *rq, enum RenderPass pass, Model model,
+        Vector3 position, float scale, Color tint);
+/**
+ * sort and draw everything pushed since renderQueueBegin, call inside
+ * BeginMode3D
+ */
+void renderQueueFlush(RenderQueue *rq);
+
+#endif
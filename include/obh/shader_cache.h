@@ -0,0 +1,45 @@
+/*****************************************************
+Create Date:        2024-12-09
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+
+/*
+ * LoadShader replacement. Sources are run through stb_include (paths
+ * relative to the including file), hashed together with the driver
+ * strings, and the linked program binary is kept in dir. Later runs load
+ * the binary and only compile if the driver rejects it.
+ */
+struct ShaderCache {
+    /* NULL: preprocess and compile, nothing is stored */
+    const char *dir;
+    bool binary_supported;
+    char driver[512];
+
+    /* stats since shaderCacheInit */
+    int hits, misses, rejected;
+    double load_ms;
+};
+
+typedef struct ShaderCache ShaderCache;
+
+extern struct ShaderCache shader_cache;
+
+/**
+ * needs a GL context, creates dir if missing
+ */
+void shaderCacheInit(const char *dir);
+/**
+ * same contract as LoadShader, NULL picks raylib's default stage
+ */
+Shader shaderCacheLoad(const char *vs_path, const char *fs_path);
+
+#endif
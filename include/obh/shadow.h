@@ -0,0 +1,160 @@
+/*****************************************************
+Create Date:        2024-11-28
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+#include "../raylib/rlgl.h"
+
+#define SHADOW_CASCADE_SLOT 10
+#define SHADOW_DYNAMIC_SLOT 11
+#define SHADOW_MAX_CASCADES 4
+
+/*
+ * One slice of the view frustum, rendered into one layer of the
+ * cascade depth array.
+ */
+struct ShadowCascade {
+    RenderTexture2D target;
+    Matrix view, proj, vp;
+    /* view depth where this cascade ends */
+    float split_far;
+    /* vp the layer currently holds, compared after texel snapping */
+    Matrix cached_vp;
+    bool valid;
+};
+
+/* lit shader id -> depth-only program used when the material casts */
+struct ShadowCasterMap {
+    unsigned int key;
+    Shader value;
+};
+
+/*
+ * Static terrain depth is split into cascades fitted to the player
+ * camera. A cascade is only re-rendered when its (texel snapped) light
+ * matrix changes or a chunk inside it is added or edited. Dynamic
+ * objects (units) go into the small dynamic_map every frame, fitted
+ * around a focus point.
+ */
+struct ShadowCache {
+    unsigned int cascade_array;
+    struct ShadowCascade cascades[SHADOW_MAX_CASCADES];
+    int cascade_count, resolution;
+    /* blend between logarithmic (1) and uniform (0) split placement */
+    float split_lambda;
+    /* shadows reach this far in front of and behind the camera target */
+    float max_distance;
+    /* extra depth towards the light so off-screen casters still land */
+    float caster_margin;
+    Vector3 light_dir;
+    Vector3 view_pos, view_forward;
+    u64 cached_revision;
+
+    RenderTexture2D dynamic_map;
+    Camera3D dynamic_cam;
+    Matrix dynamic_vp;
+    int dynamic_resolution;
+
+    /* casters draw with these instead of their lit shader */
+    Shader depth_shader, depth_shader_skinned;
+    struct ShadowCasterMap *casters;
+    /* glPolygonOffset applied while casting, replaces most shader bias */
+    float offset_factor, offset_units;
+
+    /* stats */
+    u64 static_renders;
+};
+
+typedef struct ShadowCache ShadowCache;
+
+RenderTexture2D LoadShadowmapRenderTexture(int width, int height);
+/**
+ * view projection matrix BeginMode3D would produce for an orthographic
+ * camera rendering into a square target
+ */
+Matrix shadowLightViewProj(Camera3D light_cam);
+
+/**
+ * @param light_dir direction the light travels in
+ * @param dynamic_extent world units covered by the dynamic layer
+ */
+void shadowCacheInit(ShadowCache *sc, Vector3 light_dir, int cascade_count,
+        int resolution, int dynamic_resolution, float dynamic_extent);
+void shadowCacheUnload(ShadowCache *sc);
+/**
+ * reallocate the cascade array, may be called at any time between frames
+ * @param cascade_count clamped to [1, SHADOW_MAX_CASCADES]
+ */
+void shadowCacheConfigure(ShadowCache *sc, int cascade_count, int resolution);
+void shadowCacheSetLightDir(ShadowCache *sc, Vector3 light_dir);
+/**
+ * force a static re-render of every cascade next frame
+ */
+void shadowCacheInvalidate(ShadowCache *sc);
+/**
+ * re-render the cascades that can see box, for geometry that changed
+ * without a world edit such as terrain lods
+ */
+void shadowCacheInvalidateBox(ShadowCache *sc, BoundingBox box);
+/**
+ * clear all layers to far depth, i.e. nothing is shadowed
+ */
+void shadowCacheClear(ShadowCache *sc);
+/**
+ * fit the cascades to the camera frustum and work out which are stale,
+ * call once per frame before rendering any cascade
+ */
+void shadowCacheUpdate(ShadowCache *sc, Camera3D camera, float aspect);
+/**
+ * @return true if any cascade will re-render, valid after shadowCacheUpdate
+ */
+bool shadowCacheStale(const ShadowCache *sc);
+/**
+ * @return true if box may cast into the given cascade
+ */
+bool shadowCacheCascadeSees(ShadowCache *sc, int cascade, BoundingBox box);
+/**
+ * starts rendering a cascade if it is stale
+ * @return true if the caller should draw static geometry and then call
+ * shadowCacheEndCascade
+ */
+bool shadowCacheBeginCascade(ShadowCache *sc, int cascade);
+void shadowCacheEndCascade(ShadowCache *sc);
+/**
+ * starts rendering the per-frame dynamic layer centered on focus, always
+ * to be followed by shadowCacheEndDynamic
+ */
+void shadowCacheBeginDynamic(ShadowCache *sc, Vector3 focus);
+void shadowCacheEndDynamic(ShadowCache *sc);
+/**
+ * make materials using the lit shader cast with the given depth program,
+ * e.g. depth_shader_skinned for skinned models. Materials with no entry
+ * use depth_shader
+ */
+void shadowCacheSetCaster(ShadowCache *sc, Shader lit, Shader depth);
+/**
+ * DrawModel with every material swapped to its depth-only program, only
+ * valid between a shadowCacheBegin* / shadowCacheEnd* pair
+ */
+void shadowDrawModel(ShadowCache *sc, Model model, Vector3 position, float scale);
+/**
+ * point a lighting shader's shadow samplers at their texture slots, once
+ * after loading it
+ */
+void shadowCacheSetupShader(Shader shader);
+/**
+ * write light matrices into the frame uniforms and bind all layers,
+ * the caller uploads the frame block
+ */
+void shadowCacheBind(ShadowCache *sc);
+
+#endif
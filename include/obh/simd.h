@@ -0,0 +1,40 @@
+/* -----------------------
+ * 4 wide float/int vectors
+ * ***********************
+ * gcc/clang vector extensions, lowered to SSE/NEON by the compiler and
+ * to scalar code where neither exists
+ * ----------------------- */
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "incl.h"
+
+typedef float v4f __attribute__((vector_size(16)));
+typedef i32   v4i __attribute__((vector_size(16)));
+
+#define V4F(x) ((v4f) { (x), (x), (x), (x) })
+#define V4I(x) ((v4i) { (x), (x), (x), (x) })
+
+static inline v4f v4f_load(const float *p) { v4f v; memcpy(&v, p, sizeof(v)); return v; }
+static inline void v4f_store(float *p, v4f v) { memcpy(p, &v, sizeof(v)); }
+static inline v4i v4i_load(const i32 *p) { v4i v; memcpy(&v, p, sizeof(v)); return v; }
+static inline void v4i_store(i32 *p, v4i v) { memcpy(p, &v, sizeof(v)); }
+
+/* per lane mask ? a : b, mask lanes are all ones or all zeros */
+static inline v4f v4f_select(v4i mask, v4f a, v4f b)
+{
+    return (v4f)((mask & (v4i)a) | (~mask & (v4i)b));
+}
+
+static inline v4f v4f_min(v4f a, v4f b) { return v4f_select(a < b, a, b); }
+static inline v4f v4f_max(v4f a, v4f b) { return v4f_select(a > b, a, b); }
+static inline v4f v4f_clamp(v4f v, v4f lo, v4f hi) { return v4f_min(v4f_max(v, lo), hi); }
+
+static inline float v4f_hmin(v4f v) { return fminf(fminf(v[0], v[1]), fminf(v[2], v[3])); }
+static inline float v4f_hmax(v4f v) { return fmaxf(fmaxf(v[0], v[1]), fmaxf(v[2], v[3])); }
+static inline float v4f_hadd(v4f v) { return (v[0] + v[1]) + (v[2] + v[3]); }
+
+static inline bool v4i_any(v4i mask) { return (mask[0] | mask[1] | mask[2] | mask[3]) != 0; }
+static inline bool v4i_all(v4i mask) { return (mask[0] & mask[1] & mask[2] & mask[3]) != 0; }
+
+#endif
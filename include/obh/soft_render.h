@@ -0,0 +1,131 @@
+/*****************************************************
+Create Date:        2024-12-17
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef SOFT_RENDER_H
+#define SOFT_RENDER_H
+
+#include "./incl.h"
+#include "./util.h"
+#include "./world.h"
+#include "./terrain.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+/* square tiles, a multiple of 4 */
+#define SOFT_RENDER_TILE 64
+#define SOFT_RENDER_MAX_THREADS 16
+/* one map over every chunk drawn, texels per side */
+#define SOFT_RENDER_SHADOW_SIZE 2048
+
+/* an owned chunk mesh at the lod it was built for */
+struct SoftChunk {
+    int lod;
+    u64 revision;
+    Mesh mesh;
+    Vector3 origin;
+    BoundingBox bounds;
+    /* frame it was last wanted, chunks not wanted are dropped */
+    u64 frame;
+};
+
+struct SoftChunkMap {
+    iVec2 key;
+    struct SoftChunk value;
+};
+
+/*
+ * A triangle set up for rasterizing: edge functions and planes of z, 1/w
+ * and of the attributes divided by w, all over pixel centres. Attributes
+ * are the lambert term and the shadow map coordinates.
+ */
+struct SoftTriangle {
+    float a[3], b[3], c[3];
+    float z[3], inv_w[3];
+    float attr[4][3];
+    int min_x, min_y, max_x, max_y;
+};
+
+/* depth and the triangle that won each pixel, color only for the screen */
+struct SoftTarget {
+    int width, height, tiles_x, tiles_y;
+    float *depth;
+    i32 *ids;
+    Color *color;
+};
+
+/* triangles and bins one thread set up, bins index its own triangles */
+struct SoftRenderThread {
+    /* transformed vertices of the chunk being set up */
+    float *vertices;
+    struct SoftTriangle *triangles;
+    /* per tile stb_ds arrays */
+    i32 **bins;
+    int bin_count;
+};
+
+/*
+ * Renders the world without a gpu. Chunk meshes are the ones the terrain
+ * draws at the same lods. Triangles are set up and binned into tiles in
+ * parallel, every tile is then rasterized 4 pixels at a time into depth and
+ * triangle ids and shaded once per pixel. Lighting is basic_shadow.fs
+ * without the point lights, specular and sky bake: lambert, a PCF shadow
+ * map and the ambient term, gamma corrected.
+ */
+struct SoftRender {
+    struct SoftTarget screen, shadow;
+    struct SoftChunkMap *chunks;
+    /* chunks drawn this frame, the visible ones first */
+    struct SoftChunk **frame_chunks;
+    int visible_chunks;
+    u64 frame;
+
+    /* towards the light is -light_dir, like the scene uniforms */
+    Vector3 light_dir, light_color, ambient;
+    Color base, background;
+    /* linear to srgb, indexed by value * 1023 */
+    u8 gamma[1024];
+
+    Matrix view_proj, light_proj;
+    /* light depth units per world unit, for the bias */
+    float light_depth_scale;
+    /* chunk set the shadow map was rendered for */
+    u64 shadow_key;
+
+    /* what the pool works on, see softRenderPass */
+    struct SoftTarget *target;
+    const Matrix *transform;
+    bool cull;
+    /* per pool thread */
+    struct SoftRenderThread threads[SOFT_RENDER_MAX_THREADS];
+    JobPool pool;
+
+    /* stats for the last softRenderDraw */
+    u64 triangles;
+    bool shadow_rebuilt;
+    double mesh_ms, shadow_ms, setup_ms, raster_ms, frame_ms;
+};
+
+typedef struct SoftRender SoftRender;
+
+/**
+ * @param width a multiple of 4
+ * @param threads threads rendering including the caller, <= 0 for one per core
+ */
+void softRenderInit(SoftRender *sr, int width, int height, int threads);
+void softRenderUnload(SoftRender *sr);
+/**
+ * render every generated chunk terrain would draw around focus
+ * @param terrain only its lod rings are used, it needs no gpu
+ */
+void softRenderDraw(SoftRender *sr, const Terrain *terrain, Vector3 focus, Camera3D camera);
+/**
+ * @return false if the png could not be written
+ */
+bool softRenderSave(const SoftRender *sr, const char *path);
+
+#endif
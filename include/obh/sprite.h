@@ -0,0 +1,133 @@
+/*****************************************************
+Create Date:        2024-12-14
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef SPRITE_H
+#define SPRITE_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+/* atlas pages are square */
+#define SPRITE_PAGE_SIZE 1024
+/* empty pixels between packed frames so filtering does not bleed */
+#define SPRITE_PAGE_GAP 2
+
+/* one frame packed into an atlas page */
+struct SpriteRegion {
+    int page;
+    Rectangle rec;
+    float u0, v0, u1, v1;
+};
+
+struct SpriteSheet {
+    Image image;
+    int frames_x, frames_y;
+    int first_region;
+};
+
+/*
+ * Images cut into frames and packed into a few textures. Regions of one
+ * sheet are numbered left to right, top to bottom from the id spriteAtlasAdd
+ * returns.
+ */
+struct SpriteAtlas {
+    struct SpriteSheet *sheets;
+    struct SpriteRegion *regions;
+    /* stb_ds array, ids are 0 when built without gpu */
+    Texture2D *pages;
+};
+
+typedef struct SpriteAtlas SpriteAtlas;
+
+/**
+ * add frames_x by frames_y equal frames of image, the atlas keeps a copy
+ * @return region id of the first frame
+ */
+int spriteAtlasAdd(SpriteAtlas *atlas, Image image, int frames_x, int frames_y);
+/**
+ * @return region id of the first frame, -1 if path could not be loaded
+ */
+int spriteAtlasLoad(SpriteAtlas *atlas, const char *path, int frames_x, int frames_y);
+/**
+ * pack every frame added so far into pages, nothing can be added after
+ * @param gpu upload the pages as textures
+ */
+void spriteAtlasBuild(SpriteAtlas *atlas, bool gpu);
+void spriteAtlasUnload(SpriteAtlas *atlas);
+/**
+ * @return region of an animation with frames regions from first at fps
+ */
+int spriteAnimFrame(int first, int frames, float fps, double time);
+
+struct SpriteInstance {
+    Vector3 position;
+    Vector2 size;
+    float rotation;
+    int region;
+    Color color;
+};
+
+struct SpriteVertex {
+    Vector3 position;
+    Vector2 uv;
+    Color color;
+};
+
+/* per page buffers, refilled every flush */
+struct SpritePage {
+    unsigned vao, vbo;
+    size_t vbo_size;
+};
+
+/*
+ * Sprites pushed during a frame and drawn on spriteBatchFlush, sorted by
+ * atlas page with one vertex buffer and one draw per page. Push order is
+ * kept within a page.
+ *
+ * A billboard batch turns sprites to face the camera of the 3D mode it is
+ * flushed in, a screen batch lays them out in the current 2D space.
+ */
+struct SpriteBatch {
+    const SpriteAtlas *atlas;
+    bool billboard, gpu;
+    struct SpriteInstance *sprites;
+    /* sprites grouped by page, vertices in that order */
+    int *order, *page_counts;
+    struct SpriteVertex *vertices;
+
+    struct SpritePage *pages;
+    unsigned ebo;
+    int ebo_quads;
+    Shader shader;
+    int mvp_loc;
+
+    /* stats for the last flush */
+    int drawn, draw_calls;
+    double build_ms;
+};
+
+typedef struct SpriteBatch SpriteBatch;
+
+/**
+ * @param atlas must be built and outlive the batch
+ * @param gpu false only builds vertices on flush, for headless benches
+ */
+void spriteBatchInit(SpriteBatch *batch, const SpriteAtlas *atlas, bool billboard, bool gpu);
+void spriteBatchUnload(SpriteBatch *batch);
+/**
+ * @param position centre, z is ignored by screen batches
+ * @param rotation degrees clockwise on screen
+ */
+void spriteDraw(SpriteBatch *batch, int region, Vector3 position, Vector2 size, float rotation, Color tint);
+/**
+ * build and draw everything pushed since the last flush
+ */
+void spriteBatchFlush(SpriteBatch *batch);
+
+#endif
@@ -0,0 +1,38 @@
+/*****************************************************
+Create Date:        2024-12-13
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef STB_IMPL_H
+#define STB_IMPL_H
+
+#include "./incl.h"
+
+/*
+ * raylib links its own copies of the stb libraries, so the ones several
+ * modules share are compiled once in stb_impl.c. stb_rect_pack goes by
+ * names of its own, stb_truetype calls into it, stb_image_write is static
+ * and reached through the calls below.
+ */
+#define stbrp_init_target obh_stbrp_init_target
+#define stbrp_pack_rects obh_stbrp_pack_rects
+#define stbrp_setup_allow_out_of_mem obh_stbrp_setup_allow_out_of_mem
+#define stbrp_setup_heuristic obh_stbrp_setup_heuristic
+#include "../stb/stb_rect_pack.h"
+
+/**
+ * stbi_write_png from the private stb_image_write
+ * @param stride bytes from one row to the next
+ * @return false if the file could not be written
+ */
+bool stbWritePng(const char *path, int width, int height, int channels, const void *data, int stride);
+/**
+ * stbi_write_jpg from the private stb_image_write
+ * @param quality 1 to 100
+ */
+bool stbWriteJpg(const char *path, int width, int height, int channels, const void *data, int quality);
+
+#endif
@@ -0,0 +1,108 @@
+/*****************************************************
+Create Date:        2024-12-12
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef SUN_BAKE_H
+#define SUN_BAKE_H
+
+#include "./incl.h"
+#include "./util.h"
+#include "./world.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+/* the bake texture wraps around every SUN_BAKE_CHUNKS chunks */
+#define SUN_BAKE_CHUNKS 32
+#define SUN_BAKE_SIZE (SUN_BAKE_CHUNKS * CHUNKSIZE)
+/* columns around a chunk its rays may cross */
+#define SUN_BAKE_BORDER 16
+#define SUN_BAKE_SPAN (CHUNKSIZE + 2 * SUN_BAKE_BORDER)
+#define SUN_BAKE_SUN_RAYS 4
+#define SUN_BAKE_SKY_RAYS 12
+#define SUN_BAKE_MAX_THREADS 16
+/* texture slot after the light clusters */
+#define SUN_BAKE_SLOT 15
+
+/*
+ * One chunk to bake: a copy of the heights it can see, so workers never
+ * touch world_map, and the texels they produce
+ */
+struct SunBakeJob {
+    iVec2 coord;
+    u64 stamp;
+    /* -INFINITY where no chunk has been generated */
+    float heights[SUN_BAKE_SPAN * SUN_BAKE_SPAN];
+    float top;
+    /* per column, row major on local z: sun on the top face, on the side
+     * facing the sun along x and along z, sky on the top face */
+    u8 texels[CHUNKSIZE * CHUNKSIZE * 4];
+    double ms;
+};
+
+/* chunk whose bake lives at a spot in the texture */
+struct SunBakeSlot {
+    iVec2 coord;
+    /* newest revision in the chunk and its 8 neighbours when queued */
+    u64 stamp;
+    bool used, baked;
+};
+
+/*
+ * Sun and sky visibility for static terrain, ray marched over the
+ * heightfield on worker threads. Chunks are re-baked only when they or
+ * a neighbour change, results land in a texture the lit shader samples
+ * per column in place of the shadow cascades.
+ */
+struct SunBake {
+    /* towards the sun */
+    Vector3 sun_dir;
+    Vector3 sun_rays[SUN_BAKE_SUN_RAYS];
+    Vector3 sky_rays[SUN_BAKE_SKY_RAYS];
+    float sky_weights[SUN_BAKE_SKY_RAYS];
+
+    struct SunBakeSlot slots[SUN_BAKE_CHUNKS][SUN_BAKE_CHUNKS];
+    bool gpu;
+    Texture2D texture;
+
+    /* of SunBakeJob, queued nearest first */
+    WorkQueue queue;
+
+    /* stats, totals since init except where noted */
+    u64 faces_baked;
+    double bake_ms;
+    int chunks_baked, chunks_queued;
+    /* chunks waiting or being baked after the last sunBakeUpdate */
+    int chunks_outstanding;
+};
+
+typedef struct SunBake SunBake;
+
+/**
+ * @param light_dir direction the sunlight travels
+ * @param threads worker count, <= 0 for one per core but the main thread
+ * @param gpu create the texture, false for headless use
+ */
+void sunBakeInit(SunBake *sb, Vector3 light_dir, int threads, bool gpu);
+void sunBakeUnload(SunBake *sb);
+/**
+ * take in finished chunks and queue every chunk within radius chunks of
+ * focus that is missing or out of date, radius must stay below
+ * SUN_BAKE_CHUNKS / 2
+ */
+void sunBakeUpdate(SunBake *sb, Vector3 focus, int radius);
+/**
+ * block until every queued chunk is baked, then take them in
+ */
+void sunBakeWait(SunBake *sb);
+/**
+ * point a lighting shader's bake sampler at its texture slot, once after
+ * loading it
+ */
+void sunBakeSetupShader(Shader shader);
+void sunBakeBind(SunBake *sb);
+
+#endif
@@ -0,0 +1,96 @@
+/*****************************************************
+Create Date:        2024-12-02
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include "./incl.h"
+#include "./world.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+/* lod 1..TERRAIN_MAX_LOD decimate by 2^lod, lod 0 is per cube geometry */
+#define TERRAIN_MAX_LOD 3
+
+/*
+ * Downsampled heightfield mesh standing in for the cubes of one chunk.
+ * heights holds the target top height at each (grid + 1)^2 vertex,
+ * morph_from what the previous lod showed there. grid is 0 when the
+ * chunk is drawn as cubes, a lod 0 patch with a grid is still blending
+ * into them.
+ */
+struct TerrainPatch {
+    int lod, grid;
+    u64 revision;
+    Model model;
+    float *heights, *morph_from;
+    /* 0 -> showing morph_from, 1 -> showing heights */
+    float morph;
+};
+
+struct TerrainMap {
+    iVec2 key;
+    struct TerrainPatch value;
+};
+
+/*
+ * Geometry clipmap over world chunks. Chunks within full_radius of the
+ * focus chunk are drawn as cubes, each ring beyond doubles in width and
+ * halves the patch resolution, out to view_radius.
+ */
+struct Terrain {
+    struct TerrainMap *patches;
+    iVec2 focus;
+    int full_radius, view_radius;
+    /* seconds a patch takes to blend into a new lod */
+    float morph_time;
+    Shader shader;
+    /* chunks whose drawn geometry changed in the last terrainUpdate */
+    iVec2 *changed;
+    /* stats for the last terrainUpdate */
+    int patches_visible, patches_rebuilt, patches_morphed;
+    u64 triangles;
+};
+
+typedef struct Terrain Terrain;
+
+/**
+ * @param shader lighting shader assigned to every patch material
+ */
+void terrainInit(Terrain *terrain, Shader shader, int full_radius, int view_radius);
+void terrainUnload(Terrain *terrain);
+/**
+ * lod a chunk should be drawn at given its ring distance from the focus,
+ * -1 if it is beyond view_radius
+ */
+int terrainLodForDistance(const Terrain *terrain, int chunk_distance);
+/**
+ * pick lods around focus, (re)build patches and advance morphs
+ */
+void terrainUpdate(Terrain *terrain, Vector3 focus, float dt);
+/**
+ * @return lod the chunk is currently drawn at, -1 if not drawn
+ */
+int terrainChunkLod(const Terrain *terrain, iVec2 coord);
+/**
+ * @return patch for a chunk drawn as a heightfield, NULL if it is drawn as
+ * cubes or not at all
+ */
+struct TerrainPatch *terrainGetPatch(Terrain *terrain, iVec2 coord);
+/**
+ * world position patch models are drawn at
+ */
+Vector3 terrainPatchOrigin(iVec2 coord);
+/**
+ * cpu only mesh of a chunk at lod, settled with no morph, in the space of
+ * terrainPatchOrigin. Lod 0 is the cubes as the render queue draws them.
+ * Nothing is uploaded, MemFree the vertex, normal, texcoord and index arrays.
+ */
+Mesh terrainGenChunkMesh(const struct WorldChunk *wc, int lod);
+
+#endif
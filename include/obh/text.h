@@ -0,0 +1,112 @@
+/*****************************************************
+Create Date:        2024-12-13
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef TEXT_H
+#define TEXT_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+#include "../stb/stb_sprintf.h"
+
+/* glyphs per run, longer strings are cut */
+#define TEXT_MAX_GLYPHS 512
+/* runs not drawn for this many frames are dropped */
+#define TEXT_EVICT_FRAMES 120
+
+/*
+ * Font for the text cache, either a raylib bitmap font or a signed
+ * distance field atlas where one texture serves every size
+ */
+struct TextFont {
+    Font font;
+    bool sdf;
+};
+
+typedef struct TextFont TextFont;
+
+/*
+ * One laid out string: glyph quads in a vertex buffer, in size units
+ * with the origin at the top left and y going down
+ */
+struct TextRun {
+    char *text;
+    unsigned int font_texture;
+    float size, spacing;
+    int quads;
+    Vector2 extent;
+    unsigned int vao, vbo;
+    u64 last_frame;
+};
+
+struct TextRunMap {
+    u64 key;
+    struct TextRun value;
+};
+
+/*
+ * Layout cache. Strings are shaped once into vertex buffers keyed by
+ * content, font and size and redrawn from there until they change, one
+ * draw call per run. Strings that change every frame, timings and the
+ * like, go through a slot instead: one run per owner and slot whose
+ * buffer is refilled in place when the string changes.
+ */
+struct TextCache {
+    struct TextRunMap *runs;
+    /* keyed by owner and slot */
+    struct TextRunMap *slots;
+    /* shared by every run, quads are 0 1 2 0 2 3 */
+    unsigned int ebo;
+    /* stb_ds array the quads are built in */
+    float *scratch;
+    Shader shader, shader_sdf;
+    int mvp_loc, color_loc, mvp_sdf_loc, color_sdf_loc;
+    const char *dir;
+    u64 frame;
+
+    /* stats for the current frame, reset in textCacheEndFrame */
+    int hits, misses;
+};
+
+typedef struct TextCache TextCache;
+
+extern struct TextCache text_cache;
+
+/**
+ * needs a GL context
+ * @param dir where sdf atlases are kept, NULL to always generate them
+ */
+void textCacheInit(const char *dir);
+void textCacheUnload(void);
+/**
+ * drop runs that were not drawn for TEXT_EVICT_FRAMES, once per frame
+ */
+void textCacheEndFrame(void);
+/**
+ * @param sdf build (or load from the cache dir) a distance field atlas
+ * at base_size, falls back to a bitmap font if that fails
+ */
+TextFont textLoadFont(const char *path, int base_size, bool sdf);
+void textUnloadFont(TextFont font);
+/**
+ * DrawTextEx through the cache
+ */
+void textDraw(TextFont font, const char *text, Vector2 position, float size, float spacing, Color tint);
+/**
+ * textDraw for a string that changes often, kept in its own run
+ * @param owner anything unique to the caller, with slot names the run
+ */
+void textDrawSlot(TextFont font, const void *owner, int slot, const char *text,
+        Vector2 position, float size, float spacing, Color tint);
+/**
+ * text in the x/y plane, y down, size in world units, then transform;
+ * both sides are drawn
+ */
+void textDraw3D(TextFont font, const char *text, Matrix transform, float size, float spacing, Color tint);
+
+#endif
@@ -0,0 +1,122 @@
+/*****************************************************
+Create Date:        2024-12-19
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef TEXTURE_STREAM_H
+#define TEXTURE_STREAM_H
+
+#include "./incl.h"
+#include "./util.h"
+#include "./text.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+/* largest side of the mip every texture keeps resident from load on */
+#define TEXTURE_STREAM_BASE_SIZE 32
+#define TEXTURE_STREAM_MAX_THREADS 4
+/* loads queued or running at once, later wants wait for the next update */
+#define TEXTURE_STREAM_MAX_IN_FLIGHT 8
+
+struct StreamedTexture {
+    char path[256];
+    /* full size from the file header, mip 0 */
+    int width, height, mip_count;
+    /* coarsest mip kept, base is its cpu copy with the levels below */
+    int base_mip;
+    Image base;
+    /* always usable, the placeholder until the base is uploaded */
+    Texture2D texture;
+    /* finest mip uploaded, mip_count while only the placeholder is */
+    int resident;
+    size_t bytes;
+    /* finest mip asked for since the last update, mip_count if unused,
+     * requested is what wanted was at the last update */
+    int wanted, requested;
+    u64 last_used;
+    /* mip on its way from a worker, -1 if none */
+    int loading;
+    bool failed;
+};
+
+/* decode a file and downsample it to mip, on a worker */
+struct TextureStreamJob {
+    int id, mip;
+    char path[256];
+    /* the mip and every level below it, NULL if the file could not be read */
+    Image image;
+    /* decode and downsample time */
+    double ms;
+};
+
+/*
+ * Textures uploaded a few mips at a time. A texture starts at a small base
+ * mip, finer mips are decoded and downsampled on worker threads once
+ * something draws it large enough on screen to use them. Uploads that would
+ * go over the budget first drop textures back to their base mip, least
+ * recently used first.
+ */
+struct TextureStream {
+    struct StreamedTexture *textures;
+    Texture2D placeholder;
+    size_t budget, resident_bytes;
+    u64 frame;
+    bool gpu;
+
+    /* of TextureStreamJob */
+    WorkQueue queue;
+
+    /* stats, totals since init except where noted */
+    int loads, evictions, failures;
+    /* loads finished that the budget could not fit, dropped */
+    int deferred;
+    double decode_ms, upload_ms;
+    /* loads queued or running after the last textureStreamUpdate */
+    int outstanding;
+};
+
+typedef struct TextureStream TextureStream;
+
+/**
+ * @param budget bytes of texture memory, mip chains included
+ * @param threads worker count, <= 0 for one per core but the main thread
+ * @param gpu upload textures, false for headless use
+ */
+void textureStreamInit(TextureStream *ts, size_t budget, int threads, bool gpu);
+void textureStreamUnload(TextureStream *ts);
+/**
+ * register a png, jpg or other stb_image file, its base mip is loaded
+ * on the next updates
+ * @return id for textureStreamUse, -1 if the file can not be read
+ */
+int textureStreamLoad(TextureStream *ts, const char *path);
+/**
+ * ask for the mips an object size pixels across on screen samples, the
+ * texture is assumed to span the object once
+ * @return the texture as it is resident now, fetch it every frame, its
+ * size changes with the mips resident so sample it by uv
+ */
+Texture2D textureStreamUse(TextureStream *ts, int id, float size);
+/**
+ * @return pixels across the screen a sphere of radius at position covers
+ */
+float textureStreamScreenSize(Camera3D camera, Vector3 position, float radius, int screen_height);
+/**
+ * upload finished loads, evict over budget and queue loads for this
+ * frame's wants, once per frame on the thread that owns the gl context
+ */
+void textureStreamUpdate(TextureStream *ts);
+/**
+ * block until every queued load is finished, then take them in
+ */
+void textureStreamWait(TextureStream *ts);
+/**
+ * residency of every texture: a thumbnail, resident against wanted and
+ * full size, and bytes against the budget
+ */
+void textureStreamDrawDebug(const TextureStream *ts, TextFont font, Vector2 position);
+
+#endif
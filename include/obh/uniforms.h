@@ -0,0 +1,76 @@
+/*****************************************************
+Create Date:        2024-12-10
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+#define UNIFORMS_MAX_CASCADES 4
+/* binding points, the same for every program */
+#define UNIFORMS_FRAME_BINDING 0
+#define UNIFORMS_SCENE_BINDING 1
+
+/* std140 FrameBlock in resources/shaders/uniforms.glsl, matrices column major */
+struct FrameUniforms {
+    float16 view, projection;
+    float16 cascade_vp[UNIFORMS_MAX_CASCADES];
+    float16 light_vp_dynamic;
+    float cascade_splits[UNIFORMS_MAX_CASCADES];
+    Vector3 view_pos;
+    float time;
+    Vector3 view_forward;
+    i32 cascade_count;
+    i32 shadow_map_resolution, shadow_map_dynamic_resolution;
+    i32 pad[2];
+    /* light clusters: slice scale, slice bias, near / tiles x, y, slices, light count */
+    float cluster_params[4];
+    i32 cluster_dims[4];
+};
+
+/* std140 SceneBlock */
+struct SceneUniforms {
+    Vector3 light_dir;
+    float pad;
+    Vector4 light_color;
+    Vector4 ambient;
+    /* towards the sun the terrain was baked for, baked visibility replaces the cascades when set */
+    Vector3 sun_bake_dir;
+    i32 sun_bake_enabled;
+};
+
+/*
+ * One buffer per block, bound once to its binding point. Writers fill
+ * frame/scene and upload, programs pick the blocks up through
+ * uniformsBindBlocks when loaded.
+ */
+struct UniformBuffers {
+    unsigned int frame_ubo, scene_ubo;
+    struct FrameUniforms frame;
+    struct SceneUniforms scene;
+};
+
+extern struct UniformBuffers uniform_buffers;
+
+void uniformsInit(void);
+void uniformsUnload(void);
+/**
+ * point the program's FrameBlock/SceneBlock, if it has them, at the
+ * shared binding points
+ */
+void uniformsBindBlocks(Shader shader);
+/**
+ * fill in the camera part of the frame block
+ */
+void uniformsSetCamera(Camera3D camera, float aspect);
+void uniformsUploadFrame(void);
+void uniformsUploadScene(void);
+
+#endif
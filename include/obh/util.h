@@ -1,13 +1,126 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <pthread.h>
+
 #include "incl.h"
 #include "c_log.h"
 
+#define WORK_QUEUE_MAX_THREADS 16
+
+/**
+ * a job's work, on a worker without the lock held
+ * @return job for workQueueTake, NULL if run kept or freed it
+ */
+typedef void *(*WorkQueueRun)(void *job, void *user);
+
+/*
+ * Worker threads taking jobs off a queue in the order pushed and handing
+ * them back finished. The owner may guard state of its own with lock, and
+ * wait on idle, broadcast whenever a job finishes.
+ */
+struct WorkQueue {
+    WorkQueueRun run;
+    void *user;
+    pthread_t threads[WORK_QUEUE_MAX_THREADS];
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work, idle;
+    /* stb_ds arrays guarded by lock */
+    void **pending, **done;
+    int in_flight;
+    bool quit;
+};
+
+typedef struct WorkQueue WorkQueue;
+
+#define JOB_POOL_MAX_THREADS 16
+
+/**
+ * one item of a dispatch
+ * @param thread 0 for the caller, below the pool's thread_count
+ */
+typedef void (*JobPoolRun)(void *user, int item, int thread);
+
+struct JobPoolThread {
+    struct JobPool *pool;
+    pthread_t id;
+    int index;
+};
+
+/*
+ * Threads splitting a range of items with the caller. Items go to whichever
+ * thread asks first and a dispatch returns once all are done, so per thread
+ * state needs no lock between dispatches.
+ */
+struct JobPool {
+    JobPoolRun run;
+    void *user;
+    int items, next, running;
+    u64 generation;
+    /* threads[0] is the caller */
+    struct JobPoolThread threads[JOB_POOL_MAX_THREADS];
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work, idle;
+    bool quit;
+};
+
+typedef struct JobPool JobPool;
+
 void arr_i_print(const int *arr, const int len);
 void arr_i_print2d(const int *arr, const int width, const int height);
 void arr_d_print(double *arr, int len);
 void arr_f_print(float *arr, int len);
 sds sdsfread(sds append_to, const char* path);
+/**
+ * monotonic clock in milliseconds, usable without a window
+ */
+double time_ms(void);
+/**
+ * create dir and any missing parents, like mkdir -p
+ */
+void mkdir_p(const char *dir);
+/**
+ * @param threads worker count, <= 0 for one per core but the main thread,
+ * clamped to max_threads and WORK_QUEUE_MAX_THREADS
+ * @param name of the workers for the log
+ * @return workers started
+ */
+int workQueueInit(WorkQueue *q, int threads, int max_threads, WorkQueueRun run, void *user, const char *name);
+/**
+ * join the workers, then hand every job not taken to discard
+ */
+void workQueueUnload(WorkQueue *q, void (*discard)(void *job));
+/**
+ * @param front ahead of everything pending
+ */
+void workQueuePush(WorkQueue *q, void *job, bool front);
+/**
+ * @return stb_ds array of jobs finished since the last take, oldest first,
+ * for the caller to arrfree
+ */
+void **workQueueTake(WorkQueue *q);
+/**
+ * @return jobs pending or running
+ */
+int workQueueOutstanding(WorkQueue *q);
+/**
+ * block until nothing is pending or running, returns at once without workers
+ */
+void workQueueWait(WorkQueue *q);
+/**
+ * @param threads threads including the caller, <= 0 for one per core,
+ * clamped to max_threads and JOB_POOL_MAX_THREADS
+ * @param name of the workers for the log
+ * @return threads including the caller
+ */
+int jobPoolInit(JobPool *pool, int threads, int max_threads, const char *name);
+void jobPoolUnload(JobPool *pool);
+/**
+ * run items [0, items) across every thread, the caller included, and
+ * return once they are done
+ */
+void jobPoolDispatch(JobPool *pool, int items, JobPoolRun run, void *user);
 
 #endif
@@ -0,0 +1,83 @@
+/*****************************************************
+Create Date:        2024-11-28
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "./incl.h"
+#include "../raylib/raylib.h"
+#include "../raylib/raymath.h"
+
+#define CHUNKSIZE 32
+#define HEIGHTLEVELS 40
+
+enum CUBETYPE {
+    CUBETYPE_GRASS,
+    CUBETYPE_NUM,
+};
+
+typedef struct iVec2 {
+    int x, y;
+} iVec2;
+
+struct Cube {
+    int x, y, z;
+    enum CUBETYPE type;
+};
+
+struct WorldChunk {
+    iVec2 coord;
+    /* value of world_revision when the chunk was last added or edited */
+    u64 revision;
+    /* lowest and highest cube, kept up to date on edits */
+    int y_min, y_max;
+    struct Cube cubes[CHUNKSIZE][CHUNKSIZE];
+};
+
+struct WorldMap {
+    union {
+        iVec2 coord;
+        iVec2 key;
+    };
+    union {
+        struct WorldChunk chunk;
+        struct WorldChunk value;
+    };
+};
+
+/* stb_ds hashmap of all generated chunks, keyed on chunk coordinates */
+extern struct WorldMap *world_map;
+/* bumped every time a chunk is added or edited */
+extern u64 world_revision;
+
+struct WorldChunk genWorldChunk(int x, int z);
+iVec2 getChunkCoords(Vector3 position);
+/**
+ * generate every missing chunk within radius chunks of position
+ */
+void genWorldAround(Vector3 position, int radius);
+/**
+ * height of the cube at chunk local column x, z
+ */
+int worldColumnHeight(const struct WorldChunk *wc, int x, int z);
+/**
+ * world space position of a cube in a chunk
+ */
+Vector3 worldCubePosition(const struct WorldChunk *wc, int z, int x);
+/**
+ * world space bounds of every cube in the chunk
+ */
+BoundingBox worldChunkBoundingBox(const struct WorldChunk *wc);
+/**
+ * set the height of the column containing position, bumps the revision
+ * of the owning chunk
+ * @return false if the chunk has not been generated
+ */
+bool worldSetColumnHeight(Vector3 position, int height);
+
+#endif
@@ -0,0 +1,15 @@
+#version 330
+
+// Debug lines, world space positions with a colour per vertex
+in vec3 vertexPosition;
+in vec4 vertexColor;
+
+uniform mat4 mvp;
+
+out vec4 fragColor;
+
+void main()
+{
+    fragColor = vertexColor;
+    gl_Position = mvp*vec4(vertexPosition, 1.0);
+}
@@ -0,0 +1,8 @@
+#version 330
+
+// Depth-only fragment shader for shadow casters
+// Depth is written by the fixed function stage and colour writes are masked off
+
+void main()
+{
+}
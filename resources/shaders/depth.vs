@@ -0,0 +1,14 @@
+#version 330
+
+// Depth-only vertex shader for shadow casters, nothing is passed on
+
+// Input vertex attributes
+in vec3 vertexPosition;
+
+// Input uniform values
+uniform mat4 mvp;
+
+void main()
+{
+    gl_Position = mvp*vec4(vertexPosition, 1.0);
+}
@@ -0,0 +1,67 @@
+#version 330
+
+// Single pass FXAA over the resolved scene target
+// Luma edge detection, then a blend along the edge direction (FXAA 3.11 "quality 10" style)
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+// size of texture0 in texels
+uniform vec2 resolution;
+
+out vec4 finalColor;
+
+#define FXAA_SPAN_MAX 8.0
+#define FXAA_REDUCE_MUL (1.0/8.0)
+#define FXAA_REDUCE_MIN (1.0/128.0)
+
+float luma(vec3 c)
+{
+    return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    vec2 texel = 1.0/resolution;
+    vec2 uv = fragTexCoord;
+
+    vec3 rgbNW = texture(texture0, uv + vec2(-1.0, -1.0)*texel).rgb;
+    vec3 rgbNE = texture(texture0, uv + vec2( 1.0, -1.0)*texel).rgb;
+    vec3 rgbSW = texture(texture0, uv + vec2(-1.0,  1.0)*texel).rgb;
+    vec3 rgbSE = texture(texture0, uv + vec2( 1.0,  1.0)*texel).rgb;
+    vec4 center = texture(texture0, uv);
+
+    float lumaNW = luma(rgbNW);
+    float lumaNE = luma(rgbNE);
+    float lumaSW = luma(rgbSW);
+    float lumaSE = luma(rgbSE);
+    float lumaM = luma(center.rgb);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    // Flat areas are left alone
+    if (lumaMax - lumaMin < max(0.0312, lumaMax*0.125))
+    {
+        finalColor = center*colDiffuse*fragColor;
+        return;
+    }
+
+    // Gradient is perpendicular to the edge, blend along the edge
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE)*(0.25*FXAA_REDUCE_MUL), FXAA_REDUCE_MIN);
+    float rcpDirMin = 1.0/(min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir*rcpDirMin, vec2(-FXAA_SPAN_MAX), vec2(FXAA_SPAN_MAX))*texel;
+
+    vec3 rgbA = 0.5*(texture(texture0, uv + dir*(1.0/3.0 - 0.5)).rgb +
+                     texture(texture0, uv + dir*(2.0/3.0 - 0.5)).rgb);
+    vec3 rgbB = rgbA*0.5 + 0.25*(texture(texture0, uv + dir*-0.5).rgb +
+                                 texture(texture0, uv + dir*0.5).rgb);
+
+    // Wide blend overshot the local range, use the narrow one
+    float lumaB = luma(rgbB);
+    vec3 rgb = (lumaB < lumaMin || lumaB > lumaMax) ? rgbA : rgbB;
+
+    finalColor = vec4(rgb, center.a)*colDiffuse*fragColor;
+}
@@ -0,0 +1,52 @@
+// Clustered point lights shared by the lit shaders, included with stb_include
+// Expects `in vec3 fragPosition` (world space) declared before the include
+#ifndef LIGHTS_GLSL
+#define LIGHTS_GLSL
+
+#include "uniforms.glsl"
+
+// Two texels per light: position + radius, color + intensity
+uniform samplerBuffer lightData;
+// Offset and count into lightIndices for every cluster
+uniform usamplerBuffer lightGrid;
+uniform usamplerBuffer lightIndices;
+
+// Cluster the fragment falls in, -1 past the last depth slice
+int lightCluster()
+{
+    vec4 clip = frameProjection * frameView * vec4(fragPosition, 1.0);
+    vec2 tile = clamp((clip.xy / clip.w) * 0.5 + 0.5, 0.0, 0.9999) * vec2(clusterDims.xy);
+    float depth = max(dot(fragPosition - viewPos, viewForward), clusterParams.z);
+    int slice = int(floor(log(depth) * clusterParams.x + clusterParams.y));
+    if (slice >= clusterDims.z) return -1;
+    return (max(slice, 0) * clusterDims.y + int(tile.y)) * clusterDims.x + int(tile.x);
+}
+
+// Adds the diffuse and specular light of every point light reaching the fragment
+void pointLights(vec3 normal, vec3 viewD, inout vec3 diffuse, inout vec3 specular)
+{
+    if (clusterDims.w == 0) return;
+    int cluster = lightCluster();
+    if (cluster < 0) return;
+    uvec2 range = texelFetch(lightGrid, cluster).rg;
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).r);
+        vec4 posRadius = texelFetch(lightData, 2*light);
+        vec4 color = texelFetch(lightData, 2*light + 1);
+
+        vec3 toLight = posRadius.xyz - fragPosition;
+        float dist = length(toLight);
+        vec3 l = toLight / max(dist, 0.0001);
+        // Inverse square falloff windowed to reach zero at the radius
+        float window = clamp(1.0 - pow(dist / posRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (dist * dist + 1.0);
+        vec3 radiance = color.rgb * color.a * attenuation;
+
+        float NdotL = max(dot(normal, l), 0.0);
+        diffuse += radiance * NdotL;
+        if (NdotL > 0.0) specular += radiance * pow(max(0.0, dot(viewD, reflect(-l, normal))), 16.0);
+    }
+}
+
+#endif
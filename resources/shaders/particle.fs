@@ -0,0 +1,16 @@
+#version 330
+
+in vec2 fragCorner;
+in float fragAlpha;
+
+uniform vec4 colDiffuse;
+
+out vec4 finalColor;
+
+void main()
+{
+    // round, soft edged
+    float d = dot(fragCorner, fragCorner);
+    if (d > 1.0) discard;
+    finalColor = vec4(colDiffuse.rgb, colDiffuse.a*fragAlpha*(1.0 - d));
+}
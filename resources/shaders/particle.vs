@@ -0,0 +1,29 @@
+#version 330
+
+// One instance per particle slot, a quad facing the camera
+in float particleX;
+in float particleY;
+in float particleZ;
+in float particleLife;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float size;
+// seconds of life over which a particle fades out
+uniform float fade;
+
+out vec2 fragCorner;
+out float fragAlpha;
+
+void main()
+{
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1)*2.0 - 1.0;
+    // dead slots collapse to a point and produce no fragments
+    float alive = float(particleLife > 0.0);
+    vec4 position = view*vec4(particleX, particleY, particleZ, 1.0);
+    position.xy += corner*size*0.5*alive;
+
+    fragCorner = corner;
+    fragAlpha = clamp(particleLife/fade, 0.0, 1.0);
+    gl_Position = projection*position;
+}
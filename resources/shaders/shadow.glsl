@@ -0,0 +1,102 @@
+// Shadow lookups shared by the lit shaders, included with stb_include
+// Expects `in vec3 fragPosition` (world space) declared before the include
+
+#include "uniforms.glsl"
+#include "sun_bake.glsl"
+
+// Input shadowmapping values, matrices and sizes live in FrameBlock
+// Static terrain depth, one layer per slice of the view frustum
+uniform sampler2DArray shadowCascades;
+// Small per-frame layer holding only dynamic casters, fitted around the player
+uniform sampler2D shadowMapDynamic;
+
+vec3 lightSpaceCoords(mat4 vp)
+{
+    vec4 fragPosLightSpace = vp * vec4(fragPosition, 1);
+    fragPosLightSpace.xyz /= fragPosLightSpace.w; // Perform the perspective division
+    return (fragPosLightSpace.xyz + 1.0f) / 2.0f; // Transform from [-1, 1] range to [0, 1] range
+}
+
+bool outsideLayer(vec3 coords)
+{
+    return any(lessThan(coords.xy, vec2(0.0))) || any(greaterThan(coords.xy, vec2(1.0)));
+}
+
+// PCF (percentage-closer filtering) algorithm:
+// Instead of testing if just one point is closer to the current point,
+// we test the surrounding points as well.
+// This blurs shadow edges, hiding aliasing artifacts.
+// Returns the fraction of samples in shadow
+float cascadeShadow(int cascade, float bias)
+{
+    vec3 coords = lightSpaceCoords(cascadeVP[cascade]);
+    // Outside the layer nothing is known, so nothing is shadowed
+    if (outsideLayer(coords))
+        return 0.0;
+    int shadowCounter = 0;
+    const int numSamples = 9;
+    vec2 texelSize = vec2(1.0f / float(shadowMapResolution));
+    for (int x = -1; x <= 1; x++)
+    {
+        for (int y = -1; y <= 1; y++)
+        {
+            float sampleDepth = texture(shadowCascades, vec3(coords.xy + texelSize * vec2(x, y), float(cascade))).r;
+            if (coords.z - bias > sampleDepth)
+            {
+                shadowCounter++;
+            }
+        }
+    }
+    return float(shadowCounter) / float(numSamples);
+}
+
+float dynamicShadow(float bias)
+{
+    vec3 coords = lightSpaceCoords(lightVPDynamic);
+    if (outsideLayer(coords))
+        return 0.0;
+    int shadowCounter = 0;
+    const int numSamples = 9;
+    vec2 texelSize = vec2(1.0f / float(shadowMapDynamicResolution));
+    for (int x = -1; x <= 1; x++)
+    {
+        for (int y = -1; y <= 1; y++)
+        {
+            float sampleDepth = texture(shadowMapDynamic, coords.xy + texelSize * vec2(x, y)).r;
+            if (coords.z - bias > sampleDepth)
+            {
+                shadowCounter++;
+            }
+        }
+    }
+    return float(shadowCounter) / float(numSamples);
+}
+
+// Fraction of light blocked at fragPosition, 0 lit .. 1 fully shadowed
+float sceneShadow(vec3 normal, vec3 l)
+{
+    // Slope-scale depth bias: depth biasing reduces "shadow acne" artifacts, where dark stripes appear all over the scene.
+    // Casters are drawn front-face culled with polygon offset, so only a small
+    // slope dependent bias is left here
+    float bias = max(0.0005 * (1.0 - dot(normal, l)), 0.00005);
+    float shadow = 0.0;
+    if (sunBakeEnabled != 0)
+    {
+        // Static terrain comes from the bake, only dynamic casters are left in the maps
+        shadow = 1.0 - bakedSunVisibility(normal);
+    }
+    else
+    {
+        // Pick the first cascade whose slice contains the fragment
+        float viewDepth = dot(fragPosition - viewPos, viewForward);
+        for (int i = 0; i < cascadeCount; i++)
+        {
+            if (viewDepth < cascadeSplits[i])
+            {
+                shadow = cascadeShadow(i, bias);
+                break;
+            }
+        }
+    }
+    return max(shadow, dynamicShadow(bias));
+}
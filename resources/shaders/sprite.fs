@@ -0,0 +1,16 @@
+#version 330
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+uniform sampler2D texture0;
+
+out vec4 finalColor;
+
+void main()
+{
+    vec4 texel = texture(texture0, fragTexCoord)*fragColor;
+    // billboards write depth, keep their clear pixels out of it
+    if (texel.a < 0.1) discard;
+    finalColor = texel;
+}
@@ -0,0 +1,33 @@
+// Baked terrain sun and sky visibility shared by the lit shaders, included with stb_include
+// Expects `in vec3 fragPosition` (world space) declared before the include
+#ifndef SUN_BAKE_GLSL
+#define SUN_BAKE_GLSL
+
+#include "uniforms.glsl"
+
+// One texel per column, wrapping around the world:
+// sun on the top face, on the side facing the sun along x, along z, sky on the top face
+uniform sampler2D sunBake;
+
+vec4 bakedColumn()
+{
+    ivec2 column = ivec2(floor(fragPosition.xz + 0.5)) & (textureSize(sunBake, 0) - 1);
+    return texelFetch(sunBake, column, 0);
+}
+
+// Fraction of the sun reaching the fragment, faces turned away from it get 1 (N.L is 0 there anyway)
+float bakedSunVisibility(vec3 normal)
+{
+    vec4 column = bakedColumn();
+    vec3 a = abs(normal);
+    if (a.y >= a.x && a.y >= a.z) return (normal.y > 0.0) ? column.r : 1.0;
+    if (a.x >= a.z) return (normal.x * sunBakeDir.x > 0.0) ? column.g : 1.0;
+    return (normal.z * sunBakeDir.z > 0.0) ? column.b : 1.0;
+}
+
+float bakedSkyVisibility()
+{
+    return bakedColumn().a;
+}
+
+#endif
@@ -0,0 +1,15 @@
+#version 330
+
+// Glyph quads from the text cache, already laid out
+in vec2 vertexPosition;
+in vec2 vertexTexCoord;
+
+uniform mat4 mvp;
+
+out vec2 fragTexCoord;
+
+void main()
+{
+    fragTexCoord = vertexTexCoord;
+    gl_Position = mvp*vec4(vertexPosition, 0.0, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330
+
+// Signed distance field font atlas, the glyph edge is at 0.5
+in vec2 fragTexCoord;
+
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+
+out vec4 finalColor;
+
+void main()
+{
+    float distance = texture(texture0, fragTexCoord).r;
+    // Antialias over about one screen pixel whatever size the text is drawn at
+    float width = fwidth(distance);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    finalColor = vec4(colDiffuse.rgb, colDiffuse.a*alpha);
+}
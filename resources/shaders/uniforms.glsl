@@ -0,0 +1,34 @@
+// Uniform blocks shared by every program, filled once per frame / scene by uniforms.c
+// Layouts are std140 and must match struct FrameUniforms / SceneUniforms
+#ifndef UNIFORMS_GLSL
+#define UNIFORMS_GLSL
+
+#define MAX_CASCADES 4
+
+layout(std140) uniform FrameBlock
+{
+    mat4 frameView;
+    mat4 frameProjection;
+    mat4 cascadeVP[MAX_CASCADES];   // Light source view-projection matrix per cascade
+    mat4 lightVPDynamic;
+    vec4 cascadeSplits;             // View depth where each cascade ends
+    vec3 viewPos;
+    float time;                     // Seconds since start
+    vec3 viewForward;
+    int cascadeCount;
+    int shadowMapResolution;
+    int shadowMapDynamicResolution;
+    vec4 clusterParams;             // Light slice = log(depth) * x + y, z is the first slice depth
+    ivec4 clusterDims;              // Tiles across, tiles up, depth slices, light count
+};
+
+layout(std140) uniform SceneBlock
+{
+    vec3 lightDir;
+    vec4 lightColor;
+    vec4 ambient;
+    vec3 sunBakeDir;                // Towards the sun the terrain was baked for
+    int sunBakeEnabled;             // Baked terrain visibility replaces the shadow cascades
+};
+
+#endif
@@ -0,0 +1,153 @@
+/*****************************************************
+Create Date:        2024-12-08
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/aa.h"
+#include "../include/obh/util.h"
+#include "../include/obh/shader_cache.h"
+#include "../include/raylib/rlgl.h"
+#include "../include/glad/glad.h"
+
+static const char *aa_mode_names[AA_MODE_COUNT] = { "off", "msaa 2x", "msaa 4x", "fxaa" };
+
+static int aaModeSamples(enum AAMode mode)
+{
+    return mode == AA_MSAA_2X ? 2 : mode == AA_MSAA_4X ? 4 : 0;
+}
+
+static void aaUnloadMsaa(AntiAliasing *aa)
+{
+    if (aa->msaa_fbo == 0)
+        return;
+    glDeleteRenderbuffers(1, &aa->msaa_color);
+    glDeleteRenderbuffers(1, &aa->msaa_depth);
+    glDeleteFramebuffers(1, &aa->msaa_fbo);
+    aa->msaa_fbo = aa->msaa_color = aa->msaa_depth = 0;
+    aa->msaa_width = aa->msaa_height = aa->msaa_samples = 0;
+}
+
+static bool aaLoadMsaa(AntiAliasing *aa, int width, int height, int samples)
+{
+    aaUnloadMsaa(aa);
+
+    glGenFramebuffers(1, &aa->msaa_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, aa->msaa_fbo);
+    glGenRenderbuffers(1, &aa->msaa_color);
+    glBindRenderbuffer(GL_RENDERBUFFER, aa->msaa_color);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, aa->msaa_color);
+    glGenRenderbuffers(1, &aa->msaa_depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, aa->msaa_depth);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, aa->msaa_depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        c_log_warn(LOG_TAG, "msaa %dx framebuffer incomplete, anti-aliasing off", samples);
+        aaUnloadMsaa(aa);
+        return false;
+    }
+
+    aa->msaa_width = width;
+    aa->msaa_height = height;
+    aa->msaa_samples = samples;
+    return true;
+}
+
+void aaInit(AntiAliasing *aa, enum AAMode mode)
+{
+    *aa = (AntiAliasing) { .mode = mode };
+
+    if (GLAD_GL_VERSION_3_0) {
+        glGetIntegerv(GL_MAX_SAMPLES, &aa->max_samples);
+        aa->max_samples = min(aa->max_samples, 4);
+    }
+
+    aa->fxaa = shaderCacheLoad(NULL, "resources/shaders/fxaa.fs");
+    aa->fxaa_resolution_loc = GetShaderLocation(aa->fxaa, "resolution");
+}
+
+void aaUnload(AntiAliasing *aa)
+{
+    aaUnloadMsaa(aa);
+    UnloadShader(aa->fxaa);
+    *aa = (AntiAliasing) { 0 };
+}
+
+void aaSetMode(AntiAliasing *aa, enum AAMode mode)
+{
+    aa->mode = mode;
+}
+
+const char *aaModeName(enum AAMode mode)
+{
+    return aa_mode_names[mode];
+}
+
+void aaPrepare(AntiAliasing *aa, RenderTexture2D scene)
+{
+    int samples = min(aaModeSamples(aa->mode), aa->max_samples);
+    /* msaa asked for but not available */
+    if (aaModeSamples(aa->mode) > 0 && samples < 2)
+        aa->mode = AA_OFF;
+    if (samples < 2) {
+        aaUnloadMsaa(aa);
+        aa->draw_target = scene;
+        return;
+    }
+
+    int w = scene.texture.width, h = scene.texture.height;
+    if (aa->msaa_fbo == 0 || aa->msaa_width != w || aa->msaa_height != h || aa->msaa_samples != samples) {
+        if (!aaLoadMsaa(aa, w, h, samples)) {
+            aa->mode = AA_OFF;
+            aa->draw_target = scene;
+            return;
+        }
+    }
+
+    /* BeginTextureMode only needs the fbo id and its size */
+    aa->draw_target = (RenderTexture2D) {
+        .id = aa->msaa_fbo,
+        .texture = { .width = w, .height = h },
+        .depth = { .width = w, .height = h },
+    };
+}
+
+void aaBegin(AntiAliasing *aa)
+{
+    BeginTextureMode(aa->draw_target);
+}
+
+void aaEnd(AntiAliasing *aa, RenderTexture2D scene)
+{
+    EndTextureMode();
+    if (aa->draw_target.id == scene.id)
+        return;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, aa->msaa_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, scene.id);
+    glBlitFramebuffer(0, 0, aa->msaa_width, aa->msaa_height,
+            0, 0, scene.texture.width, scene.texture.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void aaBeginPresent(AntiAliasing *aa, RenderTexture2D scene)
+{
+    if (aa->mode != AA_FXAA)
+        return;
+    Vector2 resolution = { scene.texture.width, scene.texture.height };
+    SetShaderValue(aa->fxaa, aa->fxaa_resolution_loc, &resolution, SHADER_UNIFORM_VEC2);
+    BeginShaderMode(aa->fxaa);
+}
+
+void aaEndPresent(AntiAliasing *aa)
+{
+    if (aa->mode == AA_FXAA)
+        EndShaderMode();
+}
@@ -0,0 +1,270 @@
+/*****************************************************
+Create Date:        2024-12-22
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/anim.h"
+#include "../include/obh/util.h"
+#include "../include/obh/c_log.h"
+#include "../include/raylib/rlgl.h"
+
+void animInit(AnimSystem *as, int threads, bool gpu)
+{
+    *as = (AnimSystem) { .lod_near = 20, .lod_far = 100, .lod_interval = 0.25f, .gpu = gpu };
+    jobPoolInit(&as->pool, threads, ANIM_MAX_THREADS, "anim");
+}
+
+void animUnload(AnimSystem *as)
+{
+    jobPoolUnload(&as->pool);
+
+    for (int i = 0; i < arrlen(as->instances); ++i) {
+        MemFree(as->instances[i].palette);
+        MemFree(as->instances[i].vertices);
+    }
+    for (int i = 0; i < arrlen(as->rigs); ++i) {
+        MemFree(as->rigs[i].inverse_bind);
+        MemFree(as->rigs[i].mesh_offset);
+    }
+    arrfree(as->instances);
+    arrfree(as->rigs);
+    arrfree(as->due);
+    *as = (AnimSystem) { 0 };
+}
+
+/* as raylib builds bone matrices: scale, then rotate, then translate */
+static Matrix animTransformMatrix(Transform t)
+{
+    return MatrixMultiply(MatrixMultiply(MatrixScale(t.scale.x, t.scale.y, t.scale.z), QuaternionToMatrix(t.rotation)),
+            MatrixTranslate(t.translation.x, t.translation.y, t.translation.z));
+}
+
+/* frames are close together, nlerp the short way round is as good as slerp */
+static Quaternion animNlerp(Quaternion a, Quaternion b, float t)
+{
+    if (a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0)
+        b = (Quaternion) { -b.x, -b.y, -b.z, -b.w };
+    return QuaternionNlerp(a, b, t);
+}
+
+static Transform animBlend(Transform a, Transform b, float t)
+{
+    return (Transform) {
+        Vector3Lerp(a.translation, b.translation, t),
+        animNlerp(a.rotation, b.rotation, t),
+        Vector3Lerp(a.scale, b.scale, t),
+    };
+}
+
+/* joint at time into a looping clip, between the two frames around it */
+static Transform animSample(const ModelAnimation *clip, float time, int joint)
+{
+    float f = time / ANIM_FRAME_TIME;
+    f -= floorf(f / clip->frameCount) * clip->frameCount;
+    int a = min((int)f, clip->frameCount - 1);
+    int b = (a + 1) % clip->frameCount;
+    return animBlend(clip->framePoses[a][joint], clip->framePoses[b][joint], f - a);
+}
+
+/*
+ * raylib's clip poses are in model space, so fades blend those rather than
+ * local transforms. Limbs take a straight path instead of an arc, which
+ * short fades hide.
+ */
+static void animPose(const AnimSystem *as, struct AnimInstance *in)
+{
+    const struct AnimRig *rig = &as->rigs[in->rig];
+    for (int j = 0; j < rig->joint_count; ++j) {
+        Transform t = in->clip >= 0 ? animSample(&rig->clips[in->clip], in->time, j) : rig->model.bindPose[j];
+        if (in->blend < 1) {
+            Transform from = in->from_clip >= 0
+                ? animSample(&rig->clips[in->from_clip], in->from_time, j) : rig->model.bindPose[j];
+            t = animBlend(from, t, in->blend);
+        }
+        Matrix m = MatrixMultiply(rig->inverse_bind[j], animTransformMatrix(t));
+        v4f *c = in->palette + j * 4;
+        c[0] = (v4f) { m.m0, m.m1, m.m2, m.m3 };
+        c[1] = (v4f) { m.m4, m.m5, m.m6, m.m7 };
+        c[2] = (v4f) { m.m8, m.m9, m.m10, m.m11 };
+        c[3] = (v4f) { m.m12, m.m13, m.m14, m.m15 };
+    }
+}
+
+/*
+ * The 4 joint matrices of a vertex are summed by weight a column at a time,
+ * then the position and normal are the columns scaled by their components.
+ * Normals go through the same matrix and are renormalized, which is exact
+ * for the rotations and uniform scales skeletons use.
+ */
+static void animSkin(const struct AnimRig *rig, struct AnimInstance *in)
+{
+    for (int m = 0; m < rig->model.meshCount; ++m) {
+        if (rig->mesh_offset[m] < 0)
+            continue;
+        const Mesh *mesh = &rig->model.meshes[m];
+        float *positions = in->vertices + rig->mesh_offset[m];
+        float *normals = positions + mesh->vertexCount * 3;
+        for (int v = 0; v < mesh->vertexCount; ++v) {
+            const u8 *ids = mesh->boneIds + v * 4;
+            const float *weights = mesh->boneWeights + v * 4;
+            v4f c0 = V4F(0), c1 = V4F(0), c2 = V4F(0), c3 = V4F(0);
+            /* unused influences weigh 0, adding them is cheaper than a branch */
+            for (int k = 0; k < 4; ++k) {
+                const v4f *joint = in->palette + ids[k] * 4;
+                v4f w = V4F(weights[k]);
+                c0 += joint[0] * w;
+                c1 += joint[1] * w;
+                c2 += joint[2] * w;
+                c3 += joint[3] * w;
+            }
+            const float *p = mesh->vertices + v * 3;
+            v4f out = c0 * V4F(p[0]) + c1 * V4F(p[1]) + c2 * V4F(p[2]) + c3;
+            memcpy(positions + v * 3, &out, 3 * sizeof(float));
+            if (mesh->normals == NULL)
+                continue;
+            const float *n = mesh->normals + v * 3;
+            out = c0 * V4F(n[0]) + c1 * V4F(n[1]) + c2 * V4F(n[2]);
+            out[3] = 0;
+            out *= V4F(1 / fmaxf(sqrtf(v4f_hadd(out * out)), 1e-12f));
+            memcpy(normals + v * 3, &out, 3 * sizeof(float));
+        }
+    }
+}
+
+/* pose and skin instance due[item] */
+static void animRun(void *user, int item, int thread)
+{
+    AnimSystem *as = user;
+    struct AnimInstance *in = &as->instances[as->due[item]];
+    animPose(as, in);
+    animSkin(&as->rigs[in->rig], in);
+}
+
+int animAddRig(AnimSystem *as, Model model, ModelAnimation *clips, int clip_count)
+{
+    for (int c = 0; c < clip_count; ++c) {
+        if (clips[c].boneCount != model.boneCount || clips[c].frameCount <= 0) {
+            c_log_error(LOG_TAG, "clip %s has %d joints and %d frames, the model %d joints", clips[c].name,
+                    clips[c].boneCount, clips[c].frameCount, model.boneCount);
+            return -1;
+        }
+    }
+    struct AnimRig rig = { .model = model, .clips = clips, .clip_count = clip_count, .joint_count = model.boneCount };
+    rig.inverse_bind = MemAlloc(max(rig.joint_count, 1) * sizeof(Matrix));
+    for (int j = 0; j < rig.joint_count; ++j)
+        rig.inverse_bind[j] = MatrixInvert(animTransformMatrix(model.bindPose[j]));
+
+    rig.mesh_offset = MemAlloc(max(model.meshCount, 1) * sizeof(int));
+    for (int m = 0; m < model.meshCount; ++m) {
+        const Mesh *mesh = &model.meshes[m];
+        bool skinned = rig.joint_count > 0 && mesh->boneIds != NULL && mesh->boneWeights != NULL;
+        for (int i = 0; skinned && i < mesh->vertexCount * 4; ++i)
+            skinned = mesh->boneIds[i] < rig.joint_count;
+        rig.mesh_offset[m] = -1;
+        if (!skinned)
+            continue;
+        rig.mesh_offset[m] = rig.floats;
+        rig.floats += mesh->vertexCount * (mesh->normals ? 6 : 3);
+        rig.vertex_count += mesh->vertexCount;
+    }
+    if (rig.vertex_count == 0)
+        c_log_warn(LOG_TAG, "rig %d has no skinned meshes, it is drawn as it is", (int)arrlen(as->rigs));
+    arrput(as->rigs, rig);
+    return arrlen(as->rigs) - 1;
+}
+
+int animAddInstance(AnimSystem *as, int rig, int clip, Vector3 position)
+{
+    const struct AnimRig *r = &as->rigs[rig];
+    int id = arrlen(as->instances);
+    struct AnimInstance in = {
+        .rig = rig, .position = position, .clip = clip, .from_clip = -1, .speed = 1, .blend = 1,
+        /* spread over the interval so distant instances do not all pose on one frame */
+        .pending = fmodf(id * 0.618034f, 1) * as->lod_interval,
+        .palette = MemAlloc(max(r->joint_count, 1) * 4 * sizeof(v4f)),
+        .vertices = MemAlloc(max(r->floats, 1) * sizeof(float)),
+    };
+    /* drawable before the first update */
+    animPose(as, &in);
+    animSkin(r, &in);
+    arrput(as->instances, in);
+    return id;
+}
+
+void animPlay(AnimSystem *as, int instance, int clip, float fade)
+{
+    struct AnimInstance *in = &as->instances[instance];
+    if (clip == in->clip)
+        return;
+    in->from_clip = in->clip;
+    in->from_time = in->time;
+    in->clip = clip;
+    in->time = 0;
+    in->blend = fade > 0 ? 0 : 1;
+    in->fade_rate = fade > 0 ? 1 / fade : 0;
+}
+
+/* looping clips only need time within one loop, float time drifts otherwise */
+static float animWrap(const struct AnimRig *rig, int clip, float time)
+{
+    if (clip < 0)
+        return 0;
+    float length = rig->clips[clip].frameCount * ANIM_FRAME_TIME;
+    return time - floorf(time / length) * length;
+}
+
+void animUpdate(AnimSystem *as, float dt, Vector3 camera)
+{
+    double start = time_ms();
+    arrsetlen(as->due, 0);
+    as->vertices = 0;
+    as->skipped = 0;
+    float range = fmaxf(as->lod_far - as->lod_near, 1e-3f);
+    for (int i = 0; i < arrlen(as->instances); ++i) {
+        struct AnimInstance *in = &as->instances[i];
+        const struct AnimRig *rig = &as->rigs[in->rig];
+        /* clocks always run, only posing is skipped */
+        in->time = animWrap(rig, in->clip, in->time + dt * in->speed);
+        in->from_time = animWrap(rig, in->from_clip, in->from_time + dt * in->speed);
+        in->blend = fminf(in->blend + dt * in->fade_rate, 1);
+
+        float d = Vector3Distance(camera, in->position);
+        in->interval = as->lod_interval * Clamp((d - as->lod_near) / range, 0, 1);
+        in->pending += dt;
+        in->posed = in->pending >= in->interval && rig->vertex_count > 0;
+        if (!in->posed) {
+            as->skipped++;
+            continue;
+        }
+        in->pending = in->interval > 0 ? fmodf(in->pending, in->interval) : 0;
+        arrput(as->due, i);
+        as->vertices += rig->vertex_count;
+    }
+    as->posed = arrlen(as->due);
+    jobPoolDispatch(&as->pool, as->posed, animRun, as);
+    as->ms = time_ms() - start;
+}
+
+void animDraw(AnimSystem *as, int instance, float yaw, float scale, Color tint)
+{
+    if (!as->gpu)
+        return;
+    const struct AnimInstance *in = &as->instances[instance];
+    const struct AnimRig *rig = &as->rigs[in->rig];
+    for (int m = 0; m < rig->model.meshCount; ++m) {
+        if (rig->mesh_offset[m] < 0)
+            continue;
+        const Mesh *mesh = &rig->model.meshes[m];
+        const float *positions = in->vertices + rig->mesh_offset[m];
+        rlUpdateVertexBuffer(mesh->vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION], positions,
+                mesh->vertexCount * 3 * sizeof(float), 0);
+        if (mesh->normals != NULL) {
+            rlUpdateVertexBuffer(mesh->vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL],
+                    positions + mesh->vertexCount * 3, mesh->vertexCount * 3 * sizeof(float), 0);
+        }
+    }
+    DrawModelEx(rig->model, in->position, (Vector3) { 0, 1, 0 }, yaw, (Vector3) { scale, scale, scale }, tint);
+}
@@ -0,0 +1,1334 @@
+/*****************************************************
+Create Date:        2024-12-04
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include <unistd.h>
+
+#include "../include/obh/bench.h"
+#include "../include/obh/util.h"
+#include "../include/obh/world.h"
+#include "../include/obh/occlusion.h"
+#include "../include/obh/render_queue.h"
+#include "../include/obh/aa.h"
+#include "../include/obh/light_clusters.h"
+#include "../include/obh/sun_bake.h"
+#include "../include/obh/debug.h"
+#include "../include/obh/sprite.h"
+#include "../include/obh/particles.h"
+#include "../include/obh/soft_render.h"
+#include "../include/obh/impostor.h"
+#include "../include/obh/texture_stream.h"
+#include "../include/obh/mesh_opt.h"
+#include "../include/obh/mesh_lod.h"
+#include "../include/obh/anim.h"
+#include "../include/obh/terrain.h"
+#include "../include/obh/cube.h"
+#include "../include/raylib/raymath.h"
+#include "../include/raylib/rlgl.h"
+#include "../include/glad/glad.h"
+
+struct Bench {
+    const char *name;
+    const char *usage;
+    int (*run)(int argc, char **argv);
+};
+
+struct BenchCamera *benchLoadCameraPath(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        c_log_error(LOG_TAG, "could not open camera path %s", path);
+        return NULL;
+    }
+
+    struct BenchCamera *cams = NULL;
+    struct BenchCamera c;
+    while (fscanf(f, "%f %f %f %f %f %f %f", &c.position.x, &c.position.y, &c.position.z,
+                &c.target.x, &c.target.y, &c.target.z, &c.fovy) == 7) {
+        arrput(cams, c);
+    }
+    fclose(f);
+
+    return cams;
+}
+
+struct BenchCamera *benchDefaultCameraPath(int frames)
+{
+    struct BenchCamera *cams = NULL;
+    for (int i = 0; i < frames; ++i) {
+        float a = 2 * PI * i / frames;
+        Vector3 pos = { cosf(a) * 60, 4, sinf(a) * 60 };
+        /* look along the orbit, across the terrain rather than at the centre */
+        Vector3 target = { cosf(a + 0.3f) * 60, 3, sinf(a + 0.3f) * 60 };
+        arrput(cams, ((struct BenchCamera) { pos, target, 45 }));
+    }
+    return cams;
+}
+
+void benchRecordCamera(FILE *f, Camera3D camera)
+{
+    fprintf(f, "%f %f %f %f %f %f %f\n",
+            camera.position.x, camera.position.y, camera.position.z,
+            camera.target.x, camera.target.y, camera.target.z, camera.fovy);
+}
+
+Camera3D benchCamera(struct BenchCamera c)
+{
+    return (Camera3D) {
+        .position = c.position, .target = c.target, .up = { 0, 1, 0 },
+        .fovy = c.fovy, .projection = CAMERA_PERSPECTIVE,
+    };
+}
+
+static u64 bench_draw_calls, bench_triangles;
+static PFNGLDRAWARRAYSPROC bench_draw_arrays;
+static PFNGLDRAWELEMENTSPROC bench_draw_elements;
+static PFNGLDRAWARRAYSINSTANCEDPROC bench_draw_arrays_instanced;
+static PFNGLDRAWELEMENTSINSTANCEDPROC bench_draw_elements_instanced;
+
+static void benchCountDraw(GLenum mode, GLsizei count, GLsizei instances)
+{
+    bench_draw_calls++;
+    u64 triangles = 0;
+    if (mode == GL_TRIANGLES)
+        triangles = count / 3;
+    else if (mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN)
+        triangles = max(count - 2, 0);
+    bench_triangles += triangles * instances;
+}
+
+static void GLAD_API_PTR benchDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    benchCountDraw(mode, count, 1);
+    bench_draw_arrays(mode, first, count);
+}
+
+static void GLAD_API_PTR benchDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+{
+    benchCountDraw(mode, count, 1);
+    bench_draw_elements(mode, count, type, indices);
+}
+
+static void GLAD_API_PTR benchDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+{
+    benchCountDraw(mode, count, instances);
+    bench_draw_arrays_instanced(mode, first, count, instances);
+}
+
+static void GLAD_API_PTR benchDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type,
+        const void *indices, GLsizei instances)
+{
+    benchCountDraw(mode, count, instances);
+    bench_draw_elements_instanced(mode, count, type, indices, instances);
+}
+
+void benchCountDraws(void)
+{
+    if (bench_draw_arrays != NULL)
+        return;
+    bench_draw_arrays = glad_glDrawArrays;
+    bench_draw_elements = glad_glDrawElements;
+    bench_draw_arrays_instanced = glad_glDrawArraysInstanced;
+    bench_draw_elements_instanced = glad_glDrawElementsInstanced;
+    glad_glDrawArrays = benchDrawArrays;
+    glad_glDrawElements = benchDrawElements;
+    glad_glDrawArraysInstanced = benchDrawArraysInstanced;
+    glad_glDrawElementsInstanced = benchDrawElementsInstanced;
+
+    /*
+     * only works when libraylib exports its glad pointers, a private copy
+     * never sees the swap and every frame would count 0 draws. Push one
+     * degenerate triangle through rlgl to find out now rather than print
+     * zeros for the whole run.
+     */
+    rlBegin(RL_TRIANGLES);
+        for (int i = 0; i < 3; ++i)
+            rlVertex3f(0, 0, 0);
+    rlEnd();
+    rlDrawRenderBatchActive();
+    if (bench_draw_calls == 0) {
+        c_log_error(LOG_TAG, "draw counting sees no rlgl draws, libraylib has to export its glad_gl* symbols");
+        exit(EXIT_FAILURE);
+    }
+    bench_draw_calls = 0;
+    bench_triangles = 0;
+}
+
+void benchTakeDrawCounts(u64 *draw_calls, u64 *triangles)
+{
+    *draw_calls = bench_draw_calls;
+    *triangles = bench_triangles;
+    bench_draw_calls = 0;
+    bench_triangles = 0;
+}
+
+u32 benchChecksumBackbuffer(void)
+{
+    rlDrawRenderBatchActive();
+    int width = GetRenderWidth(), height = GetRenderHeight();
+    u8 *pixels = MemAlloc((size_t)width * height * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    u32 hash = 2166136261u;
+    for (size_t i = 0; i < (size_t)width * height * 4; ++i) {
+        /* alpha is whatever the last blend left behind, it never reaches the screen */
+        if (i % 4 == 3)
+            continue;
+        hash = (hash ^ pixels[i]) * 16777619u;
+    }
+    MemFree(pixels);
+    return hash;
+}
+
+static int benchCompareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* of sorted values */
+static double benchPercentile(const double *values, int n, double p)
+{
+    return n > 0 ? values[min((int)(n * p), n - 1)] : 0;
+}
+
+/* mean and percentiles of one field over frames past the warmup */
+static void benchWriteStats(FILE *f, const char *name, const struct BenchFrame *frames, int count, size_t offset)
+{
+    int first = count > BENCH_WARMUP_FRAMES ? BENCH_WARMUP_FRAMES : 0;
+    int n = count - first;
+    double *values = MemAlloc(max(n, 1) * sizeof(double));
+    double sum = 0;
+    for (int i = 0; i < n; ++i) {
+        values[i] = *(const double *)((const u8 *)&frames[first + i] + offset);
+        sum += values[i];
+    }
+    qsort(values, n, sizeof(double), benchCompareDouble);
+    fprintf(f, "  \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f },\n",
+            name, n > 0 ? sum / n : 0, benchPercentile(values, n, 0.5), benchPercentile(values, n, 0.95),
+            benchPercentile(values, n, 0.99), benchPercentile(values, n, 1));
+    MemFree(values);
+}
+
+/* driver strings can hold anything */
+static void benchWriteJsonString(FILE *f, const char *str)
+{
+    fputc('"', f);
+    for (; str != NULL && *str != '\0'; ++str) {
+        if (*str == '"' || *str == '\\')
+            fputc('\\', f);
+        if ((u8)*str >= 0x20)
+            fputc(*str, f);
+    }
+    fputc('"', f);
+}
+
+bool benchWriteResults(const char *path, const struct BenchFrame *frames, int count)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        c_log_error(LOG_TAG, "could not write results to %s", path);
+        return false;
+    }
+
+    int first = count > BENCH_WARMUP_FRAMES ? BENCH_WARMUP_FRAMES : 0;
+    u64 draw_calls = 0, triangles = 0;
+    for (int i = first; i < count; ++i) {
+        draw_calls += frames[i].draw_calls;
+        triangles += frames[i].triangles;
+    }
+    fprintf(f, "{\n  \"renderer\": ");
+    benchWriteJsonString(f, (const char *)glGetString(GL_RENDERER));
+    fprintf(f, ",\n  \"version\": ");
+    benchWriteJsonString(f, (const char *)glGetString(GL_VERSION));
+    fprintf(f, ",\n  \"width\": %d,\n  \"height\": %d,\n", GetRenderWidth(), GetRenderHeight());
+    fprintf(f, "  \"frames\": %d,\n  \"warmup\": %d,\n", count, first);
+    benchWriteStats(f, "cpu_ms", frames, count, offsetof(struct BenchFrame, cpu_ms));
+    benchWriteStats(f, "gpu_ms", frames, count, offsetof(struct BenchFrame, gpu_ms));
+    fprintf(f, "  \"draw_calls\": %.1f,\n  \"triangles\": %.1f,\n",
+            (double)draw_calls / max(count - first, 1), (double)triangles / max(count - first, 1));
+    fprintf(f, "  \"per_frame\": [\n");
+    for (int i = 0; i < count; ++i) {
+        const struct BenchFrame *bf = &frames[i];
+        fprintf(f, "    { \"cpu_ms\": %.4f, \"gpu_ms\": %.4f, \"draw_calls\": %llu, \"triangles\": %llu, \"checksum\": \"%08x\" }%s\n",
+                bf->cpu_ms, bf->gpu_ms, (unsigned long long)bf->draw_calls, (unsigned long long)bf->triangles,
+                bf->checksum, i + 1 < count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+int benchGolden(const char *path, const struct BenchFrame *frames, int count)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        f = fopen(path, "w");
+        if (f == NULL) {
+            c_log_error(LOG_TAG, "could not write golden checksums to %s", path);
+            return -1;
+        }
+        for (int i = 0; i < count; ++i)
+            fprintf(f, "%d %08x\n", i, frames[i].checksum);
+        fclose(f);
+        c_log_info(LOG_TAG, "wrote %d golden checksums to %s", count, path);
+        return 0;
+    }
+
+    int mismatches = 0, golden = 0, frame;
+    u32 checksum;
+    while (fscanf(f, "%d %x", &frame, &checksum) == 2) {
+        golden++;
+        /* frames past the end are counted below */
+        if (frame >= 0 && frame < count && frames[frame].checksum != checksum) {
+            if (mismatches < 10)
+                c_log_error(LOG_TAG, "frame %d differs from %s", frame, path);
+            mismatches++;
+        }
+    }
+    fclose(f);
+    if (golden != count) {
+        c_log_error(LOG_TAG, "%s has %d frames, the run had %d", path, golden, count);
+        mismatches += abs(count - golden);
+    }
+    return mismatches;
+}
+
+/* occlusion [camera path], culls every chunk within 8 of the origin */
+static int benchOcclusion(int argc, char **argv)
+{
+    struct BenchCamera *path = argc > 0 ? benchLoadCameraPath(argv[0]) : benchDefaultCameraPath(360);
+    if (arrlen(path) == 0) {
+        arrfree(path);
+        return EXIT_FAILURE;
+    }
+
+    genWorldAround((Vector3) { 0 }, 8);
+
+    OcclusionCuller oc;
+    occlusionInit(&oc, false);
+
+    double raster_ms = 0, test_ms = 0;
+    u64 triangles = 0, tested = 0, occluded = 0, off_screen = 0;
+    for (int f = 0; f < arrlen(path); ++f) {
+        occlusionBegin(&oc, benchCamera(path[f]), 16.0f / 9.0f);
+        occlusionWait(&oc);
+
+        double start = time_ms();
+        for (int i = 0; i < hmlen(world_map); ++i)
+            occlusionTestBox(&oc, worldChunkBoundingBox(&world_map[i].chunk));
+        test_ms += time_ms() - start;
+
+        raster_ms += oc.raster_ms;
+        triangles += oc.triangles;
+        tested += oc.tested;
+        occluded += oc.occluded;
+        off_screen += oc.off_screen;
+    }
+
+    int frames = arrlen(path);
+    u64 on_screen = tested - off_screen;
+    printf("occlusion: %d frames, %d chunks\n", frames, (int)hmlen(world_map));
+    printf("  raster:   %.3f ms/frame, %.0f triangles/frame\n", raster_ms / frames, (double)triangles / frames);
+    printf("  test:     %.3f ms/frame\n", test_ms / frames);
+    printf("  culled:   %.1f%% off screen, %.1f%% of on screen chunks occluded\n",
+            100.0 * off_screen / max(tested, 1ull), 100.0 * occluded / max(on_screen, 1ull));
+
+    occlusionUnload(&oc);
+    arrfree(path);
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * points inside every light, mapped to clusters the way the shader does,
+ * must find the light in that cluster's list
+ * @return samples that did not
+ */
+static int benchClustersCheck(const LightClusters *lc, Camera3D camera, float aspect)
+{
+    Matrix view = MatrixLookAt(camera.position, camera.target, camera.up);
+    float sy = tanf(camera.fovy * DEG2RAD * 0.5f), sx = sy * aspect;
+    int missed = 0;
+    for (int i = 0; i < arrlen(lc->lights); ++i) {
+        for (int n = 0; n < 64; ++n) {
+            Vector3 p = { 2.0f * rand() / RAND_MAX - 1, 2.0f * rand() / RAND_MAX - 1, 2.0f * rand() / RAND_MAX - 1 };
+            if (Vector3LengthSqr(p) > 1)
+                continue;
+            p = Vector3Add(lc->lights[i].position, Vector3Scale(p, lc->lights[i].radius * 0.999f));
+            Vector3 v = Vector3Transform(p, view);
+            float depth = -v.z, ndc_x = v.x / (depth * sx), ndc_y = v.y / (depth * sy);
+            if (depth <= 0 || depth >= lc->far || fabsf(ndc_x) >= 1 || fabsf(ndc_y) >= 1)
+                continue;
+            int c = lightClustersIndex(lc, ndc_x, ndc_y, depth);
+            const u32 *list = lc->indices + lc->grid[c * 2];
+            bool found = false;
+            for (u32 j = 0; j < lc->grid[c * 2 + 1] && !found; ++j)
+                found = list[j] == (u32)i;
+            missed += !found;
+        }
+    }
+    return missed;
+}
+
+/* clusters [lights] [camera path], random lamps over the area the default path orbits */
+static int benchClusters(int argc, char **argv)
+{
+    int n = argc > 0 ? min(max(atoi(argv[0]), 1), CLUSTERS_MAX_LIGHTS) : 512;
+    struct BenchCamera *path = argc > 1 ? benchLoadCameraPath(argv[1]) : benchDefaultCameraPath(360);
+    if (arrlen(path) == 0) {
+        arrfree(path);
+        return EXIT_FAILURE;
+    }
+
+    LightClusters lc;
+    lightClustersInit(&lc, 1.0f, 200.0f, false);
+    srand(1);
+    for (int i = 0; i < n; ++i) {
+        float a = 2 * PI * rand() / RAND_MAX, d = 80.0f * rand() / RAND_MAX;
+        lightClustersAdd(&lc, (struct PointLight) {
+            .position = { cosf(a) * d, 1 + 7.0f * rand() / RAND_MAX, sinf(a) * d },
+            .radius = 4 + 8.0f * rand() / RAND_MAX, .color = { 1, 1, 1 }, .intensity = 1,
+        });
+    }
+
+    double assign_ms = 0;
+    u64 indices = 0, lit = 0;
+    int max_per_cluster = 0, missed = 0;
+    for (int f = 0; f < arrlen(path); ++f) {
+        Camera3D camera = benchCamera(path[f]);
+        lightClustersAssign(&lc, camera, 16.0f / 9.0f);
+        assign_ms += lc.assign_ms;
+        indices += arrlen(lc.indices);
+        lit += lc.clusters_lit;
+        max_per_cluster = max(max_per_cluster, lc.max_per_cluster);
+        missed += benchClustersCheck(&lc, camera, 16.0f / 9.0f);
+    }
+
+    int frames = arrlen(path);
+    printf("clusters: %d frames, %d lights, %d x %d x %d clusters\n", frames, n, CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z);
+    printf("  assign:   %.3f ms/frame\n", assign_ms / frames);
+    printf("  lists:    %.0f indices/frame, %.1f lights per lit cluster (max %d), %.1f%% clusters lit\n",
+            (double)indices / frames, (double)indices / max(lit, 1ull), max_per_cluster,
+            100.0 * lit / ((double)frames * CLUSTERS_COUNT));
+    printf("  check:    %d points inside a light fell in a cluster not listing it\n", missed);
+
+    lightClustersUnload(&lc);
+    arrfree(path);
+
+    return missed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* bake every chunk within radius of the origin from scratch */
+static void benchSunBakeAll(SunBake *sb, int radius)
+{
+    do {
+        sunBakeUpdate(sb, (Vector3) { 0 }, radius);
+        sunBakeWait(sb);
+        sunBakeUpdate(sb, (Vector3) { 0 }, radius);
+    } while (sb->chunks_outstanding > 0);
+}
+
+/* sunbake [threads], the chunks within 8 of the origin and then a single edit */
+static int benchSunBake(int argc, char **argv)
+{
+    int threads = argc > 0 ? atoi(argv[0]) : 0;
+    const int radius = 8;
+    genWorldAround((Vector3) { 0 }, radius + 1);
+
+    SunBake sb;
+    sunBakeInit(&sb, (Vector3) { 100, -200, 100 }, threads, false);
+
+    double start = time_ms();
+    benchSunBakeAll(&sb, radius);
+    double wall_ms = time_ms() - start;
+    printf("sunbake: %d chunks, %d threads\n", sb.chunks_baked, sb.queue.thread_count);
+    printf("  full:     %.1f ms, %.0f faces/s, %.0f faces/s per core\n", wall_ms,
+            sb.faces_baked / (wall_ms / 1000.0), sb.faces_baked / (sb.bake_ms / 1000.0));
+
+    /* raise one column, only the chunks around it should come back */
+    int baked = sb.chunks_baked;
+    Vector3 edit = { 5, 0, 5 };
+    worldSetColumnHeight(edit, 12);
+    start = time_ms();
+    benchSunBakeAll(&sb, radius);
+    printf("  edit:     %d chunks re-baked in %.1f ms\n", sb.chunks_baked - baked, time_ms() - start);
+
+    sunBakeUnload(&sb);
+    return EXIT_SUCCESS;
+}
+
+/* the kind of calls a frame makes: a box per chunk and now and then a label */
+static void benchDebugDrawPush(int first, int calls)
+{
+    for (int i = first; i < first + calls; ++i) {
+        Vector3 p = { (float)(i & 63), 0, (float)(i >> 6 & 63) };
+        DEBUG_BOX(DEBUG_DRAW_CHUNKS, ((BoundingBox) { p, Vector3AddValue(p, 1) }), GREEN);
+        if ((i & 63) == 0)
+            DEBUG_TEXT(DEBUG_DRAW_CHUNKS, p, 0.5f, WHITE, "%d", i);
+    }
+}
+
+struct BenchDebugDrawJob {
+    pthread_t thread;
+    int first, calls;
+};
+
+static void *benchDebugDrawWorker(void *arg)
+{
+    struct BenchDebugDrawJob *job = arg;
+    benchDebugDrawPush(job->first, job->calls);
+    return NULL;
+}
+
+/* debugdraw [calls] [threads], cost of a call switched off, on, and on from several threads */
+static int benchDebugDraw(int argc, char **argv)
+{
+    int calls = argc > 0 ? max(atoi(argv[0]), 1) : 1000000;
+    int threads = argc > 1 ? (int)Clamp(atoi(argv[1]), 1, 64) : 4;
+    const int frames = 10;
+    debugDrawInit((TextFont) { 0 }, DEBUG_DRAW_ALL, false);
+
+    printf("debugdraw: %d calls per frame, %d frames\n", calls, frames);
+#ifdef DEBUG_DRAW_OFF
+    printf("  compiled out, every call is an unevaluated sizeof\n");
+#endif
+
+    debugDrawSetEnabled(false);
+    double start = time_ms();
+    for (int f = 0; f < frames; ++f) {
+        benchDebugDrawPush(0, calls);
+        debugDrawFlush();
+    }
+    double off_ms = time_ms() - start;
+    printf("  off:      %6.2f ns/call, %d lines gathered\n", off_ms * 1e6 / ((double)calls * frames),
+            debug_draw.lines);
+
+    debugDrawSetEnabled(true);
+    double push_ms = 0, flush_ms = 0;
+    for (int f = 0; f < frames; ++f) {
+        start = time_ms();
+        benchDebugDrawPush(0, calls);
+        push_ms += time_ms() - start;
+        start = time_ms();
+        debugDrawFlush();
+        flush_ms += time_ms() - start;
+    }
+    printf("  on:       %6.2f ns/call, gather %.2f ms for %d lines, %d labels\n",
+            push_ms * 1e6 / ((double)calls * frames), flush_ms / frames, debug_draw.lines, debug_draw.labels);
+
+    struct BenchDebugDrawJob *jobs = calloc(threads, sizeof(*jobs));
+    push_ms = flush_ms = 0;
+    for (int f = 0; f < frames; ++f) {
+        start = time_ms();
+        for (int t = 0; t < threads; ++t) {
+            jobs[t] = (struct BenchDebugDrawJob) { .first = calls / threads * t, .calls = calls / threads };
+            pthread_create(&jobs[t].thread, NULL, benchDebugDrawWorker, &jobs[t]);
+        }
+        for (int t = 0; t < threads; ++t)
+            pthread_join(jobs[t].thread, NULL);
+        push_ms += time_ms() - start;
+        start = time_ms();
+        debugDrawFlush();
+        flush_ms += time_ms() - start;
+    }
+    printf("  threads:  %6.2f ns/call wall on %d threads, gather %.2f ms for %d lines\n",
+            push_ms * 1e6 / ((double)calls * frames), threads, flush_ms / frames, debug_draw.lines);
+
+    free(jobs);
+    debugDrawUnload();
+    return EXIT_SUCCESS;
+}
+
+/* sprites [count] [frames], builds every batch on the cpu, headless */
+static int benchSprites(int argc, char **argv)
+{
+    int count = argc > 0 ? max(atoi(argv[0]), 1) : 10000;
+    int frames = argc > 1 ? max(atoi(argv[1]), 1) : 100;
+
+    /* 16 sheets of 4 x 4 64 pixel frames, more than one page holds */
+    SpriteAtlas atlas = { 0 };
+    int sheets = 16;
+    for (int i = 0; i < sheets; ++i) {
+        Image image = { calloc(256 * 256, 4), 256, 256, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+        spriteAtlasAdd(&atlas, image, 4, 4);
+        free(image.data);
+    }
+    spriteAtlasBuild(&atlas, false);
+    int regions = arrlen(atlas.regions);
+
+    SpriteBatch batch;
+    for (int billboard = 0; billboard < 2; ++billboard) {
+        spriteBatchInit(&batch, &atlas, billboard, false);
+        double push_ms = 0, build_ms = 0;
+        int switches = 0;
+        u32 h = 1;
+        for (int f = 0; f < frames; ++f) {
+            double start = time_ms();
+            int last_page = -1;
+            for (int i = 0; i < count; ++i) {
+                h = h * 1664525u + 1013904223u;
+                int region = spriteAnimFrame((h >> 8) % regions & ~3, 4, 8, f / 60.0);
+                Vector3 p = { (h >> 4) % 1280, (h >> 12) % 720, (h >> 20) % 64 };
+                spriteDraw(&batch, region, p, (Vector2) { 32, 32 }, (h & 1) ? 0 : 15, WHITE);
+                /* what a draw per sprite in push order would rebind */
+                switches += atlas.regions[region].page != last_page;
+                last_page = atlas.regions[region].page;
+            }
+            push_ms += time_ms() - start;
+            spriteBatchFlush(&batch);
+            build_ms += batch.build_ms;
+        }
+        int pages_used = 0;
+        for (int p = 0; p < arrlen(atlas.pages); ++p)
+            pages_used += batch.page_counts[p + 1] > batch.page_counts[p];
+
+        printf("sprites %s: %d per frame, %d frames, %d regions on %d pages\n", billboard ? "billboard" : "screen",
+                count, frames, regions, (int)arrlen(atlas.pages));
+        printf("  push %.3f ms, build %.3f ms per frame, %.0f sprites/ms\n", push_ms / frames, build_ms / frames,
+                (double)count * frames / (push_ms + build_ms));
+        printf("  %d vertex buffers / draws per frame, %d texture switches in push order\n",
+                pages_used, switches / frames);
+        spriteBatchUnload(&batch);
+    }
+
+    spriteAtlasUnload(&atlas);
+    return EXIT_SUCCESS;
+}
+
+/* particles [count] [emitters], the update step only, headless */
+static int benchParticles(int argc, char **argv)
+{
+    int count = argc > 0 ? max(atoi(argv[0]), 16) : 1000000;
+    int emitters = argc > 1 ? (int)Clamp(atoi(argv[1]), 1, PARTICLES_MAX_EMITTERS) : 16;
+    const int frames = 200;
+    const float dt = 1 / 60.0f;
+    genWorldAround((Vector3) { 0 }, 2);
+
+    ParticleSystem ps;
+    particlesInit(&ps, false);
+    for (int i = 0; i < emitters; ++i) {
+        /* rain and dust mixed, every pool kept full */
+        bool rain = i & 1;
+        struct ParticleEmitterDesc desc = {
+            .shape = rain ? PARTICLE_SHAPE_BOX : PARTICLE_SHAPE_CONE,
+            .extent = { 8, 0, 8 }, .life = 2, .speed = rain ? 1 : 4, .spread = 0.6f,
+            .gravity = { 0, rain ? -30 : -9.8f, 0 }, .drag = rain ? 1.5f : 0.2f,
+            .bounce = 0.3f, .friction = 0.8f, .kill_on_hit = rain,
+            .size = 0.1f, .color = WHITE, .capacity = count / emitters,
+        };
+        desc.rate = desc.capacity / desc.life;
+        Vector3 origin = { (i % 4) * 16 - 24, rain ? 30 : 12, (i / 4 % 4) * 16 - 24 };
+        int e = particlesAddEmitter(&ps, desc, origin);
+        particlesBurst(&ps, e, desc.capacity);
+    }
+
+    Camera3D camera = { .position = { 0, 120, 1 }, .target = { 0, 0, 0 }, .up = { 0, 1, 0 },
+        .fovy = 60, .projection = CAMERA_PERSPECTIVE };
+    double update_ms = 0;
+    u64 simulated = 0;
+    for (int f = 0; f < frames; ++f) {
+        particlesUpdate(&ps, camera, 16 / 9.0f, dt);
+        update_ms += ps.update_ms;
+        simulated += ps.simulated;
+    }
+    printf("particles: %d emitters, %llu slots\n", emitters, (unsigned long long)(simulated / frames));
+    printf("  visible:  %.3f ms/frame, %.1f M particles/ms\n", update_ms / frames,
+            simulated / update_ms / 1e6);
+
+    /* looking up and away, everything is paused */
+    camera.target = (Vector3) { 0, 240, 500 };
+    update_ms = 0;
+    for (int f = 0; f < frames; ++f) {
+        particlesUpdate(&ps, camera, 16 / 9.0f, dt);
+        update_ms += ps.update_ms;
+    }
+    printf("  culled:   %.3f ms/frame, %d of %d emitters paused\n", update_ms / frames,
+            ps.emitters_culled, ps.emitter_count);
+
+    particlesUnload(&ps);
+    return EXIT_SUCCESS;
+}
+
+/* softraster [frames] [max threads] [image], the cpu renderer at 800x600 by thread count, headless */
+static int benchSoftRender(int argc, char **argv)
+{
+    int frames = argc > 0 ? max(atoi(argv[0]), 1) : 120;
+    int max_threads = argc > 1 ? atoi(argv[1]) : 0;
+    if (max_threads <= 0)
+        max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    max_threads = min(max(max_threads, 1), SOFT_RENDER_MAX_THREADS);
+    const char *image = argc > 2 ? argv[2] : NULL;
+
+    genWorldAround((Vector3) { 0 }, 8);
+    Terrain lods;
+    terrainInit(&lods, (Shader) { 0 }, 1, 8);
+    struct BenchCamera *path = benchDefaultCameraPath(frames);
+
+    printf("softraster: %d frames at 800 x 600, %d chunks\n", frames, (int)hmlen(world_map));
+    for (int threads = 1; ; threads = min(threads * 2, max_threads)) {
+        SoftRender sr;
+        softRenderInit(&sr, 800, 600, threads);
+        /* builds the meshes and the shadow map once */
+        softRenderDraw(&sr, &lods, (Vector3) { 0 }, benchCamera(path[0]));
+        double shadow_ms = sr.shadow_ms;
+
+        double frame_ms = 0, setup_ms = 0, raster_ms = 0;
+        u64 triangles = 0;
+        for (int f = 0; f < frames; ++f) {
+            /* the focus stays put so chunks are not rebuilt, only the view moves */
+            softRenderDraw(&sr, &lods, (Vector3) { 0 }, benchCamera(path[f]));
+            frame_ms += sr.frame_ms;
+            setup_ms += sr.setup_ms;
+            raster_ms += sr.raster_ms;
+            triangles += sr.triangles;
+        }
+        printf("  %2d threads: %6.1f fps  %7.3f ms/frame  setup %6.3f ms  raster %6.3f ms  %.0f triangles  shadow map %.1f ms\n",
+                sr.pool.thread_count, 1000.0 * frames / frame_ms, frame_ms / frames, setup_ms / frames,
+                raster_ms / frames, (double)triangles / frames, shadow_ms);
+        if (image != NULL && threads == max_threads && softRenderSave(&sr, image))
+            printf("  last frame written to %s\n", image);
+        softRenderUnload(&sr);
+        if (threads == max_threads)
+            break;
+    }
+
+    arrfree(path);
+    terrainUnload(&lods);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * impostors [units] [frames], opens a window: a crowd of monks with every
+ * one a mesh, then with quads past 30 units, at units and 4x units
+ */
+static int benchImpostors(int argc, char **argv)
+{
+    int units = argc > 0 ? max(atoi(argv[0]), 1) : 2000;
+    int frames = argc > 1 ? max(atoi(argv[1]), 1) : 300;
+    const int warmup = 10;
+
+    InitWindow(1280, 720, "bench impostors");
+    SetTargetFPS(0);
+    benchCountDraws();
+
+    Model monk = LoadModel("resources/models/monk_character/scene.gltf");
+    if (monk.meshCount == 0) {
+        CloseWindow();
+        return EXIT_FAILURE;
+    }
+    /* 1.8 units tall */
+    BoundingBox bb = GetModelBoundingBox(monk);
+    float scale = 1.8f / fmaxf(bb.max.y - bb.min.y, 1e-3f);
+
+    ImpostorSet set;
+    impostorInit(&set, 30, 5, true);
+    double start = time_ms();
+    int id = impostorAdd(&set, monk, 16, 20, 128);
+    impostorBuild(&set);
+    printf("impostors: 16 views baked in %.1f ms\n", time_ms() - start);
+
+    unsigned int query;
+    glGenQueries(1, &query);
+
+    for (int pass = 0; pass < 4 && !WindowShouldClose(); ++pass) {
+        bool impostors = pass % 2 == 1;
+        int count = pass < 2 ? units : units * 4;
+        int side = (int)ceilf(sqrtf(count));
+        set.distance = impostors ? 30 : INFINITY;
+
+        double frame_ms = 0, gpu_ms = 0;
+        u64 draw_calls = 0, triangles = 0, meshes = 0, quads = 0;
+        for (int f = -warmup; f < frames; ++f) {
+            float a = 2 * PI * max(f, 0) / frames;
+            Camera3D camera = {
+                .position = { cosf(a) * side, 12, sinf(a) * side }, .target = { 0 },
+                .up = { 0, 1, 0 }, .fovy = 45, .projection = CAMERA_PERSPECTIVE,
+            };
+            u64 calls, tris;
+            benchTakeDrawCounts(&calls, &tris);
+            double frame_start = time_ms();
+
+            BeginDrawing();
+            glBeginQuery(GL_TIME_ELAPSED, query);
+                ClearBackground(SKYBLUE);
+                BeginMode3D(camera);
+                    u32 h = 1;
+                    for (int i = 0; i < count; ++i) {
+                        h = h * 1664525u + 1013904223u;
+                        Vector3 p = { (i % side - side * 0.5f) * 2, 0, (i / side - side * 0.5f) * 2 };
+                        impostorDraw(&set, id, p, (h >> 8) % 360, scale, WHITE, camera);
+                    }
+                    impostorFlush(&set);
+                EndMode3D();
+            rlDrawRenderBatchActive();
+            glEndQuery(GL_TIME_ELAPSED);
+            glFinish();
+            double ms = time_ms() - frame_start;
+            EndDrawing();
+
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+            benchTakeDrawCounts(&calls, &tris);
+            if (f >= 0) {
+                frame_ms += ms;
+                gpu_ms += ns / 1e6;
+                draw_calls += calls;
+                triangles += tris;
+                meshes += set.meshes;
+                quads += set.impostors;
+            }
+        }
+        frame_ms /= frames;
+        gpu_ms /= frames;
+        printf("  %-9s %6d units  %7.3f ms/frame  gpu %7.3f ms  %6.2f us/unit  %5llu meshes  %5llu quads"
+                "  %6llu draws  %8llu triangles\n", impostors ? "impostors" : "meshes", count, frame_ms, gpu_ms,
+                frame_ms * 1000 / count, (unsigned long long)(meshes / frames), (unsigned long long)(quads / frames),
+                (unsigned long long)(draw_calls / frames), (unsigned long long)(triangles / frames));
+    }
+
+    glDeleteQueries(1, &query);
+    impostorUnload(&set);
+    UnloadModel(monk);
+    CloseWindow();
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * texstream [budget MiB] [frames], opens a window: every image in
+ * resources/images on a grid of objects the default orbit flies past
+ */
+static int benchTextureStream(int argc, char **argv)
+{
+    size_t budget = (size_t)(argc > 0 ? max(atoi(argv[0]), 1) : 16) << 20;
+    int frames = argc > 1 ? max(atoi(argv[1]), 1) : 600;
+    const float mib = 1024 * 1024;
+
+    InitWindow(1280, 720, "bench texstream");
+    SetTargetFPS(0);
+
+    TextureStream ts;
+    textureStreamInit(&ts, budget, 0, true);
+    FilePathList files = LoadDirectoryFilesEx("resources/images", ".png;.jpg", false);
+    int *ids = NULL;
+    size_t full_bytes = 0;
+    for (unsigned i = 0; i < files.count; ++i) {
+        int id = textureStreamLoad(&ts, files.paths[i]);
+        if (id < 0)
+            continue;
+        arrput(ids, id);
+        /* a full chain is a third on top of mip 0 */
+        full_bytes += (size_t)ts.textures[id].width * ts.textures[id].height * 4 * 4 / 3;
+    }
+    UnloadDirectoryFiles(files);
+    if (arrlen(ids) == 0) {
+        textureStreamUnload(&ts);
+        CloseWindow();
+        return EXIT_FAILURE;
+    }
+    textureStreamWait(&ts);
+
+    /* 20 x 20 objects 6 apart, the orbit passes along the outer rows */
+    struct BenchCamera *path = benchDefaultCameraPath(frames);
+    size_t peak = 0;
+    double update_ms = 0, update_peak = 0;
+    int uses = 0, at_wanted = 0;
+    for (int f = 0; f < frames && !WindowShouldClose(); ++f) {
+        Camera3D camera = benchCamera(path[f]);
+        Vector3 forward = Vector3Normalize(Vector3Subtract(camera.target, camera.position));
+        for (int i = 0; i < 400; ++i) {
+            Vector3 p = { (i % 20 - 9.5f) * 6, 1.5f, (i / 20 - 9.5f) * 6 };
+            /* only what is roughly in view asks for mips */
+            Vector3 to = Vector3Subtract(p, camera.position);
+            if (Vector3DotProduct(to, forward) < Vector3Length(to) * 0.7f)
+                continue;
+            float size = textureStreamScreenSize(camera, p, 1.5f, GetScreenHeight());
+            /* 5 x 5 blocks share a texture, so the orbit sees a few at a time */
+            textureStreamUse(&ts, ids[(i % 20 / 5 + i / 100 * 4) % arrlen(ids)], size);
+        }
+        double start = time_ms();
+        textureStreamUpdate(&ts);
+        double ms = time_ms() - start;
+        update_ms += ms;
+        update_peak = fmax(update_peak, ms);
+        peak = max(peak, ts.resident_bytes);
+        for (int i = 0; i < arrlen(ts.textures); ++i) {
+            const struct StreamedTexture *t = &ts.textures[i];
+            if (t->last_used + 1 != ts.frame)
+                continue;
+            uses++;
+            at_wanted += t->resident <= t->requested;
+        }
+        BeginDrawing();
+        ClearBackground(BLACK);
+        EndDrawing();
+    }
+    textureStreamWait(&ts);
+
+    printf("texstream: %d textures, %.2f MiB with every mip, budget %.2f MiB, %d frames\n",
+            (int)arrlen(ids), full_bytes / mib, budget / mib, frames);
+    printf("  resident: %.2f MiB peak, %.2f MiB at the end\n", peak / mib, ts.resident_bytes / mib);
+    printf("  %d loads, %d evictions, %d deferred, %d failed / %.0f%% of uses at their wanted mip\n",
+            ts.loads, ts.evictions, ts.deferred, ts.failures, uses > 0 ? 100.0 * at_wanted / uses : 0.0);
+    printf("  decode %.2f ms per load on %d workers / update %.3f ms per frame, peak %.3f ms, uploads %.3f ms\n",
+            ts.loads > 0 ? ts.decode_ms / ts.loads : 0.0, ts.queue.thread_count, update_ms / frames, update_peak,
+            ts.upload_ms / frames);
+
+    arrfree(path);
+    arrfree(ids);
+    textureStreamUnload(&ts);
+    CloseWindow();
+    return EXIT_SUCCESS;
+}
+
+/* a model of one test mesh or file for benchMeshOpt, not uploaded yet */
+static Model benchMeshOptSource(int i, const char **name)
+{
+    const struct WorldChunk *wc = &world_map[0].chunk;
+    switch (i) {
+    case 0: *name = "cube.c cube"; return LoadModelFromMesh(genCubeMesh());
+    case 1: *name = "GenMeshCube"; return LoadModelFromMesh(GenMeshCube(1, 1, 1));
+    case 2: *name = "GenMeshSphere"; return LoadModelFromMesh(GenMeshSphere(0.5f, 32, 32));
+    case 3: *name = "terrain lod 0"; return LoadModelFromMesh(terrainGenChunkMesh(wc, 0));
+    case 4: *name = "terrain lod 2"; return LoadModelFromMesh(terrainGenChunkMesh(wc, 2));
+    case 5: *name = "monk gltf"; return LoadModel("resources/models/monk_character/scene.gltf");
+    case 6: *name = "cubeman gltf"; return LoadModel("resources/models/cubeman_blender/scene.gltf");
+    }
+    return (Model) { 0 };
+}
+
+/*
+ * meshopt [instances] [frames], opens a window: test meshes and models as
+ * raylib uploads them against deduplicated, reordered and packed
+ */
+static int benchMeshOpt(int argc, char **argv)
+{
+    int instances = argc > 0 ? max(atoi(argv[0]), 1) : 1000;
+    int frames = argc > 1 ? max(atoi(argv[1]), 1) : 200;
+    const int warmup = 10;
+    const float kib = 1024;
+
+    InitWindow(1280, 720, "bench meshopt");
+    SetTargetFPS(0);
+    genWorldAround((Vector3) { 0 }, 1);
+
+    unsigned int query;
+    glGenQueries(1, &query);
+    int side = (int)ceilf(sqrtf(instances));
+    Camera3D camera = {
+        .position = { 0, side * 0.9f, side * 0.9f }, .target = { 0 },
+        .up = { 0, 1, 0 }, .fovy = 45, .projection = CAMERA_PERSPECTIVE,
+    };
+
+    printf("meshopt: %d instances, %d frames, acmr through a %d entry fifo\n", instances, frames, MESH_OPT_ACMR_CACHE);
+    for (int i = 0; i < 7 && !WindowShouldClose(); ++i) {
+        const char *name;
+        Model models[2] = { benchMeshOptSource(i, &name), benchMeshOptSource(i, &name) };
+        if (models[0].meshCount == 0)
+            continue;
+
+        /* totals over the meshes of the optimized copy */
+        struct MeshOptStats total = { 0 };
+        int skipped = 0;
+        for (int m = 0; m < models[0].meshCount; ++m) {
+            meshOptUpload(&models[0].meshes[m], false);
+            struct MeshOptStats s;
+            skipped += !meshOptimize(&models[1].meshes[m], &s);
+            meshOptUpload(&models[1].meshes[m], true);
+            total.vertices_before += s.vertices_before;
+            total.vertices_after += s.vertices_after;
+            total.triangles += s.triangles;
+            total.acmr_before += s.acmr_before * s.triangles;
+            total.acmr_after += s.acmr_after * s.triangles;
+            total.bytes_before += s.bytes_before;
+            total.bytes_packed += s.bytes_packed;
+            total.ms += s.ms;
+        }
+        /* instances about a unit across */
+        BoundingBox bb = GetModelBoundingBox(models[0]);
+        float scale = 1 / fmaxf(Vector3Distance(bb.min, bb.max), 1e-3f);
+
+        double gpu_ms[2] = { 0 };
+        for (int k = 0; k < 2; ++k) {
+            for (int f = -warmup; f < frames; ++f) {
+                BeginDrawing();
+                glBeginQuery(GL_TIME_ELAPSED, query);
+                    ClearBackground(BLACK);
+                    BeginMode3D(camera);
+                        for (int n = 0; n < instances; ++n) {
+                            Vector3 p = { (n % side - side * 0.5f) * 1.5f, 0, (n / side - side * 0.5f) * 1.5f };
+                            DrawModel(models[k], p, scale, WHITE);
+                        }
+                    EndMode3D();
+                rlDrawRenderBatchActive();
+                glEndQuery(GL_TIME_ELAPSED);
+                EndDrawing();
+
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+                if (f >= 0)
+                    gpu_ms[k] += ns / 1e6;
+            }
+        }
+
+        float tris = fmaxf(total.triangles, 1);
+        printf("  %-14s %6d -> %6d vertices  %6d triangles  acmr %.3f -> %.3f  %8.1f -> %8.1f KiB  %6.2f ms"
+                "  gpu %7.3f -> %7.3f ms%s\n", name, total.vertices_before, total.vertices_after, total.triangles,
+                total.acmr_before / tris, total.acmr_after / tris, total.bytes_before / kib, total.bytes_packed / kib,
+                total.ms, gpu_ms[0] / frames, gpu_ms[1] / frames, skipped > 0 ? "  (some meshes left as they are)" : "");
+        UnloadModel(models[0]);
+        UnloadModel(models[1]);
+    }
+
+    glDeleteQueries(1, &query);
+    CloseWindow();
+    return EXIT_SUCCESS;
+}
+
+/*
+ * meshlod [units] [frames], opens a window: levels built for the gltf
+ * models, then a crowd of monks at full detail and with levels
+ */
+static int benchMeshLod(int argc, char **argv)
+{
+    int units = argc > 0 ? max(atoi(argv[0]), 1) : 2000;
+    int frames = argc > 1 ? max(atoi(argv[1]), 1) : 300;
+    const int warmup = 10;
+    const char *paths[] = {
+        "resources/models/monk_character/scene.gltf",
+        "resources/models/cubeman_blender/scene.gltf",
+    };
+
+    InitWindow(1280, 720, "bench meshlod");
+    SetTargetFPS(0);
+    benchCountDraws();
+
+    MeshLodSet set;
+    meshLodInit(&set, 1, 0, true);
+    Model models[2];
+    for (int i = 0; i < 2; ++i) {
+        models[i] = LoadModel(paths[i]);
+        if (models[i].meshCount == 0) {
+            meshLodUnload(&set);
+            CloseWindow();
+            return EXIT_FAILURE;
+        }
+    }
+    double start = time_ms();
+    for (int i = 0; i < 2; ++i)
+        meshLodAdd(&set, models[i], MESH_LOD_MAX_LEVELS);
+    meshLodWait(&set);
+    double wall_ms = time_ms() - start;
+    printf("meshlod: %llu triangles simplified in %.1f ms on %d workers, %.2f M triangles/s, %.2f per worker\n",
+            (unsigned long long)set.simplified, wall_ms, set.queue.thread_count, set.simplified / wall_ms / 1000,
+            set.simplified / fmax(set.simplify_ms, 1e-3) / 1000);
+    for (int i = 0; i < 2; ++i) {
+        const struct LodModel *lm = &set.models[i];
+        BoundingBox bb = GetModelBoundingBox(models[i]);
+        float size = Vector3Distance(bb.min, bb.max);
+        printf("  %s\n", paths[i]);
+        for (int l = 0; l < lm->level_count; ++l) {
+            printf("    level %d: %7d triangles  %5.1f%%  error %.5f  %.3f%% of its size\n", l, lm->triangles[l],
+                    100.0 * lm->triangles[l] / max(lm->triangles[0], 1), lm->error[l], 100 * lm->error[l] / size);
+        }
+    }
+
+    /* 1.8 units tall */
+    BoundingBox bb = GetModelBoundingBox(models[0]);
+    float scale = 1.8f / fmaxf(bb.max.y - bb.min.y, 1e-3f);
+    unsigned int query;
+    glGenQueries(1, &query);
+
+    int side = (int)ceilf(sqrtf(units));
+    for (int pass = 0; pass < 2 && !WindowShouldClose(); ++pass) {
+        /* nothing is below a negative error */
+        set.pixel_error = pass == 0 ? -1 : 1;
+        double frame_ms = 0, gpu_ms = 0;
+        u64 draw_calls = 0, triangles = 0, drawn[MESH_LOD_MAX_LEVELS] = { 0 };
+        for (int f = -warmup; f < frames; ++f) {
+            float a = 2 * PI * max(f, 0) / frames;
+            Camera3D camera = {
+                .position = { cosf(a) * side, 12, sinf(a) * side }, .target = { 0 },
+                .up = { 0, 1, 0 }, .fovy = 45, .projection = CAMERA_PERSPECTIVE,
+            };
+            u64 calls, tris;
+            benchTakeDrawCounts(&calls, &tris);
+            double frame_start = time_ms();
+
+            BeginDrawing();
+            glBeginQuery(GL_TIME_ELAPSED, query);
+                ClearBackground(SKYBLUE);
+                BeginMode3D(camera);
+                    u32 h = 1;
+                    for (int i = 0; i < units; ++i) {
+                        h = h * 1664525u + 1013904223u;
+                        Vector3 p = { (i % side - side * 0.5f) * 2, 0, (i / side - side * 0.5f) * 2 };
+                        meshLodDraw(&set, 0, p, (h >> 8) % 360, scale, WHITE, camera);
+                    }
+                EndMode3D();
+            rlDrawRenderBatchActive();
+            glEndQuery(GL_TIME_ELAPSED);
+            glFinish();
+            double ms = time_ms() - frame_start;
+            EndDrawing();
+            meshLodUpdate(&set);
+
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+            benchTakeDrawCounts(&calls, &tris);
+            if (f >= 0) {
+                frame_ms += ms;
+                gpu_ms += ns / 1e6;
+                draw_calls += calls;
+                triangles += tris;
+                for (int l = 0; l < MESH_LOD_MAX_LEVELS; ++l)
+                    drawn[l] += set.drawn[l];
+            }
+        }
+        printf("  %-6s %6d units  %7.3f ms/frame  gpu %7.3f ms  %6llu draws  %8llu triangles  levels",
+                pass == 0 ? "full" : "levels", units, frame_ms / frames, gpu_ms / frames,
+                (unsigned long long)(draw_calls / frames), (unsigned long long)(triangles / frames));
+        for (int l = 0; l < MESH_LOD_MAX_LEVELS; ++l)
+            printf(" %llu", (unsigned long long)(drawn[l] / frames));
+        printf("\n");
+    }
+
+    glDeleteQueries(1, &query);
+    meshLodUnload(&set);
+    for (int i = 0; i < 2; ++i)
+        UnloadModel(models[i]);
+    CloseWindow();
+    return EXIT_SUCCESS;
+}
+
+/*
+ * anim [instances] [frames], opens a window: cubeman skinned by raylib on
+ * the main thread, then posed and skinned by anim on 1 thread up to every
+ * core, then drawn as a crowd with animation lod
+ */
+static int benchAnim(int argc, char **argv)
+{
+    int instances = argc > 0 ? max(atoi(argv[0]), 1) : 1000;
+    int frames = argc > 1 ? max(atoi(argv[1]), 1) : 300;
+    const char *path = "resources/models/cubeman_blender/scene.gltf";
+
+    InitWindow(1280, 720, "bench anim");
+    SetTargetFPS(0);
+
+    Model model = LoadModel(path);
+    int clip_count = 0;
+    ModelAnimation *clips = LoadModelAnimations(path, &clip_count);
+    if (model.meshCount == 0 || clip_count == 0) {
+        UnloadModelAnimations(clips, clip_count);
+        UnloadModel(model);
+        CloseWindow();
+        return EXIT_FAILURE;
+    }
+    /* raylib skips meshes without weights too, the rates count only the skinned ones */
+    int vertices = 0, skinned = 0;
+    for (int m = 0; m < model.meshCount; ++m) {
+        const Mesh *mesh = &model.meshes[m];
+        vertices += mesh->vertexCount;
+        if (mesh->boneIds != NULL && mesh->boneWeights != NULL)
+            skinned += mesh->vertexCount;
+    }
+    printf("anim: %s, %d joints, %d vertices, %d skinned, %d clips, %d instances\n", path, model.boneCount,
+            vertices, skinned, clip_count, instances);
+
+    /* what UpdateModelAnimation costs per instance */
+    double start = time_ms();
+    for (int f = 0; f < frames; ++f)
+        UpdateModelAnimation(model, clips[0], f);
+    double raylib_ms = (time_ms() - start) / frames;
+    printf("  raylib     %7.3f ms/instance  %6.2f M vertices/s  %6.0f instances at 60 Hz\n", raylib_ms,
+            skinned / raylib_ms / 1000, 1000 / 60.0 / raylib_ms);
+
+    int max_threads = min((int)sysconf(_SC_NPROCESSORS_ONLN), ANIM_MAX_THREADS);
+    for (int threads = 1; ; threads = min(threads * 2, max_threads)) {
+        AnimSystem as;
+        animInit(&as, threads, true);
+        /* every instance every frame */
+        as.lod_interval = 0;
+        int rig = animAddRig(&as, model, clips, clip_count);
+        for (int i = 0; i < instances; ++i)
+            animAddInstance(&as, rig, i % clip_count, (Vector3) { 0 });
+        double ms = 0;
+        for (int f = 0; f < frames; ++f) {
+            animUpdate(&as, 1 / 60.0f, (Vector3) { 0 });
+            ms += as.ms;
+        }
+        ms /= frames;
+        printf("  %2d threads %7.3f ms/update    %6.2f M vertices/s  %6.0f instances at 60 Hz\n", as.pool.thread_count,
+                ms, (double)instances * as.rigs[rig].vertex_count / ms / 1000, instances * 1000 / 60.0 / ms);
+        animUnload(&as);
+        if (threads == max_threads)
+            break;
+    }
+
+    /* a crowd on a grid 2 apart, the camera orbiting outside it */
+    AnimSystem as;
+    animInit(&as, 0, true);
+    int rig = animAddRig(&as, model, clips, clip_count);
+    int side = (int)ceilf(sqrtf(instances));
+    for (int i = 0; i < instances; ++i) {
+        Vector3 p = { (i % side - side * 0.5f) * 2, 0, (i / side - side * 0.5f) * 2 };
+        animAddInstance(&as, rig, i % clip_count, p);
+    }
+    BoundingBox bb = GetModelBoundingBox(model);
+    float scale = 1.8f / fmaxf(bb.max.y - bb.min.y, 1e-3f);
+    double frame_ms = 0, update_ms = 0;
+    u64 posed = 0, skipped = 0;
+    for (int f = 0; f < frames && !WindowShouldClose(); ++f) {
+        float a = 2 * PI * f / frames;
+        Camera3D camera = {
+            .position = { cosf(a) * side, 6, sinf(a) * side }, .target = { 0 },
+            .up = { 0, 1, 0 }, .fovy = 45, .projection = CAMERA_PERSPECTIVE,
+        };
+        /* someone is always changing clip */
+        animPlay(&as, f % instances, (as.instances[f % instances].clip + 1) % clip_count, 0.3f);
+        double frame_start = time_ms();
+        animUpdate(&as, 1 / 60.0f, camera.position);
+        BeginDrawing();
+            ClearBackground(SKYBLUE);
+            BeginMode3D(camera);
+                for (int i = 0; i < instances; ++i)
+                    animDraw(&as, i, 0, scale, WHITE);
+            EndMode3D();
+        EndDrawing();
+        frame_ms += time_ms() - frame_start;
+        update_ms += as.ms;
+        posed += as.posed;
+        skipped += as.skipped;
+    }
+    printf("  crowd      %7.3f ms/frame  update %.3f ms  %.0f posed  %.0f skipped by lod\n", frame_ms / frames,
+            update_ms / frames, (double)posed / frames, (double)skipped / frames);
+
+    animUnload(&as);
+    UnloadModelAnimations(clips, clip_count);
+    UnloadModel(model);
+    CloseWindow();
+    return EXIT_SUCCESS;
+}
+
+/* aa [frames], opens a window: the world around the origin in every aa mode */
+static int benchAA(int argc, char **argv)
+{
+    int frames = argc > 0 ? max(atoi(argv[0]), 1) : 300;
+    const int warmup = 10;
+
+    /* no vsync or frame limit, only the work counts */
+    InitWindow(1280, 720, "bench aa");
+    SetTargetFPS(0);
+
+    genWorldAround((Vector3) { 0 }, 1);
+    Model cube = LoadModelFromMesh(GenMeshCube(1, 1, 1));
+    RenderTexture2D scene = LoadRenderTexture(GetScreenWidth(), GetScreenHeight());
+    AntiAliasing aa;
+    aaInit(&aa, AA_OFF);
+    RenderQueue rq;
+    renderQueueInit(&rq);
+    struct BenchCamera *path = benchDefaultCameraPath(frames);
+    unsigned int query;
+    glGenQueries(1, &query);
+
+    printf("aa: %d frames at %d x %d\n", frames, GetScreenWidth(), GetScreenHeight());
+    double off_ms = 0;
+    for (int mode = 0; mode < AA_MODE_COUNT && !WindowShouldClose(); ++mode) {
+        aaSetMode(&aa, mode);
+        double frame_ms = 0, gpu_ms = 0;
+        for (int f = -warmup; f < frames; ++f) {
+            Camera3D camera = benchCamera(path[max(f, 0)]);
+            /* orbit radius 60 is outside the generated chunks, pull it in */
+            camera.position = Vector3Scale(camera.position, 0.5f);
+            camera.target = Vector3Scale(camera.target, 0.5f);
+            double start = time_ms();
+
+            BeginDrawing();
+            aaPrepare(&aa, scene);
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            aaBegin(&aa);
+                ClearBackground(BLUE);
+                BeginMode3D(camera);
+                    renderQueueBegin(&rq, camera.position);
+                    for (int i = 0; i < hmlen(world_map); ++i) {
+                        struct WorldChunk *wc = &world_map[i].chunk;
+                        for (int z = 0; z < CHUNKSIZE; ++z)
+                            for (int x = 0; x < CHUNKSIZE; ++x)
+                                renderQueuePushModel(&rq, RENDER_PASS_OPAQUE, cube, worldCubePosition(wc, z, x), 0.9f, BROWN);
+                    }
+                    renderQueueFlush(&rq);
+                EndMode3D();
+            aaEnd(&aa, scene);
+            aaBeginPresent(&aa, scene);
+                DrawTextureRec(scene.texture, (Rectangle) { 0, 0, scene.texture.width, -scene.texture.height },
+                        (Vector2) { 0 }, WHITE);
+            aaEndPresent(&aa);
+            rlDrawRenderBatchActive();
+            glEndQuery(GL_TIME_ELAPSED);
+            glFinish();
+            double ms = time_ms() - start;
+            EndDrawing();
+
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+            if (f >= 0) {
+                frame_ms += ms;
+                gpu_ms += ns / 1e6;
+            }
+        }
+        frame_ms /= frames;
+        gpu_ms /= frames;
+        if (mode == AA_OFF)
+            off_ms = frame_ms;
+        /* aaPrepare falls back to off when msaa is unsupported */
+        printf("  %-8s %7.3f ms/frame  gpu %7.3f ms  %+7.3f ms vs off%s\n", aaModeName(mode),
+                frame_ms, gpu_ms, frame_ms - off_ms, aa.mode != (enum AAMode)mode ? "  (unsupported)" : "");
+    }
+
+    glDeleteQueries(1, &query);
+    arrfree(path);
+    renderQueueUnload(&rq);
+    aaUnload(&aa);
+    UnloadRenderTexture(scene);
+    UnloadModel(cube);
+    CloseWindow();
+
+    return EXIT_SUCCESS;
+}
+
+static const struct Bench benches[] = {
+    { "occlusion", "[camera path]", benchOcclusion },
+    { "aa", "[frames]", benchAA },
+    { "clusters", "[lights] [camera path]", benchClusters },
+    { "sunbake", "[threads]", benchSunBake },
+    { "debugdraw", "[calls] [threads]", benchDebugDraw },
+    { "sprites", "[count] [frames]", benchSprites },
+    { "particles", "[count] [emitters]", benchParticles },
+    { "softraster", "[frames] [max threads] [image]", benchSoftRender },
+    { "impostors", "[units] [frames]", benchImpostors },
+    { "texstream", "[budget MiB] [frames]", benchTextureStream },
+    { "meshopt", "[instances] [frames]", benchMeshOpt },
+    { "meshlod", "[units] [frames]", benchMeshLod },
+    { "anim", "[instances] [frames]", benchAnim },
+};
+
+int benchMain(int argc, char **argv)
+{
+    int n = sizeof(benches) / sizeof(benches[0]);
+    for (int i = 0; argc > 0 && i < n; ++i) {
+        if (strcmp(argv[0], benches[i].name) == 0)
+            return benches[i].run(argc - 1, argv + 1);
+    }
+
+    fprintf(stderr, "usage: --bench <name> [args]\n");
+    for (int i = 0; i < n; ++i)
+        fprintf(stderr, "  %s %s\n", benches[i].name, benches[i].usage);
+    return EXIT_FAILURE;
+}
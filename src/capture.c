@@ -0,0 +1,301 @@
+/*****************************************************
+Create Date:        2024-12-16
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include <time.h>
+
+#include "../include/obh/capture.h"
+#include "../include/obh/util.h"
+#include "../include/obh/c_log.h"
+#include "../include/obh/stb_impl.h"
+#include "../include/raylib/rlgl.h"
+#include "../include/glad/glad.h"
+
+/* how long captureWait blocks on one fence before checking again, ns */
+#define CAPTURE_WAIT_TIMEOUT 100000000
+
+const char *captureFormatExtension(enum CaptureFormat format)
+{
+    return format == CAPTURE_JPG ? "jpg" : "png";
+}
+
+/* gl rows start at the bottom, encoders want them from the top without alpha */
+static void captureCopy(struct CaptureJob *job)
+{
+    size_t row = (size_t)job->width * 3;
+    job->pixels = MemAlloc(row * job->height);
+    for (int y = 0; y < job->height; ++y) {
+        const u8 *src = job->mapped + (size_t)(job->height - 1 - y) * job->width * 4;
+        u8 *dst = job->pixels + y * row;
+        for (int x = 0; x < job->width; ++x) {
+            dst[x * 3 + 0] = src[x * 4 + 0];
+            dst[x * 3 + 1] = src[x * 4 + 1];
+            dst[x * 3 + 2] = src[x * 4 + 2];
+        }
+    }
+    job->mapped = NULL;
+}
+
+static bool captureEncode(const struct CaptureJob *job)
+{
+    if (job->format == CAPTURE_JPG)
+        return stbWriteJpg(job->path, job->width, job->height, 3, job->pixels, CAPTURE_JPG_QUALITY);
+    return stbWritePng(job->path, job->width, job->height, 3, job->pixels, job->width * 3);
+}
+
+static void *captureRun(void *arg, void *user)
+{
+    Capture *c = user;
+    struct CaptureJob *job = arg;
+    if (job->buffer >= 0) {
+        captureCopy(job);
+        pthread_mutex_lock(&c->queue.lock);
+        c->buffers[job->buffer].state = CAPTURE_BUFFER_COPIED;
+        pthread_mutex_unlock(&c->queue.lock);
+        job->buffer = -1;
+        /* behind the copies, they hold a pixel buffer the render thread wants back */
+        workQueuePush(&c->queue, job, false);
+        return NULL;
+    }
+
+    double start = time_ms();
+    bool ok = captureEncode(job);
+    double ms = time_ms() - start;
+    MemFree(job->pixels);
+
+    pthread_mutex_lock(&c->queue.lock);
+    c->encode_ms += ms;
+    c->outstanding--;
+    if (ok) {
+        c->written++;
+    } else {
+        c->failed++;
+        strncpy(c->failed_path, job->path, sizeof(c->failed_path) - 1);
+    }
+    pthread_mutex_unlock(&c->queue.lock);
+    MemFree(job);
+    return NULL;
+}
+
+static void captureDiscard(void *arg)
+{
+    struct CaptureJob *job = arg;
+    MemFree(job->pixels);
+    MemFree(job);
+}
+
+void captureInit(Capture *c, const char *dir, int threads)
+{
+    *c = (Capture) { 0 };
+    strncpy(c->dir, dir, sizeof(c->dir) - 1);
+    mkdir_p(dir);
+
+    for (int i = 0; i < CAPTURE_BUFFERS; ++i)
+        glGenBuffers(1, &c->buffers[i].pbo);
+
+    if (workQueueInit(&c->queue, threads, CAPTURE_MAX_THREADS, captureRun, c, "capture") == 0)
+        c_log_error(LOG_TAG, "no capture workers, frames will not be written");
+}
+
+void captureUnload(Capture *c)
+{
+    if (c->queue.thread_count > 0)
+        captureWait(c);
+    workQueueUnload(&c->queue, captureDiscard);
+    for (int i = 0; i < CAPTURE_BUFFERS; ++i) {
+        struct CaptureBuffer *b = &c->buffers[i];
+        if (b->state == CAPTURE_BUFFER_MAPPED || b->state == CAPTURE_BUFFER_COPIED) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, b->pbo);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        if (b->fence != NULL)
+            glDeleteSync(b->fence);
+        glDeleteBuffers(1, &b->pbo);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    *c = (Capture) { 0 };
+}
+
+void captureScreenshot(Capture *c, enum CaptureFormat format)
+{
+    c->screenshot_pending = true;
+    c->screenshot_format = format;
+}
+
+void captureRecord(Capture *c, int frames, enum CaptureFormat format)
+{
+    c->record_left = max(frames, 0);
+    if (frames <= 0)
+        return;
+    c->record_index = 0;
+    c->record_format = format;
+    time_t now = time(NULL);
+    strftime(c->record_name, sizeof(c->record_name), "record_%Y%m%d_%H%M%S", localtime(&now));
+}
+
+/*
+ * Unmap buffers the workers are done with and map the ones whose readback
+ * has landed. With wait it blocks on the fences instead of polling them.
+ */
+static void captureCollect(Capture *c, bool wait)
+{
+    for (int i = 0; i < CAPTURE_BUFFERS; ++i) {
+        struct CaptureBuffer *b = &c->buffers[i];
+        pthread_mutex_lock(&c->queue.lock);
+        enum CaptureBufferState state = b->state;
+        pthread_mutex_unlock(&c->queue.lock);
+
+        if (state == CAPTURE_BUFFER_COPIED) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, b->pbo);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            b->state = CAPTURE_BUFFER_FREE;
+            continue;
+        }
+        if (state != CAPTURE_BUFFER_READING)
+            continue;
+        GLenum sync = glClientWaitSync(b->fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                wait ? CAPTURE_WAIT_TIMEOUT : 0);
+        if (sync == GL_TIMEOUT_EXPIRED)
+            continue;
+        glDeleteSync(b->fence);
+        b->fence = NULL;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, b->pbo);
+        const u8 *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)b->width * b->height * 4, GL_MAP_READ_BIT);
+        if (mapped == NULL) {
+            c_log_error(LOG_TAG, "could not map capture buffer for %s", b->path);
+            b->state = CAPTURE_BUFFER_FREE;
+            pthread_mutex_lock(&c->queue.lock);
+            c->outstanding--;
+            c->failed++;
+            pthread_mutex_unlock(&c->queue.lock);
+            continue;
+        }
+
+        struct CaptureJob *job = MemAlloc(sizeof(*job));
+        *job = (struct CaptureJob) {
+            .buffer = i, .mapped = mapped, .width = b->width, .height = b->height, .format = b->format,
+        };
+        memcpy(job->path, b->path, sizeof(job->path));
+        pthread_mutex_lock(&c->queue.lock);
+        b->state = CAPTURE_BUFFER_MAPPED;
+        pthread_mutex_unlock(&c->queue.lock);
+        /* copies go first, encodes can wait */
+        workQueuePush(&c->queue, job, true);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+/*
+ * Start reading the backbuffer into the next pixel buffer.
+ * @return false when every buffer is busy or the workers are too far behind
+ */
+static bool captureRead(Capture *c, const char *path, enum CaptureFormat format)
+{
+    struct CaptureBuffer *b = &c->buffers[c->next];
+    pthread_mutex_lock(&c->queue.lock);
+    bool behind = c->outstanding >= CAPTURE_BUFFERS + CAPTURE_MAX_BACKLOG;
+    pthread_mutex_unlock(&c->queue.lock);
+    if (b->state != CAPTURE_BUFFER_FREE || behind || c->queue.thread_count == 0)
+        return false;
+
+    b->width = GetRenderWidth();
+    b->height = GetRenderHeight();
+    b->format = format;
+    strncpy(b->path, path, sizeof(b->path) - 1);
+    size_t size = (size_t)b->width * b->height * 4;
+
+    rlDrawRenderBatchActive();
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, b->pbo);
+    if (b->size != size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        b->size = size;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, b->width, b->height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    b->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    b->state = CAPTURE_BUFFER_READING;
+    c->next = (c->next + 1) % CAPTURE_BUFFERS;
+
+    pthread_mutex_lock(&c->queue.lock);
+    c->outstanding++;
+    pthread_mutex_unlock(&c->queue.lock);
+    return true;
+}
+
+void captureFrame(Capture *c)
+{
+    double start = time_ms();
+    captureCollect(c, false);
+
+    char path[256];
+    if (c->screenshot_pending) {
+        time_t now = time(NULL);
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", localtime(&now));
+        int n = snprintf(path, sizeof(path), "%s/screenshot_%s_%d.%s", c->dir, stamp, c->screenshots,
+                captureFormatExtension(c->screenshot_format));
+        /* stays pending until a buffer frees up */
+        if (n >= (int)sizeof(path)) {
+            c_log_error(LOG_TAG, "screenshot path in %s is too long", c->dir);
+            c->screenshot_pending = false;
+        } else if (captureRead(c, path, c->screenshot_format)) {
+            c->screenshot_pending = false;
+            c->screenshots++;
+        }
+    }
+    if (c->record_left > 0) {
+        /* numbers stay contiguous, a dropped frame makes the recording run longer */
+        int n = snprintf(path, sizeof(path), "%s/%s_%05d.%s", c->dir, c->record_name, c->record_index,
+                captureFormatExtension(c->record_format));
+        if (n >= (int)sizeof(path)) {
+            c_log_error(LOG_TAG, "recording path in %s is too long", c->dir);
+            c->record_left = 0;
+        } else if (captureRead(c, path, c->record_format)) {
+            c->record_index++;
+            c->record_left--;
+        } else {
+            c->dropped++;
+        }
+    }
+
+    pthread_mutex_lock(&c->queue.lock);
+    if (c->failed_path[0] != '\0') {
+        strncpy(path, c->failed_path, sizeof(path));
+        c->failed_path[0] = '\0';
+        pthread_mutex_unlock(&c->queue.lock);
+        c_log_error(LOG_TAG, "could not write %s", path);
+    } else {
+        pthread_mutex_unlock(&c->queue.lock);
+    }
+
+    c->frame_ms = time_ms() - start;
+    c->frame_ms_peak = fmax(c->frame_ms_peak, c->frame_ms);
+}
+
+void captureWait(Capture *c)
+{
+    for (;;) {
+        captureCollect(c, true);
+        int reading = 0;
+        for (int i = 0; i < CAPTURE_BUFFERS; ++i)
+            reading += c->buffers[i].state == CAPTURE_BUFFER_READING;
+
+        pthread_mutex_lock(&c->queue.lock);
+        bool done = c->outstanding == 0;
+        /* a fence that timed out is polled again instead */
+        if (!done && reading == 0)
+            pthread_cond_wait(&c->queue.idle, &c->queue.lock);
+        pthread_mutex_unlock(&c->queue.lock);
+        if (done)
+            break;
+    }
+    /* unmap the last buffers copied out */
+    captureCollect(c, false);
+}
@@ -69,3 +69,19 @@ Shader genShader()
 {
     return LoadShader("resources/shaders/cube.vs", "resources/shaders/cube.vs");
 }
+
+Mesh genCubeMesh()
+{
+    /* the vertices above as they are, 36 of them and no indices */
+    int count = sizeof(vertices) / (8 * sizeof(float));
+    Mesh mesh = { .vertexCount = count, .triangleCount = count / 3 };
+    mesh.vertices = MemAlloc(count * 3 * sizeof(float));
+    mesh.normals = MemAlloc(count * 3 * sizeof(float));
+    mesh.texcoords = MemAlloc(count * 2 * sizeof(float));
+    for (int i = 0; i < count; ++i) {
+        memcpy(mesh.vertices + i * 3, vertices + i * 8, 3 * sizeof(float));
+        memcpy(mesh.normals + i * 3, vertices + i * 8 + 3, 3 * sizeof(float));
+        memcpy(mesh.texcoords + i * 2, vertices + i * 8 + 6, 2 * sizeof(float));
+    }
+    return mesh;
+}
@@ -1,200 +1,315 @@
-#include "../include/obh/debug.h"
-
-static void DrawTextCodepoint3D(Font font, int codepoint, Vector3 position,
-        float fontSize, bool backface, bool SHOW_LETTER_BOUNDRY, Color tint)
-{
-    int LETTER_BOUNDRY_SIZE = 1;
-    Color LETTER_BOUNDRY_COLOR = BLACK;
-    // Character index position in sprite font
-    // NOTE: In case a codepoint is not available in the font, index returned points to '?'
-    int index = GetGlyphIndex(font, codepoint);
-    float scale = fontSize/(float)font.baseSize;
-
-    // Character destination rectangle on screen
-    // NOTE: We consider charsPadding on drawing
-    position.x += (float)(font.glyphs[index].offsetX - font.glyphPadding)/(float)font.baseSize*scale;
-    position.z += (float)(font.glyphs[index].offsetY - font.glyphPadding)/(float)font.baseSize*scale;
-
-    // Character source rectangle from font texture atlas
-    // NOTE: We consider chars padding when drawing, it could be required for outline/glow shader effects
-    Rectangle srcRec = { font.recs[index].x - (float)font.glyphPadding, font.recs[index].y - (float)font.glyphPadding,
-                         font.recs[index].width + 2.0f*font.glyphPadding, font.recs[index].height + 2.0f*font.glyphPadding };
-
-    float width = (float)(font.recs[index].width + 2.0f*font.glyphPadding)/(float)font.baseSize*scale;
-    float height = (float)(font.recs[index].height + 2.0f*font.glyphPadding)/(float)font.baseSize*scale;
-
-    if (font.texture.id > 0)
-    {
-        const float x = 0.0f;
-        const float y = 0.0f;
-        const float z = 0.0f;
-
-        // normalized texture coordinates of the glyph inside the font texture (0.0f -> 1.0f)
-        const float tx = srcRec.x/font.texture.width;
-        const float ty = srcRec.y/font.texture.height;
-        const float tw = (srcRec.x+srcRec.width)/font.texture.width;
-        const float th = (srcRec.y+srcRec.height)/font.texture.height;
-
-        if (SHOW_LETTER_BOUNDRY) DrawCubeWiresV(
-                (Vector3){ position.x + width/2, position.y, position.z + height/2},
-                (Vector3){ width, LETTER_BOUNDRY_SIZE, height }, LETTER_BOUNDRY_COLOR);
-
-        rlCheckRenderBatchLimit(4 + 4*backface);
-        rlSetTexture(font.texture.id);
-
-        rlPushMatrix();
-            rlTranslatef(position.x, position.y, position.z);
-
-            rlBegin(RL_QUADS);
-                rlColor4ub(tint.r, tint.g, tint.b, tint.a);
-
-                // Front Face
-                rlNormal3f(0.0f, 1.0f, 0.0f);                                   // Normal Pointing Up
-                rlTexCoord2f(tw, th); rlVertex3f(x,         y, z);              // Top Left Of The Texture and Quad
-                rlTexCoord2f(tw, ty); rlVertex3f(x,         y, z + height);     // Bottom Left Of The Texture and Quad
-                rlTexCoord2f(tx, ty); rlVertex3f(x + width, y, z + height);     // Bottom Right Of The Texture and Quad
-                rlTexCoord2f(tx, th); rlVertex3f(x + width, y, z);              // Top Right Of The Texture and Quad
-
-                if (backface)
-                {
-                    // Back Face
-                    rlNormal3f(0.0f, -1.0f, 0.0f);                              // Normal Pointing Down
-                    rlTexCoord2f(tw, th); rlVertex3f(x,         y, z);          // Top Right Of The Texture and Quad
-                    rlTexCoord2f(tx, th); rlVertex3f(x + width, y, z);          // Top Left Of The Texture and Quad
-                    rlTexCoord2f(tx, ty); rlVertex3f(x + width, y, z + height); // Bottom Left Of The Texture and Quad
-                    rlTexCoord2f(tw, ty); rlVertex3f(x,         y, z + height); // Bottom Right Of The Texture and Quad
-                }
-            rlEnd();
-        rlPopMatrix();
-
-        rlSetTexture(0);
-    }
-}
+#include <stdarg.h>
 
-static void DrawText3D(Font font, const char *text, Vector3 position, float fontSize,
-        float fontSpacing, float lineSpacing, bool backface, Color tint)
-{
-    int length = TextLength(text);
+#include "../include/obh/debug.h"
+#include "../include/obh/shader_cache.h"
+#include "../include/raylib/raymath.h"
+#include "../include/glad/glad.h"
+#include "../include/stb/stb_ds.h"
 
-    float textOffsetY = 0.0f;
-    float textOffsetX = 0.0f;
+struct DebugDraw debug_draw;
 
-    float scale = fontSize/(float)font.baseSize;
+/* bumped by every init so thread buffers from an earlier one are dropped */
+static u64 debug_draw_generation;
+static __thread struct DebugDrawBuffer *debug_draw_local;
+static __thread u64 debug_draw_local_generation;
 
-    for (int i = 0; i < length;)
-    {
-        // Get next codepoint from byte string and glyph index in font
-        int codepointByteCount = 0;
-        int codepoint = GetCodepoint(&text[length - i - 1], &codepointByteCount);
-        int index = GetGlyphIndex(font, codepoint);
+static const char *debug_draw_names[DEBUG_DRAW_CATEGORY_COUNT] = {
+    "axes", "bounds", "grid", "lights", "chunks",
+};
 
-        // NOTE: Normally we exit the decoding sequence as soon as a bad byte is found (and return 0x3f)
-        // but we need to draw all of the bad bytes using the '?' symbol moving one byte
-        if (codepoint == 0x3f) codepointByteCount = 1;
+static void debugDrawUpdateActive(void)
+{
+    __atomic_store_n(&debug_draw.active, debug_draw.enabled ? debug_draw.categories : 0, __ATOMIC_RELAXED);
+}
 
-        if (codepoint == '\n')
-        {
-            // NOTE: Fixed line spacing of 1.5 line-height
-            // TODO: Support custom line spacing defined by user
-            textOffsetY += scale + lineSpacing/(float)font.baseSize*scale;
-            textOffsetX = 0.0f;
-        }
-        else
-        {
-            if ((codepoint != ' ') && (codepoint != '\t'))
-            {
-                DrawTextCodepoint3D(font, codepoint,
-                        (Vector3){ position.x + textOffsetX, position.y, position.z + textOffsetY },
-                        fontSize, backface, false, tint);
-            }
+void debugDrawInit(TextFont font, u32 categories, bool gpu)
+{
+    debug_draw = (DebugDraw) { .categories = categories, .enabled = true, .gpu = gpu, .font = font };
+    pthread_mutex_init(&debug_draw.lock, NULL);
+    debug_draw_generation++;
+    debugDrawUpdateActive();
+
+    if (!gpu)
+        return;
+    debug_draw.shader = shaderCacheLoad("resources/shaders/debug.vs", "resources/shaders/debug.fs");
+    debug_draw.mvp_loc = GetShaderLocation(debug_draw.shader, "mvp");
+    glGenVertexArrays(1, &debug_draw.vao);
+    glGenBuffers(1, &debug_draw.vbo);
+    glBindVertexArray(debug_draw.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, debug_draw.vbo);
+    /* the attribute locations raylib binds for vertexPosition and vertexColor */
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(struct DebugVertex),
+            (void *)offsetof(struct DebugVertex, position));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(struct DebugVertex),
+            (void *)offsetof(struct DebugVertex, color));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-            if (font.glyphs[index].advanceX == 0)
-                textOffsetX += (float)(font.recs[index].width + fontSpacing)/(float)font.baseSize*scale;
-            else
-                textOffsetX += (float)(font.glyphs[index].advanceX + fontSpacing)/(float)font.baseSize*scale;
+void debugDrawUnload(void)
+{
+    __atomic_store_n(&debug_draw.active, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < arrlen(debug_draw.buffers); ++i) {
+        struct DebugDrawBuffer *buf = debug_draw.buffers[i];
+        for (int c = 0; c < DEBUG_DRAW_CATEGORY_COUNT; ++c) {
+            arrfree(buf->lines[c]);
+            arrfree(buf->texts[c]);
+            arrfree(buf->chars[c]);
         }
-
-        i += codepointByteCount;   // Move text bytes counter to next codepoint
+        pthread_mutex_destroy(&buf->lock);
+        free(buf);
     }
+    arrfree(debug_draw.buffers);
+    arrfree(debug_draw.vertices);
+    arrfree(debug_draw.texts);
+    arrfree(debug_draw.chars);
+    pthread_mutex_destroy(&debug_draw.lock);
+    if (debug_draw.gpu) {
+        glDeleteBuffers(1, &debug_draw.vbo);
+        glDeleteVertexArrays(1, &debug_draw.vao);
+        UnloadShader(debug_draw.shader);
+    }
+    debug_draw = (DebugDraw) { 0 };
 }
 
-
-void DrawAxes(Vector3 pos, float len, Font font)
+void debugDrawSetEnabled(bool enabled)
 {
-    float arrow_len = len / 8;
-    Color color = YELLOW;
-
-    rlBegin(RL_LINES);
-
-        rlColor3f(color.r, color.g, color.b);
-
-        /* X */
-        rlVertex3f(pos.x, pos.y, pos.z);
-        rlVertex3f(pos.x + len, pos.y, pos.z);
-
-        rlVertex3f(pos.x + len, pos.y, pos.z);
-        rlVertex3f(pos.x + len - arrow_len, pos.y, pos.z - arrow_len / 2);
+    debug_draw.enabled = enabled;
+    debugDrawUpdateActive();
+}
 
-        rlVertex3f(pos.x + len, pos.y, pos.z);
-        rlVertex3f(pos.x + len - arrow_len, pos.y, pos.z + arrow_len / 2);
+void debugDrawToggle(u32 category)
+{
+    debug_draw.categories ^= category;
+    debugDrawUpdateActive();
+}
 
-        /* Y */
-        rlVertex3f(pos.x, pos.y, pos.z);
-        rlVertex3f(pos.x, pos.y + len, pos.z);
+const char *debugDrawCategoryName(u32 category)
+{
+    return debug_draw_names[__builtin_ctz(category)];
+}
 
-        rlVertex3f(pos.x, pos.y + len, pos.z);
-        rlVertex3f(pos.x, pos.y + len - arrow_len, pos.z - arrow_len / 2);
+/* this thread's buffer, locked, registered on first use */
+static struct DebugDrawBuffer *debugDrawLock(void)
+{
+    if (debug_draw_local == NULL || debug_draw_local_generation != debug_draw_generation) {
+        struct DebugDrawBuffer *buf = calloc(1, sizeof(*buf));
+        pthread_mutex_init(&buf->lock, NULL);
+        pthread_mutex_lock(&debug_draw.lock);
+        arrput(debug_draw.buffers, buf);
+        pthread_mutex_unlock(&debug_draw.lock);
+        debug_draw_local = buf;
+        debug_draw_local_generation = debug_draw_generation;
+    }
+    /* only contended while a flush gathers this buffer */
+    pthread_mutex_lock(&debug_draw_local->lock);
+    return debug_draw_local;
+}
 
-        rlVertex3f(pos.x, pos.y + len, pos.z);
-        rlVertex3f(pos.x, pos.y + len - arrow_len, pos.z + arrow_len / 2);
+static void debugDrawUnlock(struct DebugDrawBuffer *buf)
+{
+    pthread_mutex_unlock(&buf->lock);
+}
 
-        /* Z */
-        rlVertex3f(pos.x, pos.y, pos.z);
-        rlVertex3f(pos.x, pos.y, pos.z + len);
+void debugDrawLine(u32 category, Vector3 a, Vector3 b, Color color)
+{
+    struct DebugDrawBuffer *buf = debugDrawLock();
+    struct DebugVertex *v = arraddnptr(buf->lines[__builtin_ctz(category)], 2);
+    v[0] = (struct DebugVertex) { a, color };
+    v[1] = (struct DebugVertex) { b, color };
+    debugDrawUnlock(buf);
+}
 
-        rlVertex3f(pos.x, pos.y, pos.z + len);
-        rlVertex3f(pos.x + arrow_len / 2, pos.y, pos.z + len - arrow_len);
+void debugDrawBox(u32 category, BoundingBox box, Color color)
+{
+    Vector3 lo = box.min, hi = box.max;
+    Vector3 corners[8] = {
+        { lo.x, lo.y, lo.z }, { hi.x, lo.y, lo.z }, { hi.x, lo.y, hi.z }, { lo.x, lo.y, hi.z },
+        { lo.x, hi.y, lo.z }, { hi.x, hi.y, lo.z }, { hi.x, hi.y, hi.z }, { lo.x, hi.y, hi.z },
+    };
+    static const u8 edges[12][2] = {
+        { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 },
+        { 4, 5 }, { 5, 6 }, { 6, 7 }, { 7, 4 },
+        { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 },
+    };
+
+    struct DebugDrawBuffer *buf = debugDrawLock();
+    struct DebugVertex *v = arraddnptr(buf->lines[__builtin_ctz(category)], 24);
+    for (int i = 0; i < 12; ++i) {
+        v[i * 2 + 0] = (struct DebugVertex) { corners[edges[i][0]], color };
+        v[i * 2 + 1] = (struct DebugVertex) { corners[edges[i][1]], color };
+    }
+    debugDrawUnlock(buf);
+}
 
-        rlVertex3f(pos.x, pos.y, pos.z + len);
-        rlVertex3f(pos.x - arrow_len / 2, pos.y, pos.z + len - arrow_len);
+void debugDrawSphere(u32 category, Vector3 centre, float radius, Color color)
+{
+    const int n = DEBUG_DRAW_SPHERE_SEGMENTS;
+    float s[DEBUG_DRAW_SPHERE_SEGMENTS + 1], c[DEBUG_DRAW_SPHERE_SEGMENTS + 1];
+    for (int i = 0; i <= n; ++i) {
+        float a = 2 * PI * i / n;
+        s[i] = sinf(a) * radius;
+        c[i] = cosf(a) * radius;
+    }
 
-    rlEnd();
+    /* one circle around each axis */
+    int count = n * 6;
+    struct DebugDrawBuffer *buf = debugDrawLock();
+    struct DebugVertex *v = arraddnptr(buf->lines[__builtin_ctz(category)], count);
+    for (int i = 0; i < n; ++i) {
+        Vector3 o = centre;
+        v[0] = (struct DebugVertex) { { o.x + c[i], o.y + s[i], o.z }, color };
+        v[1] = (struct DebugVertex) { { o.x + c[i + 1], o.y + s[i + 1], o.z }, color };
+        v[2] = (struct DebugVertex) { { o.x, o.y + c[i], o.z + s[i] }, color };
+        v[3] = (struct DebugVertex) { { o.x, o.y + c[i + 1], o.z + s[i + 1] }, color };
+        v[4] = (struct DebugVertex) { { o.x + s[i], o.y, o.z + c[i] }, color };
+        v[5] = (struct DebugVertex) { { o.x + s[i + 1], o.y, o.z + c[i + 1] }, color };
+        v += 6;
+    }
+    debugDrawUnlock(buf);
+}
 
-    DrawTextCodepoint3D(font, 'x', (Vector3) {pos.x + len, pos.y, pos.z}, 10, true, false, color);
-    DrawTextCodepoint3D(font, 'y', (Vector3) {pos.x, pos.y + len, pos.z}, 10, true, false, color);
-    DrawTextCodepoint3D(font, 'z', (Vector3) {pos.x, pos.y, pos.z + len}, 10, true, false, color);
-    const char *pos_str = TextFormat("(%.2f, %.2f, %.2f)", pos.x, pos.y, pos.z);
-    pos.z -= 0.4;
-    DrawText3D(font, pos_str, pos, 10, 1, 1, true, color);
+void debugDrawText(u32 category, Vector3 position, float size, Color color, const char *fmt, ...)
+{
+    char str[256];
+    va_list args;
+    va_start(args, fmt);
+    int len = stbsp_vsnprintf(str, sizeof(str), fmt, args);
+    va_end(args);
+    len = min(len, (int)sizeof(str) - 1);
+
+    int c = __builtin_ctz(category);
+    struct DebugDrawBuffer *buf = debugDrawLock();
+    struct DebugText t = { position, size, color, arrlen(buf->chars[c]) };
+    memcpy(arraddnptr(buf->chars[c], len + 1), str, len + 1);
+    arrput(buf->texts[c], t);
+    debugDrawUnlock(buf);
+}
 
+void debugDrawAxes(Vector3 pos, float len)
+{
+    float arrow_len = len / 8;
+    Color color = YELLOW;
+    Vector3 x = { pos.x + len, pos.y, pos.z };
+    Vector3 y = { pos.x, pos.y + len, pos.z };
+    Vector3 z = { pos.x, pos.y, pos.z + len };
+
+    debugDrawLine(DEBUG_DRAW_AXES, pos, x, color);
+    debugDrawLine(DEBUG_DRAW_AXES, x, (Vector3) { x.x - arrow_len, x.y, x.z - arrow_len / 2 }, color);
+    debugDrawLine(DEBUG_DRAW_AXES, x, (Vector3) { x.x - arrow_len, x.y, x.z + arrow_len / 2 }, color);
+
+    debugDrawLine(DEBUG_DRAW_AXES, pos, y, color);
+    debugDrawLine(DEBUG_DRAW_AXES, y, (Vector3) { y.x, y.y - arrow_len, y.z - arrow_len / 2 }, color);
+    debugDrawLine(DEBUG_DRAW_AXES, y, (Vector3) { y.x, y.y - arrow_len, y.z + arrow_len / 2 }, color);
+
+    debugDrawLine(DEBUG_DRAW_AXES, pos, z, color);
+    debugDrawLine(DEBUG_DRAW_AXES, z, (Vector3) { z.x + arrow_len / 2, z.y, z.z - arrow_len }, color);
+    debugDrawLine(DEBUG_DRAW_AXES, z, (Vector3) { z.x - arrow_len / 2, z.y, z.z - arrow_len }, color);
+
+    debugDrawText(DEBUG_DRAW_AXES, x, 0.3f, color, "x");
+    debugDrawText(DEBUG_DRAW_AXES, y, 0.3f, color, "y");
+    debugDrawText(DEBUG_DRAW_AXES, z, 0.3f, color, "z");
+    debugDrawText(DEBUG_DRAW_AXES, (Vector3) { pos.x, pos.y, pos.z - 0.4f }, 0.3f, color,
+            "(%.2f, %.2f, %.2f)", pos.x, pos.y, pos.z);
 }
 
-void DrawGridPos(int slices, float spacing, Vector3 pos)
+void debugDrawGrid(int slices, float spacing, Vector3 pos)
 {
     pos.x = floor(pos.x);
     pos.y = floor(pos.y);
     pos.z = floor(pos.z);
-    int halfSlices = slices/2;
-
-    rlBegin(RL_LINES);
-        for (int i = -halfSlices; i <= halfSlices; i++)
-        {
-            if (i == 0)
-            {
-                rlColor3f(0.5f, 0.5f, 0.5f);
-            }
-            else
-            {
-                rlColor3f(0.75f, 0.75f, 0.75f);
-            }
-
-            rlVertex3f((float)i*spacing + pos.x, pos.y, (float)-halfSlices*spacing + pos.z);
-            rlVertex3f((float)i*spacing + pos.x, pos.y, (float)halfSlices*spacing + pos.z);
+    int half = slices / 2;
+    float lo = -half * spacing, hi = half * spacing;
+
+    for (int i = -half; i <= half; i++) {
+        Color color = i == 0 ? (Color) { 128, 128, 128, 255 } : (Color) { 191, 191, 191, 255 };
+        float d = i * spacing;
+        debugDrawLine(DEBUG_DRAW_GRID, (Vector3) { d + pos.x, pos.y, lo + pos.z },
+                (Vector3) { d + pos.x, pos.y, hi + pos.z }, color);
+        debugDrawLine(DEBUG_DRAW_GRID, (Vector3) { lo + pos.x, pos.y, d + pos.z },
+                (Vector3) { hi + pos.x, pos.y, d + pos.z }, color);
+    }
+}
 
-            rlVertex3f((float)-halfSlices*spacing + pos.x, pos.y, (float)i*spacing + pos.z);
-            rlVertex3f((float)halfSlices*spacing + pos.x, pos.y, (float)i*spacing + pos.z);
+/* move every thread's lists for the active categories into the frame arrays */
+static void debugDrawGather(void)
+{
+    arrsetlen(debug_draw.vertices, 0);
+    arrsetlen(debug_draw.texts, 0);
+    arrsetlen(debug_draw.chars, 0);
+    u32 active = debug_draw.active;
+
+    pthread_mutex_lock(&debug_draw.lock);
+    for (int i = 0; i < arrlen(debug_draw.buffers); ++i) {
+        struct DebugDrawBuffer *buf = debug_draw.buffers[i];
+        pthread_mutex_lock(&buf->lock);
+        for (int c = 0; c < DEBUG_DRAW_CATEGORY_COUNT; ++c) {
+            /* pushed before the category was switched off, dropped */
+            if (active & (1u << c)) {
+                int n = arrlen(buf->lines[c]);
+                memcpy(arraddnptr(debug_draw.vertices, n), buf->lines[c], n * sizeof(struct DebugVertex));
+                int base = arrlen(debug_draw.chars);
+                for (int t = 0; t < arrlen(buf->texts[c]); ++t) {
+                    struct DebugText text = buf->texts[c][t];
+                    text.text += base;
+                    arrput(debug_draw.texts, text);
+                }
+                n = arrlen(buf->chars[c]);
+                memcpy(arraddnptr(debug_draw.chars, n), buf->chars[c], n);
+            }
+            arrsetlen(buf->lines[c], 0);
+            arrsetlen(buf->texts[c], 0);
+            arrsetlen(buf->chars[c], 0);
         }
-    rlEnd();
+        pthread_mutex_unlock(&buf->lock);
+    }
+    pthread_mutex_unlock(&debug_draw.lock);
+
+    debug_draw.lines = arrlen(debug_draw.vertices) / 2;
+    debug_draw.labels = arrlen(debug_draw.texts);
 }
 
+void debugDrawFlush(void)
+{
+    debugDrawGather();
+    if (!debug_draw.gpu || (debug_draw.lines == 0 && debug_draw.labels == 0))
+        return;
+    /* whatever raylib has batched so far goes first */
+    rlDrawRenderBatchActive();
+    Matrix view = rlGetMatrixModelview();
+
+    if (debug_draw.lines > 0) {
+        size_t size = arrlen(debug_draw.vertices) * sizeof(struct DebugVertex);
+        glBindBuffer(GL_ARRAY_BUFFER, debug_draw.vbo);
+        if (size > debug_draw.vbo_size) {
+            debug_draw.vbo_size = size * 2;
+            glBufferData(GL_ARRAY_BUFFER, debug_draw.vbo_size, NULL, GL_STREAM_DRAW);
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, debug_draw.vertices);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        rlEnableShader(debug_draw.shader.id);
+        rlSetUniformMatrix(debug_draw.mvp_loc, MatrixMultiply(view, rlGetMatrixProjection()));
+        glBindVertexArray(debug_draw.vao);
+        glDrawArrays(GL_LINES, 0, debug_draw.lines * 2);
+        glBindVertexArray(0);
+        rlDisableShader();
+    }
 
+    /* labels face the camera, text y runs down the screen */
+    Vector3 right = { view.m0, view.m4, view.m8 };
+    Vector3 down = { -view.m1, -view.m5, -view.m9 };
+    Vector3 back = { view.m2, view.m6, view.m10 };
+    for (int i = 0; i < debug_draw.labels; ++i) {
+        const struct DebugText *t = &debug_draw.texts[i];
+        Matrix transform = {
+            right.x, down.x, back.x, t->position.x,
+            right.y, down.y, back.y, t->position.y,
+            right.z, down.z, back.z, t->position.z,
+            0, 0, 0, 1,
+        };
+        textDraw3D(debug_draw.font, &debug_draw.chars[t->text], transform, t->size, t->size * 0.1f, t->color);
+    }
+}
@@ -0,0 +1,75 @@
+/*****************************************************
+Create Date:        2024-12-07
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/dynres.h"
+#include "../include/obh/util.h"
+#include "../include/raylib/raymath.h"
+
+static void dynresResize(DynamicResolution *dr)
+{
+    float scale = dr->enabled ? dr->scale : 1.0f;
+    int width = max((int)(GetScreenWidth() * scale), 1);
+    int height = max((int)(GetScreenHeight() * scale), 1);
+    if (width == dr->width && height == dr->height)
+        return;
+
+    if (dr->target.id > 0)
+        UnloadRenderTexture(dr->target);
+    dr->target = LoadRenderTexture(width, height);
+    SetTextureFilter(dr->target.texture, TEXTURE_FILTER_BILINEAR);
+    dr->width = width;
+    dr->height = height;
+}
+
+void dynresInit(DynamicResolution *dr, float target_ms, float min_scale, float max_scale)
+{
+    *dr = (DynamicResolution) {
+        .scale = max_scale, .min_scale = min_scale, .max_scale = max_scale,
+        .target_ms = target_ms, .interval = 15, .enabled = true,
+    };
+    dynresResize(dr);
+}
+
+void dynresUnload(DynamicResolution *dr)
+{
+    if (dr->target.id > 0)
+        UnloadRenderTexture(dr->target);
+    *dr = (DynamicResolution) { 0 };
+}
+
+void dynresUpdate(DynamicResolution *dr, float frame_ms)
+{
+    dr->accum_ms += frame_ms;
+    if (++dr->frames >= dr->interval) {
+        dr->avg_ms = dr->accum_ms / dr->frames;
+        dr->accum_ms = 0;
+        dr->frames = 0;
+
+        /* cost goes with pixel count, so with scale squared */
+        float ideal = dr->scale * sqrtf(dr->target_ms / fmaxf(dr->avg_ms, 0.01f));
+        /* drop fast, climb only with headroom so it does not oscillate */
+        float next = dr->scale;
+        if (dr->avg_ms > dr->target_ms)
+            next = ideal;
+        else if (dr->avg_ms < dr->target_ms * 0.8f)
+            next = dr->scale + (ideal - dr->scale) * 0.5f;
+        next = roundf(next / DYNRES_SCALE_STEP) * DYNRES_SCALE_STEP;
+        dr->scale = Clamp(next, dr->min_scale, dr->max_scale);
+    }
+
+    /* also catches window resizes */
+    dynresResize(dr);
+}
+
+void dynresDraw(DynamicResolution *dr)
+{
+    /* render textures are stored upside down */
+    Rectangle src = { 0, 0, dr->width, -dr->height };
+    Rectangle dst = { 0, 0, GetScreenWidth(), GetScreenHeight() };
+    DrawTexturePro(dr->target.texture, src, dst, (Vector2) { 0 }, 0, WHITE);
+}
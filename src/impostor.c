@@ -0,0 +1,132 @@
+/*****************************************************
+Create Date:        2024-12-18
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/impostor.h"
+#include "../include/obh/util.h"
+#include "../include/obh/c_log.h"
+
+void impostorInit(ImpostorSet *set, float distance, float fade, bool gpu)
+{
+    *set = (ImpostorSet) { .distance = distance, .fade = Clamp(fade, 0, distance), .gpu = gpu };
+}
+
+void impostorUnload(ImpostorSet *set)
+{
+    spriteBatchUnload(&set->batch);
+    spriteAtlasUnload(&set->atlas);
+    arrfree(set->models);
+    *set = (ImpostorSet) { 0 };
+}
+
+int impostorAdd(ImpostorSet *set, Model model, int views, float pitch, int size)
+{
+    views = Clamp(views, 1, IMPOSTOR_MAX_VIEWS);
+    /* straight up or down has no up vector to render with */
+    pitch = Clamp(pitch, -89, 89) * DEG2RAD;
+
+    BoundingBox bb = GetModelBoundingBox(model);
+    struct ImpostorModel im = {
+        .model = model, .views = views,
+        .center = Vector3Scale(Vector3Add(bb.min, bb.max), 0.5f),
+        .radius = fmaxf(Vector3Distance(bb.min, bb.max) * 0.5f, 1e-3f),
+    };
+
+    /* one row of views, left to right by angle */
+    Image sheet = GenImageColor(size * views, size, BLANK);
+    if (set->gpu) {
+        double start = time_ms();
+        RenderTexture2D target = LoadRenderTexture(size, size);
+        for (int v = 0; v < views; ++v) {
+            float a = 2 * PI * v / views;
+            Vector3 dir = { sinf(a) * cosf(pitch), sinf(pitch), cosf(a) * cosf(pitch) };
+            /* orthographic, the sphere just fills the view */
+            Camera3D camera = {
+                .position = Vector3Add(im.center, Vector3Scale(dir, im.radius * 2)),
+                .target = im.center, .up = { 0, 1, 0 },
+                .fovy = im.radius * 2, .projection = CAMERA_ORTHOGRAPHIC,
+            };
+            BeginTextureMode(target);
+                ClearBackground(BLANK);
+                BeginMode3D(camera);
+                    DrawModel(model, (Vector3) { 0 }, 1, WHITE);
+                EndMode3D();
+            EndTextureMode();
+
+            /* render textures are upside down */
+            Image view = LoadImageFromTexture(target.texture);
+            for (int y = 0; y < size; ++y) {
+                memcpy((u8 *)sheet.data + ((size_t)y * sheet.width + (size_t)v * size) * 4,
+                        (u8 *)view.data + (size_t)(size - 1 - y) * size * 4, (size_t)size * 4);
+            }
+            UnloadImage(view);
+        }
+        UnloadRenderTexture(target);
+        c_log_info(LOG_TAG, "%d impostor views of %d px in %.1f ms", views, size, time_ms() - start);
+    }
+
+    im.first_region = spriteAtlasAdd(&set->atlas, sheet, views, 1);
+    UnloadImage(sheet);
+    arrput(set->models, im);
+    return arrlen(set->models) - 1;
+}
+
+void impostorBuild(ImpostorSet *set)
+{
+    spriteAtlasBuild(&set->atlas, set->gpu);
+    /* distant quads are a few pixels across, they shimmer without mipmaps */
+    for (int p = 0; set->gpu && p < arrlen(set->atlas.pages); ++p) {
+        GenTextureMipmaps(&set->atlas.pages[p]);
+        SetTextureFilter(set->atlas.pages[p], TEXTURE_FILTER_TRILINEAR);
+    }
+    spriteBatchInit(&set->batch, &set->atlas, true, set->gpu);
+}
+
+void impostorDraw(ImpostorSet *set, int id, Vector3 position, float yaw, float scale, Color tint, Camera3D camera)
+{
+    const struct ImpostorModel *im = &set->models[id];
+    Vector3 up = { 0, 1, 0 };
+    Vector3 center = Vector3Add(position,
+            Vector3Scale(Vector3RotateByAxisAngle(im->center, up, yaw * DEG2RAD), scale));
+    Vector3 to_camera = Vector3Subtract(camera.position, center);
+    float d = Vector3Length(to_camera);
+
+    if (d < set->distance) {
+        if (set->gpu)
+            DrawModelEx(im->model, position, up, yaw, (Vector3) { scale, scale, scale }, tint);
+        set->queued_meshes++;
+    }
+    float start = set->distance - set->fade;
+    if (d <= start)
+        return;
+    float alpha = d < set->distance ? (d - start) / set->fade : 1;
+    set->queued_blended += alpha < 1;
+
+    /* angle of the camera around the model, view v was rendered from 2 pi v / views */
+    float angle = atan2f(to_camera.x, to_camera.z) - yaw * DEG2RAD;
+    int view = (int)lroundf(angle / (2 * PI) * im->views) % im->views;
+    if (view < 0)
+        view += im->views;
+
+    /* to the front of the bounding sphere, shrunk to keep its size on screen */
+    float r = im->radius * scale;
+    float pull = fminf(r, d * 0.5f);
+    Vector3 p = Vector3Add(center, Vector3Scale(to_camera, pull / d));
+    float size = 2 * r * (d - pull) / d;
+    tint.a = (u8)(tint.a * alpha);
+    spriteDraw(&set->batch, im->first_region + view, p, (Vector2) { size, size }, 0, tint);
+}
+
+void impostorFlush(ImpostorSet *set)
+{
+    spriteBatchFlush(&set->batch);
+    set->impostors = set->batch.drawn;
+    set->meshes = set->queued_meshes;
+    set->blended = set->queued_blended;
+    set->queued_meshes = 0;
+    set->queued_blended = 0;
+}
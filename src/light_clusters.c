@@ -0,0 +1,278 @@
+/*****************************************************
+Create Date:        2024-12-11
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/light_clusters.h"
+#include "../include/obh/simd.h"
+#include "../include/obh/util.h"
+#include "../include/obh/uniforms.h"
+#include "../include/raylib/rlgl.h"
+#include "../include/glad/glad.h"
+
+static unsigned int lightClustersTexture(unsigned int buffer, int format)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    return texture;
+}
+
+void lightClustersInit(LightClusters *lc, float near, float far, bool gpu)
+{
+    *lc = (LightClusters) { 0 };
+    lc->near = near;
+    lc->far = far;
+    lc->slice_scale = CLUSTERS_Z / logf(far / near);
+    lc->slice_bias = -logf(near) * lc->slice_scale;
+    /* slice 0 also takes everything in front of near */
+    lc->slice_depth[0] = 0;
+    for (int k = 1; k <= CLUSTERS_Z; ++k)
+        lc->slice_depth[k] = near * powf(far / near, (float)k / CLUSTERS_Z);
+
+    lc->min_x = MemAlloc(CLUSTERS_COUNT * sizeof(float));
+    lc->max_x = MemAlloc(CLUSTERS_COUNT * sizeof(float));
+    lc->min_y = MemAlloc(CLUSTERS_COUNT * sizeof(float));
+    lc->max_y = MemAlloc(CLUSTERS_COUNT * sizeof(float));
+    lc->grid = MemAlloc(CLUSTERS_COUNT * 2 * sizeof(u32));
+
+    lc->gpu = gpu;
+    if (gpu) {
+        glGenBuffers(1, &lc->light_buffer);
+        glGenBuffers(1, &lc->grid_buffer);
+        glGenBuffers(1, &lc->index_buffer);
+        /* storage has to exist before glTexBuffer */
+        glBindBuffer(GL_TEXTURE_BUFFER, lc->light_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, CLUSTERS_MAX_LIGHTS * sizeof(struct PointLight), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, lc->grid_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, CLUSTERS_COUNT * 2 * sizeof(u32), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, lc->index_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(u32), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        lc->light_texture = lightClustersTexture(lc->light_buffer, GL_RGBA32F);
+        lc->grid_texture = lightClustersTexture(lc->grid_buffer, GL_RG32UI);
+        lc->index_texture = lightClustersTexture(lc->index_buffer, GL_R32UI);
+    }
+}
+
+void lightClustersUnload(LightClusters *lc)
+{
+    if (lc->gpu) {
+        unsigned int textures[] = { lc->light_texture, lc->grid_texture, lc->index_texture };
+        unsigned int buffers[] = { lc->light_buffer, lc->grid_buffer, lc->index_buffer };
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    }
+    MemFree(lc->min_x);
+    MemFree(lc->max_x);
+    MemFree(lc->min_y);
+    MemFree(lc->max_y);
+    MemFree(lc->grid);
+    arrfree(lc->lights);
+    arrfree(lc->indices);
+    arrfree(lc->hit_cluster);
+    arrfree(lc->hit_light);
+    *lc = (LightClusters) { 0 };
+}
+
+void lightClustersClear(LightClusters *lc)
+{
+    arrsetlen(lc->lights, 0);
+}
+
+bool lightClustersAdd(LightClusters *lc, struct PointLight light)
+{
+    if (arrlen(lc->lights) >= CLUSTERS_MAX_LIGHTS)
+        return false;
+    arrput(lc->lights, light);
+    return true;
+}
+
+static int lightClustersSlice(const LightClusters *lc, float depth)
+{
+    int k = floorf(logf(max(depth, lc->near)) * lc->slice_scale + lc->slice_bias);
+    return min(max(k, 0), CLUSTERS_Z - 1);
+}
+
+int lightClustersIndex(const LightClusters *lc, float ndc_x, float ndc_y, float depth)
+{
+    int x = min(max((int)((ndc_x * 0.5f + 0.5f) * CLUSTERS_X), 0), CLUSTERS_X - 1);
+    int y = min(max((int)((ndc_y * 0.5f + 0.5f) * CLUSTERS_Y), 0), CLUSTERS_Y - 1);
+    return (lightClustersSlice(lc, depth) * CLUSTERS_Y + y) * CLUSTERS_X + x;
+}
+
+/*
+ * View space box around each cluster: the tile's ndc range scaled out
+ * to the slice's near and far depth. View space here has x right, y up
+ * and depth growing away from the camera.
+ */
+static void lightClustersBuildBounds(LightClusters *lc, float fovy, float aspect)
+{
+    lc->fovy = fovy;
+    lc->aspect = aspect;
+    float sy = tanf(fovy * DEG2RAD * 0.5f);
+    float sx = sy * aspect;
+    for (int k = 0; k < CLUSTERS_Z; ++k) {
+        float dn = lc->slice_depth[k], df = lc->slice_depth[k + 1];
+        for (int y = 0; y < CLUSTERS_Y; ++y) {
+            float y0 = (-1 + 2.0f * y / CLUSTERS_Y) * sy;
+            float y1 = (-1 + 2.0f * (y + 1) / CLUSTERS_Y) * sy;
+            for (int x = 0; x < CLUSTERS_X; ++x) {
+                float x0 = (-1 + 2.0f * x / CLUSTERS_X) * sx;
+                float x1 = (-1 + 2.0f * (x + 1) / CLUSTERS_X) * sx;
+                int c = (k * CLUSTERS_Y + y) * CLUSTERS_X + x;
+                lc->min_x[c] = min(x0 * dn, x0 * df);
+                lc->max_x[c] = max(x1 * dn, x1 * df);
+                lc->min_y[c] = min(y0 * dn, y0 * df);
+                lc->max_y[c] = max(y1 * dn, y1 * df);
+            }
+        }
+    }
+}
+
+/*
+ * ndc range a box of half size r around (v, depth) can cover for depths
+ * in [dn, df], picking whichever end of the depth range pushes the
+ * edge further out. s is tan(half fov) along the axis.
+ */
+static void lightClustersNdcRange(float v, float r, float dn, float df, float s, float *lo, float *hi)
+{
+    *lo = (v - r) / ((v - r < 0 ? dn : df) * s);
+    *hi = (v + r) / ((v + r > 0 ? dn : df) * s);
+}
+
+static int lightClustersTile(float ndc, int tiles)
+{
+    return min(max((int)floorf((ndc * 0.5f + 0.5f) * tiles), 0), tiles - 1);
+}
+
+void lightClustersAssign(LightClusters *lc, Camera3D camera, float aspect)
+{
+    double start = time_ms();
+
+    if (camera.fovy != lc->fovy || aspect != lc->aspect)
+        lightClustersBuildBounds(lc, camera.fovy, aspect);
+
+    Matrix view = MatrixLookAt(camera.position, camera.target, camera.up);
+    float sy = tanf(camera.fovy * DEG2RAD * 0.5f);
+    float sx = sy * aspect;
+
+    arrsetlen(lc->hit_cluster, 0);
+    arrsetlen(lc->hit_light, 0);
+    for (int i = 0; i < arrlen(lc->lights); ++i) {
+        const struct PointLight *light = &lc->lights[i];
+        Vector3 v = Vector3Transform(light->position, view);
+        float depth = -v.z, r = light->radius;
+        if (depth + r < 0 || depth - r > lc->far)
+            continue;
+        /* the part of the sphere in front of the camera */
+        float dn = max(depth - r, 1e-3f), df = depth + r;
+
+        float x_lo, x_hi, y_lo, y_hi;
+        lightClustersNdcRange(v.x, r, dn, df, sx, &x_lo, &x_hi);
+        lightClustersNdcRange(v.y, r, dn, df, sy, &y_lo, &y_hi);
+        if (x_lo > 1 || x_hi < -1 || y_lo > 1 || y_hi < -1)
+            continue;
+        int x0 = lightClustersTile(x_lo, CLUSTERS_X), x1 = lightClustersTile(x_hi, CLUSTERS_X);
+        int y0 = lightClustersTile(y_lo, CLUSTERS_Y), y1 = lightClustersTile(y_hi, CLUSTERS_Y);
+        int k0 = lightClustersSlice(lc, dn), k1 = lightClustersSlice(lc, df);
+
+        /* sphere against 4 cluster boxes at a time along x */
+        v4f cx = V4F(v.x), cy = V4F(v.y), r2 = V4F(r * r), zero = V4F(0);
+        v4i lane = { 0, 1, 2, 3 };
+        for (int k = k0; k <= k1; ++k) {
+            float dz = max(max(lc->slice_depth[k] - depth, depth - lc->slice_depth[k + 1]), 0.0f);
+            v4f dz2 = V4F(dz * dz);
+            for (int y = y0; y <= y1; ++y) {
+                int row = (k * CLUSTERS_Y + y) * CLUSTERS_X;
+                for (int x = x0 & ~3; x <= x1; x += 4) {
+                    int c = row + x;
+                    v4f dx = v4f_max(v4f_max(v4f_load(lc->min_x + c) - cx, cx - v4f_load(lc->max_x + c)), zero);
+                    v4f dy = v4f_max(v4f_max(v4f_load(lc->min_y + c) - cy, cy - v4f_load(lc->max_y + c)), zero);
+                    v4i xs = V4I(x) + lane;
+                    v4i hit = (dx * dx + dy * dy + dz2 <= r2) & (xs >= V4I(x0)) & (xs <= V4I(x1));
+                    if (!v4i_any(hit))
+                        continue;
+                    for (int l = 0; l < 4; ++l) {
+                        if (hit[l]) {
+                            arrput(lc->hit_cluster, c + l);
+                            arrput(lc->hit_light, i);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /* counting sort the hits into per cluster lists, lights stay in order */
+    memset(lc->grid, 0, CLUSTERS_COUNT * 2 * sizeof(u32));
+    int hits = arrlen(lc->hit_cluster);
+    for (int h = 0; h < hits; ++h)
+        lc->grid[lc->hit_cluster[h] * 2 + 1]++;
+    u32 offset = 0;
+    lc->clusters_lit = 0;
+    lc->max_per_cluster = 0;
+    for (int c = 0; c < CLUSTERS_COUNT; ++c) {
+        u32 count = lc->grid[c * 2 + 1];
+        lc->grid[c * 2] = offset;
+        lc->grid[c * 2 + 1] = 0;
+        offset += count;
+        lc->clusters_lit += count > 0;
+        lc->max_per_cluster = max(lc->max_per_cluster, (int)count);
+    }
+    arrsetlen(lc->indices, hits);
+    for (int h = 0; h < hits; ++h) {
+        u32 *cell = &lc->grid[lc->hit_cluster[h] * 2];
+        lc->indices[cell[0] + cell[1]++] = lc->hit_light[h];
+    }
+
+    lc->assign_ms = time_ms() - start;
+}
+
+void lightClustersBind(LightClusters *lc)
+{
+    int lights = arrlen(lc->lights), indices = arrlen(lc->indices);
+    /* orphan and refill, the previous frame may still be reading */
+    glBindBuffer(GL_TEXTURE_BUFFER, lc->light_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, CLUSTERS_MAX_LIGHTS * sizeof(struct PointLight), NULL, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, lights * sizeof(struct PointLight), lc->lights);
+    glBindBuffer(GL_TEXTURE_BUFFER, lc->grid_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, CLUSTERS_COUNT * 2 * sizeof(u32), lc->grid, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, lc->index_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, max(indices, 1) * sizeof(u32), lc->indices, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    struct FrameUniforms *f = &uniform_buffers.frame;
+    f->cluster_params[0] = lc->slice_scale;
+    f->cluster_params[1] = lc->slice_bias;
+    f->cluster_params[2] = lc->near;
+    f->cluster_dims[0] = CLUSTERS_X;
+    f->cluster_dims[1] = CLUSTERS_Y;
+    f->cluster_dims[2] = CLUSTERS_Z;
+    f->cluster_dims[3] = lights;
+
+    rlActiveTextureSlot(CLUSTERS_LIGHT_SLOT);
+    glBindTexture(GL_TEXTURE_BUFFER, lc->light_texture);
+    rlActiveTextureSlot(CLUSTERS_GRID_SLOT);
+    glBindTexture(GL_TEXTURE_BUFFER, lc->grid_texture);
+    rlActiveTextureSlot(CLUSTERS_INDEX_SLOT);
+    glBindTexture(GL_TEXTURE_BUFFER, lc->index_texture);
+    rlActiveTextureSlot(0);
+}
+
+void lightClustersSetupShader(Shader shader)
+{
+    int light_slot = CLUSTERS_LIGHT_SLOT;
+    int grid_slot = CLUSTERS_GRID_SLOT;
+    int index_slot = CLUSTERS_INDEX_SLOT;
+    rlEnableShader(shader.id);
+    rlSetUniform(GetShaderLocation(shader, "lightData"), &light_slot, SHADER_UNIFORM_INT, 1);
+    rlSetUniform(GetShaderLocation(shader, "lightGrid"), &grid_slot, SHADER_UNIFORM_INT, 1);
+    rlSetUniform(GetShaderLocation(shader, "lightIndices"), &index_slot, SHADER_UNIFORM_INT, 1);
+    rlDisableShader();
+}
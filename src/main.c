@@ -11,6 +11,25 @@ License:            none
 #include "../include/obh/util.h"
 #include "../include/obh/unit.h"
 #include "../include/obh/debug.h"
+#include "../include/obh/world.h"
+#include "../include/obh/shadow.h"
+#include "../include/obh/terrain.h"
+#include "../include/obh/occlusion.h"
+#include "../include/obh/bench.h"
+#include "../include/obh/render_queue.h"
+#include "../include/obh/render_graph.h"
+#include "../include/obh/dynres.h"
+#include "../include/obh/aa.h"
+#include "../include/obh/shader_cache.h"
+#include "../include/obh/uniforms.h"
+#include "../include/obh/light_clusters.h"
+#include "../include/obh/sun_bake.h"
+#include "../include/obh/text.h"
+#include "../include/obh/sprite.h"
+#include "../include/obh/particles.h"
+#include "../include/obh/capture.h"
+#include "../include/obh/texture_stream.h"
+#include "../include/obh/mesh_opt.h"
 
 #include "../include/glad/glad.h"
 
@@ -40,82 +59,6 @@ static float CAMERA_OFF_X = 50.0f;
 static float CAMERA_OFF_Y = 50.0f;
 static float CAMERA_OFF_Z = -50.0f;
 
-enum CUBETYPE {
-    CUBETYPE_GRASS,
-    CUBETYPE_NUM,
-};
-
-#define CHUNKSIZE 32
-#define HEIGHTLEVELS 40
-
-typedef struct iVec2 {
-    int x, y;
-} iVec2;
-
-struct Cube {
-    int x, y, z;
-    enum CUBETYPE type;
-};
-
-struct WorldChunk {
-    iVec2 coord;
-    struct Cube cubes[CHUNKSIZE][CHUNKSIZE];
-};
-
-struct WorldMap {
-    union {
-        iVec2 coord;
-        iVec2 key;
-    };
-    union {
-        struct WorldChunk chunk;
-        struct WorldChunk value;
-    };
-};
-
-static struct WorldMap *world_map;
-
-struct WorldChunk genWorldChunk(int x, int z)
-{
-    struct WorldChunk wc = { .coord = { .x = x, .y = z } };
-
-    Image perlin_img = GenImagePerlinNoise(CHUNKSIZE, CHUNKSIZE, x * CHUNKSIZE, z * CHUNKSIZE, 0.6);
-    for (int i = 0; i < CHUNKSIZE; i += 1) {
-        for (int j = 0; j < CHUNKSIZE; j += 1) {
-            Color* perlin_colors = perlin_img.data;
-            wc.cubes[i][j] = (struct Cube) {.x = j,
-                    .y = perlin_colors[(CHUNKSIZE - i - 1) * CHUNKSIZE + j].r / HEIGHTLEVELS,
-                    .z = CHUNKSIZE - i - 1 };
-        }
-    }
-
-    return wc;
-}
-
-iVec2 getChunkCoords(Vector3 position)
-{
-    int chunk_x = floor(floor(position.x) / CHUNKSIZE);
-    int chunk_z = floor(floor(position.z) / CHUNKSIZE);
-    return (iVec2) { chunk_x, chunk_z };
-}
-
-void genWorldAround(Vector3 position)
-{
-    iVec2 chunk_pos = getChunkCoords(position);
-    int chunk_x = chunk_pos.x;
-    int chunk_z = chunk_pos.y;
-
-    for (int i = -1; i < 2; ++i) {
-        for (int j = -1; j < 2; ++j) {
-            iVec2 chunk_pos_inner = { chunk_x + j, chunk_z + i };
-            if (hmgeti(world_map, chunk_pos_inner) >= 0)
-                continue;
-            struct WorldChunk wc = genWorldChunk(chunk_pos_inner.x, chunk_pos_inner.y);
-            hmput(world_map, chunk_pos_inner, wc);
-        }
-    }
-}
-
 void pollKeys()
 {
 }
@@ -295,37 +238,313 @@ bool CollisionTest(Unit* unit, BoundingBox* bbs, int bbs_len)
     return false;
 }
 
-RenderTexture2D LoadShadowmapRenderTexture(int width, int height)
+/* state the render graph passes draw from, owned by main */
+struct Frame {
+    ShadowCache *shadow_cache;
+    Terrain *terrain;
+    OcclusionCuller *occlusion;
+    RenderQueue *render_queue;
+    RenderGraph *render_graph;
+    DynamicResolution *dynres;
+    AntiAliasing *aa;
+    LightClusters *lights;
+    SunBake *sun_bake;
+    SpriteBatch *sprites_world, *sprites_hud;
+    ParticleSystem *particles;
+    Capture *capture;
+    TextureStream *textures;
+    /* streamed ids, previewed in the residency view */
+    int tex_grass, tex_dirt;
+    /* first of scarfy's 6 run frames */
+    int scarfy;
+    int anim_fps;
+    /* seconds, fixed steps in headless runs */
+    double time;
+    /* particle emitters */
+    int dust, rain, puff;
+    Model *cube;
+    Shader shader;
+    TextFont font;
+    bool *shadows_enabled, *occlusion_enabled, *lights_enabled, *bake_enabled, *textures_debug;
+    FILE **camera_path;
+};
+
+/* a few flickering lamps per chunk within radius chunks of focus */
+static void placeLamps(LightClusters *lc, Vector3 focus, int radius, float time)
 {
-    RenderTexture2D target = { 0 };
+    static const Vector3 tints[] = {
+        { 1.0f, 0.55f, 0.2f }, { 1.0f, 0.8f, 0.5f }, { 0.5f, 0.7f, 1.0f }, { 0.9f, 0.3f, 0.6f },
+    };
+    lightClustersClear(lc);
+    iVec2 centre = getChunkCoords(focus);
+    for (int dz = -radius; dz <= radius; ++dz) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+            iVec2 coord = { centre.x + dx, centre.y + dz };
+            struct WorldMap *entry = hmgetp_null(world_map, coord);
+            if (entry == NULL)
+                continue;
+            /* same spots every time the chunk is visited */
+            u32 h = (u32)coord.x * 73856093u ^ (u32)coord.y * 19349663u;
+            for (int i = 0; i < 4; ++i) {
+                h = h * 1664525u + 1013904223u;
+                Vector3 top = worldCubePosition(&entry->chunk, (h >> 16) % CHUNKSIZE, (h >> 8) % CHUNKSIZE);
+                float flicker = 0.85f + 0.15f * sinf(time * 9 + (h % 97));
+                lightClustersAdd(lc, (struct PointLight) {
+                    .position = { top.x, top.y + 1.5f, top.z }, .radius = 10,
+                    .color = tints[h % 4], .intensity = 6 * flicker,
+                });
+            }
+        }
+    }
+}
 
-    target.id = rlLoadFramebuffer(); // Load an empty framebuffer
-    target.texture.width = width;
-    target.texture.height = height;
+static bool passShadowCascadesChanged(void *user)
+{
+    struct Frame *f = user;
+    return shadowCacheStale(f->shadow_cache);
+}
 
-    if (target.id > 0)
-    {
-        rlEnableFramebuffer(target.id);
+/* terrain only, re-rendered when a cascade moves or a chunk in it changes */
+static void passShadowCascades(void *user)
+{
+    struct Frame *f = user;
+    for (int c = 0; c < f->shadow_cache->cascade_count; ++c) {
+        if (!shadowCacheBeginCascade(f->shadow_cache, c))
+            continue;
+        for (int i = 0; i < hmlen(world_map); ++i) {
+            struct WorldChunk *chunk = &world_map[i].chunk;
+            int lod = terrainChunkLod(f->terrain, chunk->coord);
+            if (lod < 0 || !shadowCacheCascadeSees(f->shadow_cache, c, worldChunkBoundingBox(chunk)))
+                continue;
+            struct TerrainPatch *patch = terrainGetPatch(f->terrain, chunk->coord);
+            if (patch != NULL) {
+                shadowDrawModel(f->shadow_cache, patch->model, terrainPatchOrigin(chunk->coord), 1);
+                continue;
+            }
+            for (int z = 0; z < CHUNKSIZE; ++z) {
+                for (int x = 0; x < CHUNKSIZE; ++x) {
+                    shadowDrawModel(f->shadow_cache, *f->cube, worldCubePosition(chunk, z, x), 0.90);
+                }
+            }
+        }
+        shadowCacheEndCascade(f->shadow_cache);
+    }
+}
+
+static void passShadowDynamic(void *user)
+{
+    struct Frame *f = user;
+    shadowCacheBeginDynamic(f->shadow_cache, player_unit.position);
+        shadowDrawModel(f->shadow_cache, *player_unit.model, player_unit.position, 1);
+    shadowCacheEndDynamic(f->shadow_cache);
+}
 
-        // Create depth texture
-        // We don't need a color texture for the shadowmap
-        target.depth.id = rlLoadTextureDepth(width, height, false);
-        target.depth.width = width;
-        target.depth.height = height;
-        target.depth.format = 19;       //DEPTH_COMPONENT_24BIT?
-        target.depth.mipmaps = 1;
+static void passWorld(void *user)
+{
+    struct Frame *f = user;
+    bool occlusion_enabled = *f->occlusion_enabled;
+
+    float aspect = (float)f->dynres->width / f->dynres->height;
+    shadowCacheBind(f->shadow_cache);
+    lightClustersAssign(f->lights, unit_cam.camera, aspect);
+    lightClustersBind(f->lights);
+    sunBakeBind(f->sun_bake);
+    uniformsSetCamera(unit_cam.camera, aspect);
+    uniformsUploadFrame();
+
+    if (occlusion_enabled)
+        occlusionWait(f->occlusion);
+
+    aaBegin(f->aa);
+    BeginMode3D(unit_cam.camera);
+
+        /* world render, cubes close to the player and heightfield patches further out */
+        renderQueueBegin(f->render_queue, unit_cam.camera.position);
+        for (int i = 0; i < hmlen(world_map); ++i) {
+            struct WorldChunk *chunk = &world_map[i].chunk;
+            int lod = terrainChunkLod(f->terrain, chunk->coord);
+            if (lod < 0)
+                continue;
+            bool visible = !occlusion_enabled || occlusionTestBox(f->occlusion, worldChunkBoundingBox(chunk));
+            DEBUG_BOX(DEBUG_DRAW_CHUNKS, worldChunkBoundingBox(chunk), visible ? GREEN : RED);
+            if (!visible)
+                continue;
+            struct TerrainPatch *patch = terrainGetPatch(f->terrain, chunk->coord);
+            if (patch != NULL) {
+                renderQueuePushModel(f->render_queue, RENDER_PASS_OPAQUE, patch->model,
+                        terrainPatchOrigin(chunk->coord), 1, BROWN);
+                continue;
+            }
+            for (int z = 0; z < CHUNKSIZE; ++z) {
+                for (int x = 0; x < CHUNKSIZE; ++x) {
+                    Vector3 pos = worldCubePosition(chunk, z, x);
+                    renderQueuePushModel(f->render_queue, RENDER_PASS_OPAQUE, *f->cube, pos, 0.90, BROWN);
+                    //DrawCubeWires(pos, 1, 1, 1, WHITE);
+                    //DrawCubeTexture(tex_grass, pos, 1, 1, 1, WHITE);
+                }
+            }
+        }
+
+        DEBUG_GRID(100, 1, ((Vector3) { 0, 0.5, 0 }));
+        bool player_visible = !occlusion_enabled || occlusionTestBox(f->occlusion, unitBoundingBox(&player_unit));
+        if (player_visible)
+            renderQueuePushModel(f->render_queue, RENDER_PASS_OPAQUE, *player_unit.model, player_unit.position, 1, BLUE);
+        renderQueueFlush(f->render_queue);
+
+        if (player_visible)
+            DEBUG_BOX(DEBUG_DRAW_BOUNDS, ((BoundingBox) {
+                Vector3SubtractValue(player_unit.position, 0.5f), Vector3AddValue(player_unit.position, 0.5f) }), GREEN);
+        //DrawModel(base_plane_model, base_plane_pos, 1, DARK_GRASS);
+        Vector3 head = { player_unit.position.x, player_unit.position.y + 1.5f, player_unit.position.z };
+        spriteDraw(f->sprites_world, spriteAnimFrame(f->scarfy, 6, f->anim_fps, f->time), head,
+                (Vector2) { 1, 1 }, 0, WHITE);
+        spriteBatchFlush(f->sprites_world);
+        particlesDraw(f->particles);
+        DEBUG_AXES(GetBoundingBoxModelWithPos(player_unit.model, player_unit.position).min, 2);
+        for (int i = 0; i < arrlen(f->lights->lights); ++i) {
+            const struct PointLight *l = &f->lights->lights[i];
+            DEBUG_SPHERE(DEBUG_DRAW_LIGHTS, l->position, 0.25f, ColorFromNormalized((Vector4) {
+                l->color.x, l->color.y, l->color.z, 1 }));
+        }
+        debugDrawFlush();
+
+    EndMode3D();
+    aaEnd(f->aa, f->dynres->target);
+}
 
-        // Attach depth texture to FBO
-        rlFramebufferAttach(target.id, target.depth.id, RL_ATTACHMENT_DEPTH, RL_ATTACHMENT_TEXTURE2D, 0);
+static void passUpscale(void *user)
+{
+    struct Frame *f = user;
+    aaBeginPresent(f->aa, f->dynres->target);
+        dynresDraw(f->dynres);
+    aaEndPresent(f->aa);
+}
 
-        // Check if fbo is complete with attachments (valid)
-        if (rlFramebufferComplete(target.id)) TRACELOG(LOG_INFO, "FBO: [ID %i] Framebuffer object created successfully", target.id);
+/* text slots for the hud lines that change every frame */
+enum HudLine {
+    HUD_FPS, HUD_CAMERA, HUD_PLAYER, HUD_SUN, HUD_TERRAIN, HUD_OCCLUSION, HUD_RENDER, HUD_PASSES,
+    HUD_RESOLUTION, HUD_LIGHTS, HUD_SUN_BAKE, HUD_TEXT, HUD_DEBUG_DRAW, HUD_SPRITES, HUD_PARTICLES,
+    HUD_CAPTURE, HUD_TEXTURES,
+};
 
-        rlDisableFramebuffer();
+static void passHud(void *user)
+{
+    struct Frame *f = user;
+    const ShadowCache *sc = f->shadow_cache;
+    const OcclusionCuller *oc = f->occlusion;
+    const RenderQueue *rq = f->render_queue;
+    const RenderGraph *rg = f->render_graph;
+    const DynamicResolution *dr = f->dynres;
+    const LightClusters *lc = f->lights;
+    const SunBake *sb = f->sun_bake;
+    char str[512];
+
+    stbsp_sprintf(str, "camera: %.1f %.1f %.1f --> %.1f %.1f %.1f",
+            unit_cam.camera.position.x, unit_cam.camera.position.y, unit_cam.camera.position.z,
+            unit_cam.camera.target.x, unit_cam.camera.target.y, unit_cam.camera.target.z);
+    textDrawSlot(f->font, f, HUD_CAMERA, str, (Vector2) { 10, 30 }, 18, 1, YELLOW);
+    stbsp_sprintf(str, "player: %.2f %.2f %.2f / dir: %.2f, %.2f, %.2f",
+            player_unit.position.x, player_unit.position.y, player_unit.position.z,
+            player_unit.direction.x, player_unit.direction.y, player_unit.direction.z);
+    textDrawSlot(f->font, f, HUD_PLAYER, str, (Vector2) { 10, 50 }, 18, 1, YELLOW);
+    stbsp_sprintf(str, "sun: %.2f %.2f %.2f / shadows: %s (F2) %d x %d^2 (F3/F4) static renders: %llu / frame: %.2f ms",
+            sc->light_dir.x, sc->light_dir.y, sc->light_dir.z,
+            *f->shadows_enabled ? "on" : "off", sc->cascade_count, sc->resolution,
+            (unsigned long long)sc->static_renders, GetFrameTime() * 1000.0f);
+    textDrawSlot(f->font, f, HUD_SUN, str, (Vector2) { 10, 70 }, 18, 1, YELLOW);
+    stbsp_sprintf(str, "terrain: %d chunks / %llu triangles / %d rebuilt / %d morphing",
+            f->terrain->patches_visible, (unsigned long long)f->terrain->triangles, f->terrain->patches_rebuilt,
+            f->terrain->patches_morphed);
+    textDrawSlot(f->font, f, HUD_TERRAIN, str, (Vector2) { 10, 90 }, 18, 1, YELLOW);
+    stbsp_sprintf(str, "occlusion: %s (F6) %d/%d occluded, %d off screen / raster: %.2f ms %llu triangles%s",
+            *f->occlusion_enabled ? "on" : "off", oc->occluded, oc->tested, oc->off_screen,
+            oc->raster_ms, (unsigned long long)oc->triangles, *f->camera_path ? " / recording (F5)" : "");
+    textDrawSlot(f->font, f, HUD_OCCLUSION, str, (Vector2) { 10, 110 }, 18, 1, YELLOW);
+    stbsp_sprintf(str, "render: %s (F7) %d draws / %d shader binds / %d texture binds / submit: %.2f ms (sort %.2f ms)",
+            rq->sort ? "sorted" : "push order", rq->draw_calls, rq->shader_binds,
+            rq->texture_binds, rq->submit_ms, rq->sort_ms);
+    textDrawSlot(f->font, f, HUD_RENDER, str, (Vector2) { 10, 130 }, 18, 1, YELLOW);
+
+    /* last frame's numbers for this pass, it is still running */
+    int len = stbsp_sprintf(str, "passes: %d run / %d skipped / %d culled |",
+            rg->passes_run, rg->passes_skipped, rg->passes_culled);
+    for (int i = 0; i < rg->pass_count; ++i) {
+        const struct RenderPassStats *ps = &rg->stats[i];
+        len += stbsp_snprintf(str + len, sizeof(str) - len, " %s %s %.2f/%.2f ms", rg->passes[i].name,
+                ps->ran ? "" : ps->skipped ? "(skip)" : "(cull)", ps->cpu_ms, ps->gpu_ms);
+        if (len >= (int)sizeof(str))
+            break;
     }
-    else TRACELOG(LOG_WARNING, "FBO: Framebuffer object can not be created");
+    textDrawSlot(f->font, f, HUD_PASSES, str, (Vector2) { 10, 150 }, 18, 1, YELLOW);
+    stbsp_sprintf(str, "resolution: %s (F8) %d x %d (%.0f%%, %.0f-%.0f%%) / cost: %.2f ms of %.2f ms",
+            dr->enabled ? "dynamic" : "native", dr->width, dr->height, dr->scale * 100,
+            dr->min_scale * 100, dr->max_scale * 100, dr->avg_ms, dr->target_ms);
+    textDrawSlot(f->font, f, HUD_RESOLUTION, str, (Vector2) { 10, 170 }, 18, 1, YELLOW);
+    stbsp_sprintf(str, "anti-aliasing: %s (F9)", aaModeName(f->aa->mode));
+    textDraw(f->font, str, (Vector2) { 10, 190 }, 18, 1, YELLOW);
+    stbsp_sprintf(str, "point lights: %s (F10) %d / %d clusters lit, max %d per cluster / assign: %.2f ms",
+            *f->lights_enabled ? "on" : "off", (int)arrlen(lc->lights), lc->clusters_lit,
+            lc->max_per_cluster, lc->assign_ms);
+    textDrawSlot(f->font, f, HUD_LIGHTS, str, (Vector2) { 10, 210 }, 18, 1, YELLOW);
+    stbsp_sprintf(str, "sun bake: %s (F11) %d chunks baked, %d outstanding / %d threads, %.0f faces/s per core",
+            *f->bake_enabled ? "on" : "off", sb->chunks_baked, sb->chunks_outstanding, sb->queue.thread_count,
+            sb->bake_ms > 0 ? sb->faces_baked / (sb->bake_ms / 1000.0) : 0.0);
+    textDrawSlot(f->font, f, HUD_SUN_BAKE, str, (Vector2) { 10, 230 }, 18, 1, YELLOW);
+
+    stbsp_sprintf(str, "text: %d runs cached, %d slots / %llu reused, %llu laid out this frame",
+            (int)hmlen(text_cache.runs), (int)hmlen(text_cache.slots), (unsigned long long)text_cache.hits,
+            (unsigned long long)text_cache.misses);
+    textDrawSlot(f->font, f, HUD_TEXT, str, (Vector2) { 10, 250 }, 18, 1, YELLOW);
+    len = stbsp_sprintf(str, "debug draw: %s (F1) %d lines, %d labels |",
+            debug_draw.enabled ? "on" : "off", debug_draw.lines, debug_draw.labels);
+    for (int i = 0; i < DEBUG_DRAW_CATEGORY_COUNT; ++i)
+        len += stbsp_sprintf(str + len, " %d %s%s", i + 1, debugDrawCategoryName(1u << i),
+                debug_draw.categories & (1u << i) ? "" : " (off)");
+    textDrawSlot(f->font, f, HUD_DEBUG_DRAW, str, (Vector2) { 10, 270 }, 18, 1, YELLOW);
+    const SpriteBatch *sw = f->sprites_world;
+    stbsp_sprintf(str, "sprites: %d billboards in %d draws (%.3f ms), %d on screen",
+            sw->drawn, sw->draw_calls, sw->build_ms, f->sprites_hud->drawn);
+    textDrawSlot(f->font, f, HUD_SPRITES, str, (Vector2) { 10, 290 }, 18, 1, YELLOW);
+
+    const ParticleSystem *ps = f->particles;
+    stbsp_sprintf(str, "particles: rain %s (R) %llu simulated, %d of %d emitters paused / update: %.2f ms",
+            ps->emitters[f->rain]->desc.rate > 0 ? "on" : "off", (unsigned long long)ps->simulated,
+            ps->emitters_culled, ps->emitter_count, ps->update_ms);
+    textDrawSlot(f->font, f, HUD_PARTICLES, str, (Vector2) { 10, 310 }, 18, 1, YELLOW);
+
+    const Capture *cap = f->capture;
+    len = stbsp_sprintf(str, "capture: (P) screenshot, (O) record");
+    if (cap->record_left > 0)
+        len += stbsp_sprintf(str + len, "ing, %d frames left", cap->record_left);
+    stbsp_sprintf(str + len, " | %d written, %d dropped, %d queued / %.2f ms, peak %.2f ms",
+            cap->written, cap->dropped, cap->outstanding, cap->frame_ms, cap->frame_ms_peak);
+    textDrawSlot(f->font, f, HUD_CAPTURE, str, (Vector2) { 10, 330 }, 18, 1, YELLOW);
+
+    TextureStream *ts = f->textures;
+    if (*f->textures_debug) {
+        /* the previews ask for mips by their size on screen, like anything in the world would */
+        const int previews[] = { f->tex_grass, f->tex_dirt };
+        const float size = 256;
+        for (int i = 0; i < 2; ++i) {
+            Texture2D t = textureStreamUse(ts, previews[i], size);
+            DrawTexturePro(t, (Rectangle) { 0, 0, t.width, t.height },
+                    (Rectangle) { GetScreenWidth() - (i + 1) * (size + 10), 100, size, size }, (Vector2) { 0 }, 0, WHITE);
+        }
+        textureStreamDrawDebug(ts, f->font, (Vector2) { 10, 350 });
+    } else {
+        stbsp_sprintf(str, "textures: (T) %.2f / %.2f MiB resident, %d loads, %d evicted, %d outstanding",
+                ts->resident_bytes / (1024.0f * 1024.0f), ts->budget / (1024.0f * 1024.0f),
+                ts->loads, ts->evictions, ts->outstanding);
+        textDrawSlot(f->font, f, HUD_TEXTURES, str, (Vector2) { 10, 350 }, 18, 1, YELLOW);
+    }
+
+    spriteDraw(f->sprites_hud, spriteAnimFrame(f->scarfy, 6, f->anim_fps, f->time),
+            (Vector3) { GetScreenWidth() - 48, 48, 0 }, (Vector2) { 64, 64 }, 0, WHITE);
+    spriteBatchFlush(f->sprites_hud);
 
-    return target;
+    int fps = GetFPS();
+    stbsp_sprintf(str, "%d FPS", fps);
+    textDrawSlot(f->font, f, HUD_FPS, str, (Vector2) { 10, 10 }, 20, 1, fps < 15 ? RED : fps < 30 ? ORANGE : LIME);
 }
 
 int main(int argc, char *argv[])
@@ -335,15 +554,33 @@ int main(int argc, char *argv[])
     srand(time(NULL));
     c_log_init(stderr, LOG_LEVEL_SUCCESS);
 
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+        return benchMain(argc - 2, argv + 2);
+
+    /* --headless [camera path|-] [results.json] [golden], see bench.h */
+    bool headless = argc > 1 && strcmp(argv[1], "--headless") == 0;
+    struct BenchCamera *script = NULL;
+    const char *results_path = "headless.json", *golden_path = NULL;
+    if (headless) {
+        script = argc > 2 && strcmp(argv[2], "-") != 0 ? benchLoadCameraPath(argv[2]) : benchDefaultCameraPath(600);
+        if (arrlen(script) == 0) {
+            arrfree(script);
+            return EXIT_FAILURE;
+        }
+        if (argc > 3)
+            results_path = argv[3];
+        if (argc > 4)
+            golden_path = argv[4];
+        /* same cubes every run */
+        srand(1);
+        SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    }
+
     sds s = sdscatprintf(sdsempty(), "is in working? %s", "yes");
     c_log_success(LOG_TAG, s);
     sdsfree(s);
 
-    char camera_info_str[512] = { 0 };
-    char player_info_str[512] = { 0 };
-    char sun_info_str[512] = { 0 };
-
-    SetConfigFlags(FLAG_MSAA_4X_HINT);
+    /* no backbuffer msaa, the scene is anti-aliased offscreen (F9) */
     InitWindow(scr_w, scr_h, "raylib [models] example - heightmap loading and drawing");
     SetWindowState(FLAG_WINDOW_RESIZABLE);
     //DisableCursor();
@@ -364,9 +601,10 @@ int main(int argc, char *argv[])
     unit_cam.off_y = CAMERA_OFF_Y;
     unit_cam.off_z = CAMERA_OFF_Z;
 
-    Font font = LoadFont("resources/fonts/overpass-regular.otf");
 
-    Texture2D scarfy = LoadTexture("resources/images/scarfy.png");
+    SpriteAtlas atlas = { 0 };
+    int scarfy = spriteAtlasLoad(&atlas, "resources/images/scarfy.png", 6, 1);
+    spriteAtlasBuild(&atlas, true);
 
     Vector3 base_plane_pos = { 0, -50, 0};
     Mesh base_plane = GenMeshCube(100, 100, 100);
@@ -377,8 +615,12 @@ int main(int argc, char *argv[])
     printf("%f %f %f --> %f %f %f \n", base_plane_bb.min.x,base_plane_bb.min.y,base_plane_bb.min.z,
             base_plane_bb.max.x,base_plane_bb.max.y,base_plane_bb.max.z);
 
-    Texture2D tex_grass = LoadTexture("resources/images/minecraft_grass.png");
-    Texture2D tex_dirt = LoadTexture("resources/images/minecraft_dirt_pure.jpg");
+    /* every mip of these two alone is 18 MiB, they stay at 32 px until the residency view (T) previews them */
+    TextureStream textures;
+    textureStreamInit(&textures, 64u << 20, 0, true);
+    bool textures_debug = false;
+    int tex_grass = textureStreamLoad(&textures, "resources/images/minecraft_grass.png");
+    int tex_dirt = textureStreamLoad(&textures, "resources/images/minecraft_dirt_pure.jpg");
 
     iVec2 origin = { 0 };
     struct WorldChunk wc = genWorldChunk(0, 0);
@@ -386,34 +628,101 @@ int main(int argc, char *argv[])
 
     /* game stuff ends */
 
-    Shader shadowShader = LoadShader("resources/shaders/basic_shadow.vs",
-                                     "resources/shaders/basic_shadow.fs");
-    shadowShader.locs[SHADER_LOC_VECTOR_VIEW] = GetShaderLocation(shadowShader, "viewPos");
-    Vector3 lightDir = Vector3Normalize((Vector3){ 0.35f, -1.0f, -0.35f });
-    Color lightColor = WHITE;
-    Vector4 lightColorNormalized = ColorNormalize(lightColor);
-    int lightDirLoc = GetShaderLocation(shadowShader, "lightDir");
-    int lightColLoc = GetShaderLocation(shadowShader, "lightColor");
-    SetShaderValue(shadowShader, lightDirLoc, &lightDir, SHADER_UNIFORM_VEC3);
-    SetShaderValue(shadowShader, lightColLoc, &lightColorNormalized, SHADER_UNIFORM_VEC4);
-    int ambientLoc = GetShaderLocation(shadowShader, "ambient");
-    float ambient[4] = {0.1f, 0.1f, 0.1f, 1.0f};
-    SetShaderValue(shadowShader, ambientLoc, ambient, SHADER_UNIFORM_VEC4);
-    int lightVPLoc = GetShaderLocation(shadowShader, "lightVP");
-    int shadowMapLoc = GetShaderLocation(shadowShader, "shadowMap");
-    int shadowMapResolution = 1024;
-    SetShaderValue(shadowShader, GetShaderLocation(shadowShader, "shadowMapResolution"), &shadowMapResolution, SHADER_UNIFORM_INT);
-
-    RenderTexture2D shadowMap = LoadShadowmapRenderTexture(shadowMapResolution, shadowMapResolution);
-    Camera3D lightCam = (Camera3D){ 0 };
-    lightCam.position = (Vector3) { -100, 200, -100 };
-    lightCam.target = Vector3Zero();
-    lightCam.projection = CAMERA_ORTHOGRAPHIC;
-    lightCam.up = (Vector3){ 0.0f, 1.0f, 0.0f };
-    lightCam.fovy = 90.0f;
+    /* camera, light and shadow constants are shared by every program through uniform blocks */
+    uniformsInit();
+    shaderCacheInit("cache/shaders");
+    textCacheInit("cache/fonts");
+    TextFont font = textLoadFont("resources/fonts/overpass-regular.otf", 48, true);
+    debugDrawInit(font, DEBUG_DRAW_AXES | DEBUG_DRAW_BOUNDS, true);
+    SpriteBatch sprites_world, sprites_hud;
+    spriteBatchInit(&sprites_world, &atlas, true, true);
+    spriteBatchInit(&sprites_hud, &atlas, false, true);
+
+    ParticleSystem particles;
+    particlesInit(&particles, true);
+    int dust = particlesAddEmitter(&particles, (struct ParticleEmitterDesc) {
+        .shape = PARTICLE_SHAPE_BOX, .extent = { 10, 0.5f, 10 }, .rate = 1000, .life = 4, .speed = 0.3f,
+        .gravity = { 0, -0.05f, 0 }, .drag = 0.5f, .friction = 1,
+        .size = 0.06f, .color = { 200, 190, 160, 120 }, .capacity = 4096,
+    }, player_unit.position);
+    /* terminal velocity gravity / drag = 20 */
+    int rain = particlesAddEmitter(&particles, (struct ParticleEmitterDesc) {
+        .shape = PARTICLE_SHAPE_BOX, .extent = { 24, 0, 24 }, .rate = 0, .life = 3, .speed = 0.5f,
+        .gravity = { 0, -30, 0 }, .drag = 1.5f, .kill_on_hit = true,
+        .size = 0.05f, .color = { 170, 190, 255, 160 }, .capacity = 65536,
+    }, player_unit.position);
+    int puff = particlesAddEmitter(&particles, (struct ParticleEmitterDesc) {
+        .shape = PARTICLE_SHAPE_CONE, .rate = 0, .life = 1.2f, .speed = 3, .spread = 1.2f,
+        .gravity = { 0, -9.8f, 0 }, .drag = 0.5f, .bounce = 0.3f, .friction = 0.6f,
+        .size = 0.12f, .color = { 150, 120, 90, 200 }, .capacity = 2048,
+    }, player_unit.position);
+    /* png screenshots, jpg recordings since png encoding can not keep up at 60 fps */
+    Capture capture;
+    captureInit(&capture, "captures", 0);
+    Shader shadowShader = shaderCacheLoad("resources/shaders/basic_shadow.vs",
+                                          "resources/shaders/basic_shadow.fs");
+    shadowCacheSetupShader(shadowShader);
+    lightClustersSetupShader(shadowShader);
+    sunBakeSetupShader(shadowShader);
+    uniform_buffers.scene.light_dir = Vector3Normalize((Vector3){ 0.35f, -1.0f, -0.35f });
+    uniform_buffers.scene.light_color = ColorNormalize(WHITE);
+    uniform_buffers.scene.ambient = (Vector4){ 0.1f, 0.1f, 0.1f, 1.0f };
+    uniformsUploadScene();
+    /* slices from 1 to 200 units, lamps are placed within 4 chunks */
+    LightClusters light_clusters;
+    lightClustersInit(&light_clusters, 1.0f, 200.0f, true);
+    bool lights_enabled = true;
+    /* 4 x 512^2 spends the same texels as the single 1024^2 map used to */
+    int shadowCascadeCount = 4;
+    int shadowMapResolution = 512;
+
+    ShadowCache shadow_cache;
+    shadowCacheInit(&shadow_cache, (Vector3) { 100, -200, 100 },
+            shadowCascadeCount, shadowMapResolution, 256, 16.0f);
+    bool shadows_enabled = true;
+
+    /* terrain sun visibility baked on worker threads, the cascades are only rendered with it off */
+    SunBake sun_bake;
+    sunBakeInit(&sun_bake, shadow_cache.light_dir, 0, true);
+    uniform_buffers.scene.sun_bake_dir = sun_bake.sun_dir;
+    bool bake_enabled = true;
+
+    /* cubes within 1 chunk, then rings at 2x/4x/8x decimation out to 8 chunks */
+    Terrain terrain;
+    terrainInit(&terrain, shadowShader, 1, 8);
+
+    OcclusionCuller occlusion;
+    occlusionInit(&occlusion, true);
+    bool occlusion_enabled = true;
+    FILE *camera_path = NULL;
+
+    RenderQueue render_queue;
+    renderQueueInit(&render_queue);
+
+    /* hold 60 fps by dropping to half resolution per axis at worst */
+    DynamicResolution dynres;
+    dynresInit(&dynres, 1000.0f / 60.0f, 0.5f, 1.0f);
+
+    RenderGraph render_graph;
+    rgInit(&render_graph);
+    AntiAliasing aa;
+    aaInit(&aa, AA_MSAA_4X);
+    aaPrepare(&aa, dynres.target);
+    /* compare across launches, the first one after a shader or driver change compiles */
+    c_log_info(LOG_TAG, "shaders: %.1f ms, %d from cache, %d compiled, %d rejected",
+            shader_cache.load_ms, shader_cache.hits, shader_cache.misses, shader_cache.rejected);
+    int res_scene = rgResource(&render_graph, "scene", &aa.draw_target);
+    int res_cascades = rgResource(&render_graph, "shadow_cascades", NULL);
+    int res_dynamic = rgResource(&render_graph, "shadow_dynamic", &shadow_cache.dynamic_map);
+    int res_backbuffer = rgResource(&render_graph, "backbuffer", NULL);
+    rgSetOutput(&render_graph, res_backbuffer);
 
     Mesh m = GenMeshCube(1, 1, 1);
     Model mo = LoadModelFromMesh(m);
+    /* drawn the most of anything, every cube and the player */
+    meshOptimizeModel(&mo, "cube", true);
+    /* m's arrays went with the optimize, every cube is this box moved */
+    BoundingBox cube_mesh_bb = GetMeshBoundingBox(mo.meshes[0]);
     mo.materials[0].shader = shadowShader;
     player_unit.model = &mo;
 
@@ -432,7 +741,25 @@ int main(int argc, char *argv[])
     u64 frame_number = 0;
     int anim_frame_time = 10;
 
-    SetTargetFPS(60);
+    struct Frame frame = {
+        .shadow_cache = &shadow_cache, .terrain = &terrain, .occlusion = &occlusion,
+        .render_queue = &render_queue, .render_graph = &render_graph, .dynres = &dynres, .aa = &aa,
+        .lights = &light_clusters, .sun_bake = &sun_bake, .cube = &mo,
+        .sprites_world = &sprites_world, .sprites_hud = &sprites_hud, .scarfy = scarfy, .anim_fps = anim_frame_time,
+        .particles = &particles, .capture = &capture, .textures = &textures,
+        .tex_grass = tex_grass, .tex_dirt = tex_dirt, .dust = dust, .rain = rain, .puff = puff,
+        .shader = shadowShader, .font = font, .shadows_enabled = &shadows_enabled,
+        .occlusion_enabled = &occlusion_enabled, .lights_enabled = &lights_enabled,
+        .bake_enabled = &bake_enabled, .textures_debug = &textures_debug, .camera_path = &camera_path,
+    };
+
+    /* frames run as fast as they can, at a fixed resolution */
+    SetTargetFPS(headless ? 0 : 60);
+    struct BenchFrame *results = NULL;
+    if (headless) {
+        dynres.enabled = false;
+        benchCountDraws();
+    }
     //--------------------------------------------------------------------------------------
 
     // Main game loop
@@ -440,26 +767,112 @@ int main(int argc, char *argv[])
     {
         // Events
         //----------------------------------------------------------------------------------
+        double frame_start = time_ms();
+        double now = headless ? frame_number / 60.0 : GetTime();
+        float dt = headless ? 1 / 60.0f : GetFrameTime();
+        frame.time = now;
+        if (headless) {
+            if (arrlen(results) == arrlen(script))
+                break;
+            /* the world and terrain are built around the player, keep it in view */
+            player_unit.position = script[arrlen(results)].target;
+        }
         pollKeys();
         pollWindowEvents();
 
         unitPollInputs(&player_unit);
         unitCamPollInputs(&unit_cam);
+
+        if (IsKeyPressed(KEY_R))
+            particles.emitters[rain]->desc.rate = particles.emitters[rain]->desc.rate > 0 ? 0 : 20000;
+        if (IsKeyPressed(KEY_P))
+            captureScreenshot(&capture, CAPTURE_PNG);
+        if (IsKeyPressed(KEY_O))
+            captureRecord(&capture, capture.record_left > 0 ? 0 : 600, CAPTURE_JPG);
+        if (IsKeyPressed(KEY_T))
+            textures_debug = !textures_debug;
+        if (IsKeyPressed(KEY_F1))
+            debugDrawSetEnabled(!debug_draw.enabled);
+        for (int i = 0; i < DEBUG_DRAW_CATEGORY_COUNT; ++i) {
+            if (IsKeyPressed(KEY_ONE + i))
+                debugDrawToggle(1u << i);
+        }
+        if (IsKeyPressed(KEY_F2)) {
+            shadows_enabled = !shadows_enabled;
+            if (!shadows_enabled)
+                shadowCacheClear(&shadow_cache);
+        }
+        if (IsKeyPressed(KEY_F3)) {
+            shadowCascadeCount = shadowCascadeCount % SHADOW_MAX_CASCADES + 1;
+            shadowCacheConfigure(&shadow_cache, shadowCascadeCount, shadowMapResolution);
+        }
+        if (IsKeyPressed(KEY_F4)) {
+            shadowMapResolution = shadowMapResolution >= 2048 ? 256 : shadowMapResolution * 2;
+            shadowCacheConfigure(&shadow_cache, shadowCascadeCount, shadowMapResolution);
+        }
+        if (IsKeyPressed(KEY_F5)) {
+            /* record the camera for `--bench occlusion camera_path.txt` */
+            if (camera_path == NULL) {
+                camera_path = fopen("camera_path.txt", "w");
+            } else {
+                fclose(camera_path);
+                camera_path = NULL;
+            }
+        }
+        if (IsKeyPressed(KEY_F6))
+            occlusion_enabled = !occlusion_enabled;
+        if (IsKeyPressed(KEY_F7))
+            render_queue.sort = !render_queue.sort;
+        if (IsKeyPressed(KEY_F8))
+            dynres.enabled = !dynres.enabled;
+        if (IsKeyPressed(KEY_F9))
+            aaSetMode(&aa, (aa.mode + 1) % AA_MODE_COUNT);
+        if (IsKeyPressed(KEY_F10))
+            lights_enabled = !lights_enabled;
+        if (IsKeyPressed(KEY_F11)) {
+            bake_enabled = !bake_enabled;
+            /* the cascades were not kept up to date while baked */
+            if (!bake_enabled && shadows_enabled)
+                shadowCacheClear(&shadow_cache);
+        }
+        bool use_bake = shadows_enabled && bake_enabled;
+        if (uniform_buffers.scene.sun_bake_enabled != use_bake) {
+            uniform_buffers.scene.sun_bake_enabled = use_bake;
+            uniformsUploadScene();
+        }
         //----------------------------------------------------------------------------------
         // Update
         unitUpdate(&player_unit);
         unitUpdateThirdPersonCamera(&unit_cam);
 
-        genWorldAround(player_unit.position);
+        genWorldAround(player_unit.position, terrain.view_radius);
+        terrainUpdate(&terrain, player_unit.position, dt);
+        /* lod swaps and morphs move geometry the static cascades drew */
+        for (int i = 0; i < arrlen(terrain.changed); ++i) {
+            struct WorldMap *entry = hmgetp_null(world_map, terrain.changed[i]);
+            if (entry != NULL)
+                shadowCacheInvalidateBox(&shadow_cache, worldChunkBoundingBox(&entry->chunk));
+        }
+        if (lights_enabled)
+            placeLamps(&light_clusters, player_unit.position, 4, now);
+        else
+            lightClustersClear(&light_clusters);
+        if (bake_enabled) {
+            sunBakeUpdate(&sun_bake, player_unit.position, terrain.view_radius);
+            /* whatever the workers finished in time would differ between runs */
+            if (headless)
+                sunBakeWait(&sun_bake);
+        }
+        textureStreamUpdate(&textures);
+        if (headless)
+            textureStreamWait(&textures);
 
         iVec2 player_chunk_pos = getChunkCoords(player_unit.position);
         struct WorldChunk player_chunk = hmget(world_map, player_chunk_pos);
 
 
-        Vector3 cameraPos = unit_cam.camera.position;
-        SetShaderValue(shadowShader, shadowShader.locs[SHADER_LOC_VECTOR_VIEW], &cameraPos, SHADER_UNIFORM_VEC3);
-
         bool player_world_collision = false;
+        bool was_falling = player_unit.falling;
         for (int z = 0; z < CHUNKSIZE; ++z) {
             for (int x = 0; x < CHUNKSIZE; ++x) {
                 Vector3 pos = {
@@ -467,7 +880,7 @@ int main(int argc, char *argv[])
                     player_chunk.cubes[z][x].y,
                     player_chunk.cubes[z][x].z + player_chunk_pos.y * CHUNKSIZE,
                 };
-                BoundingBox bb = GetMeshBoundingBox(m);
+                BoundingBox bb = cube_mesh_bb;
                 bb.min = Vector3Add(bb.min, pos);
                 bb.max = Vector3Add(bb.max, pos);
                 bool coll = CollisionTestSimple(&player_unit, &bb, 1);
@@ -479,100 +892,111 @@ int main(int argc, char *argv[])
             player_unit.falling = true;
 
         unitUpdateThirdPersonCamera(&unit_cam);
+        if (headless)
+            unit_cam.camera = benchCamera(script[arrlen(results)]);
+
+        /* dust follows the player, rain falls from above, landing kicks up a puff */
+        Vector3 feet = { player_unit.position.x, player_unit.position.y - 0.5f, player_unit.position.z };
+        particlesMoveEmitter(&particles, dust, Vector3Add(feet, (Vector3) { 0, 1, 0 }));
+        particlesMoveEmitter(&particles, rain, Vector3Add(feet, (Vector3) { 0, 25, 0 }));
+        particlesMoveEmitter(&particles, puff, feet);
+        if (was_falling && !player_unit.falling)
+            particlesBurst(&particles, puff, 150);
+        particlesUpdate(&particles, unit_cam.camera, (float)GetScreenWidth() / GetScreenHeight(), dt);
+
+        /* rasterized on the worker while the shadow pass draws */
+        if (occlusion_enabled)
+            occlusionBegin(&occlusion, unit_cam.camera, (float)GetScreenWidth() / GetScreenHeight());
+        if (camera_path != NULL)
+            benchRecordCamera(camera_path, unit_cam.camera);
         //----------------------------------------------------------------------------------
         // Draw
         //----------------------------------------------------------------------------------
-        BeginDrawing();
-
-            ClearBackground(WHITE);
-
-            Matrix lightView;
-            Matrix lightProj;
-            BeginTextureMode(shadowMap);
-            ClearBackground(WHITE);
-            BeginMode3D(lightCam);
-                lightView = rlGetMatrixModelview();
-                lightProj = rlGetMatrixProjection();
-                /* world render */
-                for (int i = 0; i < 1; ++i) {
-                    for (int z = 0; z < CHUNKSIZE; ++z) {
-                        for (int x = 0; x < CHUNKSIZE; ++x) {
-                            Vector3 pos = {
-                                world_map[i].chunk.cubes[z][x].x + world_map[i].coord.x * CHUNKSIZE,
-                                world_map[i].chunk.cubes[z][x].y,
-                                world_map[i].chunk.cubes[z][x].z + world_map[i].coord.y * CHUNKSIZE,
-                            };
-                            DrawModel(mo, pos, 0.90, BROWN);
-                            //DrawCubeTexture(tex_grass, pos, 1, 1, 1, WHITE);
-                        }
-                    }
-                }
-                DrawModel(*player_unit.model, player_unit.position, 1, BLUE);
-            EndMode3D();
-            EndTextureMode();
-            Matrix lightViewProj = MatrixMultiply(lightView, lightProj);
-
-            ClearBackground(BLUE);
-
-            SetShaderValueMatrix(shadowShader, lightVPLoc, lightViewProj);
-
-            rlEnableShader(shadowShader.id);
-            int slot = 10;
-            rlActiveTextureSlot(slot);
-            rlEnableTexture(shadowMap.depth.id);
-            rlSetUniform(shadowMapLoc, &slot, SHADER_UNIFORM_INT, 1);
-
-            BeginMode3D(unit_cam.camera);
-
-                /* world render */
-                for (int i = 0; i < 1; ++i) {
-                    for (int z = CHUNKSIZE - 1; z >= 0; --z) {
-                        for (int x = 0; x < CHUNKSIZE; ++x) {
-                            Vector3 pos = {
-                                world_map[i].chunk.cubes[z][x].x + world_map[i].coord.x * CHUNKSIZE,
-                                world_map[i].chunk.cubes[z][x].y,
-                                world_map[i].chunk.cubes[z][x].z + world_map[i].coord.y * CHUNKSIZE,
-                            };
-                            DrawModel(mo, pos, 0.90, BROWN);
-                            //DrawCubeWires(pos, 1, 1, 1, WHITE);
-                            //DrawCubeTexture(tex_grass, pos, 1, 1, 1, WHITE);
-                        }
-                    }
-                }
-
-                //DrawGridPos(100, 1, (Vector3) { 0, 0.5, 0 });
-                DrawModel(*player_unit.model, player_unit.position, 1, BLUE);
-                //DrawModel(base_plane_model, base_plane_pos, 1, DARK_GRASS);
-                DrawCubeWires(player_unit.position, 1, 1, 1, GREEN);
-                DrawAxes(GetBoundingBoxModelWithPos(player_unit.model, player_unit.position).min, 2, font);
+        if (shadows_enabled)
+            shadowCacheUpdate(&shadow_cache, unit_cam.camera, (float)GetScreenWidth() / GetScreenHeight());
 
-            EndMode3D();
-
-            sprintf(camera_info_str, "camera: %.1f %.1f %.1f --> %.1f %.1f %.1f",
-                    unit_cam.camera.position.x, unit_cam.camera.position.y, unit_cam.camera.position.z,
-                    unit_cam.camera.target.x, unit_cam.camera.target.y, unit_cam.camera.target.z);
-            sprintf(player_info_str, "player: %.2f %.2f %.2f / dir: %.2f, %.2f, %.2f",
-                    player_unit.position.x, player_unit.position.y, player_unit.position.z,
-                    player_unit.direction.x, player_unit.direction.y, player_unit.direction.z);
-            sprintf(sun_info_str, "sun: %.2f %.2f %.2f",
-                    lightCam.position.x, lightCam.position.y, lightCam.position.z);
-
-            DrawTextEx(font, camera_info_str, (Vector2) { 10, 30 }, 18, 1, YELLOW);
-            DrawTextEx(font, player_info_str, (Vector2) { 10, 50 }, 18, 1, YELLOW);
-            DrawTextEx(font, sun_info_str, (Vector2) { 10, 70 }, 18, 1, YELLOW);
+        BeginDrawing();
 
-            DrawFPS(10, 10);
+            rgBeginFrame(&render_graph);
+            rgAddPass(&render_graph, (struct RenderPassDesc) {
+                .name = "shadow_cascades", .writes = RG_BIT(res_cascades),
+                .enabled = shadows_enabled && !bake_enabled, .execute = passShadowCascades,
+                .changed = passShadowCascadesChanged, .user = &frame,
+            });
+            rgAddPass(&render_graph, (struct RenderPassDesc) {
+                .name = "shadow_dynamic", .writes = RG_BIT(res_dynamic),
+                .enabled = shadows_enabled, .execute = passShadowDynamic, .user = &frame,
+            });
+            rgAddPass(&render_graph, (struct RenderPassDesc) {
+                .name = "world", .reads = RG_BIT(res_cascades) | RG_BIT(res_dynamic),
+                .writes = RG_BIT(res_scene), .clears = RG_BIT(res_scene), .clear_color = BLUE,
+                .enabled = true, .execute = passWorld, .user = &frame,
+            });
+            /* covers the whole window, so the backbuffer needs no clear */
+            rgAddPass(&render_graph, (struct RenderPassDesc) {
+                .name = "upscale", .reads = RG_BIT(res_scene), .writes = RG_BIT(res_backbuffer),
+                .enabled = true, .execute = passUpscale, .user = &frame,
+            });
+            rgAddPass(&render_graph, (struct RenderPassDesc) {
+                .name = "hud", .reads = RG_BIT(res_backbuffer), .writes = RG_BIT(res_backbuffer),
+                .enabled = !headless, .execute = passHud, .user = &frame,
+            });
+            rgExecute(&render_graph);
+            captureFrame(&capture);
+            if (headless) {
+                struct BenchFrame bf = { .cpu_ms = time_ms() - frame_start, .gpu_ms = render_graph.gpu_ms };
+                benchTakeDrawCounts(&bf.draw_calls, &bf.triangles);
+                if (golden_path != NULL)
+                    bf.checksum = benchChecksumBackbuffer();
+                arrput(results, bf);
+            }
 
+        /* work only, EndDrawing waits on vsync and the frame limiter */
+        float frame_cost = fmax(time_ms() - frame_start, render_graph.gpu_ms);
         EndDrawing();
+        textCacheEndFrame();
+        dynresUpdate(&dynres, frame_cost);
+        aaPrepare(&aa, dynres.target);
         //----------------------------------------------------------------------------------
         frame_number++;
     }
 
     // De-Initialization
     //--------------------------------------------------------------------------------------
+    if (headless) {
+        if (!benchWriteResults(results_path, results, arrlen(results)))
+            exit_code = EXIT_FAILURE;
+        if (golden_path != NULL && benchGolden(golden_path, results, arrlen(results)) != 0)
+            exit_code = EXIT_FAILURE;
+        c_log_info(LOG_TAG, "headless: %d frames written to %s", (int)arrlen(results), results_path);
+        arrfree(results);
+        arrfree(script);
+    }
     //UnloadTexture(texture);     // Unload texture
     //UnloadModel(model);         // Unload model
 
+    terrainUnload(&terrain);
+    shadowCacheUnload(&shadow_cache);
+    occlusionUnload(&occlusion);
+    renderQueueUnload(&render_queue);
+    rgUnload(&render_graph);
+    aaUnload(&aa);
+    dynresUnload(&dynres);
+    lightClustersUnload(&light_clusters);
+    sunBakeUnload(&sun_bake);
+    debugDrawUnload();
+    particlesUnload(&particles);
+    captureUnload(&capture);
+    textureStreamUnload(&textures);
+    spriteBatchUnload(&sprites_world);
+    spriteBatchUnload(&sprites_hud);
+    spriteAtlasUnload(&atlas);
+    textUnloadFont(font);
+    textCacheUnload();
+    uniformsUnload();
+    if (camera_path != NULL)
+        fclose(camera_path);
+
     CloseWindow();              // Close window and OpenGL context
     //--------------------------------------------------------------------------------------
 
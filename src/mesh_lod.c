@@ -0,0 +1,413 @@
+/*****************************************************
+Create Date:        2024-12-21
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/mesh_lod.h"
+#include "../include/obh/util.h"
+#include "../include/obh/c_log.h"
+
+/* area weighted squared distance to a sum of planes, the symmetric 4x4 as
+ * 10 terms: xx xy xz xw yy yz yw zz zw ww, then the summed area */
+struct MeshLodQuadric {
+    double v[11];
+};
+
+/* a collapse of from onto to */
+struct MeshLodCollapse {
+    int from, to;
+    float cost;
+};
+
+static void meshLodAddPlane(struct MeshLodQuadric *q, double a, double b, double c, double d, double w)
+{
+    double *v = q->v;
+    v[0] += w * a * a; v[1] += w * a * b; v[2] += w * a * c; v[3] += w * a * d;
+    v[4] += w * b * b; v[5] += w * b * c; v[6] += w * b * d;
+    v[7] += w * c * c; v[8] += w * c * d;
+    v[9] += w * d * d;
+    v[10] += w;
+}
+
+/* not divided by the area, see meshLodCost */
+static double meshLodEval(const struct MeshLodQuadric *q, const float *p)
+{
+    const double *v = q->v;
+    double x = p[0], y = p[1], z = p[2];
+    return v[0] * x * x + 2 * v[1] * x * y + 2 * v[2] * x * z + 2 * v[3] * x
+        + v[4] * y * y + 2 * v[5] * y * z + 2 * v[6] * y
+        + v[7] * z * z + 2 * v[8] * z + v[9];
+}
+
+/* mean squared distance of p to the planes of both quadrics */
+static double meshLodCost(const struct MeshLodQuadric *a, const struct MeshLodQuadric *b, const float *p)
+{
+    double w = a->v[10] + b->v[10];
+    return w > 0 ? fmax(meshLodEval(a, p) + meshLodEval(b, p), 0) / w : 0;
+}
+
+static Vector3 meshLodPos(const float *vertices, int v)
+{
+    return (Vector3) { vertices[v * 3], vertices[v * 3 + 1], vertices[v * 3 + 2] };
+}
+
+static Vector3 meshLodNormal(Vector3 a, Vector3 b, Vector3 c)
+{
+    return Vector3CrossProduct(Vector3Subtract(b, a), Vector3Subtract(c, a));
+}
+
+static int meshLodCompareCollapse(const void *a, const void *b)
+{
+    float x = ((const struct MeshLodCollapse *)a)->cost, y = ((const struct MeshLodCollapse *)b)->cost;
+    return (x > y) - (x < y);
+}
+
+/* position[v] is the first vertex at the same position as v */
+static void meshLodWeld(const float *vertices, int count, int *position)
+{
+    int size = 1;
+    while (size < count * 2)
+        size *= 2;
+    int *table = MemAlloc(size * sizeof(int));
+    memset(table, 0xff, size * sizeof(int));
+    for (int v = 0; v < count; ++v) {
+        const u8 *p = (const u8 *)(vertices + v * 3);
+        u32 h = 2166136261u;
+        for (int i = 0; i < 3 * (int)sizeof(float); ++i)
+            h = (h ^ p[i]) * 16777619u;
+        h &= size - 1;
+        while (table[h] >= 0 && memcmp(vertices + table[h] * 3, p, 3 * sizeof(float)) != 0)
+            h = (h + 1) & (size - 1);
+        if (table[h] < 0)
+            table[h] = v;
+        position[v] = table[h];
+    }
+    MemFree(table);
+}
+
+/* would moving from onto to turn any triangle around from over, dead and
+ * zero area triangles have no side to turn */
+static bool meshLodFolds(const Mesh *mesh, const int *position, const u8 *dead, const int *tris, int count, int from, int to)
+{
+    const u16 *idx = mesh->indices;
+    for (int i = 0; i < count; ++i) {
+        const u16 *t = idx + tris[i] * 3;
+        if (dead[tris[i]])
+            continue;
+        if (position[t[0]] == position[to] || position[t[1]] == position[to] || position[t[2]] == position[to])
+            continue;
+        Vector3 p[3];
+        for (int k = 0; k < 3; ++k)
+            p[k] = meshLodPos(mesh->vertices, t[k]);
+        Vector3 before = meshLodNormal(p[0], p[1], p[2]);
+        if (Vector3LengthSqr(before) == 0)
+            continue;
+        for (int k = 0; k < 3; ++k) {
+            if (t[k] == from)
+                p[k] = meshLodPos(mesh->vertices, to);
+        }
+        Vector3 after = meshLodNormal(p[0], p[1], p[2]);
+        /* more than about 75 degrees is as good as folded */
+        if (Vector3DotProduct(before, after) <= 0.25f * Vector3Length(before) * Vector3Length(after))
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Garland and Heckbert's edge collapses in passes: every candidate is
+ * costed, then the cheapest ones that share no vertex are applied, until
+ * the mesh is down to target triangles.
+ * @return the highest cost applied, a mean squared distance
+ */
+static double meshLodCollapse(Mesh *mesh, int target)
+{
+    int count = mesh->vertexCount;
+    int tri_count = mesh->triangleCount;
+    u16 *idx = mesh->indices;
+    int *position = MemAlloc(count * sizeof(int));
+    meshLodWeld(mesh->vertices, count, position);
+
+    /* a position with more than one vertex is a seam, one on an edge
+     * with one or more than two triangles a border, both stay put */
+    u8 *locked = MemAlloc(count);
+    int *wedges = MemAlloc(count * sizeof(int));
+    for (int v = 0; v < count; ++v) {
+        if (++wedges[position[v]] > 1)
+            locked[position[v]] = 1;
+    }
+    MemFree(wedges);
+    struct { u64 key; int value; } *edges = NULL;
+    for (int i = 0; i < tri_count * 3; ++i) {
+        u64 a = position[idx[i]], b = position[idx[i - i % 3 + (i + 1) % 3]];
+        u64 key = a < b ? a << 32 | b : b << 32 | a;
+        int triangles = hmget(edges, key) + 1;
+        hmput(edges, key, triangles);
+    }
+    for (int i = 0; i < hmlen(edges); ++i) {
+        if (edges[i].value != 2) {
+            locked[edges[i].key >> 32] = 1;
+            locked[edges[i].key & 0xffffffff] = 1;
+        }
+    }
+    hmfree(edges);
+
+    struct MeshLodQuadric *quadrics = MemAlloc(count * sizeof(*quadrics));
+    for (int t = 0; t < tri_count; ++t) {
+        Vector3 a = meshLodPos(mesh->vertices, idx[t * 3]);
+        Vector3 n = meshLodNormal(a, meshLodPos(mesh->vertices, idx[t * 3 + 1]), meshLodPos(mesh->vertices, idx[t * 3 + 2]));
+        float len = Vector3Length(n);
+        if (len <= 0)
+            continue;
+        n = Vector3Scale(n, 1 / len);
+        for (int k = 0; k < 3; ++k)
+            meshLodAddPlane(&quadrics[position[idx[t * 3 + k]]], n.x, n.y, n.z, -Vector3DotProduct(n, a), len * 0.5f);
+    }
+
+    BoundingBox bb = { meshLodPos(mesh->vertices, 0), meshLodPos(mesh->vertices, 0) };
+    for (int v = 1; v < count; ++v) {
+        bb.min = Vector3Min(bb.min, meshLodPos(mesh->vertices, v));
+        bb.max = Vector3Max(bb.max, meshLodPos(mesh->vertices, v));
+    }
+    float limit = MESH_LOD_MAX_ERROR * Vector3Distance(bb.min, bb.max);
+    limit *= limit;
+
+    int *offsets = MemAlloc((count + 1) * sizeof(int));
+    int *adjacency = MemAlloc(tri_count * 3 * sizeof(int));
+    struct MeshLodCollapse *collapses = MemAlloc(tri_count * 6 * sizeof(*collapses));
+    u8 *touched = MemAlloc(count);
+    u8 *dead = MemAlloc(tri_count);
+    double max_cost = 0;
+
+    while (tri_count > target) {
+        /* triangles around each vertex, for the fold test and the collapse */
+        memset(offsets, 0, (count + 1) * sizeof(int));
+        for (int i = 0; i < tri_count * 3; ++i)
+            offsets[idx[i] + 1]++;
+        for (int v = 0; v < count; ++v)
+            offsets[v + 1] += offsets[v];
+        for (int i = 0; i < tri_count * 3; ++i)
+            adjacency[offsets[idx[i]]++] = i / 3;
+        for (int v = count; v > 0; --v)
+            offsets[v] = offsets[v - 1];
+        offsets[0] = 0;
+
+        int n = 0;
+        for (int i = 0; i < tri_count * 3; ++i) {
+            int ends[2] = { idx[i], idx[i - i % 3 + (i + 1) % 3] };
+            for (int k = 0; k < 2; ++k) {
+                int from = ends[k], to = ends[1 - k];
+                if (locked[position[from]])
+                    continue;
+                collapses[n++] = (struct MeshLodCollapse) { from, to,
+                    meshLodCost(&quadrics[position[from]], &quadrics[position[to]], mesh->vertices + to * 3) };
+            }
+        }
+        qsort(collapses, n, sizeof(*collapses), meshLodCompareCollapse);
+
+        memset(touched, 0, count);
+        memset(dead, 0, tri_count);
+        int applied = 0, live = tri_count;
+        for (int c = 0; c < n && live > target; ++c) {
+            /* sorted, so nothing after it is cheaper */
+            if (collapses[c].cost > limit)
+                break;
+            int from = collapses[c].from, to = collapses[c].to;
+            if (touched[position[from]] || touched[position[to]])
+                continue;
+            const int *tris = adjacency + offsets[from];
+            int tris_count = offsets[from + 1] - offsets[from];
+            if (meshLodFolds(mesh, position, dead, tris, tris_count, from, to))
+                continue;
+
+            /* from is not on a seam, so it is the only vertex at its position */
+            for (int i = 0; i < tris_count; ++i) {
+                /* already gone to an earlier collapse of this pass */
+                if (dead[tris[i]])
+                    continue;
+                u16 *t = idx + tris[i] * 3;
+                for (int k = 0; k < 3; ++k)
+                    t[k] = t[k] == from ? to : t[k];
+                if (position[t[0]] == position[t[1]] || position[t[1]] == position[t[2]] || position[t[2]] == position[t[0]]) {
+                    dead[tris[i]] = 1;
+                    live--;
+                }
+            }
+            for (int i = 0; i < 11; ++i)
+                quadrics[position[to]].v[i] += quadrics[position[from]].v[i];
+            touched[position[from]] = touched[position[to]] = 1;
+            max_cost = fmax(max_cost, collapses[c].cost);
+            applied++;
+        }
+        if (applied == 0)
+            break;
+
+        int kept = 0;
+        for (int t = 0; t < tri_count; ++t) {
+            if (!dead[t])
+                memmove(idx + kept++ * 3, idx + t * 3, 3 * sizeof(u16));
+        }
+        tri_count = kept;
+    }
+    mesh->triangleCount = tri_count;
+
+    MemFree(position);
+    MemFree(locked);
+    MemFree(quadrics);
+    MemFree(offsets);
+    MemFree(adjacency);
+    MemFree(collapses);
+    MemFree(touched);
+    MemFree(dead);
+    return max_cost;
+}
+
+Mesh meshLodSimplify(const Mesh *mesh, float ratio, float *error)
+{
+    Mesh out = meshOptCopy(mesh);
+    double cost = 0;
+    /* a soup is indexed first, one that can not be is left as it is */
+    if (out.indices != NULL || meshOptimize(&out, NULL)) {
+        cost = meshLodCollapse(&out, max((int)(out.triangleCount * ratio), 1));
+        meshOptimize(&out, NULL);
+    }
+    if (error != NULL)
+        *error = sqrt(fmax(cost, 0));
+    return out;
+}
+
+static void *meshLodRun(void *arg, void *user)
+{
+    struct MeshLodJob *job = arg;
+    double start = time_ms();
+    job->result = meshLodSimplify(job->source, job->ratio, &job->error);
+    job->ms = time_ms() - start;
+    return job;
+}
+
+static void meshLodDiscard(void *arg)
+{
+    struct MeshLodJob *job = arg;
+    UnloadMesh(job->result);
+    MemFree(job);
+}
+
+void meshLodInit(MeshLodSet *set, float pixel_error, int threads, bool gpu)
+{
+    *set = (MeshLodSet) { .pixel_error = pixel_error, .gpu = gpu };
+    if (workQueueInit(&set->queue, threads, MESH_LOD_MAX_THREADS, meshLodRun, set, "mesh lod") == 0)
+        c_log_error(LOG_TAG, "no mesh lod workers, models stay at full detail");
+}
+
+void meshLodUnload(MeshLodSet *set)
+{
+    /* pending jobs have a zeroed result, UnloadMesh skips it */
+    workQueueUnload(&set->queue, meshLodDiscard);
+
+    for (int i = 0; i < arrlen(set->models); ++i) {
+        struct LodModel *lm = &set->models[i];
+        for (int l = 1; l < lm->level_count; ++l) {
+            /* meshes not built yet are zeroed, UnloadMesh skips them */
+            for (int m = 0; m < lm->levels[l].meshCount; ++m)
+                UnloadMesh(lm->levels[l].meshes[m]);
+            MemFree(lm->levels[l].meshes);
+        }
+    }
+    arrfree(set->models);
+    *set = (MeshLodSet) { 0 };
+}
+
+int meshLodAdd(MeshLodSet *set, Model model, int levels)
+{
+    BoundingBox bb = GetModelBoundingBox(model);
+    struct LodModel lm = {
+        .level_count = Clamp(levels, 1, MESH_LOD_MAX_LEVELS),
+        .center = Vector3Scale(Vector3Add(bb.min, bb.max), 0.5f),
+    };
+    lm.levels[0] = model;
+    for (int m = 0; m < model.meshCount; ++m)
+        lm.triangles[0] += model.meshes[m].triangleCount;
+
+    int id = arrlen(set->models);
+    float ratio = 1;
+    for (int l = 1; l < lm.level_count; ++l) {
+        ratio *= MESH_LOD_RATIO;
+        lm.levels[l] = model;
+        lm.levels[l].meshes = MemAlloc(model.meshCount * sizeof(Mesh));
+        lm.pending[l] = model.meshCount;
+        for (int m = 0; m < model.meshCount; ++m) {
+            struct MeshLodJob *job = MemAlloc(sizeof(*job));
+            *job = (struct MeshLodJob) { .id = id, .level = l, .mesh = m, .ratio = ratio, .source = &model.meshes[m] };
+            workQueuePush(&set->queue, job, false);
+        }
+    }
+    arrput(set->models, lm);
+    return id;
+}
+
+static void meshLodCollect(MeshLodSet *set)
+{
+    void **done = workQueueTake(&set->queue);
+    for (int i = 0; i < arrlen(done); ++i) {
+        struct MeshLodJob *job = done[i];
+        struct LodModel *lm = &set->models[job->id];
+        set->simplify_ms += job->ms;
+        set->simplified += job->source->triangleCount;
+        if (set->gpu)
+            meshOptUpload(&job->result, true);
+        lm->levels[job->level].meshes[job->mesh] = job->result;
+        lm->triangles[job->level] += job->result.triangleCount;
+        /* coarser levels start from the model, not from the level before */
+        lm->error[job->level] = fmaxf(lm->error[job->level], fmaxf(job->error, lm->error[job->level - 1]));
+        if (--lm->pending[job->level] == 0) {
+            c_log_info(LOG_TAG, "lod %d of model %d: %d of %d triangles, error %.4f", job->level, job->id,
+                    lm->triangles[job->level], lm->triangles[0], lm->error[job->level]);
+        }
+        MemFree(job);
+    }
+    arrfree(done);
+}
+
+void meshLodUpdate(MeshLodSet *set)
+{
+    meshLodCollect(set);
+    memcpy(set->drawn, set->queued, sizeof(set->drawn));
+    set->triangles = set->queued_triangles;
+    memset(set->queued, 0, sizeof(set->queued));
+    set->queued_triangles = 0;
+}
+
+void meshLodWait(MeshLodSet *set)
+{
+    workQueueWait(&set->queue);
+    meshLodCollect(set);
+}
+
+int meshLodSelect(const MeshLodSet *set, int id, float distance, float scale, float fovy, int screen_height)
+{
+    const struct LodModel *lm = &set->models[id];
+    /* pixels one model unit covers at distance */
+    float pixels = scale * screen_height / (2 * fmaxf(distance, 1e-3f) * tanf(fovy * 0.5f * DEG2RAD));
+    for (int l = lm->level_count - 1; l > 0; --l) {
+        if (lm->pending[l] == 0 && lm->error[l] * pixels <= set->pixel_error)
+            return l;
+    }
+    return 0;
+}
+
+void meshLodDraw(MeshLodSet *set, int id, Vector3 position, float yaw, float scale, Color tint, Camera3D camera)
+{
+    const struct LodModel *lm = &set->models[id];
+    Vector3 up = { 0, 1, 0 };
+    Vector3 center = Vector3Add(position,
+            Vector3Scale(Vector3RotateByAxisAngle(lm->center, up, yaw * DEG2RAD), scale));
+    int level = meshLodSelect(set, id, Vector3Distance(camera.position, center), scale, camera.fovy,
+            set->gpu ? GetScreenHeight() : 720);
+    if (set->gpu)
+        DrawModelEx(lm->levels[level], position, up, yaw, (Vector3) { scale, scale, scale }, tint);
+    set->queued[level]++;
+    set->queued_triangles += lm->triangles[level];
+}
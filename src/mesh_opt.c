@@ -0,0 +1,521 @@
+/*****************************************************
+Create Date:        2024-12-20
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/mesh_opt.h"
+#include "../include/obh/util.h"
+#include "../include/obh/c_log.h"
+#include "../include/raylib/rlgl.h"
+#include "../include/glad/glad.h"
+
+/* Forsyth's constants, vertices used by the last triangle score the same */
+#define MESH_OPT_LAST_TRIANGLE_SCORE 0.75f
+#define MESH_OPT_CACHE_DECAY 1.5f
+#define MESH_OPT_VALENCE_SCALE 2.0f
+
+/* a per vertex array of the mesh and bytes per vertex */
+struct MeshOptAttribute {
+    void **data;
+    int size;
+};
+
+static int meshOptAttributes(Mesh *mesh, struct MeshOptAttribute out[10])
+{
+    struct MeshOptAttribute all[] = {
+        { (void **)&mesh->vertices, 3 * sizeof(float) },
+        { (void **)&mesh->texcoords, 2 * sizeof(float) },
+        { (void **)&mesh->texcoords2, 2 * sizeof(float) },
+        { (void **)&mesh->normals, 3 * sizeof(float) },
+        { (void **)&mesh->tangents, 4 * sizeof(float) },
+        { (void **)&mesh->colors, 4 },
+        { (void **)&mesh->animVertices, 3 * sizeof(float) },
+        { (void **)&mesh->animNormals, 3 * sizeof(float) },
+        { (void **)&mesh->boneIds, 4 },
+        { (void **)&mesh->boneWeights, 4 * sizeof(float) },
+    };
+    int n = 0;
+    for (int i = 0; i < 10; ++i) {
+        if (*all[i].data != NULL)
+            out[n++] = all[i];
+    }
+    return n;
+}
+
+static int meshOptVertexBytes(const struct MeshOptAttribute *attrs, int n)
+{
+    int bytes = 0;
+    for (int i = 0; i < n; ++i)
+        bytes += attrs[i].size;
+    return bytes;
+}
+
+static u32 meshOptHash(const struct MeshOptAttribute *attrs, int n, int v)
+{
+    u32 h = 2166136261u;
+    for (int a = 0; a < n; ++a) {
+        const u8 *p = (const u8 *)*attrs[a].data + (size_t)v * attrs[a].size;
+        for (int i = 0; i < attrs[a].size; ++i)
+            h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+static bool meshOptSame(const struct MeshOptAttribute *attrs, int n, int a, int b)
+{
+    for (int i = 0; i < n; ++i) {
+        const u8 *data = *attrs[i].data;
+        if (memcmp(data + (size_t)a * attrs[i].size, data + (size_t)b * attrs[i].size, attrs[i].size) != 0)
+            return false;
+    }
+    return true;
+}
+
+/* remap[v] is the first vertex equal to v, numbered in order of first appearance */
+static int meshOptDedup(const struct MeshOptAttribute *attrs, int n, int count, int *remap, int *first)
+{
+    int size = 1;
+    while (size < count * 2)
+        size *= 2;
+    int *table = MemAlloc(size * sizeof(int));
+    memset(table, 0xff, size * sizeof(int));
+
+    int unique = 0;
+    for (int v = 0; v < count; ++v) {
+        u32 h = meshOptHash(attrs, n, v) & (size - 1);
+        while (table[h] >= 0 && !meshOptSame(attrs, n, table[h], v))
+            h = (h + 1) & (size - 1);
+        if (table[h] >= 0) {
+            remap[v] = remap[table[h]];
+        } else {
+            table[h] = v;
+            first[unique] = v;
+            remap[v] = unique++;
+        }
+    }
+    MemFree(table);
+    return unique;
+}
+
+float meshOptACMR(const unsigned short *indices, int index_count, int vertex_count, int cache_size)
+{
+    if (index_count < 3)
+        return 0;
+    /* a vertex is cached while fewer than cache_size misses came after its own */
+    int *stamp = MemAlloc(vertex_count * sizeof(int));
+    int misses = 0;
+    for (int i = 0; i < index_count; ++i) {
+        int v = indices[i];
+        if (stamp[v] == 0 || misses + 1 - stamp[v] > cache_size)
+            stamp[v] = ++misses;
+    }
+    MemFree(stamp);
+    return misses / (index_count / 3.0f);
+}
+
+static float meshOptVertexScore(int cache_pos, int valence)
+{
+    if (valence == 0)
+        return -1;
+    float score = 0;
+    if (cache_pos >= 0) {
+        score = cache_pos < 3 ? MESH_OPT_LAST_TRIANGLE_SCORE
+            : powf(1 - (cache_pos - 3) * (1.0f / (MESH_OPT_CACHE_SIZE - 3)), MESH_OPT_CACHE_DECAY);
+    }
+    /* vertices with few triangles left are worth finishing off */
+    return score + MESH_OPT_VALENCE_SCALE / sqrtf(valence);
+}
+
+/*
+ * Tom Forsyth, Linear-Speed Vertex Cache Optimisation: greedily emit the
+ * triangle whose vertices score best against a simulated lru cache. Only
+ * triangles around the cache are rescored, when none is left the next
+ * unemitted one in input order starts over.
+ */
+static void meshOptForsyth(u32 *indices, int index_count, int vertex_count)
+{
+    int tri_count = index_count / 3;
+    int *valence = MemAlloc(vertex_count * sizeof(int));
+    int *offsets = MemAlloc((vertex_count + 1) * sizeof(int));
+    int *adjacency = MemAlloc(index_count * sizeof(int));
+    int *cache_pos = MemAlloc(vertex_count * sizeof(int));
+    float *vertex_score = MemAlloc(vertex_count * sizeof(float));
+    float *tri_score = MemAlloc(tri_count * sizeof(float));
+    u8 *emitted = MemAlloc(tri_count);
+    u32 *out = MemAlloc(index_count * sizeof(u32));
+
+    for (int i = 0; i < index_count; ++i)
+        valence[indices[i]]++;
+    for (int v = 0; v < vertex_count; ++v)
+        offsets[v + 1] = offsets[v] + valence[v];
+    /* live triangles of v are adjacency[offsets[v] .. offsets[v] + valence[v]) */
+    memset(valence, 0, vertex_count * sizeof(int));
+    for (int i = 0; i < index_count; ++i) {
+        int v = indices[i];
+        adjacency[offsets[v] + valence[v]++] = i / 3;
+    }
+    for (int v = 0; v < vertex_count; ++v) {
+        cache_pos[v] = -1;
+        vertex_score[v] = meshOptVertexScore(-1, valence[v]);
+    }
+    int best = -1;
+    for (int t = 0; t < tri_count; ++t) {
+        tri_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+        if (best < 0 || tri_score[t] > tri_score[best])
+            best = t;
+    }
+
+    int cache[MESH_OPT_CACHE_SIZE + 3], cached = 0;
+    int next = 0;
+    for (int n = 0; n < tri_count; ++n) {
+        if (best < 0) {
+            while (emitted[next])
+                next++;
+            best = next;
+        }
+        int t = best;
+        emitted[t] = 1;
+        memcpy(out + n * 3, indices + t * 3, 3 * sizeof(u32));
+
+        /* the triangle's vertices to the front, the rest keep their order */
+        int updated[MESH_OPT_CACHE_SIZE + 3], count = 0;
+        for (int k = 0; k < 3; ++k) {
+            int v = indices[t * 3 + k];
+            int *tris = adjacency + offsets[v];
+            for (int i = 0; i < valence[v]; ++i) {
+                if (tris[i] == t) {
+                    tris[i] = tris[--valence[v]];
+                    break;
+                }
+            }
+            bool dup = false;
+            for (int i = 0; i < count; ++i)
+                dup |= updated[i] == v;
+            if (!dup)
+                updated[count++] = v;
+        }
+        for (int i = 0; i < cached; ++i) {
+            int v = cache[i];
+            if (v != (int)indices[t * 3] && v != (int)indices[t * 3 + 1] && v != (int)indices[t * 3 + 2])
+                updated[count++] = v;
+        }
+        for (int i = 0; i < count; ++i) {
+            int v = updated[i];
+            cache_pos[v] = i < MESH_OPT_CACHE_SIZE ? i : -1;
+            vertex_score[v] = meshOptVertexScore(cache_pos[v], valence[v]);
+        }
+        cached = min(count, MESH_OPT_CACHE_SIZE);
+        memcpy(cache, updated, cached * sizeof(int));
+
+        best = -1;
+        for (int i = 0; i < count; ++i) {
+            int v = updated[i];
+            for (int j = 0; j < valence[v]; ++j) {
+                int tt = adjacency[offsets[v] + j];
+                const u32 *tri = indices + tt * 3;
+                tri_score[tt] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+                if (best < 0 || tri_score[tt] > tri_score[best])
+                    best = tt;
+            }
+        }
+    }
+    memcpy(indices, out, index_count * sizeof(u32));
+
+    MemFree(valence);
+    MemFree(offsets);
+    MemFree(adjacency);
+    MemFree(cache_pos);
+    MemFree(vertex_score);
+    MemFree(tri_score);
+    MemFree(emitted);
+    MemFree(out);
+}
+
+int meshOptPackedStride(const Mesh *mesh)
+{
+    /* skinning reads the float arrays on the cpu or the bone attributes on the gpu */
+    if (mesh->vertices == NULL || mesh->boneIds != NULL || mesh->animVertices != NULL)
+        return 0;
+    int stride = 3 * sizeof(float);
+    stride += mesh->normals ? 4 * sizeof(i16) : 0;
+    stride += mesh->tangents ? 4 * sizeof(i16) : 0;
+    stride += mesh->texcoords ? 2 * sizeof(u16) : 0;
+    stride += mesh->texcoords2 ? 2 * sizeof(u16) : 0;
+    stride += mesh->colors ? 4 : 0;
+    return stride;
+}
+
+bool meshOptimize(Mesh *mesh, struct MeshOptStats *stats)
+{
+    double start = time_ms();
+    struct MeshOptAttribute attrs[10];
+    int n = meshOptAttributes(mesh, attrs);
+    int count = mesh->vertexCount, index_count = mesh->triangleCount * 3;
+    size_t vertex_bytes = meshOptVertexBytes(attrs, n);
+    float acmr = mesh->indices ? meshOptACMR(mesh->indices, index_count, count, MESH_OPT_ACMR_CACHE) : 3;
+    size_t bytes = vertex_bytes * count + (mesh->indices ? index_count * sizeof(u16) : 0);
+    /* after is before until it is done */
+    struct MeshOptStats s = {
+        .vertices_before = count, .vertices_after = count, .triangles = mesh->triangleCount,
+        .acmr_before = acmr, .acmr_after = acmr,
+        .bytes_before = bytes, .bytes_after = bytes, .bytes_packed = bytes,
+    };
+    if (stats != NULL)
+        *stats = s;
+    if (n == 0 || index_count == 0 || (mesh->indices == NULL && index_count != count))
+        return false;
+
+    u32 *indices = MemAlloc(index_count * sizeof(u32));
+    for (int i = 0; i < index_count; ++i)
+        indices[i] = mesh->indices ? mesh->indices[i] : i;
+
+    int *remap = MemAlloc(count * sizeof(int));
+    int *first = MemAlloc(count * sizeof(int));
+    int unique = meshOptDedup(attrs, n, count, remap, first);
+    if (unique > 65535) {
+        MemFree(indices);
+        MemFree(remap);
+        MemFree(first);
+        return false;
+    }
+    for (int i = 0; i < index_count; ++i)
+        indices[i] = remap[indices[i]];
+
+    meshOptForsyth(indices, index_count, unique);
+
+    /* number vertices by first use, unreferenced ones are dropped */
+    int *order = remap;
+    memset(order, 0xff, unique * sizeof(int));
+    int *source = MemAlloc(unique * sizeof(int));
+    int used = 0;
+    for (int i = 0; i < index_count; ++i) {
+        if (order[indices[i]] < 0) {
+            source[used] = first[indices[i]];
+            order[indices[i]] = used++;
+        }
+        indices[i] = order[indices[i]];
+    }
+
+    for (int a = 0; a < n; ++a) {
+        int size = attrs[a].size;
+        const u8 *old = *attrs[a].data;
+        u8 *data = MemAlloc((size_t)used * size);
+        for (int v = 0; v < used; ++v)
+            memcpy(data + (size_t)v * size, old + (size_t)source[v] * size, size);
+        MemFree(*attrs[a].data);
+        *attrs[a].data = data;
+    }
+    MemFree(mesh->indices);
+    mesh->indices = MemAlloc(index_count * sizeof(u16));
+    for (int i = 0; i < index_count; ++i)
+        mesh->indices[i] = indices[i];
+    mesh->vertexCount = used;
+
+    MemFree(indices);
+    MemFree(remap);
+    MemFree(first);
+    MemFree(source);
+
+    s.vertices_after = used;
+    s.acmr_after = meshOptACMR(mesh->indices, index_count, used, MESH_OPT_ACMR_CACHE);
+    s.bytes_after = vertex_bytes * used + index_count * sizeof(u16);
+    int stride = meshOptPackedStride(mesh);
+    s.bytes_packed = stride > 0 ? (size_t)stride * used + index_count * sizeof(u16) : s.bytes_after;
+    s.ms = time_ms() - start;
+    if (stats != NULL)
+        *stats = s;
+    return true;
+}
+
+Mesh meshOptCopy(const Mesh *mesh)
+{
+    Mesh copy = *mesh;
+    copy.vaoId = 0;
+    copy.vboId = NULL;
+    /* the table points at copy's fields, which still point at mesh's arrays */
+    struct MeshOptAttribute attrs[10];
+    int n = meshOptAttributes(&copy, attrs);
+    for (int a = 0; a < n; ++a) {
+        size_t size = (size_t)attrs[a].size * mesh->vertexCount;
+        void *data = MemAlloc(size);
+        memcpy(data, *attrs[a].data, size);
+        *attrs[a].data = data;
+    }
+    if (mesh->indices) {
+        copy.indices = MemAlloc(mesh->triangleCount * 3 * sizeof(u16));
+        memcpy(copy.indices, mesh->indices, mesh->triangleCount * 3 * sizeof(u16));
+    }
+    if (mesh->boneMatrices) {
+        copy.boneMatrices = MemAlloc(mesh->boneCount * sizeof(Matrix));
+        memcpy(copy.boneMatrices, mesh->boneMatrices, mesh->boneCount * sizeof(Matrix));
+    }
+    return copy;
+}
+
+static i16 meshOptSnorm(float v)
+{
+    return (i16)roundf(Clamp(v, -1, 1) * 32767);
+}
+
+/* texture coordinates never need the subnormals, they flush to 0 */
+static u16 meshOptHalf(float f)
+{
+    u32 x;
+    memcpy(&x, &f, sizeof(x));
+    u32 sign = (x >> 16) & 0x8000;
+    int exp = (int)((x >> 23) & 0xff) - 127 + 15;
+    if (exp <= 0)
+        return sign;
+    if (exp >= 31)
+        return sign | 0x7c00;
+    /* rounding may carry into the exponent, which is what it should do */
+    return sign | (((u32)exp << 10) + (((x & 0x7fffff) + 0x1000) >> 13));
+}
+
+static bool meshOptUnitRange(const float *uv, int count)
+{
+    for (int i = 0; i < count * 2; ++i) {
+        if (uv[i] < 0 || uv[i] > 1)
+            return false;
+    }
+    return true;
+}
+
+/* uvs in 0..1 as unorm, anything else as half floats */
+static void meshOptPackUV(u8 *dst, const float *uv, bool unorm)
+{
+    u16 packed[2];
+    for (int i = 0; i < 2; ++i)
+        packed[i] = unorm ? (u16)roundf(uv[i] * 65535) : meshOptHalf(uv[i]);
+    memcpy(dst, packed, sizeof(packed));
+}
+
+static void meshOptUnloadGpu(Mesh *mesh)
+{
+    if (mesh->vaoId == 0)
+        return;
+    rlUnloadVertexArray(mesh->vaoId);
+    for (int i = 0; mesh->vboId != NULL && i < MAX_MESH_VERTEX_BUFFERS; ++i)
+        rlUnloadVertexBuffer(mesh->vboId[i]);
+    MemFree(mesh->vboId);
+    mesh->vboId = NULL;
+    mesh->vaoId = 0;
+}
+
+size_t meshOptUpload(Mesh *mesh, bool pack)
+{
+    meshOptUnloadGpu(mesh);
+    size_t index_bytes = mesh->indices ? mesh->triangleCount * 3 * sizeof(u16) : 0;
+    int stride = pack ? meshOptPackedStride(mesh) : 0;
+    if (stride == 0) {
+        UploadMesh(mesh, false);
+        struct MeshOptAttribute attrs[10];
+        return (size_t)meshOptVertexBytes(attrs, meshOptAttributes(mesh, attrs)) * mesh->vertexCount + index_bytes;
+    }
+
+    bool uv_unorm = mesh->texcoords && meshOptUnitRange(mesh->texcoords, mesh->vertexCount);
+    bool uv2_unorm = mesh->texcoords2 && meshOptUnitRange(mesh->texcoords2, mesh->vertexCount);
+    size_t size = (size_t)stride * mesh->vertexCount;
+    u8 *data = MemAlloc(size);
+    for (int v = 0; v < mesh->vertexCount; ++v) {
+        u8 *dst = data + (size_t)v * stride;
+        memcpy(dst, mesh->vertices + v * 3, 3 * sizeof(float));
+        dst += 3 * sizeof(float);
+        if (mesh->normals) {
+            i16 n[4] = { meshOptSnorm(mesh->normals[v * 3]), meshOptSnorm(mesh->normals[v * 3 + 1]),
+                meshOptSnorm(mesh->normals[v * 3 + 2]), 0 };
+            memcpy(dst, n, sizeof(n));
+            dst += sizeof(n);
+        }
+        if (mesh->tangents) {
+            i16 t[4];
+            for (int i = 0; i < 4; ++i)
+                t[i] = meshOptSnorm(mesh->tangents[v * 4 + i]);
+            memcpy(dst, t, sizeof(t));
+            dst += sizeof(t);
+        }
+        if (mesh->texcoords) {
+            meshOptPackUV(dst, mesh->texcoords + v * 2, uv_unorm);
+            dst += 2 * sizeof(u16);
+        }
+        if (mesh->texcoords2) {
+            meshOptPackUV(dst, mesh->texcoords2 + v * 2, uv2_unorm);
+            dst += 2 * sizeof(u16);
+        }
+        if (mesh->colors)
+            memcpy(dst, mesh->colors + v * 4, 4);
+    }
+
+    /* ids where UnloadMesh looks for them */
+    mesh->vboId = MemAlloc(MAX_MESH_VERTEX_BUFFERS * sizeof(unsigned int));
+    glGenVertexArrays(1, &mesh->vaoId);
+    glBindVertexArray(mesh->vaoId);
+    glGenBuffers(1, &mesh->vboId[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vboId[0]);
+    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+    MemFree(data);
+
+    size_t offset = 0;
+    glEnableVertexAttribArray(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+    glVertexAttribPointer(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 3, GL_FLOAT, GL_FALSE, stride, (void *)offset);
+    offset += 3 * sizeof(float);
+    if (mesh->normals) {
+        glEnableVertexAttribArray(RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL);
+        glVertexAttribPointer(RL_DEFAULT_SHADER_ATTRIB_LOCATION_NORMAL, 3, GL_SHORT, GL_TRUE, stride, (void *)offset);
+        offset += 4 * sizeof(i16);
+    }
+    if (mesh->tangents) {
+        glEnableVertexAttribArray(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TANGENT);
+        glVertexAttribPointer(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TANGENT, 4, GL_SHORT, GL_TRUE, stride, (void *)offset);
+        offset += 4 * sizeof(i16);
+    }
+    if (mesh->texcoords) {
+        glEnableVertexAttribArray(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD);
+        glVertexAttribPointer(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD, 2,
+                uv_unorm ? GL_UNSIGNED_SHORT : GL_HALF_FLOAT, uv_unorm, stride, (void *)offset);
+        offset += 2 * sizeof(u16);
+    }
+    if (mesh->texcoords2) {
+        glEnableVertexAttribArray(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD2);
+        glVertexAttribPointer(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD2, 2,
+                uv2_unorm ? GL_UNSIGNED_SHORT : GL_HALF_FLOAT, uv2_unorm, stride, (void *)offset);
+        offset += 2 * sizeof(u16);
+    }
+    if (mesh->colors) {
+        glEnableVertexAttribArray(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR);
+        glVertexAttribPointer(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)offset);
+    } else {
+        /* as UploadMesh leaves it, white for shaders that multiply by it */
+        float white[4] = { 1, 1, 1, 1 };
+        rlSetVertexAttributeDefault(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, white, SHADER_ATTRIB_VEC4, 4);
+    }
+
+    if (mesh->indices) {
+        glGenBuffers(1, &mesh->vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->vboId[RL_DEFAULT_SHADER_ATTRIB_LOCATION_INDICES]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bytes, mesh->indices, GL_STATIC_DRAW);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    return size + index_bytes;
+}
+
+void meshOptimizeModel(Model *model, const char *name, bool pack)
+{
+    for (int m = 0; m < model->meshCount; ++m) {
+        Mesh *mesh = &model->meshes[m];
+        struct MeshOptStats s;
+        if (!meshOptimize(mesh, &s)) {
+            c_log_warn(LOG_TAG, "%s mesh %d: %d vertices left as they are", name, m, mesh->vertexCount);
+            continue;
+        }
+        meshOptUpload(mesh, pack);
+        c_log_info(LOG_TAG, "%s mesh %d: %d -> %d vertices, acmr %.2f -> %.2f, %zu -> %zu bytes, %.1f ms",
+                name, m, s.vertices_before, s.vertices_after, s.acmr_before, s.acmr_after,
+                s.bytes_before, pack ? s.bytes_packed : s.bytes_after, s.ms);
+    }
+}
@@ -0,0 +1,421 @@
+/*****************************************************
+Create Date:        2024-12-04
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/occlusion.h"
+#include "../include/obh/simd.h"
+#include "../include/obh/util.h"
+#include "../include/raylib/rlgl.h"
+
+/* cubes are drawn at 0.9 scale, keep occluders under the visible tops */
+#define OCCLUSION_BLOCK_TOP 0.45f
+
+struct OccluderCandidate {
+    float dist;
+    iVec2 coord;
+};
+
+static void *occlusionWorker(void *arg);
+
+void occlusionInit(OcclusionCuller *oc, bool threaded)
+{
+    *oc = (OcclusionCuller) { 0 };
+    oc->max_occluders = 48;
+
+    for (int i = 0; i < OCCLUSION_LEVELS; ++i) {
+        oc->level_w[i] = OCCLUSION_WIDTH >> i;
+        oc->level_h[i] = OCCLUSION_HEIGHT >> i;
+        oc->max_levels[i] = MemAlloc(oc->level_w[i] * oc->level_h[i] * sizeof(float));
+        oc->min_levels[i] = i == 0
+            ? oc->max_levels[0]
+            : MemAlloc(oc->level_w[i] * oc->level_h[i] * sizeof(float));
+    }
+    /* nothing rasterized yet, so nothing is hidden */
+    for (int i = 0; i < OCCLUSION_LEVELS; ++i) {
+        for (int t = 0; t < oc->level_w[i] * oc->level_h[i]; ++t) {
+            oc->max_levels[i][t] = 1.0f;
+            oc->min_levels[i][t] = 1.0f;
+        }
+    }
+
+    oc->threaded = threaded;
+    if (threaded) {
+        pthread_mutex_init(&oc->lock, NULL);
+        pthread_cond_init(&oc->cond, NULL);
+        if (pthread_create(&oc->thread, NULL, occlusionWorker, oc) != 0) {
+            c_log_warn(LOG_TAG, "occlusion worker could not start, culling inline");
+            oc->threaded = false;
+        }
+    }
+}
+
+void occlusionUnload(OcclusionCuller *oc)
+{
+    if (oc->threaded) {
+        pthread_mutex_lock(&oc->lock);
+        oc->quit = true;
+        pthread_cond_broadcast(&oc->cond);
+        pthread_mutex_unlock(&oc->lock);
+        pthread_join(oc->thread, NULL);
+        pthread_cond_destroy(&oc->cond);
+        pthread_mutex_destroy(&oc->lock);
+    }
+
+    for (int i = 0; i < OCCLUSION_LEVELS; ++i) {
+        MemFree(oc->max_levels[i]);
+        if (i > 0)
+            MemFree(oc->min_levels[i]);
+    }
+    hmfree(oc->occluders);
+    arrfree(oc->frame_occluders);
+    *oc = (OcclusionCuller) { 0 };
+}
+
+static void occlusionBuildOccluder(struct Occluder *occ, const struct WorldChunk *wc)
+{
+    const int s = CHUNKSIZE / OCCLUSION_GRID;
+    const int g = OCCLUSION_GRID;
+
+    int cell_min[OCCLUSION_GRID][OCCLUSION_GRID];
+    for (int cj = 0; cj < g; ++cj) {
+        for (int ci = 0; ci < g; ++ci) {
+            int h = INT_MAX;
+            for (int z = cj * s; z < (cj + 1) * s; ++z)
+                for (int x = ci * s; x < (ci + 1) * s; ++x)
+                    h = min(h, worldColumnHeight(wc, x, z));
+            cell_min[cj][ci] = h;
+        }
+    }
+
+    /* a corner takes the lowest cell around it, so every cell stays under its cubes */
+    for (int j = 0; j <= g; ++j) {
+        for (int i = 0; i <= g; ++i) {
+            int h = INT_MAX;
+            for (int cj = max(j - 1, 0); cj <= min(j, g - 1); ++cj)
+                for (int ci = max(i - 1, 0); ci <= min(i, g - 1); ++ci)
+                    h = min(h, cell_min[cj][ci]);
+            occ->heights[j * (g + 1) + i] = h + OCCLUSION_BLOCK_TOP;
+        }
+    }
+
+    occ->origin = (Vector3) { wc->coord.x * CHUNKSIZE - 0.5f, 0, wc->coord.y * CHUNKSIZE - 0.5f };
+    occ->revision = wc->revision;
+}
+
+/*
+ * x, y in depth buffer pixels (y down), z in [0, 1]
+ * @return false if the point is behind the near plane
+ */
+static bool occlusionProject(const OcclusionCuller *oc, Vector3 p, Vector3 *out)
+{
+    const Matrix m = oc->vp;
+    float x = m.m0 * p.x + m.m4 * p.y + m.m8 * p.z + m.m12;
+    float y = m.m1 * p.x + m.m5 * p.y + m.m9 * p.z + m.m13;
+    float z = m.m2 * p.x + m.m6 * p.y + m.m10 * p.z + m.m14;
+    float w = m.m3 * p.x + m.m7 * p.y + m.m11 * p.z + m.m15;
+    if (w < oc->near)
+        return false;
+
+    float inv_w = 1.0f / w;
+    out->x = (x * inv_w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+    out->y = (0.5f - y * inv_w * 0.5f) * OCCLUSION_HEIGHT;
+    out->z = z * inv_w * 0.5f + 0.5f;
+    return true;
+}
+
+static void occlusionRasterTriangle(float *depth, Vector3 v0, Vector3 v1, Vector3 v2)
+{
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (fabsf(area) < 1e-6f)
+        return;
+    /* occluders are two sided, flip into one winding */
+    if (area < 0) {
+        Vector3 t = v1;
+        v1 = v2;
+        v2 = t;
+        area = -area;
+    }
+
+    int min_x = max((int)floorf(fminf(v0.x, fminf(v1.x, v2.x))), 0) & ~3;
+    int max_x = min((int)ceilf(fmaxf(v0.x, fmaxf(v1.x, v2.x))), OCCLUSION_WIDTH - 1);
+    int min_y = max((int)floorf(fminf(v0.y, fminf(v1.y, v2.y))), 0);
+    int max_y = min((int)ceilf(fmaxf(v0.y, fmaxf(v1.y, v2.y))), OCCLUSION_HEIGHT - 1);
+    if (min_x > max_x || min_y > max_y)
+        return;
+
+    /* edge k is opposite vertex k: E(p) = a * px + b * py + c */
+    const Vector3 *v[3] = { &v0, &v1, &v2 };
+    float a[3], b[3], c[3];
+    for (int k = 0; k < 3; ++k) {
+        const Vector3 *p = v[(k + 1) % 3], *q = v[(k + 2) % 3];
+        a[k] = -(q->y - p->y);
+        b[k] = q->x - p->x;
+        c[k] = (q->y - p->y) * p->x - (q->x - p->x) * p->y;
+    }
+    float inv_area = 1.0f / area;
+    float za = (a[0] * v0.z + a[1] * v1.z + a[2] * v2.z) * inv_area;
+    float zb = (b[0] * v0.z + b[1] * v1.z + b[2] * v2.z) * inv_area;
+    float zc = (c[0] * v0.z + c[1] * v1.z + c[2] * v2.z) * inv_area;
+
+    const v4f lane = { 0.5f, 1.5f, 2.5f, 3.5f };
+    const v4f zero = V4F(0.0f);
+    for (int y = min_y; y <= max_y; ++y) {
+        float py = y + 0.5f;
+        v4f row0 = V4F(b[0] * py + c[0]), row1 = V4F(b[1] * py + c[1]), row2 = V4F(b[2] * py + c[2]);
+        v4f rowz = V4F(zb * py + zc);
+        float *dst = &depth[y * OCCLUSION_WIDTH];
+        for (int x = min_x; x <= max_x; x += 4) {
+            v4f px = V4F((float)x) + lane;
+            v4i inside = (V4F(a[0]) * px + row0 >= zero)
+                & (V4F(a[1]) * px + row1 >= zero)
+                & (V4F(a[2]) * px + row2 >= zero);
+            if (!v4i_any(inside))
+                continue;
+            v4f z = V4F(za) * px + rowz;
+            v4f d = v4f_load(&dst[x]);
+            v4f_store(&dst[x], v4f_select(inside & (z < d), z, d));
+        }
+    }
+}
+
+static void occlusionBuildPyramid(OcclusionCuller *oc)
+{
+    for (int l = 1; l < OCCLUSION_LEVELS; ++l) {
+        int w = oc->level_w[l], h = oc->level_h[l], src_w = oc->level_w[l - 1];
+        const float *src_max = oc->max_levels[l - 1], *src_min = oc->min_levels[l - 1];
+        float *dst_max = oc->max_levels[l], *dst_min = oc->min_levels[l];
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                int s = (2 * y) * src_w + 2 * x;
+                dst_max[y * w + x] = fmaxf(fmaxf(src_max[s], src_max[s + 1]),
+                        fmaxf(src_max[s + src_w], src_max[s + src_w + 1]));
+                dst_min[y * w + x] = fminf(fminf(src_min[s], src_min[s + 1]),
+                        fminf(src_min[s + src_w], src_min[s + src_w + 1]));
+            }
+        }
+    }
+}
+
+static void occlusionRun(OcclusionCuller *oc)
+{
+    double start = time_ms();
+    const int g = OCCLUSION_GRID;
+    const float s = CHUNKSIZE / (float)OCCLUSION_GRID;
+
+    float *depth = oc->max_levels[0];
+    for (int i = 0; i < OCCLUSION_WIDTH * OCCLUSION_HEIGHT; i += 4)
+        v4f_store(&depth[i], V4F(1.0f));
+
+    u64 triangles = 0;
+    Vector3 screen[(OCCLUSION_GRID + 1) * (OCCLUSION_GRID + 1)];
+    bool in_front[(OCCLUSION_GRID + 1) * (OCCLUSION_GRID + 1)];
+    for (int o = 0; o < arrlen(oc->frame_occluders); ++o) {
+        const struct Occluder *occ = oc->frame_occluders[o];
+        for (int j = 0; j <= g; ++j) {
+            for (int i = 0; i <= g; ++i) {
+                int v = j * (g + 1) + i;
+                Vector3 p = { occ->origin.x + i * s, occ->heights[v], occ->origin.z + j * s };
+                in_front[v] = occlusionProject(oc, p, &screen[v]);
+            }
+        }
+
+        for (int j = 0; j < g; ++j) {
+            for (int i = 0; i < g; ++i) {
+                int v00 = j * (g + 1) + i, v10 = v00 + 1;
+                int v01 = v00 + g + 1, v11 = v01 + 1;
+                /* dropping an occluder is always safe, clipping it is not needed */
+                if (!(in_front[v00] && in_front[v10] && in_front[v01] && in_front[v11]))
+                    continue;
+                occlusionRasterTriangle(depth, screen[v00], screen[v01], screen[v10]);
+                occlusionRasterTriangle(depth, screen[v10], screen[v01], screen[v11]);
+                triangles += 2;
+            }
+        }
+    }
+
+    occlusionBuildPyramid(oc);
+
+    oc->triangles = triangles;
+    oc->raster_ms = time_ms() - start;
+}
+
+static void *occlusionWorker(void *arg)
+{
+    OcclusionCuller *oc = arg;
+
+    pthread_mutex_lock(&oc->lock);
+    while (true) {
+        while (!oc->job_pending && !oc->quit)
+            pthread_cond_wait(&oc->cond, &oc->lock);
+        if (oc->quit)
+            break;
+        oc->job_pending = false;
+        oc->job_running = true;
+        pthread_mutex_unlock(&oc->lock);
+
+        occlusionRun(oc);
+
+        pthread_mutex_lock(&oc->lock);
+        oc->job_running = false;
+        pthread_cond_broadcast(&oc->cond);
+    }
+    pthread_mutex_unlock(&oc->lock);
+
+    return NULL;
+}
+
+static int occlusionCandidateCmp(const void *a, const void *b)
+{
+    float da = ((const struct OccluderCandidate *)a)->dist;
+    float db = ((const struct OccluderCandidate *)b)->dist;
+    return (da > db) - (da < db);
+}
+
+void occlusionBegin(OcclusionCuller *oc, Camera3D camera, float aspect)
+{
+    /* occluders and matrices are shared with the worker */
+    occlusionWait(oc);
+
+    oc->tested = oc->occluded = oc->off_screen = 0;
+    oc->frame++;
+
+    /* chunks streamed out or long behind the camera */
+    for (int i = hmlen(oc->occluders) - 1; i >= 0; --i) {
+        struct OccluderMap *entry = &oc->occluders[i];
+        if (oc->frame - entry->value.last_frame < OCCLUSION_EVICT_FRAMES)
+            continue;
+        (void)hmdel(oc->occluders, entry->key);
+    }
+
+    oc->near = rlGetCullDistanceNear();
+    Matrix view = MatrixLookAt(camera.position, camera.target, camera.up);
+    Matrix proj = MatrixPerspective(camera.fovy * DEG2RAD, aspect,
+            rlGetCullDistanceNear(), rlGetCullDistanceFar());
+    oc->vp = MatrixMultiply(view, proj);
+
+    /* nearest chunks in front of the camera hide the most */
+    Vector3 forward = Vector3Normalize(Vector3Subtract(camera.target, camera.position));
+    struct OccluderCandidate *candidates = NULL;
+    for (int i = 0; i < hmlen(world_map); ++i) {
+        const struct WorldChunk *wc = &world_map[i].chunk;
+        Vector3 center = {
+            (wc->coord.x + 0.5f) * CHUNKSIZE, (wc->y_min + wc->y_max) * 0.5f, (wc->coord.y + 0.5f) * CHUNKSIZE
+        };
+        Vector3 to_chunk = Vector3Subtract(center, camera.position);
+        if (Vector3DotProduct(to_chunk, forward) < -CHUNKSIZE)
+            continue;
+        arrput(candidates, ((struct OccluderCandidate) { Vector3Length(to_chunk), wc->coord }));
+    }
+    qsort(candidates, arrlen(candidates), sizeof(*candidates), occlusionCandidateCmp);
+    int count = min((int)arrlen(candidates), oc->max_occluders);
+
+    /* build everything first, hmput may move the entries */
+    for (int i = 0; i < count; ++i) {
+        const struct WorldChunk *wc = &hmgetp(world_map, candidates[i].coord)->chunk;
+        struct OccluderMap *entry = hmgetp_null(oc->occluders, candidates[i].coord);
+        if (entry != NULL && entry->value.revision == wc->revision)
+            continue;
+        struct Occluder occ;
+        occlusionBuildOccluder(&occ, wc);
+        hmput(oc->occluders, candidates[i].coord, occ);
+    }
+    arrsetlen(oc->frame_occluders, 0);
+    for (int i = 0; i < count; ++i) {
+        struct Occluder *occ = &hmgetp(oc->occluders, candidates[i].coord)->value;
+        occ->last_frame = oc->frame;
+        arrput(oc->frame_occluders, occ);
+    }
+    arrfree(candidates);
+
+    if (!oc->threaded) {
+        occlusionRun(oc);
+        return;
+    }
+
+    pthread_mutex_lock(&oc->lock);
+    oc->job_pending = true;
+    pthread_cond_broadcast(&oc->cond);
+    pthread_mutex_unlock(&oc->lock);
+}
+
+void occlusionWait(OcclusionCuller *oc)
+{
+    if (!oc->threaded)
+        return;
+
+    pthread_mutex_lock(&oc->lock);
+    while (oc->job_pending || oc->job_running)
+        pthread_cond_wait(&oc->cond, &oc->lock);
+    pthread_mutex_unlock(&oc->lock);
+}
+
+bool occlusionTestBox(OcclusionCuller *oc, BoundingBox box)
+{
+    oc->tested++;
+
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    float near_z = INFINITY;
+    int behind = 0;
+    for (int i = 0; i < 8; ++i) {
+        Vector3 corner = {
+            (i & 1) ? box.max.x : box.min.x,
+            (i & 2) ? box.max.y : box.min.y,
+            (i & 4) ? box.max.z : box.min.z,
+        };
+        Vector3 p;
+        if (!occlusionProject(oc, corner, &p)) {
+            behind++;
+            continue;
+        }
+        min_x = fminf(min_x, p.x);
+        max_x = fmaxf(max_x, p.x);
+        min_y = fminf(min_y, p.y);
+        max_y = fmaxf(max_y, p.y);
+        near_z = fminf(near_z, p.z);
+    }
+
+    if (behind == 8) {
+        oc->off_screen++;
+        return false;
+    }
+    /* straddles the near plane, too close to say anything */
+    if (behind > 0)
+        return true;
+
+    if (max_x < 0 || min_x >= OCCLUSION_WIDTH || max_y < 0 || min_y >= OCCLUSION_HEIGHT || near_z > 1.0f) {
+        oc->off_screen++;
+        return false;
+    }
+
+    int x0 = max((int)min_x, 0), x1 = min((int)max_x, OCCLUSION_WIDTH - 1);
+    int y0 = max((int)min_y, 0), y1 = min((int)max_y, OCCLUSION_HEIGHT - 1);
+
+    /* coarsest level where the box spans at most 2 texels per side */
+    int level = 0;
+    while (level < OCCLUSION_LEVELS - 1 && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+        level++;
+
+    /* nearest point in front of every occluder under the box, it must show */
+    float region_min = INFINITY;
+    float region_max = -INFINITY;
+    int w = oc->level_w[level];
+    for (int ty = y0 >> level; ty <= y1 >> level; ++ty) {
+        for (int tx = x0 >> level; tx <= x1 >> level; ++tx) {
+            region_min = fminf(region_min, oc->min_levels[level][ty * w + tx]);
+            region_max = fmaxf(region_max, oc->max_levels[level][ty * w + tx]);
+        }
+    }
+    if (near_z <= region_min)
+        return true;
+
+    if (near_z > region_max) {
+        oc->occluded++;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,314 @@
+/*****************************************************
+Create Date:        2024-12-15
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/particles.h"
+#include "../include/obh/simd.h"
+#include "../include/obh/util.h"
+#include "../include/obh/cull.h"
+#include "../include/obh/shader_cache.h"
+#include "../include/raylib/rlgl.h"
+#include "../include/glad/glad.h"
+
+/* arrays in data, the first four go to the gpu */
+enum { PARTICLE_X, PARTICLE_Y, PARTICLE_Z, PARTICLE_LIFE, PARTICLE_VX, PARTICLE_VY, PARTICLE_VZ, PARTICLE_ARRAYS };
+
+/* ground where no chunk has been generated, low enough to never be hit */
+#define PARTICLES_NO_GROUND -1000.0f
+
+void particlesInit(ParticleSystem *ps, bool gpu)
+{
+    *ps = (ParticleSystem) { .gpu = gpu };
+    if (!gpu)
+        return;
+    ps->shader = shaderCacheLoad("resources/shaders/particle.vs", "resources/shaders/particle.fs");
+    ps->view_loc = GetShaderLocation(ps->shader, "view");
+    ps->projection_loc = GetShaderLocation(ps->shader, "projection");
+    ps->color_loc = GetShaderLocation(ps->shader, "colDiffuse");
+    ps->size_loc = GetShaderLocation(ps->shader, "size");
+    ps->fade_loc = GetShaderLocation(ps->shader, "fade");
+}
+
+void particlesUnload(ParticleSystem *ps)
+{
+    for (int i = 0; i < ps->emitter_count; ++i) {
+        struct ParticleEmitter *e = ps->emitters[i];
+        if (ps->gpu) {
+            glDeleteBuffers(1, &e->vbo);
+            glDeleteVertexArrays(1, &e->vao);
+        }
+        free(e->data);
+        free(e);
+    }
+    if (ps->gpu)
+        UnloadShader(ps->shader);
+    *ps = (ParticleSystem) { 0 };
+}
+
+static float particlesRandom(struct ParticleEmitter *e)
+{
+    /* xorshift32 */
+    e->rng ^= e->rng << 13;
+    e->rng ^= e->rng >> 17;
+    e->rng ^= e->rng << 5;
+    return (e->rng >> 8) * (1.0f / 16777216.0f);
+}
+
+/* snapshot ground heights around the emitter, the simulation reads only these */
+static void particlesSnapshotGround(struct ParticleEmitter *e)
+{
+    e->field_origin = (Vector2) {
+        floorf(e->origin.x + 0.5f) - PARTICLES_FIELD / 2, floorf(e->origin.z + 0.5f) - PARTICLES_FIELD / 2
+    };
+    e->field_revision = world_revision;
+
+    const struct WorldChunk *wc = NULL;
+    iVec2 wc_coord = { INT_MIN, INT_MIN };
+    for (int j = 0; j < PARTICLES_FIELD; ++j) {
+        for (int i = 0; i < PARTICLES_FIELD; ++i) {
+            int x = (int)e->field_origin.x + i, z = (int)e->field_origin.y + j;
+            iVec2 coord = getChunkCoords((Vector3) { x, 0, z });
+            if (coord.x != wc_coord.x || coord.y != wc_coord.y) {
+                struct WorldMap *entry = hmgetp_null(world_map, coord);
+                wc = entry ? &entry->chunk : NULL;
+                wc_coord = coord;
+            }
+            /* cubes are unit sized and centred on their column */
+            e->field[j * PARTICLES_FIELD + i] = wc
+                ? worldColumnHeight(wc, x - coord.x * CHUNKSIZE, z - coord.y * CHUNKSIZE) + 0.5f
+                : PARTICLES_NO_GROUND;
+        }
+    }
+}
+
+int particlesAddEmitter(ParticleSystem *ps, struct ParticleEmitterDesc desc, Vector3 origin)
+{
+    if (ps->emitter_count == PARTICLES_MAX_EMITTERS)
+        return -1;
+
+    struct ParticleEmitter *e = calloc(1, sizeof(*e));
+    e->desc = desc;
+    e->origin = origin;
+    /* multiple of 16 keeps every array 64 byte aligned */
+    e->capacity = (max(desc.capacity, 1) + 15) & ~15;
+    e->data = aligned_alloc(64, (size_t)e->capacity * PARTICLE_ARRAYS * sizeof(float));
+    float **arrays[PARTICLE_ARRAYS] = { &e->x, &e->y, &e->z, &e->life, &e->vx, &e->vy, &e->vz };
+    for (int a = 0; a < PARTICLE_ARRAYS; ++a)
+        *arrays[a] = e->data + (size_t)a * e->capacity;
+    /* dead and parked at the origin, so they do not stretch the bounds */
+    for (int i = 0; i < e->capacity; ++i) {
+        e->x[i] = origin.x;
+        e->y[i] = origin.y;
+        e->z[i] = origin.z;
+        e->life[i] = 0;
+        e->vx[i] = e->vy[i] = e->vz[i] = 0;
+    }
+    e->rng = 0x9e3779b9u * (ps->emitter_count + 1);
+    particlesSnapshotGround(e);
+
+    if (ps->gpu) {
+        glGenVertexArrays(1, &e->vao);
+        glGenBuffers(1, &e->vbo);
+        glBindVertexArray(e->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, e->vbo);
+        glBufferData(GL_ARRAY_BUFFER, (size_t)e->capacity * 4 * sizeof(float), NULL, GL_STREAM_DRAW);
+        /* one instance per slot, each attribute reads its own array */
+        static const char *names[4] = { "particleX", "particleY", "particleZ", "particleLife" };
+        for (int a = 0; a < 4; ++a) {
+            int loc = glGetAttribLocation(ps->shader.id, names[a]);
+            if (loc < 0)
+                continue;
+            glEnableVertexAttribArray(loc);
+            glVertexAttribPointer(loc, 1, GL_FLOAT, GL_FALSE, sizeof(float),
+                    (void *)((size_t)a * e->capacity * sizeof(float)));
+            glVertexAttribDivisor(loc, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ps->emitters[ps->emitter_count] = e;
+    return ps->emitter_count++;
+}
+
+void particlesMoveEmitter(ParticleSystem *ps, int emitter, Vector3 origin)
+{
+    ps->emitters[emitter]->origin = origin;
+}
+
+static void particlesSpawn(struct ParticleEmitter *e, int count)
+{
+    const struct ParticleEmitterDesc *d = &e->desc;
+    count = min(count, e->capacity);
+    for (int n = 0; n < count; ++n) {
+        int i = e->cursor;
+        e->cursor = (e->cursor + 1) % e->capacity;
+
+        Vector3 p = e->origin, v;
+        if (d->shape == PARTICLE_SHAPE_BOX) {
+            p.x += (particlesRandom(e) * 2 - 1) * d->extent.x;
+            p.y += (particlesRandom(e) * 2 - 1) * d->extent.y;
+            p.z += (particlesRandom(e) * 2 - 1) * d->extent.z;
+            /* random direction and a random share of speed */
+            float cy = particlesRandom(e) * 2 - 1, a = particlesRandom(e) * 2 * PI;
+            float r = sqrtf(1 - cy * cy), s = particlesRandom(e);
+            v = (Vector3) { cosf(a) * r * s, cy * s, sinf(a) * r * s };
+        } else {
+            float cy = cosf(d->spread * particlesRandom(e)), a = particlesRandom(e) * 2 * PI;
+            float r = sqrtf(1 - cy * cy);
+            v = (Vector3) { cosf(a) * r, cy, sinf(a) * r };
+        }
+        e->x[i] = p.x;
+        e->y[i] = p.y;
+        e->z[i] = p.z;
+        e->vx[i] = v.x * d->speed;
+        e->vy[i] = v.y * d->speed;
+        e->vz[i] = v.z * d->speed;
+        /* spread deaths out a little */
+        e->life[i] = d->life * (0.75f + 0.25f * particlesRandom(e));
+    }
+}
+
+void particlesBurst(ParticleSystem *ps, int emitter, int count)
+{
+    particlesSpawn(ps->emitters[emitter], count);
+}
+
+/*
+ * 4 particles per step, no branches: ground hits are masks that pick
+ * between the bounced and the free values.
+ */
+static void particlesSimulate(struct ParticleEmitter *e, float dt)
+{
+    const struct ParticleEmitterDesc *d = &e->desc;
+    const v4f vdt = V4F(dt);
+    const v4f gx = V4F(d->gravity.x * dt), gy = V4F(d->gravity.y * dt), gz = V4F(d->gravity.z * dt);
+    const v4f damp = V4F(fmaxf(1 - d->drag * dt, 0));
+    const v4f bounce = V4F(-d->bounce), friction = V4F(d->friction);
+    const v4i kill = V4I(d->kill_on_hit ? -1 : 0);
+    /* + 0.5 so truncating picks the column a position is centred on */
+    const v4f fx = V4F(0.5f - e->field_origin.x), fz = V4F(0.5f - e->field_origin.y);
+    const v4f field_lo = V4F(0), field_hi = V4F(PARTICLES_FIELD - 1);
+    const v4i field_w = V4I(PARTICLES_FIELD);
+
+    for (int i = 0; i < e->capacity; i += 4) {
+        v4f x = v4f_load(e->x + i), y = v4f_load(e->y + i), z = v4f_load(e->z + i);
+        v4f vx = v4f_load(e->vx + i), vy = v4f_load(e->vy + i), vz = v4f_load(e->vz + i);
+        v4f life = v4f_load(e->life + i);
+
+        vx = vx * damp + gx;
+        vy = vy * damp + gy;
+        vz = vz * damp + gz;
+        x += vx * vdt;
+        y += vy * vdt;
+        z += vz * vdt;
+
+        v4i col = __builtin_convertvector(v4f_clamp(x + fx, field_lo, field_hi), v4i);
+        v4i row = __builtin_convertvector(v4f_clamp(z + fz, field_lo, field_hi), v4i);
+        v4i cell = row * field_w + col;
+        v4f ground = { e->field[cell[0]], e->field[cell[1]], e->field[cell[2]], e->field[cell[3]] };
+
+        v4i hit = y < ground;
+        y = v4f_select(hit, ground, y);
+        vy = v4f_select(hit, vy * bounce, vy);
+        vx = v4f_select(hit, vx * friction, vx);
+        vz = v4f_select(hit, vz * friction, vz);
+        life = v4f_select(hit & kill, V4F(0), life) - vdt;
+
+        v4f_store(e->x + i, x);
+        v4f_store(e->y + i, y);
+        v4f_store(e->z + i, z);
+        v4f_store(e->vx + i, vx);
+        v4f_store(e->vy + i, vy);
+        v4f_store(e->vz + i, vz);
+        v4f_store(e->life + i, life);
+    }
+}
+
+/* spawn volume grown by how far a particle can get in its life */
+static BoundingBox particlesBounds(const struct ParticleEmitter *e)
+{
+    const struct ParticleEmitterDesc *d = &e->desc;
+    float life = d->life;
+    Vector3 reach = Vector3AddValue(d->extent, d->speed * life);
+    Vector3 fall = Vector3Scale(d->gravity, 0.5f * life * life);
+    BoundingBox box = { Vector3Subtract(e->origin, reach), Vector3Add(e->origin, reach) };
+    box.min = Vector3Add(box.min, Vector3Min(fall, Vector3Zero()));
+    box.max = Vector3Add(box.max, Vector3Max(fall, Vector3Zero()));
+    return box;
+}
+
+void particlesUpdate(ParticleSystem *ps, Camera3D camera, float aspect, float dt)
+{
+    double start = time_ms();
+    Matrix view = MatrixLookAt(camera.position, camera.target, camera.up);
+    Matrix proj = MatrixPerspective(camera.fovy * DEG2RAD, aspect,
+            rlGetCullDistanceNear(), rlGetCullDistanceFar());
+    Matrix vp = MatrixMultiply(view, proj);
+
+    ps->emitters_culled = 0;
+    ps->simulated = 0;
+    for (int i = 0; i < ps->emitter_count; ++i) {
+        struct ParticleEmitter *e = ps->emitters[i];
+        e->visible = cullBoxVisible(&vp, particlesBounds(e));
+        if (!e->visible) {
+            ps->emitters_culled++;
+            continue;
+        }
+
+        /* the field has to cover the pool, follow the emitter and world edits */
+        float dx = e->origin.x - (e->field_origin.x + PARTICLES_FIELD / 2);
+        float dz = e->origin.z - (e->field_origin.y + PARTICLES_FIELD / 2);
+        if (e->field_revision != world_revision
+                || fabsf(dx) > PARTICLES_FIELD / 8 || fabsf(dz) > PARTICLES_FIELD / 8)
+            particlesSnapshotGround(e);
+
+        e->spawn_debt += e->desc.rate * dt;
+        int spawn = (int)e->spawn_debt;
+        e->spawn_debt -= spawn;
+        particlesSpawn(e, spawn);
+        particlesSimulate(e, dt);
+        ps->simulated += e->capacity;
+    }
+    ps->update_ms = time_ms() - start;
+}
+
+void particlesDraw(ParticleSystem *ps)
+{
+    if (!ps->gpu)
+        return;
+    /* whatever raylib has batched so far goes first */
+    rlDrawRenderBatchActive();
+    rlEnableShader(ps->shader.id);
+    rlSetUniformMatrix(ps->view_loc, rlGetMatrixModelview());
+    rlSetUniformMatrix(ps->projection_loc, rlGetMatrixProjection());
+    /* blended on top of the opaque world, without hiding each other */
+    rlDisableDepthMask();
+    rlDisableBackfaceCulling();
+
+    for (int i = 0; i < ps->emitter_count; ++i) {
+        struct ParticleEmitter *e = ps->emitters[i];
+        if (!e->visible)
+            continue;
+        Vector4 color = ColorNormalize(e->desc.color);
+        float fade = e->desc.life * 0.25f;
+        rlSetUniform(ps->color_loc, &color, SHADER_UNIFORM_VEC4, 1);
+        rlSetUniform(ps->size_loc, &e->desc.size, SHADER_UNIFORM_FLOAT, 1);
+        rlSetUniform(ps->fade_loc, &fade, SHADER_UNIFORM_FLOAT, 1);
+
+        glBindBuffer(GL_ARRAY_BUFFER, e->vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (size_t)e->capacity * 4 * sizeof(float), e->data);
+        glBindVertexArray(e->vao);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, e->capacity);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    rlEnableBackfaceCulling();
+    rlEnableDepthMask();
+    rlDisableShader();
+}
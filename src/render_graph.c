@@ -0,0 +1,203 @@
+/*****************************************************
+Create Date:        2024-12-06
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/render_graph.h"
+#include "../include/obh/util.h"
+#include "../include/raylib/rlgl.h"
+#include "../include/glad/glad.h"
+
+void rgInit(RenderGraph *graph)
+{
+    *graph = (RenderGraph) { 0 };
+    graph->gpu_timers = GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query;
+    if (graph->gpu_timers)
+        glGenQueries(RG_QUERY_FRAMES * RG_MAX_PASSES, &graph->queries[0][0]);
+}
+
+void rgUnload(RenderGraph *graph)
+{
+    if (graph->gpu_timers)
+        glDeleteQueries(RG_QUERY_FRAMES * RG_MAX_PASSES, &graph->queries[0][0]);
+    *graph = (RenderGraph) { 0 };
+}
+
+int rgResource(RenderGraph *graph, const char *name, RenderTexture2D *target)
+{
+    if (graph->resource_count == RG_MAX_RESOURCES) {
+        c_log_error(LOG_TAG, "render graph: too many resources, %s dropped", name);
+        return RG_MAX_RESOURCES - 1;
+    }
+    graph->resource_names[graph->resource_count] = name;
+    graph->resource_targets[graph->resource_count] = target;
+    return graph->resource_count++;
+}
+
+void rgSetOutput(RenderGraph *graph, int resource)
+{
+    graph->outputs |= RG_BIT(resource);
+}
+
+void rgBeginFrame(RenderGraph *graph)
+{
+    graph->pass_count = 0;
+    graph->frame++;
+
+    /* the slot about to be reused was issued RG_QUERY_FRAMES frames ago */
+    if (!graph->gpu_timers)
+        return;
+    int slot = graph->frame % RG_QUERY_FRAMES;
+    for (int i = 0; i < RG_MAX_PASSES; ++i) {
+        if (!graph->query_issued[slot][i])
+            continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(graph->queries[slot][i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(graph->queries[slot][i], GL_QUERY_RESULT, &ns);
+            graph->stats[i].gpu_ms = ns / 1e6;
+        }
+        graph->query_issued[slot][i] = false;
+    }
+}
+
+void rgAddPass(RenderGraph *graph, struct RenderPassDesc pass)
+{
+    if (graph->pass_count == RG_MAX_PASSES) {
+        c_log_error(LOG_TAG, "render graph: too many passes, %s dropped", pass.name);
+        return;
+    }
+    graph->passes[graph->pass_count++] = pass;
+}
+
+/* b has to run after a: b reads what a writes, ties go to declaration order */
+static bool rgDependsOn(const RenderGraph *graph, int b, int a)
+{
+    const struct RenderPassDesc *pa = &graph->passes[a], *pb = &graph->passes[b];
+    if (a == b || !(pa->writes & pb->reads))
+        return false;
+    if ((pb->writes & pa->reads) && b < a)
+        return false;
+    return true;
+}
+
+/* kahn's algorithm, lowest declaration index first among ready passes */
+static void rgSort(RenderGraph *graph)
+{
+    int n = graph->pass_count;
+    int indegree[RG_MAX_PASSES] = { 0 };
+    bool placed[RG_MAX_PASSES] = { 0 };
+    for (int b = 0; b < n; ++b)
+        for (int a = 0; a < n; ++a)
+            indegree[b] += rgDependsOn(graph, b, a);
+
+    for (int k = 0; k < n; ++k) {
+        int next = -1;
+        for (int i = 0; i < n && next < 0; ++i)
+            if (!placed[i] && indegree[i] == 0)
+                next = i;
+        /* cycle, fall back to declaration order for what is left */
+        if (next < 0) {
+            c_log_warn(LOG_TAG, "render graph: dependency cycle");
+            for (int i = 0; i < n && next < 0; ++i)
+                if (!placed[i])
+                    next = i;
+        }
+        placed[next] = true;
+        graph->order[k] = next;
+        for (int b = 0; b < n; ++b)
+            if (!placed[b] && rgDependsOn(graph, b, next))
+                indegree[b]--;
+    }
+}
+
+/* walk backwards from the outputs, a pass lives if it writes something still needed */
+static void rgCull(RenderGraph *graph)
+{
+    u32 needed = graph->outputs;
+    for (int k = graph->pass_count - 1; k >= 0; --k) {
+        int i = graph->order[k];
+        const struct RenderPassDesc *p = &graph->passes[i];
+        graph->live[i] = p->enabled && (p->writes & needed);
+        if (!graph->live[i])
+            continue;
+        /* cleared contents never reach anyone before this pass */
+        needed &= ~(p->clears & ~p->reads);
+        needed |= p->reads;
+    }
+}
+
+static void rgClear(RenderGraph *graph, const struct RenderPassDesc *p)
+{
+    for (int r = 0; r < graph->resource_count; ++r) {
+        if (!(p->clears & RG_BIT(r)))
+            continue;
+        RenderTexture2D *target = graph->resource_targets[r];
+        if (target != NULL) {
+            BeginTextureMode(*target);
+            ClearBackground(p->clear_color);
+            EndTextureMode();
+        } else {
+            ClearBackground(p->clear_color);
+        }
+        graph->clears++;
+    }
+}
+
+void rgExecute(RenderGraph *graph)
+{
+    graph->passes_run = graph->passes_culled = graph->passes_skipped = graph->clears = 0;
+    graph->cpu_ms = graph->gpu_ms = 0;
+
+    rgSort(graph);
+    rgCull(graph);
+
+    int slot = graph->frame % RG_QUERY_FRAMES;
+    for (int k = 0; k < graph->pass_count; ++k) {
+        int i = graph->order[k];
+        const struct RenderPassDesc *p = &graph->passes[i];
+        struct RenderPassStats *stats = &graph->stats[i];
+        stats->name = p->name;
+        stats->ran = stats->skipped = false;
+        stats->culled = !graph->live[i];
+        if (stats->culled) {
+            graph->passes_culled++;
+            continue;
+        }
+        if (p->changed != NULL && !p->changed(p->user)) {
+            stats->skipped = true;
+            graph->passes_skipped++;
+            continue;
+        }
+
+        /* batched draws from before belong to the previous pass */
+        rlDrawRenderBatchActive();
+        double start = time_ms();
+        if (graph->gpu_timers)
+            glBeginQuery(GL_TIME_ELAPSED, graph->queries[slot][i]);
+
+        rgClear(graph, p);
+        p->execute(p->user);
+        rlDrawRenderBatchActive();
+
+        if (graph->gpu_timers) {
+            glEndQuery(GL_TIME_ELAPSED);
+            graph->query_issued[slot][i] = true;
+        }
+        stats->cpu_ms = time_ms() - start;
+        stats->ran = true;
+        graph->passes_run++;
+    }
+
+    for (int k = 0; k < graph->pass_count; ++k) {
+        const struct RenderPassStats *stats = &graph->stats[graph->order[k]];
+        if (stats->ran) {
+            graph->cpu_ms += stats->cpu_ms;
+            graph->gpu_ms += stats->gpu_ms;
+        }
+    }
+}
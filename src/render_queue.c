@@ -0,0 +1,258 @@
+/*****************************************************
+Create Date:        2024-12-05
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/render_queue.h"
+#include "../include/obh/util.h"
+#include "../include/raylib/rlgl.h"
+
+void renderQueueInit(RenderQueue *rq)
+{
+    *rq = (RenderQueue) { 0 };
+    rq->sort = true;
+}
+
+void renderQueueUnload(RenderQueue *rq)
+{
+    arrfree(rq->items);
+    arrfree(rq->entries);
+    arrfree(rq->scratch);
+    *rq = (RenderQueue) { 0 };
+}
+
+void renderQueueBegin(RenderQueue *rq, Vector3 view_pos)
+{
+    arrsetlen(rq->items, 0);
+    arrsetlen(rq->entries, 0);
+    rq->view_pos = view_pos;
+}
+
+static u64 renderQueueKey(const RenderQueue *rq, enum RenderPass pass,
+        const Material *material, Matrix transform)
+{
+    Vector3 pos = { transform.m12, transform.m13, transform.m14 };
+    float dist = Vector3Distance(pos, rq->view_pos);
+    u32 depth;
+    memcpy(&depth, &dist, sizeof(depth));
+    if (pass == RENDER_PASS_ALPHA)
+        depth = ~depth;
+
+    return ((u64)pass << RENDER_KEY_PASS_SHIFT)
+        | ((u64)(material->shader.id & 0xfff) << RENDER_KEY_SHADER_SHIFT)
+        | ((u64)(material->maps[MATERIAL_MAP_DIFFUSE].texture.id & 0xffff) << RENDER_KEY_TEXTURE_SHIFT)
+        | depth;
+}
+
+void renderQueuePushMesh(RenderQueue *rq, enum RenderPass pass, const Mesh *mesh,
+        const Material *material, Matrix transform, Color tint)
+{
+    struct RenderSortEntry e = {
+        .key = renderQueueKey(rq, pass, material, transform),
+        .item = arrlen(rq->items),
+    };
+    arrput(rq->entries, e);
+    arrput(rq->items, ((struct RenderItem) { mesh, material, transform, tint }));
+}
+
+void renderQueuePushModel(RenderQueue *rq, enum RenderPass pass, Model model,
+        Vector3 position, float scale, Color tint)
+{
+    /* same transform DrawModel builds */
+    Matrix transform = MatrixMultiply(MatrixScale(scale, scale, scale),
+            MatrixTranslate(position.x, position.y, position.z));
+    transform = MatrixMultiply(model.transform, transform);
+
+    for (int i = 0; i < model.meshCount; ++i) {
+        renderQueuePushMesh(rq, pass, &model.meshes[i],
+                &model.materials[model.meshMaterial[i]], transform, tint);
+    }
+}
+
+/* lsd radix sort on bytes, bytes every key shares are skipped */
+static void renderQueueSort(RenderQueue *rq)
+{
+    int n = arrlen(rq->entries);
+    arrsetlen(rq->scratch, n);
+
+    u32 counts[8][256] = { 0 };
+    for (int i = 0; i < n; ++i) {
+        u64 key = rq->entries[i].key;
+        for (int b = 0; b < 8; ++b)
+            counts[b][(key >> (b * 8)) & 0xff]++;
+    }
+
+    struct RenderSortEntry *src = rq->entries, *dst = rq->scratch;
+    for (int b = 0; b < 8; ++b) {
+        if (n == 0 || counts[b][(src[0].key >> (b * 8)) & 0xff] == (u32)n)
+            continue;
+        u32 offset = 0;
+        for (int d = 0; d < 256; ++d) {
+            u32 c = counts[b][d];
+            counts[b][d] = offset;
+            offset += c;
+        }
+        for (int i = 0; i < n; ++i)
+            dst[counts[b][(src[i].key >> (b * 8)) & 0xff]++] = src[i];
+        struct RenderSortEntry *t = src;
+        src = dst;
+        dst = t;
+    }
+
+    /* keep entries as the sorted array, scratch as the spare */
+    if (src != rq->entries) {
+        rq->scratch = rq->entries;
+        rq->entries = src;
+    }
+}
+
+/* per shader state: matrices and sampler slots set once per bind */
+static void renderQueueBindShader(const Shader *shader, Matrix view, Matrix proj)
+{
+    rlEnableShader(shader->id);
+    if (shader->locs[SHADER_LOC_MATRIX_VIEW] != -1)
+        rlSetUniformMatrix(shader->locs[SHADER_LOC_MATRIX_VIEW], view);
+    if (shader->locs[SHADER_LOC_MATRIX_PROJECTION] != -1)
+        rlSetUniformMatrix(shader->locs[SHADER_LOC_MATRIX_PROJECTION], proj);
+    for (int slot = 0; slot < MAX_MATERIAL_MAPS; ++slot) {
+        if (shader->locs[SHADER_LOC_MAP_DIFFUSE + slot] != -1)
+            rlSetUniform(shader->locs[SHADER_LOC_MAP_DIFFUSE + slot], &slot, SHADER_UNIFORM_INT, 1);
+    }
+}
+
+/* diffuse colour times tint, as DrawModel does it */
+static Color renderQueueTint(Color c, Color tint)
+{
+    return (Color) {
+        (u8)(((int)c.r * tint.r) / 255), (u8)(((int)c.g * tint.g) / 255),
+        (u8)(((int)c.b * tint.b) / 255), (u8)(((int)c.a * tint.a) / 255),
+    };
+}
+
+static void renderQueueDrawDirect(const struct RenderItem *it)
+{
+    /* tint through a copy of the maps, the material is shared */
+    Material material = *it->material;
+    MaterialMap maps[MAX_MATERIAL_MAPS];
+    memcpy(maps, material.maps, sizeof(maps));
+    maps[MATERIAL_MAP_DIFFUSE].color = renderQueueTint(maps[MATERIAL_MAP_DIFFUSE].color, it->tint);
+    material.maps = maps;
+    DrawMesh(*it->mesh, material, it->transform);
+}
+
+void renderQueueFlush(RenderQueue *rq)
+{
+    double start = time_ms();
+    rq->draw_calls = rq->shader_binds = rq->texture_binds = 0;
+    rq->sort_ms = 0;
+
+    /* anything raylib batched so far goes first */
+    rlDrawRenderBatchActive();
+
+    int n = arrlen(rq->items);
+    if (!rq->sort) {
+        for (int i = 0; i < n; ++i)
+            renderQueueDrawDirect(&rq->items[i]);
+        rq->draw_calls = rq->shader_binds = n;
+        rq->submit_ms = time_ms() - start;
+        return;
+    }
+
+    renderQueueSort(rq);
+    rq->sort_ms = time_ms() - start;
+
+    Matrix view = rlGetMatrixModelview();
+    Matrix proj = rlGetMatrixProjection();
+    Matrix world = rlGetMatrixTransform();
+
+    unsigned int bound_shader = 0;
+    unsigned int bound_textures[MAX_MATERIAL_MAPS] = { 0 };
+    Color bound_diffuse = { 0 }, bound_specular = { 0 };
+    bool colors_set = false;
+    for (int e = 0; e < n; ++e) {
+        const struct RenderItem *it = &rq->items[rq->entries[e].item];
+        const Material *mat = it->material;
+        const Shader *shader = &mat->shader;
+
+        /* skinned meshes need bone uploads, raylib does those */
+        if (it->mesh->boneCount > 0 || !rlEnableVertexArray(it->mesh->vaoId)) {
+            renderQueueDrawDirect(it);
+            bound_shader = 0;
+            memset(bound_textures, 0, sizeof(bound_textures));
+            rq->draw_calls++;
+            continue;
+        }
+
+        if (shader->id != bound_shader) {
+            renderQueueBindShader(shader, view, proj);
+            bound_shader = shader->id;
+            /* colours are program state, set them again */
+            colors_set = false;
+            rq->shader_binds++;
+        }
+
+        Color diffuse = renderQueueTint(mat->maps[MATERIAL_MAP_DIFFUSE].color, it->tint);
+        Color specular = mat->maps[MATERIAL_MAP_SPECULAR].color;
+        if (!colors_set || !ColorIsEqual(diffuse, bound_diffuse)) {
+            Vector4 v = ColorNormalize(diffuse);
+            if (shader->locs[SHADER_LOC_COLOR_DIFFUSE] != -1)
+                rlSetUniform(shader->locs[SHADER_LOC_COLOR_DIFFUSE], &v, SHADER_UNIFORM_VEC4, 1);
+            bound_diffuse = diffuse;
+        }
+        if (!colors_set || !ColorIsEqual(specular, bound_specular)) {
+            Vector4 v = ColorNormalize(specular);
+            if (shader->locs[SHADER_LOC_COLOR_SPECULAR] != -1)
+                rlSetUniform(shader->locs[SHADER_LOC_COLOR_SPECULAR], &v, SHADER_UNIFORM_VEC4, 1);
+            bound_specular = specular;
+        }
+        colors_set = true;
+
+        for (int slot = 0; slot < MAX_MATERIAL_MAPS; ++slot) {
+            unsigned int id = mat->maps[slot].texture.id;
+            if (id == 0 || id == bound_textures[slot])
+                continue;
+            rlActiveTextureSlot(slot);
+            if (slot == MATERIAL_MAP_IRRADIANCE || slot == MATERIAL_MAP_PREFILTER || slot == MATERIAL_MAP_CUBEMAP)
+                rlEnableTextureCubemap(id);
+            else
+                rlEnableTexture(id);
+            bound_textures[slot] = id;
+            rq->texture_binds++;
+        }
+
+        Matrix model = MatrixMultiply(it->transform, world);
+        if (shader->locs[SHADER_LOC_MATRIX_MODEL] != -1)
+            rlSetUniformMatrix(shader->locs[SHADER_LOC_MATRIX_MODEL], model);
+        if (shader->locs[SHADER_LOC_MATRIX_NORMAL] != -1)
+            rlSetUniformMatrix(shader->locs[SHADER_LOC_MATRIX_NORMAL], MatrixTranspose(MatrixInvert(model)));
+        rlSetUniformMatrix(shader->locs[SHADER_LOC_MATRIX_MVP],
+                MatrixMultiply(MatrixMultiply(model, view), proj));
+
+        if (it->mesh->indices != NULL)
+            rlDrawVertexArrayElements(0, it->mesh->triangleCount * 3, 0);
+        else
+            rlDrawVertexArray(0, it->mesh->vertexCount);
+        rq->draw_calls++;
+    }
+
+    for (int slot = 0; slot < MAX_MATERIAL_MAPS; ++slot) {
+        if (bound_textures[slot] == 0)
+            continue;
+        rlActiveTextureSlot(slot);
+        if (slot == MATERIAL_MAP_IRRADIANCE || slot == MATERIAL_MAP_PREFILTER || slot == MATERIAL_MAP_CUBEMAP)
+            rlDisableTextureCubemap();
+        else
+            rlDisableTexture();
+    }
+    rlDisableVertexArray();
+    rlDisableVertexBuffer();
+    rlDisableVertexBufferElement();
+    rlDisableShader();
+    rlSetMatrixModelview(view);
+    rlSetMatrixProjection(proj);
+
+    rq->submit_ms = time_ms() - start;
+}
@@ -0,0 +1,216 @@
+/*****************************************************
+Create Date:        2024-12-09
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/shader_cache.h"
+#include "../include/obh/util.h"
+#include "../include/obh/uniforms.h"
+#include "../include/raylib/rlgl.h"
+#include "../include/glad/glad.h"
+
+/* glsl wants #version first, so no #line at the very top */
+#define STB_INCLUDE_LINE_GLSL
+#define STB_INCLUDE_IMPLEMENTATION
+#include "../include/stb/stb_include.h"
+
+#define SHADER_CACHE_MAGIC 0x4f424853u /* "SHBO" */
+
+struct ShaderBinaryHeader {
+    u32 magic;
+    u32 format;
+    u32 length;
+};
+
+struct ShaderCache shader_cache;
+
+void shaderCacheInit(const char *dir)
+{
+    shader_cache = (ShaderCache) { .dir = dir };
+    snprintf(shader_cache.driver, sizeof(shader_cache.driver), "%s|%s|%s|%s",
+            (const char *)glGetString(GL_VENDOR), (const char *)glGetString(GL_RENDERER),
+            (const char *)glGetString(GL_VERSION), (const char *)glGetString(GL_SHADING_LANGUAGE_VERSION));
+
+    GLint formats = 0;
+    if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    shader_cache.binary_supported = dir != NULL && formats > 0;
+    if (shader_cache.binary_supported)
+        mkdir_p(dir);
+    else
+        c_log_info(LOG_TAG, "shader cache: program binaries unsupported, compiling from source");
+}
+
+/* fnv-1a, strings are hashed with their terminator so "ab","c" != "a","bc" */
+static u64 shaderCacheHash(u64 h, const char *s)
+{
+    if (h == 0)
+        h = 0xcbf29ce484222325ull;
+    if (s == NULL)
+        s = "<default>";
+    do {
+        h ^= (u8)*s;
+        h *= 0x100000001b3ull;
+    } while (*s++);
+    return h;
+}
+
+/* @return source with #include resolved next to path, free() it */
+static char *shaderCachePreprocess(const char *path)
+{
+    if (path == NULL)
+        return NULL;
+
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (slash != NULL)
+        *slash = '\0';
+    else
+        strcpy(dir, ".");
+
+    char error[256] = { 0 };
+    char *src = stb_include_file((char *)path, NULL, dir, error);
+    if (src == NULL)
+        c_log_error(LOG_TAG, "shader cache: %s", error);
+    return src;
+}
+
+/* the locations LoadShaderFromMemory fills in, rlgl keeps the names private */
+static const struct { int loc; bool attrib; const char *name; } shader_cache_locs[] = {
+    { SHADER_LOC_VERTEX_POSITION, true, "vertexPosition" },
+    { SHADER_LOC_VERTEX_TEXCOORD01, true, "vertexTexCoord" },
+    { SHADER_LOC_VERTEX_TEXCOORD02, true, "vertexTexCoord2" },
+    { SHADER_LOC_VERTEX_NORMAL, true, "vertexNormal" },
+    { SHADER_LOC_VERTEX_TANGENT, true, "vertexTangent" },
+    { SHADER_LOC_VERTEX_COLOR, true, "vertexColor" },
+    { SHADER_LOC_VERTEX_BONEIDS, true, "vertexBoneIds" },
+    { SHADER_LOC_VERTEX_BONEWEIGHTS, true, "vertexBoneWeights" },
+    { SHADER_LOC_MATRIX_MVP, false, "mvp" },
+    { SHADER_LOC_MATRIX_VIEW, false, "matView" },
+    { SHADER_LOC_MATRIX_PROJECTION, false, "matProjection" },
+    { SHADER_LOC_MATRIX_MODEL, false, "matModel" },
+    { SHADER_LOC_MATRIX_NORMAL, false, "matNormal" },
+    { SHADER_LOC_BONE_MATRICES, false, "boneMatrices" },
+    { SHADER_LOC_COLOR_DIFFUSE, false, "colDiffuse" },
+    { SHADER_LOC_MAP_DIFFUSE, false, "texture0" },
+    { SHADER_LOC_MAP_SPECULAR, false, "texture1" },
+    { SHADER_LOC_MAP_NORMAL, false, "texture2" },
+};
+
+static void shaderCacheSetupLocs(Shader *shader)
+{
+    shader->locs = MemAlloc(RL_MAX_SHADER_LOCATIONS * sizeof(int));
+    for (int i = 0; i < RL_MAX_SHADER_LOCATIONS; ++i)
+        shader->locs[i] = -1;
+
+    int n = sizeof(shader_cache_locs) / sizeof(shader_cache_locs[0]);
+    for (int i = 0; i < n; ++i) {
+        shader->locs[shader_cache_locs[i].loc] = shader_cache_locs[i].attrib
+            ? rlGetLocationAttrib(shader->id, shader_cache_locs[i].name)
+            : rlGetLocationUniform(shader->id, shader_cache_locs[i].name);
+    }
+}
+
+static bool shaderCacheLoadBinary(const char *path, Shader *shader)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return false;
+
+    /* the length comes off disk, it has to match what is left of the file before it is trusted */
+    long size = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+    rewind(f);
+
+    struct ShaderBinaryHeader header;
+    void *data = NULL;
+    bool ok = size >= (long)sizeof(header) && fread(&header, sizeof(header), 1, f) == 1
+        && header.magic == SHADER_CACHE_MAGIC
+        && header.length > 0 && (long)header.length == size - (long)sizeof(header)
+        && (data = malloc(header.length)) != NULL && fread(data, header.length, 1, f) == 1;
+    fclose(f);
+
+    if (ok) {
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header.format, data, header.length);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked) {
+            shader->id = program;
+            shaderCacheSetupLocs(shader);
+        } else {
+            glDeleteProgram(program);
+            ok = false;
+        }
+    }
+    free(data);
+
+    /* driver update or corrupt file, drop it and compile */
+    if (!ok) {
+        c_log_warn(LOG_TAG, "shader cache: %s rejected, recompiling", path);
+        remove(path);
+        shader_cache.rejected++;
+    }
+    return ok;
+}
+
+static void shaderCacheStoreBinary(const char *path, Shader shader)
+{
+    GLint length = 0;
+    glGetProgramiv(shader.id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    void *data = malloc(length);
+    struct ShaderBinaryHeader header = { .magic = SHADER_CACHE_MAGIC };
+    GLenum format = 0;
+    glGetProgramBinary(shader.id, length, NULL, &format, data);
+    header.format = format;
+    header.length = length;
+
+    FILE *f = fopen(path, "wb");
+    if (f != NULL) {
+        fwrite(&header, sizeof(header), 1, f);
+        fwrite(data, length, 1, f);
+        fclose(f);
+    }
+    free(data);
+}
+
+Shader shaderCacheLoad(const char *vs_path, const char *fs_path)
+{
+    double start = time_ms();
+
+    char *vs = shaderCachePreprocess(vs_path);
+    char *fs = shaderCachePreprocess(fs_path);
+
+    Shader shader = { 0 };
+    char path[600] = { 0 };
+    if (shader_cache.binary_supported) {
+        u64 h = shaderCacheHash(0, shader_cache.driver);
+        h = shaderCacheHash(h, vs);
+        h = shaderCacheHash(h, fs);
+        snprintf(path, sizeof(path), "%s/%016" PRIx64 ".bin", shader_cache.dir, h);
+        if (shaderCacheLoadBinary(path, &shader))
+            shader_cache.hits++;
+    }
+
+    if (shader.id == 0) {
+        shader = LoadShaderFromMemory(vs, fs);
+        shader_cache.misses++;
+        if (shader_cache.binary_supported && IsShaderValid(shader))
+            shaderCacheStoreBinary(path, shader);
+    }
+
+    if (IsShaderValid(shader))
+        uniformsBindBlocks(shader);
+
+    free(vs);
+    free(fs);
+
+    shader_cache.load_ms += time_ms() - start;
+    return shader;
+}
@@ -0,0 +1,443 @@
+/*****************************************************
+Create Date:        2024-11-28
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/shadow.h"
+#include "../include/obh/world.h"
+#include "../include/obh/shader_cache.h"
+#include "../include/obh/uniforms.h"
+
+#include "../include/glad/glad.h"
+
+RenderTexture2D LoadShadowmapRenderTexture(int width, int height)
+{
+    RenderTexture2D target = { 0 };
+
+    target.id = rlLoadFramebuffer(); // Load an empty framebuffer
+    target.texture.width = width;
+    target.texture.height = height;
+
+    if (target.id > 0)
+    {
+        rlEnableFramebuffer(target.id);
+
+        // Create depth texture
+        // We don't need a color texture for the shadowmap
+        target.depth.id = rlLoadTextureDepth(width, height, false);
+        target.depth.width = width;
+        target.depth.height = height;
+        target.depth.format = 19;       //DEPTH_COMPONENT_24BIT?
+        target.depth.mipmaps = 1;
+
+        // Attach depth texture to FBO
+        rlFramebufferAttach(target.id, target.depth.id, RL_ATTACHMENT_DEPTH, RL_ATTACHMENT_TEXTURE2D, 0);
+
+        // Check if fbo is complete with attachments (valid)
+        if (rlFramebufferComplete(target.id)) TRACELOG(LOG_INFO, "FBO: [ID %i] Framebuffer object created successfully", target.id);
+
+        rlDisableFramebuffer();
+    }
+    else TRACELOG(LOG_WARNING, "FBO: Framebuffer object can not be created");
+
+    return target;
+}
+
+Matrix shadowLightViewProj(Camera3D light_cam)
+{
+    /* mirrors BeginMode3D for CAMERA_ORTHOGRAPHIC with aspect 1 */
+    double top = light_cam.fovy / 2.0;
+    Matrix view = MatrixLookAt(light_cam.position, light_cam.target, light_cam.up);
+    Matrix proj = MatrixOrtho(-top, top, -top, top,
+            rlGetCullDistanceNear(), rlGetCullDistanceFar());
+    return MatrixMultiply(view, proj);
+}
+
+static void shadowClearTarget(RenderTexture2D target)
+{
+    BeginTextureMode(target);
+    ClearBackground(WHITE);
+    EndTextureMode();
+}
+
+static void shadowLoadCascades(ShadowCache *sc)
+{
+    int res = sc->resolution;
+
+    glGenTextures(1, &sc->cascade_array);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, sc->cascade_array);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, res, res,
+            sc->cascade_count, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    /* one depth-only fbo per layer so BeginTextureMode works unchanged */
+    for (int i = 0; i < sc->cascade_count; ++i) {
+        RenderTexture2D *target = &sc->cascades[i].target;
+        *target = (RenderTexture2D) { 0 };
+        target->id = rlLoadFramebuffer();
+        target->texture.width = res;
+        target->texture.height = res;
+        target->depth.id = sc->cascade_array;
+        target->depth.width = res;
+        target->depth.height = res;
+        target->depth.format = 19;
+        target->depth.mipmaps = 1;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target->id);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, sc->cascade_array, 0, i);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (!rlFramebufferComplete(target->id))
+            TRACELOG(LOG_WARNING, "FBO: [ID %i] Shadow cascade %i is incomplete", target->id, i);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        sc->cascades[i].valid = false;
+    }
+}
+
+static void shadowUnloadCascades(ShadowCache *sc)
+{
+    for (int i = 0; i < sc->cascade_count; ++i)
+        rlUnloadFramebuffer(sc->cascades[i].target.id);
+    glDeleteTextures(1, &sc->cascade_array);
+    sc->cascade_array = 0;
+}
+
+void shadowCacheInit(ShadowCache *sc, Vector3 light_dir, int cascade_count,
+        int resolution, int dynamic_resolution, float dynamic_extent)
+{
+    *sc = (ShadowCache) { 0 };
+
+    sc->cascade_count = Clamp(cascade_count, 1, SHADOW_MAX_CASCADES);
+    sc->resolution = resolution;
+    sc->split_lambda = 0.75f;
+    sc->max_distance = 120.0f;
+    sc->caster_margin = 150.0f;
+    sc->light_dir = Vector3Normalize(light_dir);
+    shadowLoadCascades(sc);
+
+    sc->dynamic_resolution = dynamic_resolution;
+    sc->dynamic_map = LoadShadowmapRenderTexture(dynamic_resolution, dynamic_resolution);
+    sc->dynamic_cam.projection = CAMERA_ORTHOGRAPHIC;
+    sc->dynamic_cam.up = (Vector3) { 0.0f, 1.0f, 0.0f };
+    sc->dynamic_cam.fovy = dynamic_extent;
+
+    sc->depth_shader = shaderCacheLoad("resources/shaders/depth.vs", "resources/shaders/depth.fs");
+    sc->depth_shader_skinned = shaderCacheLoad("resources/shaders/depth_skinned.vs", "resources/shaders/depth.fs");
+    sc->offset_factor = 2.0f;
+    sc->offset_units = 4.0f;
+
+    shadowCacheClear(sc);
+}
+
+void shadowCacheUnload(ShadowCache *sc)
+{
+    shadowUnloadCascades(sc);
+    UnloadRenderTexture(sc->dynamic_map);
+    UnloadShader(sc->depth_shader);
+    UnloadShader(sc->depth_shader_skinned);
+    hmfree(sc->casters);
+    *sc = (ShadowCache) { 0 };
+}
+
+void shadowCacheConfigure(ShadowCache *sc, int cascade_count, int resolution)
+{
+    cascade_count = Clamp(cascade_count, 1, SHADOW_MAX_CASCADES);
+    if (cascade_count == sc->cascade_count && resolution == sc->resolution)
+        return;
+
+    shadowUnloadCascades(sc);
+    sc->cascade_count = cascade_count;
+    sc->resolution = resolution;
+    shadowLoadCascades(sc);
+}
+
+void shadowCacheSetLightDir(ShadowCache *sc, Vector3 light_dir)
+{
+    light_dir = Vector3Normalize(light_dir);
+    if (Vector3Equals(light_dir, sc->light_dir))
+        return;
+    sc->light_dir = light_dir;
+    shadowCacheInvalidate(sc);
+}
+
+void shadowCacheInvalidate(ShadowCache *sc)
+{
+    for (int i = 0; i < sc->cascade_count; ++i)
+        sc->cascades[i].valid = false;
+}
+
+void shadowCacheClear(ShadowCache *sc)
+{
+    for (int i = 0; i < sc->cascade_count; ++i)
+        shadowClearTarget(sc->cascades[i].target);
+    shadowClearTarget(sc->dynamic_map);
+    shadowCacheInvalidate(sc);
+}
+
+/*
+ * No colour is written and back faces (as seen from the light) are what
+ * lands in the map, offset away from the light by the rasterizer
+ */
+static void shadowBeginCasterState(ShadowCache *sc)
+{
+    rlDrawRenderBatchActive();
+    rlColorMask(false, false, false, false);
+    rlEnableBackfaceCulling();
+    rlSetCullFace(RL_CULL_FACE_FRONT);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(sc->offset_factor, sc->offset_units);
+}
+
+static void shadowEndCasterState(ShadowCache *sc)
+{
+    rlDrawRenderBatchActive();
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    rlSetCullFace(RL_CULL_FACE_BACK);
+    rlColorMask(true, true, true, true);
+}
+
+static Matrix shadowLightRotation(Vector3 light_dir)
+{
+    Vector3 up = fabsf(light_dir.y) > 0.99f ? (Vector3) { 0, 0, 1 } : (Vector3) { 0, 1, 0 };
+    return MatrixLookAt(Vector3Zero(), light_dir, up);
+}
+
+static void shadowFitCascade(ShadowCache *sc, struct ShadowCascade *cascade,
+        Camera3D camera, float aspect, float near, float far)
+{
+    Vector3 forward = sc->view_forward;
+    Vector3 right = Vector3Normalize(Vector3CrossProduct(forward, camera.up));
+    Vector3 up = Vector3CrossProduct(right, forward);
+    float tan_half = tanf(camera.fovy * DEG2RAD * 0.5f);
+
+    Vector3 corners[8];
+    Vector3 center = Vector3Zero();
+    for (int i = 0; i < 8; ++i) {
+        float d = (i & 4) ? far : near;
+        float h = d * tan_half;
+        float w = h * aspect;
+        Vector3 c = Vector3Add(camera.position, Vector3Scale(forward, d));
+        c = Vector3Add(c, Vector3Scale(right, (i & 1) ? w : -w));
+        c = Vector3Add(c, Vector3Scale(up, (i & 2) ? h : -h));
+        corners[i] = c;
+        center = Vector3Add(center, c);
+    }
+    center = Vector3Scale(center, 1.0f / 8.0f);
+
+    /* a bounding sphere keeps the extent constant as the camera turns */
+    float radius = 0;
+    for (int i = 0; i < 8; ++i)
+        radius = fmaxf(radius, Vector3Distance(center, corners[i]));
+    radius = ceilf(radius * 16.0f) / 16.0f;
+
+    /* snap the center to whole texels in light space, stops shimmering */
+    Matrix view = shadowLightRotation(sc->light_dir);
+    Vector3 center_ls = Vector3Transform(center, view);
+    float texel = 2.0f * radius / sc->resolution;
+    center_ls.x = floorf(center_ls.x / texel) * texel;
+    center_ls.y = floorf(center_ls.y / texel) * texel;
+
+    /* light space looks down -z */
+    float depth = -center_ls.z;
+    cascade->view = view;
+    cascade->proj = MatrixOrtho(center_ls.x - radius, center_ls.x + radius,
+            center_ls.y - radius, center_ls.y + radius,
+            depth - radius - sc->caster_margin, depth + radius);
+    cascade->vp = MatrixMultiply(cascade->view, cascade->proj);
+    cascade->split_far = far;
+}
+
+static bool shadowBoxInFrustum(Matrix vp, BoundingBox bb)
+{
+    Vector3 ndc_min = { INFINITY, INFINITY, INFINITY };
+    Vector3 ndc_max = { -INFINITY, -INFINITY, -INFINITY };
+    for (int i = 0; i < 8; ++i) {
+        Vector3 corner = {
+            (i & 1) ? bb.max.x : bb.min.x,
+            (i & 2) ? bb.max.y : bb.min.y,
+            (i & 4) ? bb.max.z : bb.min.z,
+        };
+        /* orthographic, w stays 1 */
+        Vector3 p = Vector3Transform(corner, vp);
+        ndc_min = Vector3Min(ndc_min, p);
+        ndc_max = Vector3Max(ndc_max, p);
+    }
+
+    return ndc_max.x >= -1 && ndc_min.x <= 1
+        && ndc_max.y >= -1 && ndc_min.y <= 1
+        && ndc_max.z >= -1 && ndc_min.z <= 1;
+}
+
+void shadowCacheInvalidateBox(ShadowCache *sc, BoundingBox box)
+{
+    for (int c = 0; c < sc->cascade_count; ++c) {
+        if (shadowBoxInFrustum(sc->cascades[c].vp, box))
+            sc->cascades[c].valid = false;
+    }
+}
+
+void shadowCacheUpdate(ShadowCache *sc, Camera3D camera, float aspect)
+{
+    sc->view_pos = camera.position;
+    sc->view_forward = Vector3Normalize(Vector3Subtract(camera.target, camera.position));
+
+    /* spend the cascades around the camera target, not from the near plane */
+    float focus = Vector3Distance(camera.position, camera.target);
+    float range_near = fmaxf(rlGetCullDistanceNear(), focus - sc->max_distance);
+    float range_far = focus + sc->max_distance;
+
+    float split_near = range_near;
+    for (int i = 0; i < sc->cascade_count; ++i) {
+        float t = (float)(i + 1) / sc->cascade_count;
+        float split_log = range_near * powf(range_far / range_near, t);
+        float split_uni = range_near + (range_far - range_near) * t;
+        float split_far = Lerp(split_uni, split_log, sc->split_lambda);
+
+        shadowFitCascade(sc, &sc->cascades[i], camera, aspect, split_near, split_far);
+        split_near = split_far;
+    }
+
+    for (int i = 0; i < sc->cascade_count; ++i) {
+        struct ShadowCascade *cascade = &sc->cascades[i];
+        if (memcmp(&cascade->cached_vp, &cascade->vp, sizeof(Matrix)) != 0)
+            cascade->valid = false;
+    }
+
+    if (sc->cached_revision == world_revision)
+        return;
+
+    /* only chunks touched since the last check that a cascade can see matter */
+    for (int i = 0; i < hmlen(world_map); ++i) {
+        struct WorldChunk *wc = &world_map[i].chunk;
+        if (wc->revision > sc->cached_revision)
+            shadowCacheInvalidateBox(sc, worldChunkBoundingBox(wc));
+    }
+    sc->cached_revision = world_revision;
+}
+
+bool shadowCacheStale(const ShadowCache *sc)
+{
+    for (int i = 0; i < sc->cascade_count; ++i) {
+        if (!sc->cascades[i].valid)
+            return true;
+    }
+    return false;
+}
+
+bool shadowCacheCascadeSees(ShadowCache *sc, int cascade, BoundingBox box)
+{
+    return shadowBoxInFrustum(sc->cascades[cascade].vp, box);
+}
+
+bool shadowCacheBeginCascade(ShadowCache *sc, int cascade)
+{
+    struct ShadowCascade *c = &sc->cascades[cascade];
+    if (c->valid)
+        return false;
+
+    c->cached_vp = c->vp;
+    c->valid = true;
+    sc->static_renders++;
+
+    BeginTextureMode(c->target);
+    ClearBackground(WHITE);
+
+    /* same as BeginMode3D, with our own fitted matrices */
+    rlDrawRenderBatchActive();
+    rlMatrixMode(RL_PROJECTION);
+    rlPushMatrix();
+    rlLoadIdentity();
+    rlMultMatrixf(MatrixToFloat(c->proj));
+    rlMatrixMode(RL_MODELVIEW);
+    rlLoadIdentity();
+    rlMultMatrixf(MatrixToFloat(c->view));
+    rlEnableDepthTest();
+    shadowBeginCasterState(sc);
+
+    return true;
+}
+
+void shadowCacheEndCascade(ShadowCache *sc)
+{
+    EndMode3D();
+    shadowEndCasterState(sc);
+    EndTextureMode();
+}
+
+void shadowCacheBeginDynamic(ShadowCache *sc, Vector3 focus)
+{
+    /* same direction as the cascades, sat over focus */
+    sc->dynamic_cam.target = focus;
+    sc->dynamic_cam.position = Vector3Subtract(focus, Vector3Scale(sc->light_dir, 100.0f));
+    sc->dynamic_vp = shadowLightViewProj(sc->dynamic_cam);
+
+    BeginTextureMode(sc->dynamic_map);
+    ClearBackground(WHITE);
+    BeginMode3D(sc->dynamic_cam);
+    shadowBeginCasterState(sc);
+}
+
+void shadowCacheEndDynamic(ShadowCache *sc)
+{
+    EndMode3D();
+    shadowEndCasterState(sc);
+    EndTextureMode();
+}
+
+void shadowCacheSetCaster(ShadowCache *sc, Shader lit, Shader depth)
+{
+    hmput(sc->casters, lit.id, depth);
+}
+
+void shadowDrawModel(ShadowCache *sc, Model model, Vector3 position, float scale)
+{
+    /* model is a copy, but materials is shared so the swap must be undone */
+    Shader lit[model.materialCount];
+    for (int i = 0; i < model.materialCount; ++i) {
+        lit[i] = model.materials[i].shader;
+        struct ShadowCasterMap *caster = hmgetp_null(sc->casters, lit[i].id);
+        model.materials[i].shader = caster ? caster->value : sc->depth_shader;
+    }
+
+    DrawModel(model, position, scale, WHITE);
+
+    for (int i = 0; i < model.materialCount; ++i)
+        model.materials[i].shader = lit[i];
+}
+
+void shadowCacheSetupShader(Shader shader)
+{
+    int cascade_slot = SHADOW_CASCADE_SLOT;
+    int dynamic_slot = SHADOW_DYNAMIC_SLOT;
+    rlEnableShader(shader.id);
+    rlSetUniform(GetShaderLocation(shader, "shadowCascades"), &cascade_slot, SHADER_UNIFORM_INT, 1);
+    rlSetUniform(GetShaderLocation(shader, "shadowMapDynamic"), &dynamic_slot, SHADER_UNIFORM_INT, 1);
+    rlDisableShader();
+}
+
+void shadowCacheBind(ShadowCache *sc)
+{
+    struct FrameUniforms *f = &uniform_buffers.frame;
+    for (int i = 0; i < sc->cascade_count; ++i) {
+        f->cascade_vp[i] = MatrixToFloatV(sc->cascades[i].vp);
+        f->cascade_splits[i] = sc->cascades[i].split_far;
+    }
+    f->cascade_count = sc->cascade_count;
+    f->shadow_map_resolution = sc->resolution;
+    f->light_vp_dynamic = MatrixToFloatV(sc->dynamic_vp);
+    f->shadow_map_dynamic_resolution = sc->dynamic_resolution;
+
+    rlActiveTextureSlot(SHADOW_CASCADE_SLOT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, sc->cascade_array);
+    rlActiveTextureSlot(SHADOW_DYNAMIC_SLOT);
+    rlEnableTexture(sc->dynamic_map.depth.id);
+    rlActiveTextureSlot(0);
+}
@@ -0,0 +1,532 @@
+/*****************************************************
+Create Date:        2024-12-17
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/soft_render.h"
+#include "../include/obh/simd.h"
+#include "../include/obh/util.h"
+#include "../include/obh/c_log.h"
+#include "../include/obh/cull.h"
+#include "../include/obh/stb_impl.h"
+#include "../include/raylib/rlgl.h"
+
+/* clip x, y, z, w then the lambert term and shadow map x, y, depth */
+#define SOFT_VERTEX 8
+/* shadow bias in world units, the slope part grows as the surface turns from the light */
+#define SOFT_RENDER_BIAS 0.08f
+#define SOFT_RENDER_SLOPE_BIAS 0.3f
+
+static void softTargetInit(struct SoftTarget *t, int width, int height, bool ids, bool color)
+{
+    *t = (struct SoftTarget) { .width = width, .height = height };
+    t->tiles_x = (width + SOFT_RENDER_TILE - 1) / SOFT_RENDER_TILE;
+    t->tiles_y = (height + SOFT_RENDER_TILE - 1) / SOFT_RENDER_TILE;
+    t->depth = MemAlloc((size_t)width * height * sizeof(float));
+    if (ids)
+        t->ids = MemAlloc((size_t)width * height * sizeof(i32));
+    if (color)
+        t->color = MemAlloc((size_t)width * height * sizeof(Color));
+}
+
+static void softTargetUnload(struct SoftTarget *t)
+{
+    MemFree(t->depth);
+    MemFree(t->ids);
+    MemFree(t->color);
+    *t = (struct SoftTarget) { 0 };
+}
+
+void softRenderInit(SoftRender *sr, int width, int height, int threads)
+{
+    *sr = (SoftRender) { 0 };
+    width = (width + 3) & ~3;
+    softTargetInit(&sr->screen, width, height, true, true);
+    softTargetInit(&sr->shadow, SOFT_RENDER_SHADOW_SIZE, SOFT_RENDER_SHADOW_SIZE, false, false);
+
+    /* the scene defaults main uploads */
+    sr->light_dir = Vector3Normalize((Vector3) { 0.35f, -1.0f, -0.35f });
+    sr->light_color = (Vector3) { 1, 1, 1 };
+    sr->ambient = (Vector3) { 0.1f, 0.1f, 0.1f };
+    sr->base = BROWN;
+    sr->background = BLUE;
+    for (int i = 0; i < 1024; ++i)
+        sr->gamma[i] = (u8)(powf(i / 1023.0f, 1 / 2.2f) * 255 + 0.5f);
+
+    jobPoolInit(&sr->pool, threads, SOFT_RENDER_MAX_THREADS, "soft render");
+}
+
+static void softChunkUnload(struct SoftChunk *chunk)
+{
+    MemFree(chunk->mesh.vertices);
+    MemFree(chunk->mesh.normals);
+    MemFree(chunk->mesh.texcoords);
+    MemFree(chunk->mesh.indices);
+    *chunk = (struct SoftChunk) { 0 };
+}
+
+void softRenderUnload(SoftRender *sr)
+{
+    jobPoolUnload(&sr->pool);
+
+    for (int i = 0; i < SOFT_RENDER_MAX_THREADS; ++i) {
+        struct SoftRenderThread *th = &sr->threads[i];
+        for (int b = 0; b < th->bin_count; ++b)
+            arrfree(th->bins[b]);
+        MemFree(th->bins);
+        arrfree(th->vertices);
+        arrfree(th->triangles);
+    }
+    for (int i = 0; i < hmlen(sr->chunks); ++i)
+        softChunkUnload(&sr->chunks[i].value);
+    hmfree(sr->chunks);
+    arrfree(sr->frame_chunks);
+    softTargetUnload(&sr->screen);
+    softTargetUnload(&sr->shadow);
+    *sr = (SoftRender) { 0 };
+}
+
+static Vector4 softTransform(const Matrix *m, Vector3 p)
+{
+    return (Vector4) {
+        m->m0 * p.x + m->m4 * p.y + m->m8 * p.z + m->m12,
+        m->m1 * p.x + m->m5 * p.y + m->m9 * p.z + m->m13,
+        m->m2 * p.x + m->m6 * p.y + m->m10 * p.z + m->m14,
+        m->m3 * p.x + m->m7 * p.y + m->m11 * p.z + m->m15,
+    };
+}
+
+/* value of a plane over pixel centres from its value at the three vertices */
+static void softPlane(const struct SoftTriangle *tri, const float f[3], float inv_area, float out[3])
+{
+    out[0] = (tri->a[0] * f[0] + tri->a[1] * f[1] + tri->a[2] * f[2]) * inv_area;
+    out[1] = (tri->b[0] * f[0] + tri->b[1] * f[1] + tri->b[2] * f[2]) * inv_area;
+    out[2] = (tri->c[0] * f[0] + tri->c[1] * f[1] + tri->c[2] * f[2]) * inv_area;
+}
+
+static void softRenderSetup(SoftRender *sr, struct SoftRenderThread *th, const float *p0, const float *p1, const float *p2)
+{
+    const struct SoftTarget *t = sr->target;
+    const float *p[3] = { p0, p1, p2 };
+    float sx[3], sy[3], sz[3], iw[3];
+    for (int k = 0; k < 3; ++k) {
+        iw[k] = 1.0f / p[k][3];
+        sx[k] = (p[k][0] * iw[k] * 0.5f + 0.5f) * t->width;
+        sy[k] = (0.5f - p[k][1] * iw[k] * 0.5f) * t->height;
+        sz[k] = p[k][2] * iw[k] * 0.5f + 0.5f;
+    }
+
+    float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+    /* y points down here, gl's counter clockwise front faces come out negative */
+    if (sr->cull ? area > -1e-6f : fabsf(area) < 1e-6f)
+        return;
+    int order[3] = { 0, 1, 2 };
+    if (area < 0) {
+        order[1] = 2;
+        order[2] = 1;
+        area = -area;
+    }
+
+    struct SoftTriangle tri;
+    tri.min_x = max((int)floorf(fminf(sx[0], fminf(sx[1], sx[2]))), 0);
+    tri.max_x = min((int)ceilf(fmaxf(sx[0], fmaxf(sx[1], sx[2]))), t->width - 1);
+    tri.min_y = max((int)floorf(fminf(sy[0], fminf(sy[1], sy[2]))), 0);
+    tri.max_y = min((int)ceilf(fmaxf(sy[0], fmaxf(sy[1], sy[2]))), t->height - 1);
+    if (tri.min_x > tri.max_x || tri.min_y > tri.max_y)
+        return;
+
+    /* edge k is opposite vertex k: E(p) = a * px + b * py + c */
+    for (int k = 0; k < 3; ++k) {
+        int i = order[(k + 1) % 3], j = order[(k + 2) % 3];
+        tri.a[k] = -(sy[j] - sy[i]);
+        tri.b[k] = sx[j] - sx[i];
+        tri.c[k] = (sy[j] - sy[i]) * sx[i] - (sx[j] - sx[i]) * sy[i];
+    }
+    float inv_area = 1.0f / area;
+    float f[3];
+    for (int k = 0; k < 3; ++k)
+        f[k] = sz[order[k]];
+    softPlane(&tri, f, inv_area, tri.z);
+    for (int k = 0; k < 3; ++k)
+        f[k] = iw[order[k]];
+    softPlane(&tri, f, inv_area, tri.inv_w);
+    if (t->color != NULL) {
+        for (int a = 0; a < 4; ++a) {
+            for (int k = 0; k < 3; ++k)
+                f[k] = p[order[k]][4 + a] * iw[order[k]];
+            softPlane(&tri, f, inv_area, tri.attr[a]);
+        }
+    }
+
+    int index = arrlen(th->triangles);
+    arrput(th->triangles, tri);
+    for (int ty = tri.min_y / SOFT_RENDER_TILE; ty <= tri.max_y / SOFT_RENDER_TILE; ++ty)
+        for (int tx = tri.min_x / SOFT_RENDER_TILE; tx <= tri.max_x / SOFT_RENDER_TILE; ++tx)
+            arrput(th->bins[ty * t->tiles_x + tx], index);
+}
+
+/* against the near plane only, the bounding box clamp handles the sides */
+static void softRenderClip(SoftRender *sr, struct SoftRenderThread *th, const float *v0, const float *v1, const float *v2)
+{
+    const float *in[3] = { v0, v1, v2 };
+    float d[3];
+    int inside = 0;
+    for (int k = 0; k < 3; ++k) {
+        d[k] = in[k][2] + in[k][3];
+        inside += d[k] >= 0;
+    }
+    if (inside == 3) {
+        softRenderSetup(sr, th, v0, v1, v2);
+        return;
+    }
+    if (inside == 0)
+        return;
+
+    float poly[4][SOFT_VERTEX];
+    int n = 0;
+    for (int k = 0; k < 3; ++k) {
+        const float *a = in[k], *b = in[(k + 1) % 3];
+        float da = d[k], db = d[(k + 1) % 3];
+        if (da >= 0)
+            memcpy(poly[n++], a, sizeof(poly[0]));
+        if ((da >= 0) != (db >= 0)) {
+            float s = da / (da - db);
+            for (int c = 0; c < SOFT_VERTEX; ++c)
+                poly[n][c] = a[c] + (b[c] - a[c]) * s;
+            n++;
+        }
+    }
+    for (int i = 1; i + 1 < n; ++i)
+        softRenderSetup(sr, th, poly[0], poly[i], poly[i + 1]);
+}
+
+static void softRenderSetupChunk(SoftRender *sr, struct SoftRenderThread *th, const struct SoftChunk *chunk)
+{
+    const Mesh *mesh = &chunk->mesh;
+    bool lit = sr->target->color != NULL;
+    Vector3 to_light = Vector3Negate(sr->light_dir);
+
+    arrsetlen(th->vertices, mesh->vertexCount * SOFT_VERTEX);
+    for (int v = 0; v < mesh->vertexCount; ++v) {
+        float *out = &th->vertices[v * SOFT_VERTEX];
+        Vector3 p = Vector3Add(*(const Vector3 *)&mesh->vertices[v * 3], chunk->origin);
+        Vector4 clip = softTransform(sr->transform, p);
+        out[0] = clip.x;
+        out[1] = clip.y;
+        out[2] = clip.z;
+        out[3] = clip.w;
+        if (!lit)
+            continue;
+        /* the light is orthographic, w stays 1 */
+        Vector4 light = softTransform(&sr->light_proj, p);
+        out[4] = fmaxf(Vector3DotProduct(*(const Vector3 *)&mesh->normals[v * 3], to_light), 0);
+        out[5] = (light.x * 0.5f + 0.5f) * sr->shadow.width;
+        out[6] = (0.5f - light.y * 0.5f) * sr->shadow.height;
+        out[7] = light.z * 0.5f + 0.5f;
+    }
+
+    for (int i = 0; i < mesh->triangleCount; ++i) {
+        const unsigned short *idx = &mesh->indices[i * 3];
+        softRenderClip(sr, th, &th->vertices[idx[0] * SOFT_VERTEX],
+                &th->vertices[idx[1] * SOFT_VERTEX], &th->vertices[idx[2] * SOFT_VERTEX]);
+    }
+}
+
+static void softRenderRasterTriangle(struct SoftTarget *t, const struct SoftTriangle *tri, i32 id,
+        int x0, int y0, int x1, int y1)
+{
+    /* tiles start on a multiple of 4, so rows of 4 never leave the tile */
+    int min_x = max(tri->min_x, x0) & ~3, max_x = min(tri->max_x, x1 - 1);
+    int min_y = max(tri->min_y, y0), max_y = min(tri->max_y, y1 - 1);
+
+    const v4f lane = { 0.5f, 1.5f, 2.5f, 3.5f };
+    const v4f zero = V4F(0.0f);
+    const v4i ids = V4I(id);
+    for (int y = min_y; y <= max_y; ++y) {
+        float py = y + 0.5f;
+        v4f row0 = V4F(tri->b[0] * py + tri->c[0]);
+        v4f row1 = V4F(tri->b[1] * py + tri->c[1]);
+        v4f row2 = V4F(tri->b[2] * py + tri->c[2]);
+        v4f rowz = V4F(tri->z[1] * py + tri->z[2]);
+        float *depth = &t->depth[y * t->width];
+        for (int x = min_x; x <= max_x; x += 4) {
+            v4f px = V4F((float)x) + lane;
+            v4i inside = (V4F(tri->a[0]) * px + row0 >= zero)
+                & (V4F(tri->a[1]) * px + row1 >= zero)
+                & (V4F(tri->a[2]) * px + row2 >= zero);
+            if (!v4i_any(inside))
+                continue;
+            v4f z = V4F(tri->z[0]) * px + rowz;
+            v4f d = v4f_load(&depth[x]);
+            v4i pass = inside & (z < d);
+            v4f_store(&depth[x], v4f_select(pass, z, d));
+            if (t->ids != NULL) {
+                i32 *dst = &t->ids[y * t->width + x];
+                v4i_store(dst, (pass & ids) | (~pass & v4i_load(dst)));
+            }
+        }
+    }
+}
+
+/* fraction of the 3x3 texels around u, v closer to the light than depth */
+static float softRenderShadow(const SoftRender *sr, float u, float v, float depth)
+{
+    const struct SoftTarget *s = &sr->shadow;
+    /* outside the map nothing is known, so nothing is shadowed */
+    if (u < 0 || v < 0 || u >= s->width || v >= s->height)
+        return 0;
+    int cx = (int)u, cy = (int)v;
+    int hits = 0;
+    for (int dy = -1; dy <= 1; ++dy) {
+        int y = Clamp(cy + dy, 0, s->height - 1);
+        for (int dx = -1; dx <= 1; ++dx) {
+            int x = Clamp(cx + dx, 0, s->width - 1);
+            hits += depth > s->depth[y * s->width + x];
+        }
+    }
+    return hits / 9.0f;
+}
+
+static u8 softRenderGamma(const SoftRender *sr, float v)
+{
+    return sr->gamma[(int)(Clamp(v, 0, 1) * 1023 + 0.5f)];
+}
+
+static void softRenderShadeTile(SoftRender *sr, int x0, int y0, int x1, int y1)
+{
+    struct SoftTarget *t = &sr->screen;
+    Vector3 base = { sr->base.r / 255.0f, sr->base.g / 255.0f, sr->base.b / 255.0f };
+    /* basic_shadow.fs divides the ambient by 10 */
+    Vector3 ambient = Vector3Multiply(base, Vector3Scale(sr->ambient, 0.1f));
+    Vector3 diffuse = Vector3Multiply(base, sr->light_color);
+
+    for (int y = y0; y < y1; ++y) {
+        float py = y + 0.5f;
+        for (int x = x0; x < x1; ++x) {
+            int p = y * t->width + x;
+            i32 id = t->ids[p];
+            if (id < 0) {
+                t->color[p] = sr->background;
+                continue;
+            }
+            const struct SoftTriangle *tri = &sr->threads[id >> 24].triangles[id & 0xffffff];
+            float px = x + 0.5f;
+            float w = 1.0f / (tri->inv_w[0] * px + tri->inv_w[1] * py + tri->inv_w[2]);
+            float attr[4];
+            for (int a = 0; a < 4; ++a)
+                attr[a] = (tri->attr[a][0] * px + tri->attr[a][1] * py + tri->attr[a][2]) * w;
+
+            float ndl = attr[0];
+            float bias = (SOFT_RENDER_BIAS + SOFT_RENDER_SLOPE_BIAS * (1 - ndl)) * sr->light_depth_scale;
+            float lit = ndl * (1 - softRenderShadow(sr, attr[1], attr[2], attr[3] - bias));
+            t->color[p] = (Color) {
+                softRenderGamma(sr, diffuse.x * lit + ambient.x),
+                softRenderGamma(sr, diffuse.y * lit + ambient.y),
+                softRenderGamma(sr, diffuse.z * lit + ambient.z),
+                255,
+            };
+        }
+    }
+}
+
+static void softRenderTile(SoftRender *sr, int tile)
+{
+    struct SoftTarget *t = sr->target;
+    int x0 = (tile % t->tiles_x) * SOFT_RENDER_TILE, y0 = (tile / t->tiles_x) * SOFT_RENDER_TILE;
+    int x1 = min(x0 + SOFT_RENDER_TILE, t->width), y1 = min(y0 + SOFT_RENDER_TILE, t->height);
+
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; x += 4) {
+            v4f_store(&t->depth[y * t->width + x], V4F(1.0f));
+            if (t->ids != NULL)
+                v4i_store(&t->ids[y * t->width + x], V4I(-1));
+        }
+    }
+    for (int i = 0; i < sr->pool.thread_count; ++i) {
+        const struct SoftRenderThread *th = &sr->threads[i];
+        const i32 *bin = th->bins[tile];
+        for (int b = 0; b < arrlen(bin); ++b)
+            softRenderRasterTriangle(t, &th->triangles[bin[b]], i << 24 | bin[b], x0, y0, x1, y1);
+    }
+    if (t->color != NULL)
+        softRenderShadeTile(sr, x0, y0, x1, y1);
+}
+
+static void softRenderSetupRun(void *user, int item, int thread)
+{
+    SoftRender *sr = user;
+    softRenderSetupChunk(sr, &sr->threads[thread], sr->frame_chunks[item]);
+}
+
+static void softRenderTileRun(void *user, int item, int thread)
+{
+    softRenderTile(user, item);
+}
+
+/* set up chunks [0, chunks) of frame_chunks and rasterize them into target */
+static void softRenderPass(SoftRender *sr, struct SoftTarget *target, const Matrix *transform, bool cull, int chunks)
+{
+    int tiles = target->tiles_x * target->tiles_y;
+    for (int i = 0; i < sr->pool.thread_count; ++i) {
+        struct SoftRenderThread *th = &sr->threads[i];
+        if (th->bin_count < tiles) {
+            th->bins = MemRealloc(th->bins, tiles * sizeof(i32 *));
+            memset(th->bins + th->bin_count, 0, (tiles - th->bin_count) * sizeof(i32 *));
+            th->bin_count = tiles;
+        }
+        for (int b = 0; b < tiles; ++b)
+            arrsetlen(th->bins[b], 0);
+        arrsetlen(th->triangles, 0);
+    }
+    sr->target = target;
+    sr->transform = transform;
+    sr->cull = cull;
+
+    double start = time_ms();
+    jobPoolDispatch(&sr->pool, chunks, softRenderSetupRun, sr);
+    double setup_ms = time_ms() - start;
+    jobPoolDispatch(&sr->pool, tiles, softRenderTileRun, sr);
+    double raster_ms = time_ms() - start - setup_ms;
+
+    if (target == &sr->screen) {
+        sr->setup_ms = setup_ms;
+        sr->raster_ms = raster_ms;
+    }
+}
+
+/* build or rebuild meshes for every chunk terrain would draw, drop the rest */
+static void softRenderGather(SoftRender *sr, const Terrain *terrain, Vector3 focus)
+{
+    iVec2 fc = getChunkCoords(focus);
+    for (int i = 0; i < hmlen(world_map); ++i) {
+        const struct WorldChunk *wc = &world_map[i].chunk;
+        int lod = terrainLodForDistance(terrain, max(abs(wc->coord.x - fc.x), abs(wc->coord.y - fc.y)));
+        if (lod < 0)
+            continue;
+        struct SoftChunkMap *sc = hmgetp_null(sr->chunks, wc->coord);
+        if (sc == NULL) {
+            hmput(sr->chunks, wc->coord, ((struct SoftChunk) { .lod = -1 }));
+            sc = hmgetp_null(sr->chunks, wc->coord);
+        }
+        struct SoftChunk *chunk = &sc->value;
+        chunk->frame = sr->frame;
+        if (chunk->lod == lod && chunk->revision == wc->revision)
+            continue;
+
+        softChunkUnload(chunk);
+        chunk->lod = lod;
+        chunk->revision = wc->revision;
+        chunk->frame = sr->frame;
+        chunk->mesh = terrainGenChunkMesh(wc, lod);
+        chunk->origin = terrainPatchOrigin(wc->coord);
+        BoundingBox b = { { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY } };
+        for (int v = 0; v < chunk->mesh.vertexCount; ++v) {
+            Vector3 p = Vector3Add(*(const Vector3 *)&chunk->mesh.vertices[v * 3], chunk->origin);
+            b.min = Vector3Min(b.min, p);
+            b.max = Vector3Max(b.max, p);
+        }
+        chunk->bounds = b;
+    }
+
+    iVec2 *evict = NULL;
+    for (int i = 0; i < hmlen(sr->chunks); ++i)
+        if (sr->chunks[i].value.frame != sr->frame)
+            arrput(evict, sr->chunks[i].key);
+    for (int i = 0; i < arrlen(evict); ++i) {
+        softChunkUnload(&hmgetp(sr->chunks, evict[i])->value);
+        (void)hmdel(sr->chunks, evict[i]);
+    }
+    arrfree(evict);
+}
+
+/* fit an orthographic light over every chunk drawn */
+static void softRenderFitLight(SoftRender *sr)
+{
+    BoundingBox all = { { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY } };
+    for (int i = 0; i < arrlen(sr->frame_chunks); ++i) {
+        all.min = Vector3Min(all.min, sr->frame_chunks[i]->bounds.min);
+        all.max = Vector3Max(all.max, sr->frame_chunks[i]->bounds.max);
+    }
+    Vector3 center = Vector3Scale(Vector3Add(all.min, all.max), 0.5f);
+    float radius = Vector3Distance(all.min, all.max) * 0.5f + 1;
+    Vector3 up = fabsf(sr->light_dir.y) > 0.99f ? (Vector3) { 1, 0, 0 } : (Vector3) { 0, 1, 0 };
+    Matrix view = MatrixLookAt(Vector3Subtract(center, Vector3Scale(sr->light_dir, radius)), center, up);
+
+    Vector3 lo = { INFINITY, INFINITY, INFINITY }, hi = { -INFINITY, -INFINITY, -INFINITY };
+    for (int c = 0; c < 8; ++c) {
+        Vector3 p = { c & 1 ? all.max.x : all.min.x, c & 2 ? all.max.y : all.min.y, c & 4 ? all.max.z : all.min.z };
+        p = Vector3Transform(p, view);
+        lo = Vector3Min(lo, p);
+        hi = Vector3Max(hi, p);
+    }
+    /* view space looks down -z */
+    Matrix proj = MatrixOrtho(lo.x, hi.x, lo.y, hi.y, -hi.z, -lo.z);
+    sr->light_proj = MatrixMultiply(view, proj);
+    sr->light_depth_scale = 1.0f / fmaxf(hi.z - lo.z, 1e-3f);
+}
+
+void softRenderDraw(SoftRender *sr, const Terrain *terrain, Vector3 focus, Camera3D camera)
+{
+    double start = time_ms();
+    sr->frame++;
+    softRenderGather(sr, terrain, focus);
+
+    float aspect = (float)sr->screen.width / sr->screen.height;
+    Matrix view = MatrixLookAt(camera.position, camera.target, camera.up);
+    Matrix proj = MatrixPerspective(camera.fovy * DEG2RAD, aspect,
+            rlGetCullDistanceNear(), rlGetCullDistanceFar());
+    sr->view_proj = MatrixMultiply(view, proj);
+
+    /* visible chunks first, the shadow pass takes them all */
+    arrsetlen(sr->frame_chunks, 0);
+    u64 key = 1469598103934665603ull;
+    for (int i = 0; i < hmlen(sr->chunks); ++i) {
+        struct SoftChunk *chunk = &sr->chunks[i].value;
+        arrput(sr->frame_chunks, chunk);
+        /* order independent, hashmap order is not stable */
+        key += ((u64)(u32)sr->chunks[i].key.x * 73856093u ^ (u64)(u32)sr->chunks[i].key.y * 19349663u
+                ^ (u64)chunk->lod << 40 ^ chunk->revision * 83492791u) * 1099511628211ull;
+    }
+    sr->visible_chunks = 0;
+    for (int i = 0; i < arrlen(sr->frame_chunks); ++i) {
+        if (!cullBoxVisible(&sr->view_proj, sr->frame_chunks[i]->bounds))
+            continue;
+        struct SoftChunk *t = sr->frame_chunks[sr->visible_chunks];
+        sr->frame_chunks[sr->visible_chunks++] = sr->frame_chunks[i];
+        sr->frame_chunks[i] = t;
+    }
+    sr->mesh_ms = time_ms() - start;
+
+    /* terrain is static, the map only changes with the chunks drawn */
+    u32 light_bits[3];
+    memcpy(light_bits, &sr->light_dir, sizeof(light_bits));
+    key ^= (u64)light_bits[0] * 31 + (u64)light_bits[1] * 131 + (u64)light_bits[2] * 1031;
+    sr->shadow_rebuilt = key != sr->shadow_key;
+    sr->shadow_ms = 0;
+    if (sr->shadow_rebuilt) {
+        double shadow_start = time_ms();
+        softRenderFitLight(sr);
+        softRenderPass(sr, &sr->shadow, &sr->light_proj, false, arrlen(sr->frame_chunks));
+        sr->shadow_key = key;
+        sr->shadow_ms = time_ms() - shadow_start;
+    }
+
+    softRenderPass(sr, &sr->screen, &sr->view_proj, true, sr->visible_chunks);
+    sr->triangles = 0;
+    for (int i = 0; i < sr->pool.thread_count; ++i)
+        sr->triangles += arrlen(sr->threads[i].triangles);
+    sr->frame_ms = time_ms() - start;
+}
+
+bool softRenderSave(const SoftRender *sr, const char *path)
+{
+    const struct SoftTarget *t = &sr->screen;
+    if (!stbWritePng(path, t->width, t->height, 4, t->color, t->width * sizeof(Color))) {
+        c_log_error(LOG_TAG, "could not write %s", path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,324 @@
+/*****************************************************
+Create Date:        2024-12-14
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/sprite.h"
+#include "../include/obh/util.h"
+#include "../include/obh/c_log.h"
+#include "../include/obh/shader_cache.h"
+#include "../include/obh/stb_impl.h"
+#include "../include/raylib/rlgl.h"
+#include "../include/glad/glad.h"
+
+int spriteAtlasAdd(SpriteAtlas *atlas, Image image, int frames_x, int frames_y)
+{
+    Image copy = image;
+    if (image.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 && image.mipmaps == 1) {
+        size_t size = (size_t)image.width * image.height * 4;
+        copy.data = malloc(size);
+        memcpy(copy.data, image.data, size);
+    } else {
+        copy = ImageCopy(image);
+        ImageFormat(&copy, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    }
+
+    int first = arrlen(atlas->regions), frames = frames_x * frames_y;
+    arrput(atlas->sheets, ((struct SpriteSheet) { copy, frames_x, frames_y, first }));
+    arraddnptr(atlas->regions, frames);
+    return first;
+}
+
+int spriteAtlasLoad(SpriteAtlas *atlas, const char *path, int frames_x, int frames_y)
+{
+    Image image = LoadImage(path);
+    if (image.data == NULL) {
+        c_log_error(LOG_TAG, "could not load %s", path);
+        return -1;
+    }
+    int first = spriteAtlasAdd(atlas, image, frames_x, frames_y);
+    UnloadImage(image);
+    return first;
+}
+
+void spriteAtlasBuild(SpriteAtlas *atlas, bool gpu)
+{
+    int count = arrlen(atlas->regions);
+    stbrp_rect *rects = calloc(count, sizeof(*rects));
+    int n = 0;
+    for (int s = 0; s < arrlen(atlas->sheets); ++s) {
+        struct SpriteSheet *sheet = &atlas->sheets[s];
+        int w = sheet->image.width / sheet->frames_x, h = sheet->image.height / sheet->frames_y;
+        for (int f = 0; f < sheet->frames_x * sheet->frames_y; ++f) {
+            int id = sheet->first_region + f;
+            atlas->regions[id] = (struct SpriteRegion) { .page = -1 };
+            if (w + SPRITE_PAGE_GAP > SPRITE_PAGE_SIZE || h + SPRITE_PAGE_GAP > SPRITE_PAGE_SIZE) {
+                c_log_error(LOG_TAG, "frame %d x %d does not fit a %d page", w, h, SPRITE_PAGE_SIZE);
+                continue;
+            }
+            rects[n++] = (stbrp_rect) { .id = id, .w = w + SPRITE_PAGE_GAP, .h = h + SPRITE_PAGE_GAP };
+        }
+    }
+
+    /* fill a page, whatever did not fit goes on the next one */
+    stbrp_node *nodes = malloc(SPRITE_PAGE_SIZE * sizeof(*nodes));
+    while (n > 0) {
+        int page = arrlen(atlas->pages);
+        stbrp_context ctx;
+        stbrp_init_target(&ctx, SPRITE_PAGE_SIZE, SPRITE_PAGE_SIZE, nodes, SPRITE_PAGE_SIZE);
+        stbrp_pack_rects(&ctx, rects, n);
+
+        u8 *pixels = gpu ? calloc((size_t)SPRITE_PAGE_SIZE * SPRITE_PAGE_SIZE, 4) : NULL;
+        int left = 0;
+        for (int i = 0; i < n; ++i) {
+            if (!rects[i].was_packed) {
+                rects[left++] = rects[i];
+                continue;
+            }
+            struct SpriteRegion *r = &atlas->regions[rects[i].id];
+            r->page = page;
+            r->rec = (Rectangle) { rects[i].x, rects[i].y, rects[i].w - SPRITE_PAGE_GAP, rects[i].h - SPRITE_PAGE_GAP };
+            r->u0 = r->rec.x / SPRITE_PAGE_SIZE;
+            r->v0 = r->rec.y / SPRITE_PAGE_SIZE;
+            r->u1 = (r->rec.x + r->rec.width) / SPRITE_PAGE_SIZE;
+            r->v1 = (r->rec.y + r->rec.height) / SPRITE_PAGE_SIZE;
+        }
+        if (left == n) {
+            /* an empty page that can not take anything, give up on the rest */
+            free(pixels);
+            break;
+        }
+        n = left;
+
+        Texture2D tex = { .width = SPRITE_PAGE_SIZE, .height = SPRITE_PAGE_SIZE, .mipmaps = 1,
+            .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+        if (gpu) {
+            for (int s = 0; s < arrlen(atlas->sheets); ++s) {
+                const struct SpriteSheet *sheet = &atlas->sheets[s];
+                int w = sheet->image.width / sheet->frames_x, h = sheet->image.height / sheet->frames_y;
+                for (int f = 0; f < sheet->frames_x * sheet->frames_y; ++f) {
+                    const struct SpriteRegion *r = &atlas->regions[sheet->first_region + f];
+                    if (r->page != page)
+                        continue;
+                    int sx = f % sheet->frames_x * w, sy = f / sheet->frames_x * h;
+                    for (int y = 0; y < h; ++y) {
+                        memcpy(pixels + (((size_t)r->rec.y + y) * SPRITE_PAGE_SIZE + (size_t)r->rec.x) * 4,
+                                (u8 *)sheet->image.data + ((size_t)(sy + y) * sheet->image.width + sx) * 4,
+                                (size_t)w * 4);
+                    }
+                }
+            }
+            Image image = { pixels, SPRITE_PAGE_SIZE, SPRITE_PAGE_SIZE, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+            tex = LoadTextureFromImage(image);
+            free(pixels);
+        }
+        arrput(atlas->pages, tex);
+    }
+    free(nodes);
+    free(rects);
+
+    for (int s = 0; s < arrlen(atlas->sheets); ++s)
+        UnloadImage(atlas->sheets[s].image);
+    arrfree(atlas->sheets);
+    c_log_info(LOG_TAG, "%d frames packed into %d pages", count, (int)arrlen(atlas->pages));
+}
+
+void spriteAtlasUnload(SpriteAtlas *atlas)
+{
+    for (int i = 0; i < arrlen(atlas->pages); ++i) {
+        if (atlas->pages[i].id != 0)
+            UnloadTexture(atlas->pages[i]);
+    }
+    for (int s = 0; s < arrlen(atlas->sheets); ++s)
+        UnloadImage(atlas->sheets[s].image);
+    arrfree(atlas->sheets);
+    arrfree(atlas->regions);
+    arrfree(atlas->pages);
+}
+
+int spriteAnimFrame(int first, int frames, float fps, double time)
+{
+    return first + (int)(time * fps) % frames;
+}
+
+void spriteBatchInit(SpriteBatch *batch, const SpriteAtlas *atlas, bool billboard, bool gpu)
+{
+    *batch = (SpriteBatch) { .atlas = atlas, .billboard = billboard, .gpu = gpu };
+    if (!gpu)
+        return;
+
+    batch->shader = shaderCacheLoad("resources/shaders/sprite.vs", "resources/shaders/sprite.fs");
+    batch->mvp_loc = GetShaderLocation(batch->shader, "mvp");
+    glGenBuffers(1, &batch->ebo);
+    for (int p = 0; p < arrlen(atlas->pages); ++p) {
+        struct SpritePage page = { 0 };
+        glGenVertexArrays(1, &page.vao);
+        glGenBuffers(1, &page.vbo);
+        glBindVertexArray(page.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, page.vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->ebo);
+        /* the attribute locations raylib binds for vertexPosition, vertexTexCoord and vertexColor */
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(struct SpriteVertex),
+                (void *)offsetof(struct SpriteVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(struct SpriteVertex),
+                (void *)offsetof(struct SpriteVertex, uv));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(struct SpriteVertex),
+                (void *)offsetof(struct SpriteVertex, color));
+        glBindVertexArray(0);
+        arrput(batch->pages, page);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void spriteBatchUnload(SpriteBatch *batch)
+{
+    for (int p = 0; p < arrlen(batch->pages); ++p) {
+        glDeleteBuffers(1, &batch->pages[p].vbo);
+        glDeleteVertexArrays(1, &batch->pages[p].vao);
+    }
+    if (batch->gpu) {
+        glDeleteBuffers(1, &batch->ebo);
+        UnloadShader(batch->shader);
+    }
+    arrfree(batch->pages);
+    arrfree(batch->sprites);
+    arrfree(batch->order);
+    arrfree(batch->page_counts);
+    arrfree(batch->vertices);
+    *batch = (SpriteBatch) { 0 };
+}
+
+void spriteDraw(SpriteBatch *batch, int region, Vector3 position, Vector2 size, float rotation, Color tint)
+{
+    if (region < 0 || region >= arrlen(batch->atlas->regions) || batch->atlas->regions[region].page < 0)
+        return;
+    arrput(batch->sprites, ((struct SpriteInstance) { position, size, rotation, region, tint }));
+}
+
+/* group sprites by page and write their quads in that order */
+static void spriteBatchBuild(SpriteBatch *batch)
+{
+    const SpriteAtlas *atlas = batch->atlas;
+    int n = arrlen(batch->sprites);
+    int pages = arrlen(atlas->pages);
+
+    /* counting sort, page_counts ends up holding where each page starts */
+    arrsetlen(batch->page_counts, pages + 1);
+    memset(batch->page_counts, 0, (pages + 1) * sizeof(int));
+    for (int i = 0; i < n; ++i)
+        batch->page_counts[atlas->regions[batch->sprites[i].region].page + 1]++;
+    for (int p = 0; p < pages; ++p)
+        batch->page_counts[p + 1] += batch->page_counts[p];
+    arrsetlen(batch->order, n);
+    for (int i = 0; i < n; ++i)
+        batch->order[batch->page_counts[atlas->regions[batch->sprites[i].region].page]++] = i;
+    /* the scatter moved every start to the next page's, shift back */
+    memmove(batch->page_counts + 1, batch->page_counts, pages * sizeof(int));
+    batch->page_counts[0] = 0;
+
+    Vector3 right = { 1, 0, 0 }, down = { 0, 1, 0 };
+    if (batch->billboard && batch->gpu) {
+        Matrix view = rlGetMatrixModelview();
+        right = (Vector3) { view.m0, view.m4, view.m8 };
+        down = (Vector3) { -view.m1, -view.m5, -view.m9 };
+    }
+
+    arrsetlen(batch->vertices, n * 4);
+    struct SpriteVertex *v = batch->vertices;
+    for (int i = 0; i < n; ++i, v += 4) {
+        const struct SpriteInstance *s = &batch->sprites[batch->order[i]];
+        const struct SpriteRegion *r = &atlas->regions[s->region];
+        Vector3 ax = right, ay = down;
+        if (s->rotation != 0) {
+            float c = cosf(s->rotation * DEG2RAD), sn = sinf(s->rotation * DEG2RAD);
+            ax = Vector3Add(Vector3Scale(right, c), Vector3Scale(down, sn));
+            ay = Vector3Subtract(Vector3Scale(down, c), Vector3Scale(right, sn));
+        }
+        ax = Vector3Scale(ax, s->size.x * 0.5f);
+        ay = Vector3Scale(ay, s->size.y * 0.5f);
+        Vector3 p = s->position;
+        if (!batch->billboard)
+            p.z = 0;
+
+        v[0] = (struct SpriteVertex) { { p.x - ax.x - ay.x, p.y - ax.y - ay.y, p.z - ax.z - ay.z }, { r->u0, r->v0 }, s->color };
+        v[1] = (struct SpriteVertex) { { p.x - ax.x + ay.x, p.y - ax.y + ay.y, p.z - ax.z + ay.z }, { r->u0, r->v1 }, s->color };
+        v[2] = (struct SpriteVertex) { { p.x + ax.x + ay.x, p.y + ax.y + ay.y, p.z + ax.z + ay.z }, { r->u1, r->v1 }, s->color };
+        v[3] = (struct SpriteVertex) { { p.x + ax.x - ay.x, p.y + ax.y - ay.y, p.z + ax.z - ay.z }, { r->u1, r->v0 }, s->color };
+    }
+}
+
+/* quad indices for at least quads sprites */
+static void spriteBatchReserve(SpriteBatch *batch, int quads)
+{
+    if (quads <= batch->ebo_quads)
+        return;
+    batch->ebo_quads = max(quads, batch->ebo_quads * 2);
+    u32 *indices = malloc(batch->ebo_quads * 6 * sizeof(u32));
+    for (int q = 0; q < batch->ebo_quads; ++q) {
+        static const u32 quad[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int i = 0; i < 6; ++i)
+            indices[q * 6 + i] = q * 4 + quad[i];
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, batch->ebo_quads * 6 * sizeof(u32), indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    free(indices);
+}
+
+void spriteBatchFlush(SpriteBatch *batch)
+{
+    double start = time_ms();
+    spriteBatchBuild(batch);
+    batch->build_ms = time_ms() - start;
+    batch->drawn = arrlen(batch->sprites);
+    batch->draw_calls = 0;
+    arrsetlen(batch->sprites, 0);
+    if (!batch->gpu || batch->drawn == 0)
+        return;
+
+    int largest = 0;
+    for (int p = 0; p < arrlen(batch->pages); ++p)
+        largest = max(largest, batch->page_counts[p + 1] - batch->page_counts[p]);
+    /* before any vao is bound, the ebo is attached to all of them */
+    glBindVertexArray(0);
+    spriteBatchReserve(batch, largest);
+
+    /* whatever raylib has batched so far goes first */
+    rlDrawRenderBatchActive();
+    rlEnableShader(batch->shader.id);
+    rlSetUniformMatrix(batch->mvp_loc, MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection()));
+    rlActiveTextureSlot(0);
+    rlDisableBackfaceCulling();
+
+    for (int p = 0; p < arrlen(batch->pages); ++p) {
+        int first = batch->page_counts[p], count = batch->page_counts[p + 1] - first;
+        if (count == 0)
+            continue;
+        struct SpritePage *page = &batch->pages[p];
+        size_t size = (size_t)count * 4 * sizeof(struct SpriteVertex);
+        glBindBuffer(GL_ARRAY_BUFFER, page->vbo);
+        if (size > page->vbo_size) {
+            page->vbo_size = size * 2;
+            glBufferData(GL_ARRAY_BUFFER, page->vbo_size, NULL, GL_STREAM_DRAW);
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, batch->vertices + first * 4);
+
+        rlEnableTexture(batch->atlas->pages[p].id);
+        glBindVertexArray(page->vao);
+        glDrawElements(GL_TRIANGLES, count * 6, GL_UNSIGNED_INT, 0);
+        batch->draw_calls++;
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    rlEnableBackfaceCulling();
+    rlDisableTexture();
+    rlDisableShader();
+}
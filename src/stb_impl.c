@@ -0,0 +1,30 @@
+/*****************************************************
+Create Date:        2024-12-13
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/stb_impl.h"
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "../include/stb/stb_rect_pack.h"
+
+/* static, most of it goes unused */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../include/stb/stb_image_write.h"
+#pragma GCC diagnostic pop
+
+bool stbWritePng(const char *path, int width, int height, int channels, const void *data, int stride)
+{
+    return stbi_write_png(path, width, height, channels, data, stride) != 0;
+}
+
+bool stbWriteJpg(const char *path, int width, int height, int channels, const void *data, int quality)
+{
+    return stbi_write_jpg(path, width, height, channels, data, quality) != 0;
+}
@@ -0,0 +1,278 @@
+/*****************************************************
+Create Date:        2024-12-12
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/sun_bake.h"
+#include "../include/obh/util.h"
+#include "../include/raylib/rlgl.h"
+
+/* ray march step in columns */
+#define SUN_BAKE_STEP 0.25f
+/* keeps rays from hitting the face they start on */
+#define SUN_BAKE_EPSILON 0.01f
+/* new chunks snapshotted per sunBakeUpdate, the copy runs on the main thread */
+#define SUN_BAKE_QUEUE_PER_UPDATE 64
+
+static int sunBakeWrap(int v, int n)
+{
+    return ((v % n) + n) % n;
+}
+
+static float sunBakeHeightAt(const struct SunBakeJob *job, Vector3 p, bool *inside)
+{
+    int i = (int)floorf(p.x + 0.5f), j = (int)floorf(p.z + 0.5f);
+    *inside = i >= 0 && j >= 0 && i < SUN_BAKE_SPAN && j < SUN_BAKE_SPAN;
+    return *inside ? job->heights[j * SUN_BAKE_SPAN + i] : -INFINITY;
+}
+
+/* true if a column top is hit before the ray climbs above every column in reach */
+static bool sunBakeOccluded(const struct SunBakeJob *job, Vector3 p, Vector3 dir)
+{
+    Vector3 step = Vector3Scale(dir, SUN_BAKE_STEP);
+    for (;;) {
+        p = Vector3Add(p, step);
+        if (p.y > job->top)
+            return false;
+        bool inside;
+        float h = sunBakeHeightAt(job, p, &inside);
+        if (!inside)
+            return false;
+        /* columns are solid from their top cube down */
+        if (p.y < h + 0.5f)
+            return true;
+    }
+}
+
+static u8 sunBakeSun(const SunBake *sb, const struct SunBakeJob *job, Vector3 p)
+{
+    int lit = 0;
+    for (int r = 0; r < SUN_BAKE_SUN_RAYS; ++r)
+        lit += !sunBakeOccluded(job, p, sb->sun_rays[r]);
+    return 255 * lit / SUN_BAKE_SUN_RAYS;
+}
+
+static void sunBakeJob(const SunBake *sb, struct SunBakeJob *job)
+{
+    const int b = SUN_BAKE_BORDER;
+    float side_x = sb->sun_dir.x < 0 ? -1 : 1;
+    float side_z = sb->sun_dir.z < 0 ? -1 : 1;
+    float sky_total = 0;
+    for (int r = 0; r < SUN_BAKE_SKY_RAYS; ++r)
+        sky_total += sb->sky_weights[r];
+
+    for (int z = 0; z < CHUNKSIZE; ++z) {
+        for (int x = 0; x < CHUNKSIZE; ++x) {
+            float h = job->heights[(z + b) * SUN_BAKE_SPAN + x + b];
+            Vector3 top = { x + b, h + 0.5f + SUN_BAKE_EPSILON, z + b };
+            Vector3 face_x = { x + b + side_x * (0.5f + SUN_BAKE_EPSILON), h, z + b };
+            Vector3 face_z = { x + b, h, z + b + side_z * (0.5f + SUN_BAKE_EPSILON) };
+
+            float sky = 0;
+            for (int r = 0; r < SUN_BAKE_SKY_RAYS; ++r)
+                sky += sunBakeOccluded(job, top, sb->sky_rays[r]) ? 0 : sb->sky_weights[r];
+
+            u8 *t = &job->texels[(z * CHUNKSIZE + x) * 4];
+            t[0] = sunBakeSun(sb, job, top);
+            t[1] = sunBakeSun(sb, job, face_x);
+            t[2] = sunBakeSun(sb, job, face_z);
+            t[3] = 255 * sky / sky_total;
+        }
+    }
+}
+
+static void *sunBakeRun(void *arg, void *user)
+{
+    struct SunBakeJob *job = arg;
+    double start = time_ms();
+    sunBakeJob(user, job);
+    job->ms = time_ms() - start;
+    return job;
+}
+
+void sunBakeInit(SunBake *sb, Vector3 light_dir, int threads, bool gpu)
+{
+    *sb = (SunBake) { 0 };
+    sb->sun_dir = Vector3Normalize(Vector3Negate(light_dir));
+
+    /* a few rays across the sun's disc soften the edges */
+    Vector3 u = Vector3Normalize(Vector3CrossProduct(sb->sun_dir,
+                fabsf(sb->sun_dir.y) > 0.99f ? (Vector3) { 1, 0, 0 } : (Vector3) { 0, 1, 0 }));
+    Vector3 v = Vector3CrossProduct(sb->sun_dir, u);
+    for (int r = 0; r < SUN_BAKE_SUN_RAYS; ++r) {
+        float a = 2 * PI * (r + 0.5f) / SUN_BAKE_SUN_RAYS;
+        Vector3 offset = Vector3Add(Vector3Scale(u, cosf(a) * 0.03f), Vector3Scale(v, sinf(a) * 0.03f));
+        sb->sun_rays[r] = Vector3Normalize(Vector3Add(sb->sun_dir, offset));
+    }
+    /* three rings of sky, cosine weighted for the top face; the lowest
+     * ring stays steep enough to clear the tallest column within the border */
+    for (int r = 0; r < SUN_BAKE_SKY_RAYS; ++r) {
+        int ring = r / 4;
+        float elevation = (30 + 20 * ring) * DEG2RAD;
+        float azimuth = (r % 4 + 0.5f * ring) * PI / 2;
+        sb->sky_rays[r] = (Vector3) { cosf(elevation) * cosf(azimuth), sinf(elevation), cosf(elevation) * sinf(azimuth) };
+        sb->sky_weights[r] = sinf(elevation);
+    }
+
+    sb->gpu = gpu;
+    if (gpu) {
+        /* unbaked columns read as fully lit */
+        Image white = GenImageColor(SUN_BAKE_SIZE, SUN_BAKE_SIZE, WHITE);
+        sb->texture = LoadTextureFromImage(white);
+        UnloadImage(white);
+        SetTextureFilter(sb->texture, TEXTURE_FILTER_POINT);
+        SetTextureWrap(sb->texture, TEXTURE_WRAP_REPEAT);
+    }
+
+    if (workQueueInit(&sb->queue, threads, SUN_BAKE_MAX_THREADS, sunBakeRun, sb, "sun bake") == 0)
+        c_log_error(LOG_TAG, "no sun bake workers, terrain stays unbaked");
+}
+
+void sunBakeUnload(SunBake *sb)
+{
+    workQueueUnload(&sb->queue, MemFree);
+    if (sb->gpu)
+        UnloadTexture(sb->texture);
+    *sb = (SunBake) { 0 };
+}
+
+static struct SunBakeSlot *sunBakeSlot(SunBake *sb, iVec2 coord)
+{
+    return &sb->slots[sunBakeWrap(coord.y, SUN_BAKE_CHUNKS)][sunBakeWrap(coord.x, SUN_BAKE_CHUNKS)];
+}
+
+/* the chunk and its neighbours, NULL where not generated */
+static u64 sunBakeNeighbours(iVec2 coord, const struct WorldChunk *nb[3][3])
+{
+    u64 stamp = 0;
+    for (int dz = -1; dz <= 1; ++dz) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            struct WorldMap *entry = hmgetp_null(world_map, ((iVec2) { coord.x + dx, coord.y + dz }));
+            nb[dz + 1][dx + 1] = entry ? &entry->chunk : NULL;
+            if (entry)
+                stamp = max(stamp, entry->chunk.revision);
+        }
+    }
+    return stamp;
+}
+
+static struct SunBakeJob *sunBakeSnapshot(iVec2 coord, u64 stamp, const struct WorldChunk *nb[3][3])
+{
+    struct SunBakeJob *job = MemAlloc(sizeof(*job));
+    job->coord = coord;
+    job->stamp = stamp;
+    job->top = -INFINITY;
+    for (int j = 0; j < SUN_BAKE_SPAN; ++j) {
+        for (int i = 0; i < SUN_BAKE_SPAN; ++i) {
+            /* border < CHUNKSIZE, so every column is in the 3x3 neighbourhood */
+            int lx = i - SUN_BAKE_BORDER, lz = j - SUN_BAKE_BORDER;
+            int cx = lx < 0 ? 0 : lx < CHUNKSIZE ? 1 : 2;
+            int cz = lz < 0 ? 0 : lz < CHUNKSIZE ? 1 : 2;
+            const struct WorldChunk *wc = nb[cz][cx];
+            float h = wc
+                ? worldColumnHeight(wc, sunBakeWrap(lx, CHUNKSIZE), sunBakeWrap(lz, CHUNKSIZE))
+                : -INFINITY;
+            job->heights[j * SUN_BAKE_SPAN + i] = h;
+            job->top = fmaxf(job->top, h + 0.5f);
+        }
+    }
+    return job;
+}
+
+static void sunBakeCollect(SunBake *sb)
+{
+    void **done = workQueueTake(&sb->queue);
+    sb->chunks_outstanding = workQueueOutstanding(&sb->queue);
+
+    for (int i = 0; i < arrlen(done); ++i) {
+        struct SunBakeJob *job = done[i];
+        sb->bake_ms += job->ms;
+        /* the top and the two sides that can face the sun */
+        sb->faces_baked += CHUNKSIZE * CHUNKSIZE * 3;
+        struct SunBakeSlot *slot = sunBakeSlot(sb, job->coord);
+        /* dropped if the chunk changed again or the slot moved on while baking */
+        if (slot->used && slot->coord.x == job->coord.x && slot->coord.y == job->coord.y
+                && slot->stamp == job->stamp) {
+            if (sb->gpu) {
+                Rectangle rect = {
+                    sunBakeWrap(job->coord.x, SUN_BAKE_CHUNKS) * CHUNKSIZE,
+                    sunBakeWrap(job->coord.y, SUN_BAKE_CHUNKS) * CHUNKSIZE,
+                    CHUNKSIZE, CHUNKSIZE,
+                };
+                UpdateTextureRec(sb->texture, rect, job->texels);
+            }
+            slot->baked = true;
+            sb->chunks_baked++;
+        }
+        MemFree(job);
+    }
+    arrfree(done);
+}
+
+void sunBakeUpdate(SunBake *sb, Vector3 focus, int radius)
+{
+    sunBakeCollect(sb);
+    if (sb->queue.thread_count == 0)
+        return;
+
+    /* rings outwards, so the chunks around the player come back first */
+    iVec2 centre = getChunkCoords(focus);
+    struct SunBakeJob **queue = NULL;
+    for (int ring = 0; ring <= radius && arrlen(queue) < SUN_BAKE_QUEUE_PER_UPDATE; ++ring) {
+        for (int dz = -ring; dz <= ring; ++dz) {
+            for (int dx = -ring; dx <= ring; ++dx) {
+                if (max(abs(dx), abs(dz)) != ring || arrlen(queue) >= SUN_BAKE_QUEUE_PER_UPDATE)
+                    continue;
+                iVec2 coord = { centre.x + dx, centre.y + dz };
+                const struct WorldChunk *nb[3][3];
+                u64 stamp = sunBakeNeighbours(coord, nb);
+                if (nb[1][1] == NULL)
+                    continue;
+                struct SunBakeSlot *slot = sunBakeSlot(sb, coord);
+                bool same_chunk = slot->used && slot->coord.x == coord.x && slot->coord.y == coord.y;
+                if (same_chunk && slot->stamp == stamp)
+                    continue;
+                *slot = (struct SunBakeSlot) {
+                    .coord = coord, .stamp = stamp, .used = true,
+                    /* keep showing the old bake of this chunk until the new one lands */
+                    .baked = same_chunk && slot->baked,
+                };
+                arrput(queue, sunBakeSnapshot(coord, stamp, nb));
+            }
+        }
+    }
+    if (arrlen(queue) == 0) {
+        arrfree(queue);
+        return;
+    }
+
+    for (int i = 0; i < arrlen(queue); ++i)
+        workQueuePush(&sb->queue, queue[i], false);
+    sb->chunks_queued += arrlen(queue);
+    sb->chunks_outstanding = workQueueOutstanding(&sb->queue);
+    arrfree(queue);
+}
+
+void sunBakeWait(SunBake *sb)
+{
+    workQueueWait(&sb->queue);
+    sunBakeCollect(sb);
+}
+
+void sunBakeSetupShader(Shader shader)
+{
+    int slot = SUN_BAKE_SLOT;
+    rlEnableShader(shader.id);
+    rlSetUniform(GetShaderLocation(shader, "sunBake"), &slot, SHADER_UNIFORM_INT, 1);
+    rlDisableShader();
+}
+
+void sunBakeBind(SunBake *sb)
+{
+    rlActiveTextureSlot(SUN_BAKE_SLOT);
+    rlEnableTexture(sb->texture.id);
+    rlActiveTextureSlot(0);
+}
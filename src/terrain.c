@@ -0,0 +1,424 @@
+/*****************************************************
+Create Date:        2024-12-02
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/terrain.h"
+
+/*
+ * lod changes and edits are spread out so walking never costs a full ring
+ * at once, a patch keeps showing its old level until its turn comes
+ */
+#define TERRAIN_REBUILDS_PER_FRAME 8
+/* cubes are centered on integer positions, their tops sit half a block up */
+#define TERRAIN_BLOCK_TOP 0.5f
+
+void terrainInit(Terrain *terrain, Shader shader, int full_radius, int view_radius)
+{
+    *terrain = (Terrain) { 0 };
+    terrain->shader = shader;
+    terrain->full_radius = max(full_radius, 1);
+    terrain->view_radius = max(view_radius, terrain->full_radius);
+    terrain->morph_time = 0.5f;
+}
+
+static void terrainPatchUnload(struct TerrainPatch *patch)
+{
+    if (patch->grid > 0)
+        UnloadModel(patch->model);
+    MemFree(patch->heights);
+    MemFree(patch->morph_from);
+    *patch = (struct TerrainPatch) { 0 };
+}
+
+void terrainUnload(Terrain *terrain)
+{
+    for (int i = 0; i < hmlen(terrain->patches); ++i)
+        terrainPatchUnload(&terrain->patches[i].value);
+    hmfree(terrain->patches);
+    arrfree(terrain->changed);
+    *terrain = (Terrain) { 0 };
+}
+
+int terrainLodForDistance(const Terrain *terrain, int chunk_distance)
+{
+    if (chunk_distance > terrain->view_radius)
+        return -1;
+
+    int lod = 0;
+    int ring = terrain->full_radius;
+    while (chunk_distance > ring && lod < TERRAIN_MAX_LOD) {
+        ring *= 2;
+        lod++;
+    }
+
+    return lod;
+}
+
+Vector3 terrainPatchOrigin(iVec2 coord)
+{
+    return (Vector3) { coord.x * CHUNKSIZE, 0, coord.y * CHUNKSIZE };
+}
+
+/*
+ * Height at the grid vertex on the corner between cubes, the max over
+ * the s x s cubes around it so silhouettes never sink below the cubes.
+ * At s 1 that is the 2 x 2 cubes sharing the corner.
+ */
+static float terrainGridHeight(const struct WorldChunk *wc, int i, int j, int s)
+{
+    int half = max(s / 2, 1);
+    int x0 = Clamp(i * s - half, 0, CHUNKSIZE - 1);
+    int x1 = Clamp(i * s + half - 1, 0, CHUNKSIZE - 1);
+    int z0 = Clamp(j * s - half, 0, CHUNKSIZE - 1);
+    int z1 = Clamp(j * s + half - 1, 0, CHUNKSIZE - 1);
+
+    int h = INT_MIN;
+    for (int z = z0; z <= z1; ++z)
+        for (int x = x0; x <= x1; ++x)
+            h = max(h, worldColumnHeight(wc, x, z));
+
+    return h + TERRAIN_BLOCK_TOP;
+}
+
+/*
+ * What the chunk currently shows at chunk local lx, lz, used as the start
+ * of a morph into a new lod
+ */
+static float terrainSampleShown(const struct TerrainPatch *patch,
+        const struct WorldChunk *wc, float lx, float lz)
+{
+    if (patch->grid == 0) {
+        int x = Clamp(floorf(lx + 0.5f), 0, CHUNKSIZE - 1);
+        int z = Clamp(floorf(lz + 0.5f), 0, CHUNKSIZE - 1);
+        return worldColumnHeight(wc, x, z) + TERRAIN_BLOCK_TOP;
+    }
+
+    int g = patch->grid;
+    float s = CHUNKSIZE / (float)g;
+    float u = Clamp((lx + 0.5f) / s, 0, g);
+    float v = Clamp((lz + 0.5f) / s, 0, g);
+    int i = min((int)u, g - 1);
+    int j = min((int)v, g - 1);
+    float fu = u - i, fv = v - j;
+
+    float h[4];
+    for (int k = 0; k < 4; ++k) {
+        int idx = (j + (k >> 1)) * (g + 1) + i + (k & 1);
+        h[k] = Lerp(patch->morph_from[idx], patch->heights[idx], patch->morph);
+    }
+
+    return Lerp(Lerp(h[0], h[1], fu), Lerp(h[2], h[3], fu), fv);
+}
+
+/*
+ * k-th top vertex along a border edge. Edges run -z, +x, +z, -x, each
+ * walked so a skirt quad built from consecutive vertices faces outwards
+ */
+static int terrainBorderVertex(int g, int edge, int k)
+{
+    switch (edge) {
+        case 0: return k;
+        case 1: return k * (g + 1) + g;
+        case 2: return g * (g + 1) + (g - k);
+        default: return (g - k) * (g + 1);
+    }
+}
+
+static void terrainPatchWriteHeights(struct TerrainPatch *patch)
+{
+    Mesh *mesh = &patch->model.meshes[0];
+    int g = patch->grid;
+    int top_count = (g + 1) * (g + 1);
+    float skirt = 2.0f * (CHUNKSIZE / g) + 2.0f;
+
+    for (int v = 0; v < top_count; ++v)
+        mesh->vertices[v * 3 + 1] = Lerp(patch->morph_from[v], patch->heights[v], patch->morph);
+
+    /* skirt bottoms follow the border vertex they hang from */
+    for (int b = 0; b < 4 * (g + 1); ++b) {
+        int top = terrainBorderVertex(g, b / (g + 1), b % (g + 1));
+        mesh->vertices[(top_count + b) * 3 + 1] = mesh->vertices[top * 3 + 1] - skirt;
+    }
+}
+
+static void terrainPushSkirtQuad(unsigned short *indices, int *n,
+        unsigned short a, unsigned short b, unsigned short a_low, unsigned short b_low)
+{
+    /* normal is (b - a) x down, outwards for the walk in terrainBorderVertex */
+    indices[(*n)++] = a;
+    indices[(*n)++] = b;
+    indices[(*n)++] = a_low;
+    indices[(*n)++] = a_low;
+    indices[(*n)++] = b;
+    indices[(*n)++] = b_low;
+}
+
+static Mesh terrainGenPatchMesh(const struct TerrainPatch *patch)
+{
+    int g = patch->grid;
+    float s = CHUNKSIZE / (float)g;
+    int top_count = (g + 1) * (g + 1);
+
+    Mesh mesh = { 0 };
+    mesh.vertexCount = top_count + 4 * (g + 1);
+    mesh.triangleCount = 2 * g * g + 4 * 2 * g;
+    mesh.vertices = MemAlloc(mesh.vertexCount * 3 * sizeof(float));
+    mesh.normals = MemAlloc(mesh.vertexCount * 3 * sizeof(float));
+    mesh.texcoords = MemAlloc(mesh.vertexCount * 2 * sizeof(float));
+    mesh.indices = MemAlloc(mesh.triangleCount * 3 * sizeof(unsigned short));
+
+    for (int j = 0; j <= g; ++j) {
+        for (int i = 0; i <= g; ++i) {
+            int v = j * (g + 1) + i;
+            float lx = i * s - 0.5f, lz = j * s - 0.5f;
+            mesh.vertices[v * 3 + 0] = lx;
+            mesh.vertices[v * 3 + 2] = lz;
+            mesh.texcoords[v * 2 + 0] = (float)i / g;
+            mesh.texcoords[v * 2 + 1] = (float)j / g;
+
+            const float *h = patch->heights;
+            float hl = h[j * (g + 1) + max(i - 1, 0)], hr = h[j * (g + 1) + min(i + 1, g)];
+            float hd = h[max(j - 1, 0) * (g + 1) + i], hu = h[min(j + 1, g) * (g + 1) + i];
+            Vector3 n = Vector3Normalize((Vector3) { hl - hr, 2.0f * s, hd - hu });
+            mesh.normals[v * 3 + 0] = n.x;
+            mesh.normals[v * 3 + 1] = n.y;
+            mesh.normals[v * 3 + 2] = n.z;
+        }
+    }
+
+    int n = 0;
+    for (int j = 0; j < g; ++j) {
+        for (int i = 0; i < g; ++i) {
+            unsigned short v00 = j * (g + 1) + i, v10 = v00 + 1;
+            unsigned short v01 = v00 + (g + 1), v11 = v01 + 1;
+            mesh.indices[n++] = v00;
+            mesh.indices[n++] = v01;
+            mesh.indices[n++] = v10;
+            mesh.indices[n++] = v10;
+            mesh.indices[n++] = v01;
+            mesh.indices[n++] = v11;
+        }
+    }
+
+    for (int b = 0; b < 4 * (g + 1); ++b) {
+        int edge = b / (g + 1), k = b % (g + 1);
+        int top = terrainBorderVertex(g, edge, k);
+        int low = top_count + b;
+        memcpy(&mesh.vertices[low * 3], &mesh.vertices[top * 3], 3 * sizeof(float));
+        memcpy(&mesh.normals[low * 3], &mesh.normals[top * 3], 3 * sizeof(float));
+        memcpy(&mesh.texcoords[low * 2], &mesh.texcoords[top * 2], 2 * sizeof(float));
+        if (k > 0)
+            terrainPushSkirtQuad(mesh.indices, &n, terrainBorderVertex(g, edge, k - 1), top, low - 1, low);
+    }
+
+    return mesh;
+}
+
+/* the render queue draws cubes at 0.9 scale */
+#define TERRAIN_CUBE_SCALE 0.9f
+
+/* every cube of the chunk, bottoms left out since nothing looks up at them */
+static Mesh terrainGenCubesMesh(const struct WorldChunk *wc)
+{
+    static const float corners[5][4][3] = {
+        { { -1, 1, -1 }, { -1, 1, 1 }, { 1, 1, 1 }, { 1, 1, -1 } },
+        { { -1, -1, 1 }, { 1, -1, 1 }, { 1, 1, 1 }, { -1, 1, 1 } },
+        { { 1, -1, -1 }, { -1, -1, -1 }, { -1, 1, -1 }, { 1, 1, -1 } },
+        { { 1, -1, 1 }, { 1, -1, -1 }, { 1, 1, -1 }, { 1, 1, 1 } },
+        { { -1, -1, -1 }, { -1, -1, 1 }, { -1, 1, 1 }, { -1, 1, -1 } },
+    };
+    static const float normals[5][3] = { { 0, 1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { -1, 0, 0 } };
+
+    Mesh mesh = { 0 };
+    mesh.vertexCount = CHUNKSIZE * CHUNKSIZE * 5 * 4;
+    mesh.triangleCount = CHUNKSIZE * CHUNKSIZE * 5 * 2;
+    mesh.vertices = MemAlloc(mesh.vertexCount * 3 * sizeof(float));
+    mesh.normals = MemAlloc(mesh.vertexCount * 3 * sizeof(float));
+    mesh.texcoords = MemAlloc(mesh.vertexCount * 2 * sizeof(float));
+    mesh.indices = MemAlloc(mesh.triangleCount * 3 * sizeof(unsigned short));
+
+    Vector3 origin = terrainPatchOrigin(wc->coord);
+    float h = TERRAIN_CUBE_SCALE * 0.5f;
+    int v = 0, n = 0;
+    for (int z = 0; z < CHUNKSIZE; ++z) {
+        for (int x = 0; x < CHUNKSIZE; ++x) {
+            Vector3 p = Vector3Subtract(worldCubePosition(wc, z, x), origin);
+            for (int f = 0; f < 5; ++f) {
+                for (int k = 0; k < 4; ++k) {
+                    mesh.vertices[(v + k) * 3 + 0] = p.x + corners[f][k][0] * h;
+                    mesh.vertices[(v + k) * 3 + 1] = p.y + corners[f][k][1] * h;
+                    mesh.vertices[(v + k) * 3 + 2] = p.z + corners[f][k][2] * h;
+                    memcpy(&mesh.normals[(v + k) * 3], normals[f], 3 * sizeof(float));
+                    mesh.texcoords[(v + k) * 2 + 0] = k == 1 || k == 2;
+                    mesh.texcoords[(v + k) * 2 + 1] = k >= 2;
+                }
+                mesh.indices[n++] = v;
+                mesh.indices[n++] = v + 1;
+                mesh.indices[n++] = v + 2;
+                mesh.indices[n++] = v;
+                mesh.indices[n++] = v + 2;
+                mesh.indices[n++] = v + 3;
+                v += 4;
+            }
+        }
+    }
+
+    return mesh;
+}
+
+Mesh terrainGenChunkMesh(const struct WorldChunk *wc, int lod)
+{
+    if (lod <= 0)
+        return terrainGenCubesMesh(wc);
+
+    int g = CHUNKSIZE >> lod;
+    int s = 1 << lod;
+    struct TerrainPatch patch = { .lod = lod, .grid = g, .morph = 1.0f };
+    patch.heights = MemAlloc((g + 1) * (g + 1) * sizeof(float));
+    patch.morph_from = patch.heights;
+    for (int j = 0; j <= g; ++j)
+        for (int i = 0; i <= g; ++i)
+            patch.heights[j * (g + 1) + i] = terrainGridHeight(wc, i, j, s);
+
+    Mesh mesh = terrainGenPatchMesh(&patch);
+    patch.model.meshes = &mesh;
+    terrainPatchWriteHeights(&patch);
+    MemFree(patch.heights);
+    return mesh;
+}
+
+/*
+ * A patch refining into cubes is built at cube resolution and morphed
+ * like any other, the cubes only take over once it has settled
+ */
+static void terrainPatchBuild(Terrain *terrain, struct TerrainPatch *patch,
+        const struct WorldChunk *wc, int lod, bool morph)
+{
+    struct TerrainPatch old = *patch;
+    struct TerrainPatch built = { .lod = lod, .revision = wc->revision, .morph = 1.0f };
+
+    if (lod > 0 || morph) {
+        int g = CHUNKSIZE >> lod;
+        int s = 1 << lod;
+        built.grid = g;
+        built.heights = MemAlloc((g + 1) * (g + 1) * sizeof(float));
+        built.morph_from = MemAlloc((g + 1) * (g + 1) * sizeof(float));
+        for (int j = 0; j <= g; ++j) {
+            for (int i = 0; i <= g; ++i) {
+                int v = j * (g + 1) + i;
+                built.heights[v] = terrainGridHeight(wc, i, j, s);
+                built.morph_from[v] = morph
+                    ? terrainSampleShown(&old, wc, i * s - 0.5f, j * s - 0.5f)
+                    : built.heights[v];
+            }
+        }
+        built.morph = morph ? 0.0f : 1.0f;
+
+        built.model = LoadModelFromMesh(terrainGenPatchMesh(&built));
+        built.model.materials[0].shader = terrain->shader;
+        terrainPatchWriteHeights(&built);
+        UploadMesh(&built.model.meshes[0], true);
+    }
+
+    terrainPatchUnload(&old);
+    *patch = built;
+    terrain->patches_rebuilt++;
+    arrput(terrain->changed, wc->coord);
+}
+
+void terrainUpdate(Terrain *terrain, Vector3 focus, float dt)
+{
+    terrain->focus = getChunkCoords(focus);
+    terrain->patches_visible = 0;
+    terrain->patches_rebuilt = 0;
+    terrain->patches_morphed = 0;
+    terrain->triangles = 0;
+    arrsetlen(terrain->changed, 0);
+
+    int r = terrain->view_radius;
+    for (int dz = -r; dz <= r; ++dz) {
+        for (int dx = -r; dx <= r; ++dx) {
+            iVec2 coord = { terrain->focus.x + dx, terrain->focus.y + dz };
+            struct WorldMap *entry = hmgetp_null(world_map, coord);
+            if (entry == NULL)
+                continue;
+            const struct WorldChunk *wc = &entry->chunk;
+
+            int d = max(abs(dx), abs(dz));
+            int lod = terrainLodForDistance(terrain, d);
+            struct TerrainMap *tm = hmgetp_null(terrain->patches, coord);
+
+            /* nothing to keep showing yet, a hole is worse than a slow frame */
+            if (tm == NULL) {
+                struct TerrainPatch patch = { 0 };
+                terrainPatchBuild(terrain, &patch, wc, lod, false);
+                hmput(terrain->patches, coord, patch);
+                tm = hmgetp_null(terrain->patches, coord);
+            } else {
+                struct TerrainPatch *patch = &tm->value;
+                /*
+                 * refine at once, but only coarsen a chunk once it is a full
+                 * chunk past the ring edge so walking along it does not flicker
+                 */
+                int lod_near = terrainLodForDistance(terrain, d - 1);
+                bool keep = patch->lod == lod || (patch->lod < lod && patch->lod >= lod_near);
+
+                /* edits show up at once, lod changes blend in both ways */
+                if ((patch->revision != wc->revision || !keep) && terrain->patches_rebuilt < TERRAIN_REBUILDS_PER_FRAME)
+                    terrainPatchBuild(terrain, patch, wc, keep ? patch->lod : lod, !keep);
+            }
+
+            struct TerrainPatch *patch = &tm->value;
+            if (patch->grid > 0 && patch->morph < 1.0f) {
+                patch->morph = fminf(1.0f, patch->morph + dt / terrain->morph_time);
+                terrainPatchWriteHeights(patch);
+                Mesh mesh = patch->model.meshes[0];
+                UpdateMeshBuffer(mesh, 0, mesh.vertices, mesh.vertexCount * 3 * sizeof(float), 0);
+                terrain->patches_morphed++;
+                arrput(terrain->changed, coord);
+            }
+            /* settled at cube resolution, hand over to the cubes */
+            if (patch->lod == 0 && patch->grid > 0 && patch->morph >= 1.0f) {
+                u64 revision = patch->revision;
+                terrainPatchUnload(patch);
+                patch->revision = revision;
+                arrput(terrain->changed, coord);
+            }
+
+            terrain->patches_visible++;
+            terrain->triangles += patch->grid > 0
+                ? patch->model.meshes[0].triangleCount
+                : 12 * CHUNKSIZE * CHUNKSIZE;
+        }
+    }
+
+    /* drop patches that fell out of view */
+    iVec2 *evict = NULL;
+    for (int i = 0; i < hmlen(terrain->patches); ++i) {
+        iVec2 c = terrain->patches[i].key;
+        if (max(abs(c.x - terrain->focus.x), abs(c.y - terrain->focus.y)) > r)
+            arrput(evict, c);
+    }
+    for (int i = 0; i < arrlen(evict); ++i) {
+        terrainPatchUnload(&hmgetp(terrain->patches, evict[i])->value);
+        (void)hmdel(terrain->patches, evict[i]);
+        arrput(terrain->changed, evict[i]);
+    }
+    arrfree(evict);
+}
+
+int terrainChunkLod(const Terrain *terrain, iVec2 coord)
+{
+    struct TerrainMap *tm = hmgetp_null(((Terrain *)terrain)->patches, coord);
+    return tm ? tm->value.lod : -1;
+}
+
+struct TerrainPatch *terrainGetPatch(Terrain *terrain, iVec2 coord)
+{
+    struct TerrainMap *tm = hmgetp_null(terrain->patches, coord);
+    return (tm && tm->value.grid > 0) ? &tm->value : NULL;
+}
@@ -0,0 +1,456 @@
+/*****************************************************
+Create Date:        2024-12-13
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/text.h"
+#include "../include/obh/util.h"
+#include "../include/obh/shader_cache.h"
+#include "../include/obh/stb_impl.h"
+#include "../include/raylib/rlgl.h"
+#include "../include/glad/glad.h"
+
+#define STB_SPRINTF_IMPLEMENTATION
+#include "../include/stb/stb_sprintf.h"
+/* raylib links its own copy, keep this one private, most of it unused */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "../include/stb/stb_truetype.h"
+#pragma GCC diagnostic pop
+
+#define TEXT_SDF_MAGIC 0x31464453u /* "SDF1" */
+/* printable ascii */
+#define TEXT_SDF_FIRST 32
+#define TEXT_SDF_GLYPHS 95
+/* distance field reach in atlas pixels, the edge sits at 128 */
+#define TEXT_SDF_PADDING 6
+/* raylib's default line spacing */
+#define TEXT_LINE_SPACING 2
+
+struct TextSdfHeader {
+    u32 magic;
+    i32 base_size, width, height, glyphs;
+};
+
+struct TextSdfGlyph {
+    i32 value, offset_x, offset_y, advance_x;
+    Rectangle rec;
+};
+
+struct TextCache text_cache;
+
+void textCacheInit(const char *dir)
+{
+    text_cache = (TextCache) { .dir = dir };
+    if (dir != NULL)
+        mkdir_p(dir);
+
+    unsigned short indices[TEXT_MAX_GLYPHS * 6];
+    for (int q = 0; q < TEXT_MAX_GLYPHS; ++q) {
+        static const unsigned short quad[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int i = 0; i < 6; ++i)
+            indices[q * 6 + i] = q * 4 + quad[i];
+    }
+    glGenBuffers(1, &text_cache.ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, text_cache.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    text_cache.shader = shaderCacheLoad("resources/shaders/text.vs", "resources/shaders/text.fs");
+    text_cache.shader_sdf = shaderCacheLoad("resources/shaders/text.vs", "resources/shaders/text_sdf.fs");
+    text_cache.mvp_loc = GetShaderLocation(text_cache.shader, "mvp");
+    text_cache.color_loc = GetShaderLocation(text_cache.shader, "colDiffuse");
+    text_cache.mvp_sdf_loc = GetShaderLocation(text_cache.shader_sdf, "mvp");
+    text_cache.color_sdf_loc = GetShaderLocation(text_cache.shader_sdf, "colDiffuse");
+}
+
+static void textRunUnload(struct TextRun *run)
+{
+    glDeleteBuffers(1, &run->vbo);
+    glDeleteVertexArrays(1, &run->vao);
+    free(run->text);
+}
+
+void textCacheUnload(void)
+{
+    for (int i = 0; i < hmlen(text_cache.runs); ++i)
+        textRunUnload(&text_cache.runs[i].value);
+    hmfree(text_cache.runs);
+    for (int i = 0; i < hmlen(text_cache.slots); ++i)
+        textRunUnload(&text_cache.slots[i].value);
+    hmfree(text_cache.slots);
+    arrfree(text_cache.scratch);
+    glDeleteBuffers(1, &text_cache.ebo);
+    UnloadShader(text_cache.shader);
+    UnloadShader(text_cache.shader_sdf);
+    text_cache = (TextCache) { 0 };
+}
+
+static void textEvictRuns(struct TextRunMap **runs)
+{
+    for (int i = hmlen(*runs) - 1; i >= 0; --i) {
+        struct TextRunMap *entry = &(*runs)[i];
+        if (text_cache.frame - entry->value.last_frame < TEXT_EVICT_FRAMES)
+            continue;
+        textRunUnload(&entry->value);
+        (void)hmdel(*runs, entry->key);
+    }
+}
+
+void textCacheEndFrame(void)
+{
+    textEvictRuns(&text_cache.runs);
+    textEvictRuns(&text_cache.slots);
+    text_cache.frame++;
+    text_cache.hits = 0;
+    text_cache.misses = 0;
+}
+
+/* fnv-1a */
+static u64 textHash(u64 h, const void *data, size_t size)
+{
+    const u8 *p = data;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static bool textLoadSdfAtlas(const char *path, Font *font)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return false;
+
+    struct TextSdfHeader header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 && header.magic == TEXT_SDF_MAGIC
+        && header.glyphs == TEXT_SDF_GLYPHS && header.width > 0 && header.height > 0
+        && header.width <= 4096 && header.height <= 4096;
+    struct TextSdfGlyph glyphs[TEXT_SDF_GLYPHS];
+    ok = ok && fread(glyphs, sizeof(glyphs), 1, f) == 1;
+    Image atlas = { 0 };
+    if (ok) {
+        atlas = (Image) {
+            .data = MemAlloc(header.width * header.height), .width = header.width, .height = header.height,
+            .mipmaps = 1, .format = PIXELFORMAT_UNCOMPRESSED_GRAYSCALE,
+        };
+        ok = fread(atlas.data, header.width * header.height, 1, f) == 1;
+    }
+    fclose(f);
+    if (!ok) {
+        UnloadImage(atlas);
+        return false;
+    }
+
+    *font = (Font) {
+        .baseSize = header.base_size, .glyphCount = TEXT_SDF_GLYPHS,
+        .recs = MemAlloc(TEXT_SDF_GLYPHS * sizeof(Rectangle)),
+        .glyphs = MemAlloc(TEXT_SDF_GLYPHS * sizeof(GlyphInfo)),
+    };
+    for (int i = 0; i < TEXT_SDF_GLYPHS; ++i) {
+        font->recs[i] = glyphs[i].rec;
+        font->glyphs[i] = (GlyphInfo) {
+            .value = glyphs[i].value, .offsetX = glyphs[i].offset_x,
+            .offsetY = glyphs[i].offset_y, .advanceX = glyphs[i].advance_x,
+        };
+    }
+    font->texture = LoadTextureFromImage(atlas);
+    UnloadImage(atlas);
+    return true;
+}
+
+static void textStoreSdfAtlas(const char *path, const Font *font, const Image *atlas)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        c_log_warn(LOG_TAG, "could not write font atlas %s", path);
+        return;
+    }
+    struct TextSdfHeader header = {
+        TEXT_SDF_MAGIC, font->baseSize, atlas->width, atlas->height, TEXT_SDF_GLYPHS,
+    };
+    struct TextSdfGlyph glyphs[TEXT_SDF_GLYPHS];
+    for (int i = 0; i < TEXT_SDF_GLYPHS; ++i) {
+        glyphs[i] = (struct TextSdfGlyph) {
+            font->glyphs[i].value, font->glyphs[i].offsetX, font->glyphs[i].offsetY,
+            font->glyphs[i].advanceX, font->recs[i],
+        };
+    }
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(glyphs, sizeof(glyphs), 1, f);
+    fwrite(atlas->data, atlas->width * atlas->height, 1, f);
+    fclose(f);
+}
+
+/* distance fields of printable ascii packed into one grayscale atlas */
+static bool textBuildSdfAtlas(const u8 *ttf, int base_size, Font *font, Image *atlas)
+{
+    stbtt_fontinfo info;
+    if (!stbtt_InitFont(&info, ttf, stbtt_GetFontOffsetForIndex(ttf, 0)))
+        return false;
+    float scale = stbtt_ScaleForPixelHeight(&info, base_size);
+    int ascent;
+    stbtt_GetFontVMetrics(&info, &ascent, NULL, NULL);
+
+    *font = (Font) {
+        .baseSize = base_size, .glyphCount = TEXT_SDF_GLYPHS,
+        .recs = MemAlloc(TEXT_SDF_GLYPHS * sizeof(Rectangle)),
+        .glyphs = MemAlloc(TEXT_SDF_GLYPHS * sizeof(GlyphInfo)),
+    };
+    u8 *bitmaps[TEXT_SDF_GLYPHS];
+    stbrp_rect rects[TEXT_SDF_GLYPHS];
+    for (int i = 0; i < TEXT_SDF_GLYPHS; ++i) {
+        int cp = TEXT_SDF_FIRST + i, w = 0, h = 0, xoff = 0, yoff = 0, advance;
+        bitmaps[i] = stbtt_GetCodepointSDF(&info, scale, cp, TEXT_SDF_PADDING, 128,
+                128.0f / TEXT_SDF_PADDING, &w, &h, &xoff, &yoff);
+        stbtt_GetCodepointHMetrics(&info, cp, &advance, NULL);
+        font->glyphs[i] = (GlyphInfo) {
+            .value = cp, .offsetX = xoff, .offsetY = yoff + (int)(ascent * scale),
+            .advanceX = (int)(advance * scale),
+        };
+        /* one pixel apart so bilinear filtering stays inside a glyph */
+        rects[i] = (stbrp_rect) { .id = i, .w = w + 1, .h = h + 1 };
+    }
+
+    int size = 128;
+    stbrp_node nodes[4096];
+    for (;; size *= 2) {
+        stbrp_context ctx;
+        stbrp_init_target(&ctx, size, size, nodes, min(size, 4096));
+        if (stbrp_pack_rects(&ctx, rects, TEXT_SDF_GLYPHS) || size >= 4096)
+            break;
+    }
+
+    *atlas = (Image) {
+        .data = MemAlloc(size * size), .width = size, .height = size,
+        .mipmaps = 1, .format = PIXELFORMAT_UNCOMPRESSED_GRAYSCALE,
+    };
+    bool packed = true;
+    for (int i = 0; i < TEXT_SDF_GLYPHS; ++i) {
+        int w = rects[i].w - 1, h = rects[i].h - 1;
+        packed = packed && rects[i].was_packed;
+        font->recs[i] = (Rectangle) { rects[i].x, rects[i].y, w, h };
+        for (int y = 0; rects[i].was_packed && y < h; ++y)
+            memcpy((u8 *)atlas->data + (rects[i].y + y) * size + rects[i].x, bitmaps[i] + y * w, w);
+        stbtt_FreeSDF(bitmaps[i], NULL);
+    }
+    if (!packed) {
+        UnloadFont(*font);
+        UnloadImage(*atlas);
+        return false;
+    }
+    return true;
+}
+
+static bool textLoadSdfFont(const char *path, int base_size, Font *font)
+{
+    int ttf_size = 0;
+    u8 *ttf = LoadFileData(path, &ttf_size);
+    if (ttf == NULL)
+        return false;
+
+    u64 h = textHash(0xcbf29ce484222325ull, ttf, ttf_size);
+    h = textHash(h, &base_size, sizeof(base_size));
+    char cached[600] = { 0 };
+    if (text_cache.dir != NULL) {
+        snprintf(cached, sizeof(cached), "%s/%016" PRIx64 ".sdf", text_cache.dir, h);
+        if (textLoadSdfAtlas(cached, font)) {
+            UnloadFileData(ttf);
+            return true;
+        }
+    }
+
+    double start = time_ms();
+    Image atlas;
+    bool ok = textBuildSdfAtlas(ttf, base_size, font, &atlas);
+    UnloadFileData(ttf);
+    if (!ok)
+        return false;
+    c_log_info(LOG_TAG, "font atlas for %s: %d x %d in %.1f ms", path, atlas.width, atlas.height, time_ms() - start);
+    if (text_cache.dir != NULL)
+        textStoreSdfAtlas(cached, font, &atlas);
+    font->texture = LoadTextureFromImage(atlas);
+    UnloadImage(atlas);
+    return true;
+}
+
+TextFont textLoadFont(const char *path, int base_size, bool sdf)
+{
+    TextFont font = { .sdf = sdf };
+    if (sdf && !textLoadSdfFont(path, base_size, &font.font)) {
+        c_log_warn(LOG_TAG, "no distance field atlas for %s, using a bitmap font", path);
+        font.sdf = false;
+    }
+    if (font.sdf)
+        SetTextureFilter(font.font.texture, TEXTURE_FILTER_BILINEAR);
+    else
+        font.font = LoadFontEx(path, base_size, NULL, 0);
+    return font;
+}
+
+void textUnloadFont(TextFont font)
+{
+    UnloadFont(font.font);
+}
+
+/*
+ * glyph quads the way DrawTextEx places them, stream for slot runs that
+ * are refilled over and over
+ */
+static void textBuildRun(struct TextRun *run, const TextFont *font, const char *text, float size, float spacing,
+        bool stream)
+{
+    const Font *f = &font->font;
+    float scale = size / f->baseSize;
+    float pad = f->glyphPadding;
+    float tex_w = f->texture.width, tex_h = f->texture.height;
+
+    arrsetlen(text_cache.scratch, 0);
+    float x = 0, y = 0, width = 0;
+    int quads = 0;
+    for (int i = 0; text[i] != '\0' && quads < TEXT_MAX_GLYPHS;) {
+        int bytes = 0;
+        int codepoint = GetCodepointNext(&text[i], &bytes);
+        i += bytes;
+        if (codepoint == '\n') {
+            y += size + TEXT_LINE_SPACING;
+            x = 0;
+            continue;
+        }
+        int g = GetGlyphIndex(*f, codepoint);
+        Rectangle rec = f->recs[g];
+        if (codepoint != ' ' && codepoint != '\t') {
+            float x0 = x + (f->glyphs[g].offsetX - pad) * scale;
+            float y0 = y + (f->glyphs[g].offsetY - pad) * scale;
+            float x1 = x0 + (rec.width + 2 * pad) * scale;
+            float y1 = y0 + (rec.height + 2 * pad) * scale;
+            float u0 = (rec.x - pad) / tex_w, v0 = (rec.y - pad) / tex_h;
+            float u1 = (rec.x + rec.width + pad) / tex_w, v1 = (rec.y + rec.height + pad) / tex_h;
+            float quad[16] = {
+                x0, y0, u0, v0,
+                x0, y1, u0, v1,
+                x1, y1, u1, v1,
+                x1, y0, u1, v0,
+            };
+            memcpy(arraddnptr(text_cache.scratch, 16), quad, sizeof(quad));
+            quads++;
+        }
+        x += (f->glyphs[g].advanceX == 0 ? rec.width : f->glyphs[g].advanceX) * scale + spacing;
+        width = fmaxf(width, x);
+    }
+
+    free(run->text);
+    run->text = strdup(text);
+    run->font_texture = f->texture.id;
+    run->size = size;
+    run->spacing = spacing;
+    run->quads = quads;
+    run->extent = (Vector2) { width, y + size };
+
+    if (run->vao == 0) {
+        glGenVertexArrays(1, &run->vao);
+        glGenBuffers(1, &run->vbo);
+        glBindVertexArray(run->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, run->vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, text_cache.ebo);
+        /* the attribute locations raylib binds for vertexPosition and vertexTexCoord */
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(2 * sizeof(float)));
+        glBindVertexArray(0);
+    }
+    GLsizeiptr bytes = quads * 16 * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, run->vbo);
+    if (stream) {
+        /* orphan, the driver hands out fresh storage instead of waiting on last frame's draw */
+        glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, text_cache.scratch);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, bytes, text_cache.scratch, GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static struct TextRun *textGetRun(struct TextRunMap **runs, u64 key, bool stream,
+        const TextFont *font, const char *text, float size, float spacing)
+{
+    struct TextRunMap *entry = hmgetp_null(*runs, key);
+    if (entry == NULL) {
+        hmput(*runs, key, (struct TextRun) { 0 });
+        entry = hmgetp_null(*runs, key);
+    }
+    struct TextRun *run = &entry->value;
+    /* a collision or a slot with a new string rebuilds in place */
+    if (run->text == NULL || strcmp(run->text, text) != 0 || run->font_texture != font->font.texture.id
+            || run->size != size || run->spacing != spacing) {
+        textBuildRun(run, font, text, size, spacing, stream);
+        text_cache.misses++;
+    } else {
+        text_cache.hits++;
+    }
+    run->last_frame = text_cache.frame;
+    return run;
+}
+
+static void textDrawRun(const TextFont *font, const struct TextRun *run, Matrix transform, Color tint)
+{
+    if (run->quads == 0)
+        return;
+    /* whatever raylib has batched so far goes first */
+    rlDrawRenderBatchActive();
+
+    Matrix mvp = MatrixMultiply(MatrixMultiply(transform, rlGetMatrixModelview()), rlGetMatrixProjection());
+    Vector4 color = ColorNormalize(tint);
+    Shader shader = font->sdf ? text_cache.shader_sdf : text_cache.shader;
+    rlEnableShader(shader.id);
+    rlSetUniformMatrix(font->sdf ? text_cache.mvp_sdf_loc : text_cache.mvp_loc, mvp);
+    rlSetUniform(font->sdf ? text_cache.color_sdf_loc : text_cache.color_loc, &color, SHADER_UNIFORM_VEC4, 1);
+    rlActiveTextureSlot(0);
+    rlEnableTexture(font->font.texture.id);
+    rlDisableBackfaceCulling();
+
+    glBindVertexArray(run->vao);
+    glDrawElements(GL_TRIANGLES, run->quads * 6, GL_UNSIGNED_SHORT, 0);
+    glBindVertexArray(0);
+
+    rlEnableBackfaceCulling();
+    rlDisableTexture();
+    rlDisableShader();
+}
+
+static struct TextRun *textGetStaticRun(const TextFont *font, const char *text, float size, float spacing)
+{
+    u64 key = textHash(0xcbf29ce484222325ull, text, strlen(text));
+    key = textHash(key, &font->font.texture.id, sizeof(font->font.texture.id));
+    key = textHash(key, &size, sizeof(size));
+    key = textHash(key, &spacing, sizeof(spacing));
+    return textGetRun(&text_cache.runs, key, false, font, text, size, spacing);
+}
+
+void textDraw(TextFont font, const char *text, Vector2 position, float size, float spacing, Color tint)
+{
+    struct TextRun *run = textGetStaticRun(&font, text, size, spacing);
+    textDrawRun(&font, run, MatrixTranslate(position.x, position.y, 0), tint);
+}
+
+void textDrawSlot(TextFont font, const void *owner, int slot, const char *text,
+        Vector2 position, float size, float spacing, Color tint)
+{
+    u64 key = textHash(0xcbf29ce484222325ull, &owner, sizeof(owner));
+    key = textHash(key, &slot, sizeof(slot));
+    struct TextRun *run = textGetRun(&text_cache.slots, key, true, &font, text, size, spacing);
+    textDrawRun(&font, run, MatrixTranslate(position.x, position.y, 0), tint);
+}
+
+void textDraw3D(TextFont font, const char *text, Matrix transform, float size, float spacing, Color tint)
+{
+    struct TextRun *run = textGetStaticRun(&font, text, size, spacing);
+    textDrawRun(&font, run, transform, tint);
+}
@@ -0,0 +1,354 @@
+/*****************************************************
+Create Date:        2024-12-19
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/texture_stream.h"
+#include "../include/obh/util.h"
+#include "../include/obh/c_log.h"
+
+/* raylib links its own copy, keep this one private, most of it unused */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include "../include/stb/stb_image.h"
+#pragma GCC diagnostic pop
+
+static int textureStreamMipSize(int size, int mip)
+{
+    return max(size >> mip, 1);
+}
+
+/* bytes of mip and every level below it */
+static size_t textureStreamChainBytes(const struct StreamedTexture *t, int mip)
+{
+    size_t bytes = 0;
+    for (int k = mip; k < t->mip_count; ++k)
+        bytes += (size_t)textureStreamMipSize(t->width, k) * textureStreamMipSize(t->height, k) * 4;
+    return bytes;
+}
+
+/* 2x2 box filter into dst, odd edges repeat their last texel */
+static void textureStreamHalve(const u8 *src, int w, int h, u8 *dst)
+{
+    int hw = max(w / 2, 1), hh = max(h / 2, 1);
+    for (int y = 0; y < hh; ++y) {
+        int y0 = min(y * 2, h - 1), y1 = min(y * 2 + 1, h - 1);
+        for (int x = 0; x < hw; ++x) {
+            int x0 = min(x * 2, w - 1), x1 = min(x * 2 + 1, w - 1);
+            const u8 *a = src + ((size_t)y0 * w + x0) * 4, *b = src + ((size_t)y0 * w + x1) * 4;
+            const u8 *c = src + ((size_t)y1 * w + x0) * 4, *d = src + ((size_t)y1 * w + x1) * 4;
+            for (int i = 0; i < 4; ++i)
+                dst[((size_t)y * hw + x) * 4 + i] = (a[i] + b[i] + c[i] + d[i] + 2) / 4;
+        }
+    }
+}
+
+static void textureStreamDecode(struct TextureStreamJob *job)
+{
+    int w, h, channels;
+    u8 *pixels = stbi_load(job->path, &w, &h, &channels, 4);
+    if (pixels == NULL)
+        return;
+
+    /* down to the mip asked for, only the chain is kept */
+    u8 *level = pixels;
+    for (int k = 0; k < job->mip; ++k) {
+        u8 *half = MemAlloc((size_t)max(w / 2, 1) * max(h / 2, 1) * 4);
+        textureStreamHalve(level, w, h, half);
+        if (level != pixels)
+            MemFree(level);
+        level = half;
+        w = max(w / 2, 1);
+        h = max(h / 2, 1);
+    }
+
+    int levels = 1;
+    size_t size = (size_t)w * h * 4;
+    for (int lw = w, lh = h; lw > 1 || lh > 1; ++levels) {
+        lw = max(lw / 2, 1);
+        lh = max(lh / 2, 1);
+        size += (size_t)lw * lh * 4;
+    }
+    u8 *data = MemAlloc(size);
+    memcpy(data, level, (size_t)w * h * 4);
+    u8 *src = data;
+    for (int k = 1, lw = w, lh = h; k < levels; ++k) {
+        u8 *dst = src + (size_t)lw * lh * 4;
+        textureStreamHalve(src, lw, lh, dst);
+        src = dst;
+        lw = max(lw / 2, 1);
+        lh = max(lh / 2, 1);
+    }
+    if (level != pixels)
+        MemFree(level);
+    stbi_image_free(pixels);
+
+    job->image = (Image) { data, w, h, levels, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+}
+
+static void *textureStreamRun(void *arg, void *user)
+{
+    struct TextureStreamJob *job = arg;
+    double start = time_ms();
+    textureStreamDecode(job);
+    job->ms = time_ms() - start;
+    return job;
+}
+
+static void textureStreamDiscard(void *arg)
+{
+    struct TextureStreamJob *job = arg;
+    if (job->image.data != NULL)
+        UnloadImage(job->image);
+    MemFree(job);
+}
+
+void textureStreamInit(TextureStream *ts, size_t budget, int threads, bool gpu)
+{
+    *ts = (TextureStream) { .budget = budget, .gpu = gpu };
+    if (gpu) {
+        /* not yet loaded reads as untextured */
+        Image white = GenImageColor(1, 1, WHITE);
+        ts->placeholder = LoadTextureFromImage(white);
+        UnloadImage(white);
+    }
+
+    if (workQueueInit(&ts->queue, threads, TEXTURE_STREAM_MAX_THREADS, textureStreamRun, ts, "texture stream") == 0)
+        c_log_error(LOG_TAG, "no texture stream workers, textures stay placeholders");
+}
+
+void textureStreamUnload(TextureStream *ts)
+{
+    workQueueUnload(&ts->queue, textureStreamDiscard);
+
+    for (int i = 0; i < arrlen(ts->textures); ++i) {
+        struct StreamedTexture *t = &ts->textures[i];
+        if (ts->gpu && t->texture.id != ts->placeholder.id)
+            UnloadTexture(t->texture);
+        if (t->base.data != NULL)
+            UnloadImage(t->base);
+    }
+    arrfree(ts->textures);
+    if (ts->gpu)
+        UnloadTexture(ts->placeholder);
+    *ts = (TextureStream) { 0 };
+}
+
+static void textureStreamQueue(TextureStream *ts, int id, int mip)
+{
+    struct StreamedTexture *t = &ts->textures[id];
+    struct TextureStreamJob *job = MemAlloc(sizeof(*job));
+    job->id = id;
+    job->mip = mip;
+    memcpy(job->path, t->path, sizeof(job->path));
+    t->loading = mip;
+
+    workQueuePush(&ts->queue, job, false);
+}
+
+int textureStreamLoad(TextureStream *ts, const char *path)
+{
+    int w, h, channels;
+    if (strlen(path) >= sizeof(ts->textures[0].path) || !stbi_info(path, &w, &h, &channels)) {
+        c_log_error(LOG_TAG, "could not read %s", path);
+        return -1;
+    }
+
+    struct StreamedTexture t = {
+        .texture = ts->placeholder, .width = w, .height = h, .mip_count = 1, .loading = -1,
+    };
+    strcpy(t.path, path);
+    int size = max(w, h);
+    while (size >> t.mip_count > 0)
+        t.mip_count++;
+    while (size >> t.base_mip > TEXTURE_STREAM_BASE_SIZE)
+        t.base_mip++;
+    t.resident = t.wanted = t.requested = t.mip_count;
+    arrput(ts->textures, t);
+
+    int id = arrlen(ts->textures) - 1;
+    textureStreamQueue(ts, id, t.base_mip);
+    return id;
+}
+
+Texture2D textureStreamUse(TextureStream *ts, int id, float size)
+{
+    if (id < 0 || id >= arrlen(ts->textures))
+        return ts->placeholder;
+    struct StreamedTexture *t = &ts->textures[id];
+    t->last_used = ts->frame;
+    /* a texel per pixel at least: mip k is max side >> k across */
+    int mip = size >= 1 ? (int)floorf(log2f(max(t->width, t->height) / size)) : t->base_mip;
+    t->wanted = min(t->wanted, min(max(mip, 0), t->base_mip));
+    return t->texture;
+}
+
+float textureStreamScreenSize(Camera3D camera, Vector3 position, float radius, int screen_height)
+{
+    if (camera.projection == CAMERA_ORTHOGRAPHIC)
+        return 2 * radius / camera.fovy * screen_height;
+    float d = Vector3Distance(camera.position, position);
+    if (d <= radius)
+        return screen_height;
+    return radius / (d * tanf(camera.fovy * 0.5f * DEG2RAD)) * screen_height;
+}
+
+static void textureStreamUpload(TextureStream *ts, struct StreamedTexture *t, Image image, int mip)
+{
+    double start = time_ms();
+    if (ts->gpu) {
+        Texture2D texture = LoadTextureFromImage(image);
+        SetTextureFilter(texture, image.mipmaps > 1 ? TEXTURE_FILTER_TRILINEAR : TEXTURE_FILTER_BILINEAR);
+        SetTextureWrap(texture, TEXTURE_WRAP_REPEAT);
+        if (t->texture.id != ts->placeholder.id)
+            UnloadTexture(t->texture);
+        t->texture = texture;
+    }
+    size_t bytes = textureStreamChainBytes(t, mip);
+    ts->resident_bytes = ts->resident_bytes - t->bytes + bytes;
+    t->bytes = bytes;
+    t->resident = mip;
+    ts->upload_ms += time_ms() - start;
+}
+
+/* back to the base mip, least recently used first, until need more bytes fit */
+static bool textureStreamMakeRoom(TextureStream *ts, size_t need, int keep)
+{
+    while (ts->resident_bytes + need > ts->budget) {
+        int lru = -1;
+        for (int i = 0; i < arrlen(ts->textures); ++i) {
+            const struct StreamedTexture *t = &ts->textures[i];
+            /* what this frame draws stays */
+            if (i == keep || t->resident >= t->base_mip || t->last_used == ts->frame)
+                continue;
+            if (lru < 0 || t->last_used < ts->textures[lru].last_used)
+                lru = i;
+        }
+        if (lru < 0)
+            return false;
+        struct StreamedTexture *t = &ts->textures[lru];
+        textureStreamUpload(ts, t, t->base, t->base_mip);
+        ts->evictions++;
+    }
+    return true;
+}
+
+static void textureStreamCollect(TextureStream *ts)
+{
+    void **done = workQueueTake(&ts->queue);
+    for (int i = 0; i < arrlen(done); ++i) {
+        struct TextureStreamJob *job = done[i];
+        struct StreamedTexture *t = &ts->textures[job->id];
+        ts->decode_ms += job->ms;
+        t->loading = -1;
+        if (job->image.data == NULL) {
+            c_log_error(LOG_TAG, "could not stream %s", t->path);
+            t->failed = true;
+            ts->failures++;
+        } else if (job->mip == t->base_mip) {
+            /* kept on the cpu, evictions go back to it without a load */
+            t->base = job->image;
+            textureStreamUpload(ts, t, t->base, t->base_mip);
+            ts->loads++;
+        } else {
+            size_t bytes = textureStreamChainBytes(t, job->mip);
+            if (textureStreamMakeRoom(ts, bytes - min(bytes, t->bytes), job->id)) {
+                textureStreamUpload(ts, t, job->image, job->mip);
+                ts->loads++;
+            } else {
+                ts->deferred++;
+            }
+            UnloadImage(job->image);
+        }
+        MemFree(job);
+    }
+    arrfree(done);
+}
+
+static size_t textureStreamPinned(const TextureStream *ts, const struct StreamedTexture *t)
+{
+    if (t->loading >= 0 && t->loading < t->resident)
+        return textureStreamChainBytes(t, t->loading);
+    if (t->last_used == ts->frame || t->resident >= t->base_mip)
+        return t->bytes;
+    return textureStreamChainBytes(t, t->base_mip);
+}
+
+void textureStreamUpdate(TextureStream *ts)
+{
+    textureStreamCollect(ts);
+
+    /* what stays whatever gets evicted: this frame's textures, every base
+     * and the loads still on their way */
+    size_t pinned = 0;
+    for (int i = 0; i < arrlen(ts->textures); ++i)
+        pinned += textureStreamPinned(ts, &ts->textures[i]);
+
+    int outstanding = workQueueOutstanding(&ts->queue);
+
+    for (int i = 0; i < arrlen(ts->textures); ++i) {
+        struct StreamedTexture *t = &ts->textures[i];
+        int mip = t->wanted;
+        t->requested = t->wanted;
+        t->wanted = t->mip_count;
+        if (t->failed || t->loading >= 0 || t->base.data == NULL || mip >= t->resident
+                || outstanding >= TEXTURE_STREAM_MAX_IN_FLIGHT)
+            continue;
+        /* the finest mip that fits next to everything pinned, loads that
+         * could only be dropped are not worth decoding */
+        size_t held = textureStreamPinned(ts, t);
+        while (mip < t->resident && pinned - held + textureStreamChainBytes(t, mip) > ts->budget)
+            mip++;
+        if (mip >= t->resident)
+            continue;
+        pinned = pinned - held + textureStreamChainBytes(t, mip);
+        textureStreamQueue(ts, i, mip);
+        outstanding++;
+    }
+    ts->outstanding = outstanding;
+    ts->frame++;
+}
+
+void textureStreamWait(TextureStream *ts)
+{
+    workQueueWait(&ts->queue);
+    textureStreamCollect(ts);
+}
+
+void textureStreamDrawDebug(const TextureStream *ts, TextFont font, Vector2 position)
+{
+    char str[256];
+    const float mib = 1024 * 1024;
+    float x = position.x, y = position.y;
+    stbsp_snprintf(str, sizeof(str), "textures: %.2f / %.2f MiB / %d loads, %d evicted, %d deferred, %d outstanding",
+            ts->resident_bytes / mib, ts->budget / mib, ts->loads, ts->evictions, ts->deferred, ts->outstanding);
+    textDrawSlot(font, ts, 0, str, (Vector2) { x, y }, 18, 1, YELLOW);
+    y += 22;
+    float fill = ts->budget > 0 ? fminf((float)ts->resident_bytes / ts->budget, 1) : 1;
+    DrawRectangle(x, y, 300, 8, DARKGRAY);
+    DrawRectangle(x, y, 300 * fill, 8, fill > 0.9f ? ORANGE : LIME);
+    y += 14;
+
+    for (int i = 0; i < arrlen(ts->textures) && y < GetScreenHeight(); ++i, y += 36) {
+        const struct StreamedTexture *t = &ts->textures[i];
+        DrawTexturePro(t->texture, (Rectangle) { 0, 0, t->texture.width, t->texture.height },
+                (Rectangle) { x, y, 32, 32 }, (Vector2) { 0 }, 0, WHITE);
+        /* one box per mip, finest left: resident green, wanted on top orange */
+        for (int k = 0; k < t->mip_count; ++k) {
+            Color c = t->resident <= k ? LIME : t->requested <= k ? ORANGE : DARKGRAY;
+            DrawRectangle(x + 40 + k * 10, y + 22, 8, 8, c);
+        }
+        const char *name = strrchr(t->path, '/');
+        bool used = t->last_used + 1 == ts->frame;
+        stbsp_snprintf(str, sizeof(str), "%s %d x %d of %d x %d, %.0f KiB%s", name ? name + 1 : t->path,
+                textureStreamMipSize(t->width, min(t->resident, t->mip_count - 1)),
+                textureStreamMipSize(t->height, min(t->resident, t->mip_count - 1)),
+                t->width, t->height, t->bytes / 1024.0f, t->failed ? " failed" : t->loading >= 0 ? " loading" : "");
+        textDraw(font, str, (Vector2) { x + 40, y }, 16, 1, t->failed ? RED : used ? WHITE : GRAY);
+    }
+}
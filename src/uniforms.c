@@ -0,0 +1,81 @@
+/*****************************************************
+Create Date:        2024-12-10
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/uniforms.h"
+#include "../include/raylib/rlgl.h"
+#include "../include/glad/glad.h"
+
+_Static_assert(sizeof(struct FrameUniforms) == 544, "FrameUniforms must match the std140 FrameBlock");
+_Static_assert(sizeof(struct SceneUniforms) == 64, "SceneUniforms must match the std140 SceneBlock");
+
+struct UniformBuffers uniform_buffers;
+
+static unsigned int uniformsCreate(int binding, size_t size)
+{
+    unsigned int ubo;
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return ubo;
+}
+
+void uniformsInit(void)
+{
+    uniform_buffers = (struct UniformBuffers) { 0 };
+    uniform_buffers.frame_ubo = uniformsCreate(UNIFORMS_FRAME_BINDING, sizeof(struct FrameUniforms));
+    uniform_buffers.scene_ubo = uniformsCreate(UNIFORMS_SCENE_BINDING, sizeof(struct SceneUniforms));
+}
+
+void uniformsUnload(void)
+{
+    glDeleteBuffers(1, &uniform_buffers.frame_ubo);
+    glDeleteBuffers(1, &uniform_buffers.scene_ubo);
+    uniform_buffers = (struct UniformBuffers) { 0 };
+}
+
+void uniformsBindBlocks(Shader shader)
+{
+    GLuint frame = glGetUniformBlockIndex(shader.id, "FrameBlock");
+    if (frame != GL_INVALID_INDEX)
+        glUniformBlockBinding(shader.id, frame, UNIFORMS_FRAME_BINDING);
+    GLuint scene = glGetUniformBlockIndex(shader.id, "SceneBlock");
+    if (scene != GL_INVALID_INDEX)
+        glUniformBlockBinding(shader.id, scene, UNIFORMS_SCENE_BINDING);
+}
+
+void uniformsSetCamera(Camera3D camera, float aspect)
+{
+    struct FrameUniforms *f = &uniform_buffers.frame;
+    Matrix view = MatrixLookAt(camera.position, camera.target, camera.up);
+    Matrix proj = MatrixPerspective(camera.fovy * DEG2RAD, aspect,
+            rlGetCullDistanceNear(), rlGetCullDistanceFar());
+    f->view = MatrixToFloatV(view);
+    f->projection = MatrixToFloatV(proj);
+    f->view_pos = camera.position;
+    f->view_forward = Vector3Normalize(Vector3Subtract(camera.target, camera.position));
+    f->time = GetTime();
+}
+
+static void uniformsUpload(unsigned int ubo, const void *data, size_t size)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void uniformsUploadFrame(void)
+{
+    uniformsUpload(uniform_buffers.frame_ubo, &uniform_buffers.frame, sizeof(struct FrameUniforms));
+}
+
+void uniformsUploadScene(void)
+{
+    uniformsUpload(uniform_buffers.scene_ubo, &uniform_buffers.scene, sizeof(struct SceneUniforms));
+}
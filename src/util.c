@@ -1,3 +1,6 @@
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "../include/obh/util.h"
 
 void arr_i_print(const int *arr, const int len)
@@ -85,4 +88,217 @@ sds sdsfread(sds append_to, const char* path)
     return append_to;
 }
 
+double time_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+void mkdir_p(const char *dir)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s", dir);
+    for (char *p = path + 1; *p; ++p) {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        mkdir(path, 0755);
+        *p = '/';
+    }
+    mkdir(path, 0755);
+}
+
+static void *workQueueWorker(void *arg)
+{
+    WorkQueue *q = arg;
+    pthread_mutex_lock(&q->lock);
+    for (;;) {
+        while (!q->quit && arrlen(q->pending) == 0)
+            pthread_cond_wait(&q->work, &q->lock);
+        if (q->quit)
+            break;
+        void *job = q->pending[0];
+        arrdel(q->pending, 0);
+        q->in_flight++;
+        pthread_mutex_unlock(&q->lock);
+
+        job = q->run(job, q->user);
+
+        pthread_mutex_lock(&q->lock);
+        q->in_flight--;
+        if (job != NULL)
+            arrput(q->done, job);
+        pthread_cond_broadcast(&q->idle);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return NULL;
+}
+
+int workQueueInit(WorkQueue *q, int threads, int max_threads, WorkQueueRun run, void *user, const char *name)
+{
+    *q = (WorkQueue) { .run = run, .user = user };
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    threads = min(max(threads, 1), min(max_threads, WORK_QUEUE_MAX_THREADS));
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->work, NULL);
+    pthread_cond_init(&q->idle, NULL);
+    for (int i = 0; i < threads; ++i) {
+        if (pthread_create(&q->threads[i], NULL, workQueueWorker, q) != 0) {
+            c_log_warn(LOG_TAG, "%s worker %d could not start", name, i);
+            break;
+        }
+        q->thread_count++;
+    }
+    return q->thread_count;
+}
+
+void workQueueUnload(WorkQueue *q, void (*discard)(void *job))
+{
+    pthread_mutex_lock(&q->lock);
+    q->quit = true;
+    pthread_cond_broadcast(&q->work);
+    pthread_mutex_unlock(&q->lock);
+    for (int i = 0; i < q->thread_count; ++i)
+        pthread_join(q->threads[i], NULL);
+    pthread_cond_destroy(&q->idle);
+    pthread_cond_destroy(&q->work);
+    pthread_mutex_destroy(&q->lock);
+
+    for (int i = 0; i < arrlen(q->pending); ++i)
+        discard(q->pending[i]);
+    for (int i = 0; i < arrlen(q->done); ++i)
+        discard(q->done[i]);
+    arrfree(q->pending);
+    arrfree(q->done);
+    *q = (WorkQueue) { 0 };
+}
+
+void workQueuePush(WorkQueue *q, void *job, bool front)
+{
+    pthread_mutex_lock(&q->lock);
+    if (front)
+        arrins(q->pending, 0, job);
+    else
+        arrput(q->pending, job);
+    pthread_cond_signal(&q->work);
+    pthread_mutex_unlock(&q->lock);
+}
+
+void **workQueueTake(WorkQueue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    void **done = q->done;
+    q->done = NULL;
+    pthread_mutex_unlock(&q->lock);
+    return done;
+}
+
+int workQueueOutstanding(WorkQueue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    int outstanding = arrlen(q->pending) + q->in_flight;
+    pthread_mutex_unlock(&q->lock);
+    return outstanding;
+}
+
+void workQueueWait(WorkQueue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->thread_count > 0 && (arrlen(q->pending) > 0 || q->in_flight > 0))
+        pthread_cond_wait(&q->idle, &q->lock);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void jobPoolWork(JobPool *pool, int thread)
+{
+    for (;;) {
+        int i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+        if (i >= pool->items)
+            return;
+        pool->run(pool->user, i, thread);
+    }
+}
 
+static void *jobPoolWorker(void *arg)
+{
+    struct JobPoolThread *th = arg;
+    JobPool *pool = th->pool;
+    /* dispatches wait for every worker, so none falls more than one behind */
+    u64 seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->quit && pool->generation == seen)
+            pthread_cond_wait(&pool->work, &pool->lock);
+        if (pool->quit)
+            break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        jobPoolWork(pool, th->index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0)
+            pthread_cond_signal(&pool->idle);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int jobPoolInit(JobPool *pool, int threads, int max_threads, const char *name)
+{
+    *pool = (JobPool) { 0 };
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = min(max(threads, 1), min(max_threads, JOB_POOL_MAX_THREADS));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    pool->thread_count = 1;
+    pool->threads[0] = (struct JobPoolThread) { .pool = pool, .index = 0 };
+    for (int i = 1; i < threads; ++i) {
+        struct JobPoolThread *th = &pool->threads[i];
+        *th = (struct JobPoolThread) { .pool = pool, .index = i };
+        if (pthread_create(&th->id, NULL, jobPoolWorker, th) != 0) {
+            c_log_warn(LOG_TAG, "%s worker %d could not start", name, i);
+            break;
+        }
+        pool->thread_count++;
+    }
+    return pool->thread_count;
+}
+
+void jobPoolUnload(JobPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->thread_count; ++i)
+        pthread_join(pool->threads[i].id, NULL);
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    *pool = (JobPool) { 0 };
+}
+
+void jobPoolDispatch(JobPool *pool, int items, JobPoolRun run, void *user)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->run = run;
+    pool->user = user;
+    pool->items = items;
+    pool->next = 0;
+    pool->running = pool->thread_count - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    jobPoolWork(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0)
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
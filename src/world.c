@@ -0,0 +1,110 @@
+/*****************************************************
+Create Date:        2024-11-28
+Author:             Oskar Bahner Hansen
+Email:              cph-oh82@cphbusiness.dk
+Description:        exercise in games programming
+License:            none
+*****************************************************/
+
+#include "../include/obh/world.h"
+
+struct WorldMap *world_map;
+u64 world_revision;
+
+static void worldChunkUpdateBounds(struct WorldChunk *wc)
+{
+    wc->y_min = INT_MAX;
+    wc->y_max = INT_MIN;
+    for (int z = 0; z < CHUNKSIZE; ++z) {
+        for (int x = 0; x < CHUNKSIZE; ++x) {
+            wc->y_min = min(wc->y_min, wc->cubes[z][x].y);
+            wc->y_max = max(wc->y_max, wc->cubes[z][x].y);
+        }
+    }
+}
+
+struct WorldChunk genWorldChunk(int x, int z)
+{
+    struct WorldChunk wc = { .coord = { .x = x, .y = z } };
+
+    Image perlin_img = GenImagePerlinNoise(CHUNKSIZE, CHUNKSIZE, x * CHUNKSIZE, z * CHUNKSIZE, 0.6);
+    Color* perlin_colors = perlin_img.data;
+    for (int i = 0; i < CHUNKSIZE; i += 1) {
+        for (int j = 0; j < CHUNKSIZE; j += 1) {
+            wc.cubes[i][j] = (struct Cube) {.x = j,
+                    .y = perlin_colors[(CHUNKSIZE - i - 1) * CHUNKSIZE + j].r / HEIGHTLEVELS,
+                    .z = CHUNKSIZE - i - 1 };
+        }
+    }
+    UnloadImage(perlin_img);
+
+    worldChunkUpdateBounds(&wc);
+    wc.revision = ++world_revision;
+
+    return wc;
+}
+
+iVec2 getChunkCoords(Vector3 position)
+{
+    int chunk_x = floor(floor(position.x) / CHUNKSIZE);
+    int chunk_z = floor(floor(position.z) / CHUNKSIZE);
+    return (iVec2) { chunk_x, chunk_z };
+}
+
+void genWorldAround(Vector3 position, int radius)
+{
+    iVec2 chunk_pos = getChunkCoords(position);
+    int chunk_x = chunk_pos.x;
+    int chunk_z = chunk_pos.y;
+
+    for (int i = -radius; i <= radius; ++i) {
+        for (int j = -radius; j <= radius; ++j) {
+            iVec2 chunk_pos_inner = { chunk_x + j, chunk_z + i };
+            if (hmgeti(world_map, chunk_pos_inner) >= 0)
+                continue;
+            struct WorldChunk wc = genWorldChunk(chunk_pos_inner.x, chunk_pos_inner.y);
+            hmput(world_map, chunk_pos_inner, wc);
+        }
+    }
+}
+
+int worldColumnHeight(const struct WorldChunk *wc, int x, int z)
+{
+    /* genWorldChunk stores rows flipped, row i holds local z = CHUNKSIZE - i - 1 */
+    return wc->cubes[CHUNKSIZE - z - 1][x].y;
+}
+
+Vector3 worldCubePosition(const struct WorldChunk *wc, int z, int x)
+{
+    return (Vector3) {
+        wc->cubes[z][x].x + wc->coord.x * CHUNKSIZE,
+        wc->cubes[z][x].y,
+        wc->cubes[z][x].z + wc->coord.y * CHUNKSIZE,
+    };
+}
+
+BoundingBox worldChunkBoundingBox(const struct WorldChunk *wc)
+{
+    /* cubes are unit sized and centered on their position */
+    return (BoundingBox) {
+        .min = { wc->coord.x * CHUNKSIZE - 0.5f, wc->y_min - 0.5f, wc->coord.y * CHUNKSIZE - 0.5f },
+        .max = { (wc->coord.x + 1) * CHUNKSIZE - 0.5f, wc->y_max + 0.5f, (wc->coord.y + 1) * CHUNKSIZE - 0.5f },
+    };
+}
+
+bool worldSetColumnHeight(Vector3 position, int height)
+{
+    iVec2 chunk_pos = getChunkCoords(position);
+    struct WorldMap *entry = hmgetp_null(world_map, chunk_pos);
+    if (entry == NULL)
+        return false;
+
+    int x = (int)floor(position.x) - chunk_pos.x * CHUNKSIZE;
+    int z = (int)floor(position.z) - chunk_pos.y * CHUNKSIZE;
+    /* genWorldChunk stores rows flipped, row i holds local z = CHUNKSIZE - i - 1 */
+    entry->chunk.cubes[CHUNKSIZE - z - 1][x].y = height;
+    worldChunkUpdateBounds(&entry->chunk);
+    entry->chunk.revision = ++world_revision;
+
+    return true;
+}